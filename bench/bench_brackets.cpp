@@ -0,0 +1,166 @@
+// Matching brackets in a generated 100k-line C++ file wrapped in a namespace, with the cursor in the middle: the
+// innermost pair around the cursor and the pair enclosing the whole file (its brackets are 4 MB apart), through the
+// bracket index, against scanning the text from the cursor. The brackets in the strings and comments of the file are
+// balanced so that the scan, which doesn't skip them, finds the same pairs. Also the cost of filling the index while
+// lexing the file, and of typing in the middle (an edit, lexing the edited line again, then both queries). Run with
+// "make bench".
+
+#include "bracket_index.h"
+#include "cpp_highlighter.h"
+#include "piece_table.h"
+#include <stdio.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+static const size_t LINE_COUNT = 100000;
+static const int QUERIES = 10000;
+static const int FRAMES = 1000;
+
+// Functions of a few lines to a few dozen, with brackets in strings and comments too
+static std::string MakeText()
+{
+    static const char* lines[] = {
+        "    int value = compute(lhs, rhs[2]); // (some) generated code\n",
+        "    if (value > limit && (flags & 0x1F))\n        return Result(value, \"too large: (%d)\");\n",
+        "    for (int n = 0; n < count; n++) {\n        sum += table[n];\n    }\n",
+        "    /* A comment spanning\n       two lines {} */\n",
+    };
+    std::string text = "namespace generated {\n";
+    for (unsigned n = 1; text.size() < LINE_COUNT * 40; n = n * 1103515245u + 12345u)
+    {
+        text += "static int Function(int lhs, int rhs)\n{\n";
+        for (unsigned line = 0; line < 2 + (n >> 20) % 30; line++)
+            text += lines[(n >> (line % 16)) % (sizeof(lines) / sizeof(lines[0]))];
+        text += "    return value;\n}\n";
+    }
+    text += "}\n";
+    return text;
+}
+
+static double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+static bool IsOpening(char c)
+{
+    return c == '(' || c == '[' || c == '{';
+}
+
+static bool IsClosing(char c)
+{
+    return c == ')' || c == ']' || c == '}';
+}
+
+// Without an index: the last bracket before 'pos' left open, then the one closing it
+static bool ScanEnclosing(const PieceTable& text, size_t pos, size_t* out_open, size_t* out_close)
+{
+    int depth = 0;
+    size_t open = pos;
+    while (open > 0)
+    {
+        const char c = text.CharAt(--open);
+        depth += IsClosing(c) ? 1 : IsOpening(c) ? -1 : 0;
+        if (depth < 0)
+            break;
+    }
+    if (depth >= 0)
+        return false;
+    depth = 0;
+    for (size_t close = open + 1; close < text.Size(); close++)
+    {
+        const char c = text.CharAt(close);
+        depth += IsOpening(c) ? 1 : IsClosing(c) ? -1 : 0;
+        if (depth < 0)
+        {
+            *out_open = open;
+            *out_close = close;
+            return true;
+        }
+    }
+    return false;
+}
+
+int main()
+{
+    const std::string source = MakeText();
+    PieceTable text;
+    text.Load(source.data(), source.size());
+    const size_t line_count = text.LineCount();
+
+    // Lexing the whole file, with and without filling the index
+    CppHighlighter plain;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    while (!plain.Update(text, line_count - 1))
+    {
+    }
+    const double plain_ms = ElapsedMs(start);
+    BracketIndex brackets;
+    CppHighlighter highlighter;
+    highlighter.SetBracketIndex(&brackets);
+    text.AddListener(&brackets);
+    text.AddListener(&highlighter);
+    start = std::chrono::steady_clock::now();
+    while (!highlighter.Update(text, line_count - 1))
+    {
+    }
+    printf("%zu lines (%.1f MB), %zu brackets. Lexing them %.1f ms, %.1f ms filling the index\n", line_count, (double)source.size() / (1024 * 1024), brackets.Count(), plain_ms, ElapsedMs(start));
+
+    const size_t middle = text.LineStart(line_count / 2) + 8;
+    size_t open = 0, close = 0, scan_open = 0, scan_close = 0;
+    size_t sum = 0;
+    start = std::chrono::steady_clock::now();
+    for (int query = 0; query < QUERIES; query++)
+        if (brackets.FindEnclosing(middle + query % 8, &open, &close))
+            sum += close - open;
+    printf("%-36s %8.5f ms per query\n", "innermost pair, index", ElapsedMs(start) / QUERIES);
+    start = std::chrono::steady_clock::now();
+    for (int query = 0; query < QUERIES / 100; query++)
+        if (ScanEnclosing(text, middle + query % 8, &scan_open, &scan_close))
+            sum += scan_close - scan_open;
+    printf("%-36s %8.5f ms per query\n", "innermost pair, scan", ElapsedMs(start) / (QUERIES / 100));
+    if (!brackets.FindEnclosing(middle, &open, &close) || !ScanEnclosing(text, middle, &scan_open, &scan_close) || open != scan_open || close != scan_close)
+    {
+        fprintf(stderr, "the index and the scan found different pairs\n");
+        return 1;
+    }
+
+    // The namespace's braces, from between two functions
+    size_t outer = middle;
+    while (outer < text.Size() && !(text.CharAt(outer) == '\n' && text.CharAt(outer + 1) == 's'))
+        outer++;
+    start = std::chrono::steady_clock::now();
+    for (int query = 0; query < QUERIES; query++)
+        if (brackets.FindEnclosing(outer, &open, &close))
+            sum += close - open;
+    printf("%-36s %8.5f ms per query (%zu bytes apart)\n", "whole file pair, index", ElapsedMs(start) / QUERIES, close - open);
+    start = std::chrono::steady_clock::now();
+    for (int query = 0; query < 10; query++)
+        if (ScanEnclosing(text, outer, &scan_open, &scan_close))
+            sum += scan_close - scan_open;
+    printf("%-36s %8.5f ms per query\n", "whole file pair, scan", ElapsedMs(start) / 10);
+    if (open != source.find('{') || close != text.Size() - 2)
+    {
+        fprintf(stderr, "the pair around the functions isn't the namespace's braces\n");
+        return 1;
+    }
+
+    // Typing in the middle: one character per frame, a bracket every 10
+    size_t pos = middle;
+    start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < FRAMES; frame++)
+    {
+        text.Insert(pos++, frame % 10 == 9 ? "(" : "x", 1);
+        highlighter.Update(text, line_count - 1);
+        if (brackets.FindEnclosing(pos, &open, &close))
+            sum += close - open;
+        if (brackets.FindMatch(pos - 1, &close))
+            sum += close;
+    }
+    printf("%-36s %8.5f ms per frame\n", "typing in the middle", ElapsedMs(start) / FRAMES);
+    text.RemoveListener(&highlighter);
+    text.RemoveListener(&brackets);
+    return sum == 0;
+}
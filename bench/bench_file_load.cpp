@@ -0,0 +1,94 @@
+// File open throughput: LoadFile() (stat, one allocation, large reads) vs. the old OpenFile() loop that read the
+// file one character at a time through std::ifstream into a growing string. Files of 1 MB, 100 MB and 1 GB are
+// generated in the current directory and deleted afterwards.
+// Run with "make bench".
+
+#include "file_io.h"
+#include "piece_table.h"
+#include <stdio.h>
+#include <chrono>
+#include <fstream>
+#include <string>
+
+static const char* BENCH_FILE = "bench_file_load.tmp";
+
+static bool WriteFile(const char* filename, size_t size)
+{
+    FILE* f = fopen(filename, "wb");
+    if (f == NULL)
+        return false;
+    static const char line[] = "    int value = compute(lhs, rhs); // some generated code\n";
+    std::string block;
+    while (block.size() < 1024 * 1024)
+        block += line;
+    for (size_t written = 0; written < size; )
+    {
+        const size_t len = size - written < block.size() ? size - written : block.size();
+        if (fwrite(block.data(), 1, len, f) != len)
+        {
+            fclose(f);
+            return false;
+        }
+        written += len;
+    }
+    return fclose(f) == 0;
+}
+
+// What OpenFile() used to do
+static void LoadFileByChar(const char* filename, PieceTable* out)
+{
+    std::ifstream InFile(filename);
+    std::string fileText;
+    char byte;
+    while (InFile.get(byte))
+        fileText.push_back(byte);
+    out->Load(fileText.data(), fileText.size());
+}
+
+// Best of 'runs', in MB/s
+static double Bench(bool by_char, size_t size, int runs)
+{
+    double best_ms = 0.0;
+    for (int n = 0; n < runs; n++)
+    {
+        PieceTable text;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (by_char)
+            LoadFileByChar(BENCH_FILE, &text);
+        else
+            LoadFile(BENCH_FILE, &text);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        if (text.Size() != size)
+        {
+            fprintf(stderr, "loaded %zu bytes, expected %zu\n", text.Size(), size);
+            return 0.0;
+        }
+        if (n == 0 || elapsed.count() < best_ms)
+            best_ms = elapsed.count();
+    }
+    return (double)size / (1024.0 * 1024.0) / (best_ms / 1000.0);
+}
+
+int main()
+{
+    const size_t MB = 1024 * 1024;
+    const size_t sizes[] = { 1 * MB, 100 * MB, 1024 * MB };
+    printf("%-10s %20s %20s\n", "size", "LoadFile MB/s", "per-char MB/s");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        const size_t size = sizes[i];
+        if (!WriteFile(BENCH_FILE, size))
+        {
+            fprintf(stderr, "can't write %zu MB to %s, skipping\n", size / MB, BENCH_FILE);
+            remove(BENCH_FILE);
+            continue;
+        }
+        // Files are read from the page cache after the first run: this measures the loading code, not the disk
+        const int runs = size > 100 * MB ? 1 : 3;
+        const double bulk = Bench(false, size, runs + 1);
+        const double by_char = Bench(true, size, runs);
+        printf("%7zu MB %20.1f %20.1f\n", size / MB, bulk, by_char);
+        remove(BENCH_FILE);
+    }
+    return 0;
+}
@@ -0,0 +1,101 @@
+// Searching a 1 GB document: FindText() (SIMD first/last byte filter) vs. memchr() + memcmp() on every occurrence of
+// the first byte, and the time a full TextSearch takes on its worker thread vs. what Start() costs the UI thread.
+// Run with "make bench".
+
+#include "piece_table.h"
+#include "text_search.h"
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+static const size_t DOCUMENT_SIZE = 1024 * 1024 * 1024;
+
+static std::unique_ptr<char[]> MakeText(size_t size)
+{
+    std::unique_ptr<char[]> text(new char[size]);
+    static const char line[] = "    int value = compute(lhs, rhs); // some generated code\n";
+    for (size_t i = 0; i < size; i++)
+        text[i] = line[i % (sizeof(line) - 1)];
+    return text;
+}
+
+static double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+// The usual scalar search: jump to each occurrence of the first byte and compare the rest
+static const char* FindWithMemchr(const char* haystack, size_t haystack_len, const char* needle, size_t needle_len)
+{
+    const char* last = haystack + (haystack_len - needle_len);
+    for (const char* p = haystack; p <= last; p++)
+    {
+        p = (const char*)memchr(p, needle[0], (size_t)(last - p) + 1);
+        if (p == NULL)
+            return NULL;
+        if (memcmp(p + 1, needle + 1, needle_len - 1) == 0)
+            return p;
+    }
+    return NULL;
+}
+
+static size_t CountMatches(const char* data, size_t size, const char* needle, bool simd, bool ignore_case)
+{
+    const size_t needle_len = strlen(needle);
+    size_t count = 0;
+    for (const char* p = data; p < data + size; p += needle_len)
+    {
+        p = simd ? FindText(p, (size_t)(data + size - p), needle, needle_len, ignore_case) : FindWithMemchr(p, (size_t)(data + size - p), needle, needle_len);
+        if (p == NULL)
+            break;
+        count++;
+    }
+    return count;
+}
+
+int main()
+{
+    std::unique_ptr<char[]> data = MakeText(DOCUMENT_SIZE);
+    const char* needles[] = { "not in the text", "compute(", "value" };
+
+    printf("%-18s %10s %14s %14s %18s\n", "needle", "matches", "memchr GB/s", "FindText GB/s", "ignore case GB/s");
+    for (size_t n = 0; n < sizeof(needles) / sizeof(needles[0]); n++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        const size_t scalar_count = CountMatches(data.get(), DOCUMENT_SIZE, needles[n], false, false);
+        const double scalar_ms = ElapsedMs(start);
+        start = std::chrono::steady_clock::now();
+        const size_t count = CountMatches(data.get(), DOCUMENT_SIZE, needles[n], true, false);
+        const double simd_ms = ElapsedMs(start);
+        start = std::chrono::steady_clock::now();
+        const size_t ignore_case_count = CountMatches(data.get(), DOCUMENT_SIZE, needles[n], true, true);
+        const double ignore_case_ms = ElapsedMs(start);
+        if (count != scalar_count || count != ignore_case_count)
+        {
+            fprintf(stderr, "%s: %zu matches vs %zu / %zu\n", needles[n], count, scalar_count, ignore_case_count);
+            return 1;
+        }
+        const double gb = (double)DOCUMENT_SIZE / 1e9;
+        printf("%-18s %10zu %14.2f %14.2f %18.2f\n", needles[n], count, gb / (scalar_ms / 1000.0), gb / (simd_ms / 1000.0), gb / (ignore_case_ms / 1000.0));
+    }
+
+    // The same text in a piece table, searched in the background
+    PieceTable text;
+    text.Load(std::move(data), DOCUMENT_SIZE);
+    text.Insert(DOCUMENT_SIZE / 2, "not in the text");
+    printf("\n%-18s %10s %14s %14s\n", "TextSearch", "matches", "Start() ms", "search ms");
+    for (size_t n = 0; n < sizeof(needles) / sizeof(needles[0]); n++)
+    {
+        TextSearch search;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        search.Start(text, needles[n], false);
+        const double start_ms = ElapsedMs(start);
+        while (search.IsSearching())
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        printf("%-18s %10zu %14.2f %14.1f\n", needles[n], search.MatchCount(), start_ms, ElapsedMs(start));
+    }
+    return 0;
+}
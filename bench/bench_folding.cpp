@@ -0,0 +1,166 @@
+// Cost per frame of laying out the rows of a generated 100k-line C++ file with every block folded, for a view of 60
+// rows: mapping the first visible row to its line through the fold index and walking the visible lines from there,
+// while scrolling through the rows. The same walk over the file with nothing folded is timed for reference, and so is
+// finding the first visible row by counting the lines not hidden from the top, the way a flag per line would. Also
+// times finding the regions (lexing the whole file once) and typing in the middle with every block folded. Rows must
+// land on the same lines both ways. Run with "make bench".
+
+#include "code_folding.h"
+#include "cpp_highlighter.h"
+#include "piece_table.h"
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+static const size_t LINE_COUNT = 100000;
+static const size_t VIEW_ROWS = 60;
+static const int FRAMES = 1000;
+
+// Functions of a few lines to a few dozen, some with nested blocks, grouped in #pragma regions
+static std::string MakeText()
+{
+    std::string text;
+    size_t lines = 0;
+    for (unsigned n = 1; lines < LINE_COUNT; n = n * 1103515245u + 12345u)
+    {
+        if ((n >> 16) % 50 == 0)
+        {
+            text += "#pragma region Helpers\n";
+            lines++;
+        }
+        text += "static int Function(int lhs, int rhs) // { in a comment\n{\n";
+        const unsigned body = 2 + (n >> 20) % 30;
+        for (unsigned line = 0; line < body; line++)
+            text += line % 7 == 3 ? "    if (lhs > rhs) {\n        lhs = Compute(\"{\", rhs);\n    }\n" : "    lhs += rhs * 2;\n";
+        text += "    return lhs;\n}\n";
+        lines += 4 + body + (body + 3) / 7 * 2;
+        if ((n >> 16) % 50 == 49)
+        {
+            text += "#pragma endregion\n";
+            lines++;
+        }
+    }
+    return text;
+}
+
+static double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+// What the editor does per frame to lay out the view from 'first_row': the line of each visible row and where it
+// starts. 'folds' may be NULL. Returns a checksum of the lines.
+static size_t LayOut(const PieceTable& text, const FoldIndex* folds, size_t first_row)
+{
+    size_t line = folds != NULL ? folds->LineFromRow(first_row) : first_row;
+    size_t line_start = text.LineStart(line);
+    size_t sum = 0;
+    for (size_t row = 0; row < VIEW_ROWS; row++)
+    {
+        const size_t line_end = text.FindChar('\n', line_start);
+        sum += line * 31 + line_end - line_start;
+        if (line_end >= text.Size())
+            break;
+        const size_t next_line = folds != NULL ? folds->NextVisibleLine(line) : line + 1;
+        line_start = next_line == line + 1 ? line_end + 1 : text.LineStart(next_line);
+        line = next_line;
+    }
+    return sum;
+}
+
+// The same, finding the first row by walking the lines from the top with a hidden flag per line
+static size_t LayOutByFlags(const PieceTable& text, const std::vector<bool>& hidden, size_t first_row)
+{
+    size_t line = 0;
+    for (size_t row = 0; ; line++)
+        if (!hidden[line] && row++ == first_row)
+            break;
+    size_t line_start = text.LineStart(line);
+    size_t sum = 0;
+    for (size_t row = 0; row < VIEW_ROWS; row++)
+    {
+        const size_t line_end = text.FindChar('\n', line_start);
+        sum += line * 31 + line_end - line_start;
+        if (line_end >= text.Size())
+            break;
+        size_t next_line = line + 1;
+        while (next_line < hidden.size() && hidden[next_line])
+            next_line++;
+        line_start = next_line == line + 1 ? line_end + 1 : text.LineStart(next_line);
+        line = next_line;
+    }
+    return sum;
+}
+
+int main()
+{
+    const std::string source = MakeText();
+    PieceTable text;
+    text.Load(source.data(), source.size());
+    const size_t line_count = text.LineCount();
+    CppHighlighter highlighter;
+    FoldIndex folds;
+    text.AddListener(&highlighter);
+    text.AddListener(&folds);
+    folds.Update(text, &highlighter);
+
+    // Folding everything: a frame lexes UpdateBudget bytes, and finds the regions in what was lexed before
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    folds.FoldAll();
+    int fold_frames = 0;
+    double fold_frame_max_ms = 0.0;
+    while (folds.IsFoldPending())
+    {
+        std::chrono::steady_clock::time_point frame_start = std::chrono::steady_clock::now();
+        folds.Update(text, &highlighter);
+        highlighter.Update(text, line_count - 1);
+        fold_frame_max_ms = std::max(fold_frame_max_ms, ElapsedMs(frame_start));
+        fold_frames++;
+    }
+    printf("%zu lines, every region folded in %.2f ms, %d frames of %.2f ms at most\n", line_count, ElapsedMs(start), fold_frames, fold_frame_max_ms);
+    const size_t row_count = folds.RowCount(line_count);
+    printf("%zu rows with every region folded, %zu rows in view\n", row_count, VIEW_ROWS);
+
+    std::vector<bool> hidden(line_count);
+    for (size_t line = 0; line < line_count; line++)
+        hidden[line] = folds.IsHidden(line);
+    for (size_t row = 0; row + VIEW_ROWS <= row_count; row += 997)
+        if (LayOut(text, &folds, row) != LayOutByFlags(text, hidden, row))
+        {
+            fprintf(stderr, "the fold index and the flags put row %zu on different lines\n", row);
+            return 1;
+        }
+
+    // Scrolling through the rows, one page per frame
+    size_t sum = 0;
+    start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < FRAMES; frame++)
+        sum += LayOut(text, &folds, (size_t)frame * VIEW_ROWS % (row_count - VIEW_ROWS));
+    printf("%-34s %6d frames, %8.4f ms per frame\n", "scrolling, folded", FRAMES, ElapsedMs(start) / FRAMES);
+    start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < FRAMES; frame++)
+        sum += LayOut(text, NULL, (size_t)frame * VIEW_ROWS % (line_count - VIEW_ROWS));
+    printf("%-34s %6d frames, %8.4f ms per frame\n", "scrolling, nothing folded", FRAMES, ElapsedMs(start) / FRAMES);
+    start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < FRAMES; frame++)
+        sum += LayOutByFlags(text, hidden, (size_t)frame * VIEW_ROWS % (row_count - VIEW_ROWS));
+    printf("%-34s %6d frames, %8.4f ms per frame\n", "scrolling, folded, flag per line", FRAMES, ElapsedMs(start) / FRAMES);
+
+    // Typing on the first line of a fold in the middle (keeps every fold), a newline every 40 characters (outside of
+    // any block, which moves the folds after it)
+    size_t pos = text.LineStart(folds.LineFromRow(row_count / 2));
+    start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < FRAMES; frame++)
+    {
+        text.Insert(pos, frame % 40 == 39 ? "\n" : "x", 1);
+        folds.Update(text, &highlighter);
+        sum += LayOut(text, &folds, folds.RowFromLine(text.LineFromPos(pos)) - VIEW_ROWS / 2);
+    }
+    printf("%-34s %6d frames, %8.4f ms per frame, %zu rows left\n", "typing in the middle, folded", FRAMES, ElapsedMs(start) / FRAMES, folds.RowCount(text.LineCount()));
+    text.RemoveListener(&folds);
+    text.RemoveListener(&highlighter);
+    return sum == 0;
+}
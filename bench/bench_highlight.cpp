@@ -0,0 +1,134 @@
+// Cost per frame of the C++ highlighter on a generated 100k-line file, for a view of 60 rows: what the editor does
+// each frame (Update() up to the last visible row, then GetRuns() for each row), while scrolling, while typing in the
+// middle of the file, and when an edit turns the rest of the file into a comment and back. Lexing the file from the
+// top to the view every frame, without the state cache, is timed for comparison. Run with "make bench".
+
+#include "cpp_highlighter.h"
+#include "piece_table.h"
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+static const size_t LINE_COUNT = 100000;
+static const size_t VIEW_ROWS = 60;
+static const int FRAMES = 1000;
+
+static std::string MakeText()
+{
+    static const char* lines[] = {
+        "    int value = compute(lhs, rhs); // some generated code\n",
+        "    if (value > limit && flags & 0x1F)\n",
+        "        return Result(value, \"too large: \\\"%d\\\"\");\n",
+        "}\n",
+        "/* A comment spanning\n   two lines */\n",
+        "static const char* table[] = { \"one\", \"two\", R\"(raw \"text\")\" };\n",
+        "#define CHECK(x) if (!(x)) \\\n        abort()\n",
+        "template <typename T> static inline T Clamp(T v, T lo, T hi) { return v < lo ? lo : v > hi ? hi : v; }\n",
+    };
+    std::string text;
+    for (unsigned n = 1; text.size() < LINE_COUNT * 48; n = n * 1103515245u + 12345u)
+        text += lines[(n >> 16) % (sizeof(lines) / sizeof(lines[0]))];
+    return text;
+}
+
+static double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+// One frame of the editor with the view starting at 'first_line'. Returns the number of rows drawn with colors.
+static size_t DrawFrame(CppHighlighter* highlighter, const PieceTable& text, size_t first_line, std::string* scratch, std::vector<CppHighlighter::Run>* runs)
+{
+    const size_t last_line = std::min(first_line + VIEW_ROWS - 1, text.LineCount() - 1);
+    highlighter->Update(text, last_line);
+    size_t colored = 0;
+    size_t line_start = text.LineStart(first_line);
+    for (size_t line = first_line; line <= last_line; line++)
+    {
+        const size_t line_end = text.FindChar('\n', line_start);
+        scratch->resize(line_end - line_start);
+        text.Copy(line_start, line_end - line_start, &(*scratch)[0]);
+        runs->clear();
+        if (highlighter->GetRuns(line, scratch->data(), scratch->data() + scratch->size(), runs))
+            colored++;
+        line_start = line_end + 1;
+    }
+    return colored;
+}
+
+int main()
+{
+    const std::string source = MakeText();
+    PieceTable text;
+    text.Load(source.data(), source.size());
+    const size_t line_count = text.LineCount();
+    printf("%zu lines (%.1f MB), %zu rows in view, budget %zu KB per frame\n", line_count, (double)source.size() / (1024 * 1024), VIEW_ROWS, CppHighlighter::UpdateBudget / 1024);
+    std::string scratch;
+    std::vector<CppHighlighter::Run> runs;
+
+    // Opening the file and going to its end: rows are plain until the states are known
+    CppHighlighter highlighter;
+    text.AddListener(&highlighter);
+    int frames = 0;
+    double max_ms = 0.0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (;;)
+    {
+        std::chrono::steady_clock::time_point frame_start = std::chrono::steady_clock::now();
+        const size_t colored = DrawFrame(&highlighter, text, line_count - VIEW_ROWS, &scratch, &runs);
+        max_ms = std::max(max_ms, ElapsedMs(frame_start));
+        frames++;
+        if (colored == VIEW_ROWS)
+            break;
+    }
+    printf("%-34s %6d frames, %8.2f ms in all, %6.3f ms per frame at most\n", "jump to the end", frames, ElapsedMs(start), max_ms);
+
+    // Scrolling through the file, one page per frame
+    start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < FRAMES; frame++)
+        DrawFrame(&highlighter, text, (size_t)frame * VIEW_ROWS % (line_count - VIEW_ROWS), &scratch, &runs);
+    printf("%-34s %6d frames, %8.3f ms per frame\n", "scrolling", FRAMES, ElapsedMs(start) / FRAMES);
+
+    // Typing in the middle: one character per frame, a newline every 40
+    const size_t middle = line_count / 2;
+    size_t pos = text.LineStart(middle);
+    start = std::chrono::steady_clock::now();
+    max_ms = 0.0;
+    for (int frame = 0; frame < FRAMES; frame++)
+    {
+        std::chrono::steady_clock::time_point frame_start = std::chrono::steady_clock::now();
+        text.Insert(pos++, frame % 40 == 39 ? "\n" : "x", 1);
+        DrawFrame(&highlighter, text, text.LineFromPos(pos) - VIEW_ROWS / 2, &scratch, &runs);
+        max_ms = std::max(max_ms, ElapsedMs(frame_start));
+    }
+    printf("%-34s %6d frames, %8.3f ms per frame, %6.3f ms at most\n", "typing in the middle", FRAMES, ElapsedMs(start) / FRAMES, max_ms);
+
+    // Opening a block comment in the middle changes the state of every line after it, but only the visible ones are
+    // lexed again; closing it makes the states after it converge with the stale ones
+    pos = text.LineStart(middle);
+    start = std::chrono::steady_clock::now();
+    text.Insert(pos, "/*", 2);
+    DrawFrame(&highlighter, text, middle, &scratch, &runs);
+    const double open_ms = ElapsedMs(start);
+    start = std::chrono::steady_clock::now();
+    text.Insert(pos + 2, "*/", 2);
+    DrawFrame(&highlighter, text, middle, &scratch, &runs);
+    const double close_ms = ElapsedMs(start);
+    printf("%-34s %8.3f ms, closing it %.3f ms (%zu lines known)\n", "opening a block comment", open_ms, close_ms, highlighter.KnownLines());
+
+    // Without the cache: every frame lexes from the top of the file to the view
+    start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < 20; frame++)
+    {
+        CppHighlighter uncached;
+        while (DrawFrame(&uncached, text, middle, &scratch, &runs) < VIEW_ROWS)
+        {
+        }
+    }
+    printf("%-34s %6d frames, %8.3f ms per frame\n", "lexing from the top every frame", 20, ElapsedMs(start) / 20);
+    text.RemoveListener(&highlighter);
+    return 0;
+}
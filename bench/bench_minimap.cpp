@@ -0,0 +1,163 @@
+// Cost per frame of keeping the minimap of a generated 1M-line C++ file up to date, for a minimap showing 400 lines:
+// the CPU time of Minimap::Update() and the rows it leaves to upload to the texture, while scrolling through the file,
+// typing in the middle, adding a line per frame and jumping around. Redrawing every row shown each frame, the way a
+// minimap without the ring would, is timed for reference. The pixels must be the same both ways. Run with "make bench".
+
+#include "minimap.h"
+#include "cpp_highlighter.h"
+#include "piece_table.h"
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+
+static const size_t LINE_COUNT = 1000000;
+static const size_t SHOWN = 400;
+static const int FRAMES = 1000;
+static const ImU32 TEXT_COL = IM_COL32(255, 255, 255, 255);
+
+static std::string MakeText()
+{
+    std::string text;
+    for (size_t line = 0; line < LINE_COUNT; line++)
+    {
+        switch (line % 8)
+        {
+        case 0:  text += "// Adds 'rhs' to the total, twice\n"; break;
+        case 1:  text += "static int Function(int lhs, int rhs)\n"; break;
+        case 2:  text += "{\n"; break;
+        case 3:  text += "\tif (lhs > 0x40)\n"; break;
+        case 4:  text += "\t\treturn Compute(\"total\", rhs);\n"; break;
+        case 5:  text += "    lhs += rhs * 2; /* twice */\n"; break;
+        case 6:  text += "    return lhs;\n"; break;
+        default: text += "}\n"; break;
+        }
+    }
+    return text;
+}
+
+static double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+static size_t RowsDrawn(const Minimap& map)
+{
+    size_t rows = 0;
+    for (size_t n = 0; n < map.DirtyBands().size(); n++)
+        rows += map.DirtyBands()[n].RowCount;
+    return rows;
+}
+
+// Update 'map' for the view starting at 'first_line' the way the editor does every frame. 'redraw_all' redraws
+// every row shown, as if nothing was kept from the last frame. Returns the rows to upload.
+static size_t Frame(PieceTable& text, CppHighlighter* highlighter, Minimap* map, size_t first_line, bool redraw_all)
+{
+    highlighter->Update(text, first_line + SHOWN);
+    if (redraw_all)
+        map->OnEditLines(0, 0, 1);
+    map->Update(text, highlighter, first_line, SHOWN, TEXT_COL);
+    return RowsDrawn(*map);
+}
+
+// Are the rows of the lines shown from 'first_line' the same in both?
+static bool SamePixels(const Minimap& map, const Minimap& reference, size_t first_line)
+{
+    for (size_t line = first_line; line < first_line + SHOWN; line++)
+    {
+        const size_t row = (line % Minimap::Rows) * Minimap::Width;
+        if (memcmp(map.Pixels() + row, reference.Pixels() + row, Minimap::Width * sizeof(uint32_t)) != 0)
+        {
+            fprintf(stderr, "the ring and the redrawn rows differ at line %zu\n", line);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void Report(const char* name, double ms, size_t rows)
+{
+    printf("%-36s %8.4f ms per frame, %6.1f rows (%5.1f KB) uploaded per frame\n", name, ms / FRAMES, (double)rows / FRAMES, (double)rows * Minimap::Width * 4 / 1024 / FRAMES);
+}
+
+int main()
+{
+    const std::string source = MakeText();
+    PieceTable text;
+    text.Load(source.data(), source.size());
+    CppHighlighter highlighter;
+    text.AddListener(&highlighter);
+    Minimap map;
+    Minimap reference;
+    text.AddListener(&map);
+    text.AddListener(&reference);
+    printf("%zu lines (%.1f MB), %zu lines shown\n", text.LineCount(), (double)source.size() / (1024 * 1024), SHOWN);
+
+    // Scrolling down through the file, 3 lines per frame
+    size_t rows = 0;
+    size_t first = 0;
+    Frame(text, &highlighter, &map, first, false);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < FRAMES; frame++)
+        rows += Frame(text, &highlighter, &map, first += 3, false);
+    Report("scrolling, ring", ElapsedMs(start), rows);
+    rows = 0;
+    first = 0;
+    start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < FRAMES; frame++)
+        rows += Frame(text, &highlighter, &reference, first += 3, true);
+    Report("scrolling, redrawing all", ElapsedMs(start), rows);
+    if (!SamePixels(map, reference, first))
+        return 1;
+
+    // Typing in the middle of the lines shown, a character per frame
+    first = LINE_COUNT / 2;
+    Frame(text, &highlighter, &map, first, false);
+    size_t pos = text.LineStart(first + SHOWN / 2) + 4;
+    rows = 0;
+    start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < FRAMES; frame++)
+    {
+        text.Insert(pos++, "x", 1);
+        rows += Frame(text, &highlighter, &map, first, false);
+    }
+    Report("typing, ring", ElapsedMs(start), rows);
+    rows = 0;
+    start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < FRAMES; frame++)
+    {
+        text.Insert(pos++, "x", 1);
+        rows += Frame(text, &highlighter, &reference, first, true);
+    }
+    Report("typing, redrawing all", ElapsedMs(start), rows);
+
+    // A line added in the middle per frame: the lines after it move
+    rows = 0;
+    start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < FRAMES; frame++)
+    {
+        text.Insert(pos, "\n", 1);
+        rows += Frame(text, &highlighter, &map, first, false);
+    }
+    Report("adding lines, ring", ElapsedMs(start), rows);
+    Frame(text, &highlighter, &reference, first, true);
+    if (!SamePixels(map, reference, first))
+        return 1;
+
+    // Jumping to another place every frame: everything shown is new
+    rows = 0;
+    unsigned seed = 1;
+    start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < FRAMES / 10; frame++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        rows += Frame(text, &highlighter, &map, (seed >> 8) % (LINE_COUNT - SHOWN), false) * 10;
+    }
+    Report("jumping, ring", ElapsedMs(start) * 10, rows);
+
+    text.RemoveListener(&reference);
+    text.RemoveListener(&map);
+    text.RemoveListener(&highlighter);
+    return 0;
+}
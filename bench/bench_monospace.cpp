@@ -0,0 +1,142 @@
+// Measuring and clicking in a 100k-column line with the default font, which is monospace: ImFont::CalcTextSizeA(),
+// a frame of InputTextMultiline() holding the line, and a click in the TextEditor scrolled to the end of the line. Each
+// is timed with the monospace fast path and with the glyph by glyph measuring proportional fonts go through (by
+// clearing ImFont::MonospaceAdvanceX). Both ways must give the same sizes and put the cursor at the same place. Runs
+// headless (the font atlas is built but never uploaded). Run with "make bench".
+
+#include "text_editor.h"
+#include "piece_table.h"
+#include "imgui.h"
+#include <stdio.h>
+#include <chrono>
+#include <string>
+
+static const size_t COLUMNS = 100000;
+static const int RUNS = 200;
+
+static double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+static std::string MakeLine()
+{
+    static const char* words[] = { "static", "int", "Function(int", "lhs,", "int", "rhs)", "{", "return", "lhs", "+", "rhs;", "}" };
+    std::string line;
+    for (unsigned n = 0; line.size() < COLUMNS; n++)
+    {
+        line += words[n % (sizeof(words) / sizeof(words[0]))];
+        line += ' ';
+    }
+    line.resize(COLUMNS);
+    return line;
+}
+
+// A frame with the editor, or InputTextMultiline() if 'input_text' isn't NULL, filling an 800x600 window
+static double Frame(PieceTable* text, TextEditorState* state, std::string* input_text)
+{
+    ImGui::NewFrame();
+    ImGui::SetNextWindowPos(ImVec2(0.0f, 0.0f));
+    ImGui::SetNextWindowSize(ImVec2(800.0f, 600.0f));
+    ImGui::Begin("Editor", NULL, ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoMove);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (input_text != NULL)
+        ImGui::InputTextMultiline("##input", &(*input_text)[0], input_text->size() + 1, ImVec2(-1.0f, -1.0f), ImGuiInputTextFlags_ReadOnly);
+    else
+        TextEditor("##editor", text, state, ImVec2(-1.0f, -1.0f));
+    const double ms = ElapsedMs(start);
+    ImGui::End();
+    ImGui::EndFrame();
+    return ms;
+}
+
+// A click in the middle of the editor scrolled to the end of the line, then the button released. Returns the time of
+// the frame handling the click, the cursor in 'out_cursor'.
+static double Click(PieceTable* text, TextEditorState* state, size_t* out_cursor)
+{
+    ImGuiIO& io = ImGui::GetIO();
+    state->Cursor = state->SelectStart = text->Size();
+    state->CursorFollow = true;
+    Frame(text, state, NULL);
+    io.AddMousePosEvent(400.0f, 100.0f);
+    Frame(text, state, NULL);
+    io.AddMouseButtonEvent(0, true);
+    const double ms = Frame(text, state, NULL);
+    io.AddMouseButtonEvent(0, false);
+    Frame(text, state, NULL);
+    *out_cursor = state->Cursor;
+    return ms;
+}
+
+int main()
+{
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.DisplaySize = ImVec2(1920.0f, 1080.0f);
+    io.IniFilename = NULL;
+    unsigned char* pixels;
+    int width, height;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+    ImFont* font = io.Fonts->Fonts[0];
+    if (!font->IsMonospace())
+    {
+        fprintf(stderr, "the default font wasn't detected as monospace\n");
+        return 1;
+    }
+    const float advance = font->MonospaceAdvanceX;
+
+    std::string line = MakeLine();
+    PieceTable text;
+    text.Load(line.data(), line.size());
+    TextEditorState state;
+    printf("a line of %zu columns, %.0f pixels per column\n", COLUMNS, advance);
+
+    ImVec2 sizes[2];
+    size_t cursors[2];
+    for (int generic = 0; generic < 2; generic++)
+    {
+        font->MonospaceAdvanceX = generic ? 0.0f : advance;
+        const char* way = generic ? "glyph by glyph" : "monospace";
+        char name[64];
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int run = 0; run < RUNS; run++)
+            sizes[generic] = font->CalcTextSizeA(font->FontSize, FLT_MAX, 0.0f, line.data(), line.data() + line.size());
+        snprintf(name, sizeof(name), "CalcTextSizeA(), %s", way);
+        printf("%-40s %8.4f ms\n", name, ElapsedMs(start) / RUNS);
+
+        // Clicked first: the active InputText lays out its whole text every frame
+        io.AddMousePosEvent(400.0f, 100.0f);
+        io.AddMouseButtonEvent(0, true);
+        Frame(NULL, NULL, &line);
+        io.AddMouseButtonEvent(0, false);
+        Frame(NULL, NULL, &line);
+        double input_ms = 0.0;
+        for (int run = 0; run < RUNS; run++)
+            input_ms += Frame(NULL, NULL, &line);
+        snprintf(name, sizeof(name), "InputTextMultiline() frame, %s", way);
+        printf("%-40s %8.4f ms\n", name, input_ms / RUNS);
+
+        double click_ms = 0.0;
+        for (int run = 0; run < RUNS; run++)
+            click_ms += Click(&text, &state, &cursors[generic]);
+        snprintf(name, sizeof(name), "click at column %zu, %s", cursors[generic], way);
+        printf("%-40s %8.4f ms per frame\n", name, click_ms / RUNS);
+    }
+    font->MonospaceAdvanceX = advance;
+
+    if (sizes[0].x != sizes[1].x || sizes[0].y != sizes[1].y)
+    {
+        fprintf(stderr, "CalcTextSizeA() measured %.1f x %.1f, %.1f x %.1f glyph by glyph\n", sizes[0].x, sizes[0].y, sizes[1].x, sizes[1].y);
+        return 1;
+    }
+    if (cursors[0] != cursors[1])
+    {
+        fprintf(stderr, "the click put the cursor at %zu, at %zu glyph by glyph\n", cursors[0], cursors[1]);
+        return 1;
+    }
+    ImGui::DestroyContext();
+    return 0;
+}
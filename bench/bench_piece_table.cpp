@@ -0,0 +1,83 @@
+// Keystroke latency of the piece table vs. a flat buffer, for documents from 1 KB to 500 MB.
+// Each "keystroke" inserts one character at a random position, every fourth one is followed by a backspace.
+// Run with "make bench".
+
+#include "piece_table.h"
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+static const int KEYSTROKES = 20000;
+
+static std::unique_ptr<char[]> MakeText(size_t size)
+{
+    std::unique_ptr<char[]> text(new char[size]);
+    static const char line[] = "    int value = compute(lhs, rhs); // some generated code\n";
+    for (size_t i = 0; i < size; i++)
+        text[i] = line[i % (sizeof(line) - 1)];
+    return text;
+}
+
+static uint32_t Rand(uint32_t* state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static double BenchPieceTable(size_t size)
+{
+    PieceTable text;
+    text.Load(MakeText(size), size);
+    uint32_t rng = 1234;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int n = 0; n < KEYSTROKES; n++)
+    {
+        const size_t pos = (size_t)Rand(&rng) % (text.Size() + 1);
+        text.Insert(pos, "x", 1);
+        if ((n & 3) == 3)
+            text.Erase(pos, 1);
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / KEYSTROKES;
+}
+
+// What the tabs used to do: insert into a contiguous buffer and move the tail.
+static double BenchFlatBuffer(size_t size, int keystrokes)
+{
+    std::vector<char> text(size);
+    memcpy(text.data(), MakeText(size).get(), size);
+    uint32_t rng = 1234;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int n = 0; n < keystrokes; n++)
+    {
+        const size_t pos = (size_t)Rand(&rng) % (text.size() + 1);
+        text.insert(text.begin() + pos, 'x');
+        if ((n & 3) == 3)
+            text.erase(text.begin() + pos);
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / keystrokes;
+}
+
+int main()
+{
+    const size_t KB = 1024, MB = 1024 * 1024;
+    const size_t sizes[] = { 1 * KB, 64 * KB, 1 * MB, 16 * MB, 100 * MB, 500 * MB };
+    printf("%-10s %20s %20s\n", "size", "piece table ns/key", "flat buffer ns/key");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        const size_t size = sizes[i];
+        const double piece_ns = BenchPieceTable(size);
+        // The flat buffer gets slow quickly, keep its run short on big sizes
+        const double flat_ns = BenchFlatBuffer(size, size > 16 * MB ? 200 : KEYSTROKES);
+        if (size >= MB)
+            printf("%7zu MB %20.1f %20.1f\n", size / MB, piece_ns, flat_ns);
+        else
+            printf("%7zu KB %20.1f %20.1f\n", size / KB, piece_ns, flat_ns);
+    }
+    return 0;
+}
@@ -0,0 +1,177 @@
+// "Find in files" over a generated tree of 100k source files (~400 MB) in 1000 directories, plus a build/ directory
+// that its .gitignore excludes. The tree is searched twice per pattern (the second run is the one reported: the files
+// are in the page cache then, as in an editor that keeps searching the same project) and compared with ripgrep and
+// grep -r when they are installed. The tree is generated in the current directory and deleted afterwards.
+// Run with "make bench".
+
+#include "project_search.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+static int MakeDir(const char* path)        { return _mkdir(path); }
+#else
+#include <sys/stat.h>
+static int MakeDir(const char* path)        { return mkdir(path, 0755); }
+#endif
+
+static const char* BENCH_DIR = "bench_project_search.tmp/";
+static const int DIR_COUNT = 1000;
+static const int FILES_PER_DIR = 100;
+static const int IGNORED_FILES = 10000;
+
+static bool WriteFile(const std::string& filename, unsigned seed)
+{
+    static const char* lines[] = {
+        "    int value = compute(lhs, rhs); // some generated code\n",
+        "    if (value > limit)\n",
+        "        return Result(value, \"too large\");\n",
+        "}\n",
+        "static int table[] = { 1, 2, 3, 5, 8, 13, 21, 34, 55, 89 };\n",
+    };
+    std::string text;
+    const size_t size = 2048 + seed % 4096;
+    for (unsigned n = seed; text.size() < size; n = n * 1103515245u + 12345u)
+        text += lines[(n >> 16) % (sizeof(lines) / sizeof(lines[0]))];
+    FILE* f = fopen(filename.c_str(), "wb");
+    if (f == NULL)
+        return false;
+    const bool ok = fwrite(text.data(), 1, text.size(), f) == text.size();
+    return fclose(f) == 0 && ok;
+}
+
+static std::string DirName(int dir)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "%smodule%02d/part%02d/", BENCH_DIR, dir / 10, dir % 10);
+    return name;
+}
+
+static std::string FileName(const std::string& dir, int file)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "file%03d.cpp", file);
+    return dir + name;
+}
+
+static bool MakeTree(size_t* out_bytes)
+{
+    MakeDir(BENCH_DIR);
+    MakeDir((std::string(BENCH_DIR) + "build").c_str());
+    FILE* f = fopen((std::string(BENCH_DIR) + ".gitignore").c_str(), "wb");
+    if (f == NULL)
+        return false;
+    fputs("# generated\n/build/\n*.o\n", f);
+    fclose(f);
+    *out_bytes = 0;
+    for (int dir = 0; dir < DIR_COUNT; dir++)
+    {
+        const std::string path = DirName(dir);
+        if (dir % 10 == 0)
+            MakeDir(path.substr(0, path.size() - 7).c_str());
+        MakeDir(path.c_str());
+        for (int file = 0; file < FILES_PER_DIR; file++)
+        {
+            const unsigned seed = (unsigned)(dir * FILES_PER_DIR + file);
+            if (!WriteFile(FileName(path, file), seed))
+                return false;
+            *out_bytes += 2048 + seed % 4096;
+        }
+    }
+    for (int file = 0; file < IGNORED_FILES; file++)
+        if (!WriteFile(FileName(std::string(BENCH_DIR) + "build/", file), (unsigned)file))
+            return false;
+    return true;
+}
+
+static void DeleteTree()
+{
+    for (int dir = 0; dir < DIR_COUNT; dir++)
+    {
+        const std::string path = DirName(dir);
+        for (int file = 0; file < FILES_PER_DIR; file++)
+            remove(FileName(path, file).c_str());
+        remove(path.c_str());
+        if (dir % 10 == 9)
+            remove(path.substr(0, path.size() - 7).c_str());
+    }
+    for (int file = 0; file < IGNORED_FILES; file++)
+        remove(FileName(std::string(BENCH_DIR) + "build/", file).c_str());
+    remove((std::string(BENCH_DIR) + "build").c_str());
+    remove((std::string(BENCH_DIR) + ".gitignore").c_str());
+    remove(BENCH_DIR);
+}
+
+static double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+static double RunSearch(ProjectSearch* search, const char* pattern)
+{
+    std::string error;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (!search->Start(BENCH_DIR, pattern, false, &error))
+    {
+        fprintf(stderr, "%s: %s\n", pattern, error.c_str());
+        exit(1);
+    }
+    while (search->IsSearching())
+    {
+        search->Poll();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    search->Poll();
+    return ElapsedMs(start);
+}
+
+// -1 when the tool isn't installed. Its output goes through a pipe: GNU grep stops at the first match when it
+// writes to /dev/null.
+static double RunTool(const char* tool, const char* args, const char* pattern)
+{
+    char command[512];
+    snprintf(command, sizeof(command), "%s --version > /dev/null 2>&1", tool);
+    if (system(command) != 0)
+        return -1.0;
+    snprintf(command, sizeof(command), "%s %s '%s' %s | cat > /dev/null", tool, args, pattern, BENCH_DIR);
+    if (system(command) != 0)
+        return -1.0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (system(command) != 0)
+        return -1.0;
+    return ElapsedMs(start);
+}
+
+int main()
+{
+    size_t bytes = 0;
+    if (!MakeTree(&bytes))
+    {
+        fprintf(stderr, "Unable to write %s\n", BENCH_DIR);
+        DeleteTree();
+        return 1;
+    }
+    printf("%u worker threads, %d files (%.0f MB) + %d ignored\n", std::max(1u, std::thread::hardware_concurrency()),
+        DIR_COUNT * FILES_PER_DIR, (double)bytes / (1024 * 1024), IGNORED_FILES);
+    printf("%-26s %10s %10s %10s %10s %12s\n", "pattern", "hits", "files", "ms", "rg ms", "grep -r ms");
+    const char* patterns[] = { "not_in_the_text\\d+", "compute\\(\\w+,", "[0-9]{2}, [0-9]{2} \\}", "^\\s*\\}$" };
+    ProjectSearch search;
+    for (size_t n = 0; n < sizeof(patterns) / sizeof(patterns[0]); n++)
+    {
+        RunSearch(&search, patterns[n]);
+        const double ms = RunSearch(&search, patterns[n]);
+        const double rg_ms = RunTool("rg", "-n", patterns[n]);
+        const double grep_ms = RunTool("grep", "-r -n -P --exclude-dir=build", patterns[n]);
+        printf("%-26s %10zu %10zu %10.0f %10.0f %12.0f\n", patterns[n], search.HitCount(), search.SearchedFiles(), ms, rg_ms, grep_ms);
+    }
+    DeleteTree();
+    return 0;
+}
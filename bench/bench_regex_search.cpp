@@ -0,0 +1,101 @@
+// "Search all tabs" over 4 documents of 128 MB: RegexSearch (lazy DFA, literal prefilter, one worker per core) vs.
+// std::regex run line by line on one thread, which is measured on 16 MB only and extrapolated.
+// Run with "make bench".
+
+#include "piece_table.h"
+#include "regex_search.h"
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <memory>
+#include <regex>
+#include <string>
+#include <thread>
+
+static const size_t TAB_COUNT = 4;
+static const size_t TAB_SIZE = 128 * 1024 * 1024;
+static const size_t STD_REGEX_SIZE = 16 * 1024 * 1024;
+
+static std::unique_ptr<char[]> MakeText(size_t size, unsigned seed)
+{
+    std::unique_ptr<char[]> text(new char[size]);
+    static const char* lines[] = {
+        "    int value = compute(lhs, rhs); // some generated code\n",
+        "    if (value > limit)\n",
+        "        return Result(value, \"too large\");\n",
+        "}\n",
+        "static int table[] = { 1, 2, 3, 5, 8, 13, 21, 34, 55, 89 };\n",
+    };
+    size_t pos = 0;
+    for (unsigned n = seed; pos < size; n = n * 1103515245u + 12345u)
+    {
+        const char* line = lines[(n >> 16) % (sizeof(lines) / sizeof(lines[0]))];
+        const size_t len = strlen(line);
+        memcpy(text.get() + pos, line, len < size - pos ? len : size - pos);
+        pos += len;
+    }
+    return text;
+}
+
+static double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+static size_t CountWithStdRegex(const char* data, size_t size, const std::regex& re)
+{
+    size_t count = 0;
+    for (const char* line = data; line < data + size; )
+    {
+        const char* line_end = (const char*)memchr(line, '\n', (size_t)(data + size - line));
+        if (line_end == NULL)
+            line_end = data + size;
+        if (std::regex_search(line, line_end, re))
+            count++;
+        line = line_end + 1;
+    }
+    return count;
+}
+
+int main()
+{
+    PieceTable tabs[TAB_COUNT];
+    for (size_t n = 0; n < TAB_COUNT; n++)
+    {
+        std::unique_ptr<char[]> data = MakeText(TAB_SIZE, (unsigned)n);
+        tabs[n].Load(std::move(data), TAB_SIZE);
+    }
+    RegexSearch search;
+    for (size_t n = 0; n < TAB_COUNT; n++)
+        search.AddText(tabs[n]);
+    std::unique_ptr<char[]> sample = MakeText(STD_REGEX_SIZE, 0);
+
+    printf("%u worker threads, %zu tabs of %zu MB\n", std::max(1u, std::thread::hardware_concurrency()), TAB_COUNT, TAB_SIZE >> 20);
+    printf("%-26s %10s %10s %12s %16s\n", "pattern", "hits", "literal", "GB/s", "std::regex GB/s");
+    const char* patterns[] = { "not_in_the_text\\d+", "compute\\(\\w+,", "table\\[\\] = \\{ 1, 2", "[0-9]{2}, [0-9]{2} \\}", "^\\s*\\}$" };
+    for (size_t n = 0; n < sizeof(patterns) / sizeof(patterns[0]); n++)
+    {
+        std::string error;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (!search.Start(patterns[n], false, &error))
+        {
+            fprintf(stderr, "%s: %s\n", patterns[n], error.c_str());
+            return 1;
+        }
+        while (search.IsSearching())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        const double search_ms = ElapsedMs(start);
+
+        const std::regex std_re(patterns[n]);
+        start = std::chrono::steady_clock::now();
+        const size_t std_count = CountWithStdRegex(sample.get(), STD_REGEX_SIZE, std_re);
+        const double std_ms = ElapsedMs(start);
+        (void)std_count;
+
+        const double total_gb = (double)(TAB_COUNT * TAB_SIZE) / 1e9;
+        printf("%-26s %10zu %10s %12.2f %16.3f\n", patterns[n], search.HitCount(), search.Pattern().RequiredLiteral().empty() ? "no" : "yes",
+            total_gb / (search_ms / 1000.0), (double)STD_REGEX_SIZE / 1e9 / (std_ms / 1000.0));
+    }
+    return 0;
+}
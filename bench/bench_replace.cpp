@@ -0,0 +1,96 @@
+// Replacing 1M occurrences in a 500 MB document with TextReplace, as plain text and as a regex, and the same edits made
+// one by one through the undo history, extrapolated from the first few thousand: each is cheap on a piece table, but
+// leaves two more pieces and an undo record behind. Undo and redo of the replace-all are timed too.
+// Run with "make bench".
+
+#include "piece_table.h"
+#include "text_replace.h"
+#include "undo_history.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+static const size_t DOCUMENT_SIZE = 500 * 1024 * 1024;
+static const size_t LINES_PER_MATCH = 8;            // One line in this many holds the pattern: ~1M matches
+static const size_t ONE_BY_ONE_EDITS = 2000;
+
+static const char PLAIN_LINE[] = "    int value = compute(lhs, rhs); // some generated code\n";
+static const char MATCH_LINE[] = "    int value = old_name(lhs, rhs); // some generated code\n";
+
+static std::unique_ptr<char[]> MakeText(size_t size)
+{
+    std::unique_ptr<char[]> text(new char[size]);
+    const size_t line_len = sizeof(PLAIN_LINE) - 1;
+    for (size_t pos = 0, line = 0; pos < size; pos += line_len, line++)
+        memcpy(&text[pos], line % LINES_PER_MATCH == 0 ? MATCH_LINE : PLAIN_LINE, std::min(line_len, size - pos));
+    return text;
+}
+
+static double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+static void LoadText(PieceTable* table)
+{
+    table->Load(MakeText(DOCUMENT_SIZE), DOCUMENT_SIZE);
+}
+
+static void RunReplace(const char* name, const char* pattern, bool regex)
+{
+    PieceTable table;
+    LoadText(&table);
+    UndoHistory undo;
+    TextReplace replace;
+    std::string error;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (!replace.Start(table, pattern, regex, false, "new_function_name", &error))
+    {
+        fprintf(stderr, "%s: %s\n", pattern, error.c_str());
+        return;
+    }
+    const double start_ms = ElapsedMs(start);
+    while (replace.IsReplacing())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    const double scan_ms = ElapsedMs(start);
+    size_t begin = 0, end = 0;
+    start = std::chrono::steady_clock::now();
+    const bool applied = replace.Apply(&table, &undo, &begin, &end);
+    const double apply_ms = ElapsedMs(start);
+    start = std::chrono::steady_clock::now();
+    size_t cursor = 0;
+    undo.Undo(&table, &cursor);
+    const double undo_ms = ElapsedMs(start);
+    start = std::chrono::steady_clock::now();
+    undo.Redo(&table, &cursor);
+    const double redo_ms = ElapsedMs(start);
+    printf("%-24s %9zu matches%s: Start() %6.2f ms, worker %7.0f ms, Apply() %6.1f ms (%zu MB), undo %5.2f ms, redo %5.2f ms\n", name, replace.MatchCount(),
+        applied ? "" : " (not applied)", start_ms, scan_ms, apply_ms, (end - begin) / (1024 * 1024), undo_ms, redo_ms);
+}
+
+int main()
+{
+    printf("%zu MB document, 1 line in %zu to replace\n", DOCUMENT_SIZE / (1024 * 1024), LINES_PER_MATCH);
+    RunReplace("plain text", "old_name", false);
+    RunReplace("regex, literal", "old_name", true);
+    RunReplace("regex", "old_[a-z]+\\(", true);
+
+    // One edit per match, from the end so that the positions of the others stay valid
+    PieceTable table;
+    LoadText(&table);
+    UndoHistory undo;
+    const size_t line_len = sizeof(PLAIN_LINE) - 1;
+    const size_t matches = (DOCUMENT_SIZE / line_len + LINES_PER_MATCH - 1) / LINES_PER_MATCH;
+    const size_t column = strstr(MATCH_LINE, "old_name") - MATCH_LINE;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t n = 0; n < ONE_BY_ONE_EDITS; n++)
+        undo.Replace(&table, (matches - 1 - n) * LINES_PER_MATCH * line_len + column, 8, "new_function_name", 17, false);
+    const double ms = ElapsedMs(start);
+    printf("%-24s %9zu edits: %.0f ms, ~%.0f ms for all %zu, %d pieces (vs %d)\n", "one by one", ONE_BY_ONE_EDITS, ms,
+        ms * (double)matches / (double)ONE_BY_ONE_EDITS, matches, table.PieceCount(), (int)(DOCUMENT_SIZE / (64 * 1024)));
+    return 0;
+}
@@ -0,0 +1,151 @@
+// Saving a barely edited big file: SaveFile() (only what changed is written, or copied by the kernel) vs. a full
+// WriteFileAtomic(). A file is generated in the current directory, loaded, edited, saved both ways and deleted
+// afterwards; the file on disk is checked against the text after every save.
+// Run with "make bench".
+
+#include "file_io.h"
+#include "piece_table.h"
+#include "save_queue.h"
+#include <stdio.h>
+#include <chrono>
+#include <string>
+
+static const char* BENCH_FILE = "bench_save.tmp";
+
+static bool WriteFile(const char* filename, size_t size)
+{
+    FILE* f = fopen(filename, "wb");
+    if (f == NULL)
+        return false;
+    static const char line[] = "    int value = compute(lhs, rhs); // some generated code\n";
+    std::string block;
+    while (block.size() < 1024 * 1024)
+        block += line;
+    for (size_t written = 0; written < size; )
+    {
+        const size_t len = size - written < block.size() ? size - written : block.size();
+        if (fwrite(block.data(), 1, len, f) != len)
+        {
+            fclose(f);
+            return false;
+        }
+        written += len;
+    }
+    return fclose(f) == 0;
+}
+
+// The file holds the text plus the '\n' added by the savers when it doesn't end with one
+static bool FileMatches(const char* filename, const PieceTable& text)
+{
+    FILE* f = fopen(filename, "rb");
+    if (f == NULL)
+        return false;
+    std::string expected, actual;
+    const size_t chunk = 16 * 1024 * 1024;
+    bool same = true;
+    for (size_t pos = 0; pos < text.Size() && same; pos += chunk)
+    {
+        const size_t len = text.Size() - pos < chunk ? text.Size() - pos : chunk;
+        expected.resize(len);
+        actual.resize(len);
+        text.Copy(pos, len, &expected[0]);
+        same = fread(&actual[0], 1, len, f) == len && actual == expected;
+    }
+    char c;
+    if (same && (text.Empty() || text.CharAt(text.Size() - 1) != '\n'))
+        same = fread(&c, 1, 1, f) == 1 && c == '\n';
+    same = same && fread(&c, 1, 1, f) == 0;
+    fclose(f);
+    return same;
+}
+
+struct Edit
+{
+    const char* Name;
+    double      Where;          // Position in the file, 0..1
+    bool        SameLength;     // Replace a few bytes, or insert a line
+};
+
+static double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+int main()
+{
+    const size_t MB = 1024 * 1024;
+    const size_t sizes[] = { 100 * MB, 2048 * MB };
+    const Edit edits[] =
+    {
+        { "change near the end", 0.99, true },
+        { "insert near the end", 0.999, false },
+        { "change in the middle", 0.5, true },
+        { "insert at the start", 0.0, false },
+    };
+    printf("%-10s %-22s %16s %16s\n", "size", "edit", "SaveFile ms", "full write ms");
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        const size_t size = sizes[i];
+        if (!WriteFile(BENCH_FILE, size))
+        {
+            fprintf(stderr, "can't write %zu MB to %s, skipping\n", size / MB, BENCH_FILE);
+            remove(BENCH_FILE);
+            continue;
+        }
+        {
+            // Flush the generated file to disk first so that the first save doesn't pay for it
+            PieceTable text;
+            PieceTableSnapshot snapshot;
+            std::string error;
+            LoadFile(BENCH_FILE, &text);
+            text.GetSnapshot(&snapshot);
+            WriteFileAtomic(BENCH_FILE, snapshot, -1, NULL, &error);
+        }
+        for (size_t e = 0; e < sizeof(edits) / sizeof(edits[0]); e++)
+        {
+            // Start every edit from the file as saved by the previous full write, freshly loaded
+            PieceTable text;
+            FileStamp stamp;
+            if (!LoadFile(BENCH_FILE, &text) || !GetFileStamp(BENCH_FILE, &stamp))
+            {
+                fprintf(stderr, "can't load %s\n", BENCH_FILE);
+                return 1;
+            }
+            const size_t line_start = text.LineStart(text.LineFromPos((size_t)(edits[e].Where * (double)(text.Size() - 1))));
+            if (edits[e].SameLength)
+            {
+                text.Erase(line_start, 3);
+                text.Insert(line_start, "// ", 3);
+            }
+            else
+            {
+                text.Insert(line_start, "    // inserted line\n");
+            }
+
+            PieceTableSnapshot snapshot;
+            text.GetSnapshot(&snapshot);
+            std::string error;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            bool ok = SaveFile(BENCH_FILE, snapshot, &stamp, &stamp, &error);
+            const double incremental_ms = ElapsedMs(start);
+            if (!ok || !FileMatches(BENCH_FILE, text))
+            {
+                fprintf(stderr, "SaveFile: wrong file (%s)\n", error.c_str());
+                return 1;
+            }
+
+            start = std::chrono::steady_clock::now();
+            ok = WriteFileAtomic(BENCH_FILE, snapshot, -1, NULL, &error);
+            const double full_ms = ElapsedMs(start);
+            if (!ok || !FileMatches(BENCH_FILE, text))
+            {
+                fprintf(stderr, "WriteFileAtomic: wrong file (%s)\n", error.c_str());
+                return 1;
+            }
+            printf("%7zu MB %-22s %16.1f %16.1f\n", size / MB, edits[e].Name, incremental_ms, full_ms);
+        }
+        remove(BENCH_FILE);
+    }
+    return 0;
+}
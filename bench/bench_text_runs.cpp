@@ -0,0 +1,122 @@
+// Drawing syntax highlighted rows: one ImDrawList::AddText() per run against one AddTextRuns() per row, for a view of
+// 60 rows of 120 columns of generated code in ~20 runs each, with the default font, and drawing the rows plain (one
+// AddText() per row) for reference. Both ways of highlighting must produce the same glyphs in the same colors. Runs
+// headless (the font atlas is built but never uploaded). Run with "make bench".
+
+#include "imgui.h"
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+static const int ROWS = 60;
+static const int FRAMES = 2000;
+
+static const ImU32 COLORS[] = { IM_COL32(255, 255, 255, 255), IM_COL32(86, 156, 214, 255), IM_COL32(181, 206, 168, 255), IM_COL32(206, 145, 120, 255) };
+
+static double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+// A row of code, cut into runs at each space
+static void MakeRow(int row, std::string* text, std::vector<ImDrawTextRun>* runs)
+{
+    static const char* words[] = { "int", "value", "=", "compute(lhs,", "rhs);", "if", "(value", ">", "0x1F)", "\"a string\"", "return", "//" };
+    text->clear();
+    runs->clear();
+    for (unsigned n = (unsigned)row + 1; text->size() < 120; n = n * 1103515245u + 12345u)
+    {
+        const char* word = words[(n >> 16) % (sizeof(words) / sizeof(words[0]))];
+        const ImDrawTextRun run = { (int)strlen(word) + 1, COLORS[(n >> 20) % (sizeof(COLORS) / sizeof(COLORS[0]))] };
+        *text += word;
+        *text += ' ';
+        runs->push_back(run);
+    }
+}
+
+enum DrawMode { DRAW_PLAIN, DRAW_PER_RUN, DRAW_BATCHED, DRAW_MODE_COUNT };
+static const char* DRAW_MODE_NAMES[] = { "AddText() per row, plain", "AddText() per run", "AddTextRuns() per row" };
+
+static void DrawView(ImDrawList* draw_list, const std::vector<std::string>& texts, const std::vector<std::vector<ImDrawTextRun> >& runs, int mode)
+{
+    ImFont* font = ImGui::GetFont();
+    const float size = ImGui::GetFontSize();
+    for (int row = 0; row < ROWS; row++)
+    {
+        const ImVec2 pos(10.0f, 10.0f + row * size);
+        const char* text = texts[row].c_str();
+        if (mode == DRAW_PLAIN)
+        {
+            draw_list->AddText(font, size, pos, COLORS[0], text, text + texts[row].size());
+            continue;
+        }
+        if (mode == DRAW_BATCHED)
+        {
+            draw_list->AddTextRuns(font, size, pos, text, text + texts[row].size(), runs[row].data(), (int)runs[row].size());
+            continue;
+        }
+        float x = pos.x;
+        for (size_t n = 0; n < runs[row].size(); n++)
+        {
+            draw_list->AddText(font, size, ImVec2(x, pos.y), runs[row][n].Col, text, text + runs[row][n].Len);
+            x += font->CalcTextSizeA(size, FLT_MAX, 0.0f, text, text + runs[row][n].Len).x;
+            text += runs[row][n].Len;
+        }
+    }
+}
+
+int main()
+{
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.DisplaySize = ImVec2(1920.0f, 1080.0f);
+    io.IniFilename = NULL;
+    unsigned char* pixels;
+    int width, height;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+
+    std::vector<std::string> texts(ROWS);
+    std::vector<std::vector<ImDrawTextRun> > runs(ROWS);
+    size_t run_count = 0;
+    for (int row = 0; row < ROWS; row++)
+    {
+        MakeRow(row, &texts[row], &runs[row]);
+        run_count += runs[row].size();
+    }
+    printf("%d rows, %zu runs\n", ROWS, run_count);
+
+    std::vector<ImU32> per_run_colors;
+    for (int mode = 0; mode < DRAW_MODE_COUNT; mode++)
+    {
+        std::vector<ImU32> colors;
+        int vertices = 0;
+        double ms = 0.0;
+        for (int frame = 0; frame < FRAMES; frame++)
+        {
+            ImGui::NewFrame();
+            ImDrawList* draw_list = ImGui::GetForegroundDrawList();
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            DrawView(draw_list, texts, runs, mode);
+            ms += ElapsedMs(start);
+            vertices = draw_list->VtxBuffer.Size;
+            if (frame == 0)
+                for (int n = 0; n < draw_list->VtxBuffer.Size; n++)
+                    colors.push_back(draw_list->VtxBuffer[n].col);
+            ImGui::EndFrame();
+        }
+        printf("%-26s %8.4f ms per frame, %d vertices\n", DRAW_MODE_NAMES[mode], ms / FRAMES, vertices);
+        if (mode == DRAW_PER_RUN)
+            per_run_colors = colors;
+        if (mode == DRAW_BATCHED && colors != per_run_colors)
+        {
+            fprintf(stderr, "AddTextRuns() and AddText() drew different glyphs or colors\n");
+            return 1;
+        }
+    }
+    ImGui::DestroyContext();
+    return 0;
+}
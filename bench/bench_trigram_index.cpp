@@ -0,0 +1,188 @@
+// "Find in files" with and without the trigram index, over a generated tree of 100k source files (~400 MB) in 1000
+// directories. Every file defines a symbol of its own, so that looking one up is the kind of selective query the index
+// is for. Reports the time to build the index and its size, the time to open it again (mapped), and each query walking
+// the tree and from the index (both with the files in the page cache). The tree is generated in the current directory
+// and deleted afterwards. Run with "make bench".
+
+#include "project_search.h"
+#include "trigram_index.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+static int MakeDir(const char* path)        { return _mkdir(path); }
+#else
+#include <sys/stat.h>
+static int MakeDir(const char* path)        { return mkdir(path, 0755); }
+#endif
+
+static const char* BENCH_DIR = "bench_trigram_index.tmp/";
+static const int DIR_COUNT = 1000;
+static const int FILES_PER_DIR = 100;
+
+static bool WriteFile(const std::string& filename, unsigned seed)
+{
+    static const char* lines[] = {
+        "    int value = compute(lhs, rhs); // some generated code\n",
+        "    if (value > limit)\n",
+        "        return Result(value, \"too large\");\n",
+        "}\n",
+        "static int table[] = { 1, 2, 3, 5, 8, 13, 21, 34, 55, 89 };\n",
+    };
+    char symbol[64];
+    snprintf(symbol, sizeof(symbol), "int symbol_%06u(int lhs, int rhs)\n{\n", seed);
+    std::string text = symbol;
+    const size_t size = 2048 + seed % 4096;
+    for (unsigned n = seed; text.size() < size; n = n * 1103515245u + 12345u)
+        text += lines[(n >> 16) % (sizeof(lines) / sizeof(lines[0]))];
+    FILE* f = fopen(filename.c_str(), "wb");
+    if (f == NULL)
+        return false;
+    const bool ok = fwrite(text.data(), 1, text.size(), f) == text.size();
+    return fclose(f) == 0 && ok;
+}
+
+static std::string DirName(int dir)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "%smodule%02d/part%02d/", BENCH_DIR, dir / 10, dir % 10);
+    return name;
+}
+
+static std::string FileName(const std::string& dir, int file)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "file%03d.cpp", file);
+    return dir + name;
+}
+
+static bool MakeTree(size_t* out_bytes)
+{
+    MakeDir(BENCH_DIR);
+    *out_bytes = 0;
+    for (int dir = 0; dir < DIR_COUNT; dir++)
+    {
+        const std::string path = DirName(dir);
+        if (dir % 10 == 0)
+            MakeDir(path.substr(0, path.size() - 7).c_str());
+        MakeDir(path.c_str());
+        for (int file = 0; file < FILES_PER_DIR; file++)
+        {
+            const unsigned seed = (unsigned)(dir * FILES_PER_DIR + file);
+            if (!WriteFile(FileName(path, file), seed))
+                return false;
+            *out_bytes += 2048 + seed % 4096;
+        }
+    }
+    return true;
+}
+
+static void DeleteTree()
+{
+    for (int dir = 0; dir < DIR_COUNT; dir++)
+    {
+        const std::string path = DirName(dir);
+        for (int file = 0; file < FILES_PER_DIR; file++)
+            remove(FileName(path, file).c_str());
+        remove(path.c_str());
+        if (dir % 10 == 9)
+            remove(path.substr(0, path.size() - 7).c_str());
+    }
+    remove((std::string(BENCH_DIR) + TrigramIndex::FileName).c_str());
+    remove(BENCH_DIR);
+}
+
+static double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+static double RunSearch(ProjectSearch* search, const char* pattern, const TrigramIndex* index)
+{
+    std::string error;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (!search->Start(BENCH_DIR, pattern, false, &error, index))
+    {
+        fprintf(stderr, "%s: %s\n", pattern, error.c_str());
+        exit(1);
+    }
+    while (search->IsSearching())
+    {
+        search->Poll();
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    search->Poll();
+    return ElapsedMs(start);
+}
+
+static double WaitForIndex(const TrigramIndex& index, std::chrono::steady_clock::time_point start)
+{
+    while (index.FileCount() == 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return ElapsedMs(start);
+}
+
+int main()
+{
+    size_t bytes = 0;
+    if (!MakeTree(&bytes))
+    {
+        fprintf(stderr, "Unable to write %s\n", BENCH_DIR);
+        DeleteTree();
+        return 1;
+    }
+    printf("%u threads, %d files (%.0f MB)\n", std::max(1u, std::thread::hardware_concurrency()), DIR_COUNT * FILES_PER_DIR, (double)bytes / (1024 * 1024));
+
+    // Built with the files in the page cache, as they are after the first search
+    ProjectSearch search;
+    RunSearch(&search, "warm_up_the_cache", NULL);
+    TrigramIndex index;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    index.Open(BENCH_DIR);
+    const double build_ms = WaitForIndex(index, start);
+    FILE* f = fopen((std::string(BENCH_DIR) + TrigramIndex::FileName).c_str(), "rb");
+    long index_size = 0;
+    if (f != NULL)
+    {
+        fseek(f, 0, SEEK_END);
+        index_size = ftell(f);
+        fclose(f);
+    }
+    index.Close();
+    start = std::chrono::steady_clock::now();
+    index.Open(BENCH_DIR);
+    const double open_ms = WaitForIndex(index, start);
+    printf("index: built in %.0f ms, %.1f MB (%.1f%% of the text), opened again in %.1f ms\n", build_ms, (double)index_size / (1024 * 1024),
+        100.0 * (double)index_size / (double)bytes, open_ms);
+    // Let the refresh that opening starts finish: the index isn't used until then
+    while (index.IsRefreshing())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    printf("%-26s %10s %10s %10s %12s %10s\n", "pattern", "hits", "files", "walk ms", "candidates", "index ms");
+    const char* patterns[] = { "symbol_042042\\(", "symbol_0420\\d\\d", "not_in_the_text\\d+", "too large", "compute\\(\\w+," };
+    for (size_t n = 0; n < sizeof(patterns) / sizeof(patterns[0]); n++)
+    {
+        const double walk_ms = RunSearch(&search, patterns[n], NULL);
+        const size_t hits = search.HitCount();
+        RunSearch(&search, patterns[n], &index);
+        const double index_ms = RunSearch(&search, patterns[n], &index);
+        if (search.HitCount() != hits || !search.UsedIndex())
+        {
+            fprintf(stderr, "%s: %zu hits from the index, %zu walking the tree\n", patterns[n], search.HitCount(), hits);
+            DeleteTree();
+            return 1;
+        }
+        printf("%-26s %10zu %10zu %10.0f %12zu %10.1f\n", patterns[n], hits, search.Files().size(), walk_ms, search.SearchedFiles(), index_ms);
+    }
+    index.Close();
+    DeleteTree();
+    return 0;
+}
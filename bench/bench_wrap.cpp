@@ -0,0 +1,142 @@
+// Drawing a word-wrapped 100k-line log in a 600 pixel high window, the way the Console shows its output: ImGui::Text()
+// under PushTextWrapPos(), which wraps the whole text again every frame, against WrappedText() with a WrapLayout,
+// which lays it out once and draws the visible rows. Also times laying out the whole log again after the wrap width
+// changes (on every core), and a line added per frame. Both ways must take the same height. Runs headless (the
+// font atlas is built but never uploaded). Run with "make bench".
+
+#include "wrap_layout.h"
+#include "imgui.h"
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+
+static const size_t LINE_COUNT = 100000;
+static const int FRAMES = 200;
+static const float WRAP_WIDTH = 300.0f;
+
+static double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+// Compiler output: short lines, and long ones that wrap a few times
+static std::string MakeLine(unsigned n)
+{
+    static const char* words[] = { "src/text_editor.cpp:412:18:", "warning:", "comparison", "of", "integer", "expressions", "of", "different", "signedness:", "'int'", "and", "'size_t'", "[-Wsign-compare]", "note:", "in", "expansion" };
+    std::string line;
+    const unsigned word_count = (n >> 16) % 4 == 0 ? 3 : 4 + (n >> 8) % 40;
+    for (unsigned word = 0; word < word_count; word++, n = n * 1103515245u + 12345u)
+    {
+        line += words[(n >> 16) % (sizeof(words) / sizeof(words[0]))];
+        line += ' ';
+    }
+    return line;
+}
+
+static std::string MakeLog(size_t line_count)
+{
+    std::string log;
+    unsigned n = 1;
+    for (size_t line = 0; line < line_count; line++, n = n * 1103515245u + 12345u)
+        log += MakeLine(n) + "\n";
+    return log;
+}
+
+// Height of the text drawn one way or the other, as laid out in the window
+static float DrawFrame(const std::string& log, WrapLayout* layout, double* ms)
+{
+    ImGui::NewFrame();
+    ImGui::SetNextWindowPos(ImVec2(0.0f, 0.0f));
+    ImGui::SetNextWindowSize(ImVec2(WRAP_WIDTH + 40.0f, 600.0f));
+    ImGui::Begin("Console");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (layout == NULL)
+    {
+        ImGui::PushTextWrapPos(ImGui::GetCursorPos().x + WRAP_WIDTH);
+        ImGui::Text("%s", log.c_str());
+        ImGui::PopTextWrapPos();
+    }
+    else
+    {
+        WrappedText(layout, WRAP_WIDTH);
+    }
+    *ms += ElapsedMs(start);
+    const float height = ImGui::GetItemRectSize().y;
+    ImGui::End();
+    ImGui::EndFrame();
+    return height;
+}
+
+int main()
+{
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO& io = ImGui::GetIO();
+    io.DisplaySize = ImVec2(1920.0f, 1080.0f);
+    io.IniFilename = NULL;
+    unsigned char* pixels;
+    int width, height;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+
+    std::string log = MakeLog(LINE_COUNT);
+    printf("%zu lines (%.1f MB), wrapped at %.0f pixels\n", LINE_COUNT, (double)log.size() / (1024 * 1024), WRAP_WIDTH);
+
+    double text_ms = 0.0;
+    float text_height = 0.0f;
+    for (int frame = 0; frame < FRAMES; frame++)
+        text_height = DrawFrame(log, NULL, &text_ms);
+    printf("%-36s %8.4f ms per frame\n", "ImGui::Text() wrapped", text_ms / FRAMES);
+
+    WrapLayout layout;
+    layout.SetText(log);
+    double first_ms = 0.0;
+    const float layout_height = DrawFrame(log, &layout, &first_ms);
+    printf("%-36s %8.4f ms (%u threads), %zu rows\n", "WrappedText(), first frame", first_ms, std::max(1u, std::thread::hardware_concurrency()), layout.RowCount());
+    double layout_ms = 0.0;
+    for (int frame = 0; frame < FRAMES; frame++)
+        DrawFrame(log, &layout, &layout_ms);
+    printf("%-36s %8.4f ms per frame\n", "WrappedText(), laid out", layout_ms / FRAMES);
+    if (layout_height != text_height)
+    {
+        fprintf(stderr, "WrappedText() took %.0f pixels, ImGui::Text() %.0f\n", layout_height, text_height);
+        return 1;
+    }
+
+    // The window resized: every line is laid out again, then back to the width the frames use
+    ImFont* font = io.Fonts->Fonts[0];
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    layout.Layout(font, font->FontSize, WRAP_WIDTH * 2.0f);
+    printf("%-36s %8.4f ms, %zu rows\n", "laying out again for a new width", ElapsedMs(start), layout.RowCount());
+    layout.Layout(font, font->FontSize, WRAP_WIDTH);
+
+    // A line added per frame, appended or set with the whole text (which compares every line with the last text)
+    for (int set_text = 0; set_text < 2; set_text++)
+    {
+        double append_ms = 0.0;
+        unsigned n = 7;
+        for (int frame = 0; frame < FRAMES; frame++, n = n * 1103515245u + 12345u)
+        {
+            const std::string line = MakeLine(n) + "\n";
+            log += line;
+            start = std::chrono::steady_clock::now();
+            if (set_text)
+                layout.SetText(log);
+            else
+                layout.Append(line);
+            append_ms += ElapsedMs(start);
+            DrawFrame(log, &layout, &append_ms);
+        }
+        printf("%-36s %8.4f ms per frame\n", set_text ? "adding a line with SetText()" : "adding a line with Append()", append_ms / FRAMES);
+    }
+    double check_ms = 0.0;
+    const float grown_height = DrawFrame(log, &layout, &check_ms);
+    if (grown_height != DrawFrame(log, NULL, &check_ms))
+    {
+        fprintf(stderr, "WrappedText() and ImGui::Text() took different heights after adding lines\n");
+        return 1;
+    }
+    return 0;
+}
@@ -1644,6 +1644,21 @@ void ImDrawList::AddText(const ImVec2& pos, ImU32 col, const char* text_begin, c
     AddText(NULL, 0.0f, pos, col, text_begin, text_end);
 }
 
+void ImDrawList::AddTextRuns(const ImFont* font, float font_size, const ImVec2& pos, const char* text_begin, const char* text_end, const ImDrawTextRun* runs, int runs_count)
+{
+    if (text_begin == text_end || runs_count <= 0)
+        return;
+
+    // Pull default font/size from the shared ImDrawListSharedData instance
+    if (font == NULL)
+        font = _Data->Font;
+    if (font_size == 0.0f)
+        font_size = _Data->FontSize;
+
+    IM_ASSERT(font->ContainerAtlas->TexID == _CmdHeader.TextureId);  // Use high-level ImGui::PushFont() or low-level ImDrawList::PushTextureId() to change font.
+    font->RenderTextRuns(this, font_size, pos, _CmdHeader.ClipRect, text_begin, text_end, runs, runs_count);
+}
+
 void ImDrawList::AddImage(ImTextureID user_texture_id, const ImVec2& p_min, const ImVec2& p_max, const ImVec2& uv_min, const ImVec2& uv_max, ImU32 col)
 {
     if ((col & IM_COL32_A_MASK) == 0)
@@ -3561,6 +3576,7 @@ ImFont::ImFont()
 {
     FontSize = 0.0f;
     FallbackAdvanceX = 0.0f;
+    MonospaceAdvanceX = 0.0f;
     FallbackChar = (ImWchar)-1;
     EllipsisChar = (ImWchar)-1;
     EllipsisWidth = EllipsisCharStep = 0.0f;
@@ -3585,6 +3601,7 @@ void    ImFont::ClearOutputData()
 {
     FontSize = 0.0f;
     FallbackAdvanceX = 0.0f;
+    MonospaceAdvanceX = 0.0f;
     Glyphs.clear();
     IndexAdvanceX.clear();
     IndexLookup.clear();
@@ -3664,6 +3681,13 @@ void ImFont::BuildLookupTable()
         if (IndexAdvanceX[i] < 0.0f)
             IndexAdvanceX[i] = FallbackAdvanceX;
 
+    // Detect monospace fonts: every character but TAB (and the control characters that have no glyph, which take
+    // the fallback's advance like the characters past the index) advances the same
+    MonospaceAdvanceX = FallbackAdvanceX;
+    for (int i = 0; i < max_codepoint + 1 && MonospaceAdvanceX > 0.0f; i++)
+        if (i != '\t' && IndexAdvanceX[i] != MonospaceAdvanceX)
+            MonospaceAdvanceX = 0.0f;
+
     // Setup Ellipsis character. It is required for rendering elided text. We prefer using U+2026 (horizontal ellipsis).
     // However some old fonts may contain ellipsis at U+0085. Here we auto-detect most suitable ellipsis character.
     // FIXME: Note that 0x2026 is rarely included in our font ranges. Because of this we are more likely to use three individual dots.
@@ -3775,6 +3799,8 @@ void ImFont::AddRemapChar(ImWchar dst, ImWchar src, bool overwrite_dst)
     GrowIndex(dst + 1);
     IndexLookup[dst] = (src < index_size) ? IndexLookup.Data[src] : (ImWchar)-1;
     IndexAdvanceX[dst] = (src < index_size) ? IndexAdvanceX.Data[src] : 1.0f;
+    if (IndexAdvanceX[dst] != MonospaceAdvanceX && dst != '\t')
+        MonospaceAdvanceX = 0.0f;
 }
 
 const ImFontGlyph* ImFont::FindGlyph(ImWchar c) const
@@ -3908,10 +3934,89 @@ const char* ImFont::CalcWordWrapPositionA(float scale, const char* text, const c
     return s;
 }
 
+// CalcTextSizeA() without wrapping for a monospace font: a line is as wide as its characters (and TABs) count, no glyph
+// is looked up. Multi-byte UTF-8 characters are stepped over like CalcTextSizeA() decodes them, whatever they are.
+static ImVec2 CalcTextSizeMonospaceA(const ImFont* font, float size, float max_width, const char* text_begin, const char* text_end, const char** remaining)
+{
+    const float line_height = size;
+    const float scale = size / font->FontSize;
+    const float char_width = font->MonospaceAdvanceX * scale;
+    const float tab_width = font->GetCharAdvance((ImWchar)'\t') * scale;
+
+    ImVec2 text_size = ImVec2(0, 0);
+    int columns = 0;    // In the current line, TABs aside
+    int tabs = 0;
+    const ImU64 ones = 0x0101010101010101ull;
+    const ImU64 highs = 0x8080808080808080ull;
+    const char* s = text_begin;
+    while (s < text_end)
+    {
+        // 8 ASCII characters of one column each (no '\n', '\r' or TAB), all within max_width
+        if (text_end - s >= 8)
+        {
+            ImU64 word;
+            memcpy(&word, s, 8);
+            const ImU64 lf_bytes = word ^ (ones * '\n'), cr_bytes = word ^ (ones * '\r'), tab_bytes = word ^ (ones * '\t');
+            const ImU64 special = ((lf_bytes - ones) & ~lf_bytes) | ((cr_bytes - ones) & ~cr_bytes) | ((tab_bytes - ones) & ~tab_bytes);
+            if (((word | special) & highs) == 0 && (max_width == FLT_MAX || (columns + 8) * char_width + tabs * tab_width < max_width))
+            {
+                columns += 8;
+                s += 8;
+                continue;
+            }
+        }
+
+        const char* prev_s = s;
+        const unsigned char c = (unsigned char)*s;
+        if (c < 0x80)
+        {
+            s += 1;
+        }
+        else
+        {
+            unsigned int decoded;
+            s += ImTextCharFromUtf8(&decoded, s, text_end);
+        }
+
+        if (c == '\n')
+        {
+            text_size.x = ImMax(text_size.x, columns * char_width + tabs * tab_width);
+            text_size.y += line_height;
+            columns = tabs = 0;
+            continue;
+        }
+        if (c == '\r')
+            continue;
+
+        const int tab = (c == '\t') ? 1 : 0;
+        if (max_width != FLT_MAX && (columns + 1 - tab) * char_width + (tabs + tab) * tab_width >= max_width)
+        {
+            s = prev_s;
+            break;
+        }
+        columns += 1 - tab;
+        tabs += tab;
+    }
+
+    const float line_width = columns * char_width + tabs * tab_width;
+    if (text_size.x < line_width)
+        text_size.x = line_width;
+
+    if (line_width > 0 || text_size.y == 0.0f)
+        text_size.y += line_height;
+
+    if (remaining)
+        *remaining = s;
+
+    return text_size;
+}
+
 ImVec2 ImFont::CalcTextSizeA(float size, float max_width, float wrap_width, const char* text_begin, const char* text_end, const char** remaining) const
 {
     if (!text_end)
         text_end = text_begin + strlen(text_begin); // FIXME-OPT: Need to avoid this.
+    if (wrap_width <= 0.0f && MonospaceAdvanceX > 0.0f)
+        return CalcTextSizeMonospaceA(this, size, max_width, text_begin, text_end, remaining);
 
     const float line_height = size;
     const float scale = size / FontSize;
@@ -4188,6 +4293,79 @@ void ImFont::RenderText(ImDrawList* draw_list, float size, const ImVec2& pos, Im
     draw_list->_VtxCurrentIdx = vtx_index;
 }
 
+// One line of text in several colors, e.g. a syntax highlighted line. One RenderText() per run would set up, reserve
+// and give back vertices once per run (often a single word). This reserves once for the whole line, like RenderText()
+// for the worst case of one quad per byte, and writes every glyph in one pass, taking its color from its run.
+// The line isn't wrapped and '\n' isn't a line break: like '\r', it isn't drawn. Bytes past the last run aren't drawn.
+void ImFont::RenderTextRuns(ImDrawList* draw_list, float size, const ImVec2& pos, const ImVec4& clip_rect, const char* text_begin, const char* text_end, const ImDrawTextRun* runs, int runs_count) const
+{
+    // Align to be pixel perfect
+    float x = IM_TRUNC(pos.x);
+    const float y = IM_TRUNC(pos.y);
+    const float scale = size / FontSize;
+    if (y > clip_rect.w || y + FontSize * scale < clip_rect.y)
+        return;
+    int runs_len = 0;
+    for (int n = 0; n < runs_count; n++)
+        runs_len += runs[n].Len;
+    if (text_end - text_begin > runs_len)
+        text_end = text_begin + runs_len;
+    if (text_begin >= text_end)
+        return;
+
+    const int vtx_count_max = (int)(text_end - text_begin) * 4;
+    const int idx_count_max = (int)(text_end - text_begin) * 6;
+    const int idx_expected_size = draw_list->IdxBuffer.Size + idx_count_max;
+    draw_list->PrimReserve(idx_count_max, vtx_count_max);
+    ImDrawVert*  vtx_write = draw_list->_VtxWritePtr;
+    ImDrawIdx*   idx_write = draw_list->_IdxWritePtr;
+    unsigned int vtx_index = draw_list->_VtxCurrentIdx;
+
+    int run = 0;
+    const char* run_end = text_begin + runs[0].Len;
+    for (const char* s = text_begin; s < text_end; )
+    {
+        while (s >= run_end)
+            run_end += runs[++run].Len;
+        unsigned int c = (unsigned int)*s;
+        if (c < 0x80)
+            s += 1;
+        else
+            s += ImTextCharFromUtf8(&c, s, text_end);
+        if (c == '\n' || c == '\r')
+            continue;
+        const ImFontGlyph* glyph = FindGlyph((ImWchar)c);
+        if (glyph == NULL)
+            continue;
+        const float x1 = x + glyph->X0 * scale;
+        const float x2 = x + glyph->X1 * scale;
+        x += glyph->AdvanceX * scale;
+        if (!glyph->Visible || x1 > clip_rect.z || x2 < clip_rect.x)
+            continue;
+
+        const float y1 = y + glyph->Y0 * scale;
+        const float y2 = y + glyph->Y1 * scale;
+        const ImU32 glyph_col = glyph->Colored ? (runs[run].Col | ~IM_COL32_A_MASK) : runs[run].Col;
+        vtx_write[0].pos.x = x1; vtx_write[0].pos.y = y1; vtx_write[0].col = glyph_col; vtx_write[0].uv.x = glyph->U0; vtx_write[0].uv.y = glyph->V0;
+        vtx_write[1].pos.x = x2; vtx_write[1].pos.y = y1; vtx_write[1].col = glyph_col; vtx_write[1].uv.x = glyph->U1; vtx_write[1].uv.y = glyph->V0;
+        vtx_write[2].pos.x = x2; vtx_write[2].pos.y = y2; vtx_write[2].col = glyph_col; vtx_write[2].uv.x = glyph->U1; vtx_write[2].uv.y = glyph->V1;
+        vtx_write[3].pos.x = x1; vtx_write[3].pos.y = y2; vtx_write[3].col = glyph_col; vtx_write[3].uv.x = glyph->U0; vtx_write[3].uv.y = glyph->V1;
+        idx_write[0] = (ImDrawIdx)(vtx_index); idx_write[1] = (ImDrawIdx)(vtx_index + 1); idx_write[2] = (ImDrawIdx)(vtx_index + 2);
+        idx_write[3] = (ImDrawIdx)(vtx_index); idx_write[4] = (ImDrawIdx)(vtx_index + 2); idx_write[5] = (ImDrawIdx)(vtx_index + 3);
+        vtx_write += 4;
+        vtx_index += 4;
+        idx_write += 6;
+    }
+
+    // Give back unused vertices (clipped ones, blanks), as RenderText() does
+    draw_list->VtxBuffer.Size = (int)(vtx_write - draw_list->VtxBuffer.Data);
+    draw_list->IdxBuffer.Size = (int)(idx_write - draw_list->IdxBuffer.Data);
+    draw_list->CmdBuffer[draw_list->CmdBuffer.Size - 1].ElemCount -= (idx_expected_size - draw_list->IdxBuffer.Size);
+    draw_list->_VtxWritePtr = vtx_write;
+    draw_list->_IdxWritePtr = idx_write;
+    draw_list->_VtxCurrentIdx = vtx_index;
+}
+
 //-----------------------------------------------------------------------------
 // [SECTION] ImGui Internal Render Helpers
 //-----------------------------------------------------------------------------
@@ -203,10 +203,10 @@ namespace ImStb
 #undef IMSTB_TEXTEDIT_STRING
 #undef IMSTB_TEXTEDIT_CHARTYPE
 #define IMSTB_TEXTEDIT_STRING             ImGuiInputTextState
-#define IMSTB_TEXTEDIT_CHARTYPE           ImWchar
+#define IMSTB_TEXTEDIT_CHARTYPE           char
 #define IMSTB_TEXTEDIT_GETWIDTH_NEWLINE   (-1.0f)
 #define IMSTB_TEXTEDIT_UNDOSTATECOUNT     99
-#define IMSTB_TEXTEDIT_UNDOCHARCOUNT      999
+#define IMSTB_TEXTEDIT_UNDOCHARCOUNT      (999 * 3) // UTF-8 bytes: keeps as much CJK undo text as 999 ImWchar did
 #include "imstb_textedit.h"
 
 } // namespace ImStb
@@ -346,6 +346,7 @@ namespace ImStb
 // - Helper: ImSpan<>, ImSpanAllocator<>
 // - Helper: ImPool<>
 // - Helper: ImChunkStream<>
+// - Helper: ImGapBuffer<>
 // - Helper: ImGuiTextIndex
 //-----------------------------------------------------------------------------
 
@@ -720,6 +721,77 @@ struct ImChunkStream
     void    swap(ImChunkStream<T>& rhs) { rhs.Buf.swap(Buf); }
 };
 
+// Helper: ImGapBuffer<>
+// Text storage with a movable hole ("gap"): Buf = [0, GapBegin) text + [GapBegin, GapEnd) gap + [GapEnd, Buf.Size - 1) text + zero-terminator.
+// Inserting/deleting at the gap is O(1) amortized, moving the gap costs the distance it moves. Edits near the previous one (typing) never move the tail of the buffer.
+// Indices are logical (as if the gap wasn't there). Use get_segments() or make_contiguous() when you need raw memory.
+template<typename T>
+struct ImGapBuffer
+{
+    ImVector<T>     Buf;
+    int             GapBegin, GapEnd;
+
+    ImGapBuffer()                           { GapBegin = GapEnd = 0; }
+    void    clear()                         { Buf.clear(); GapBegin = GapEnd = 0; }
+    int     size() const                    { return Buf.Size > 0 ? Buf.Size - 1 - (GapEnd - GapBegin) : 0; }
+    int     gap_size() const                { return GapEnd - GapBegin; }
+    T       operator[](int idx) const       { IM_ASSERT(idx >= 0 && idx <= size()); return Buf.Data[idx < GapBegin ? idx : idx + (GapEnd - GapBegin)]; } // [size()] is the zero-terminator
+
+    // After writing 'len' elements at the beginning of Buf (e.g. converting a string into it), turn the rest of Buf into the gap.
+    void    reset_gap(int len)              { IM_ASSERT(len < Buf.Size); GapBegin = len; GapEnd = Buf.Size - 1; Buf.Data[GapEnd] = 0; }
+
+    // Text in [begin, end) is at most two runs of memory, before and after the gap.
+    void    get_segments(int begin, int end, const T** out_p0, int* out_len0, const T** out_p1, int* out_len1) const
+    {
+        IM_ASSERT(begin >= 0 && begin <= end && end <= size());
+        const int split = ImClamp(GapBegin, begin, end);
+        const int gap = GapEnd - GapBegin;
+        *out_p0 = Buf.Data + begin; *out_len0 = split - begin;
+        *out_p1 = Buf.Data + split + gap; *out_len1 = end - split;
+    }
+
+    void    move_gap(int pos)
+    {
+        IM_ASSERT(pos >= 0 && pos <= size());
+        const int gap = GapEnd - GapBegin;
+        if (pos < GapBegin)
+            memmove(Buf.Data + pos + gap, Buf.Data + pos, (size_t)(GapBegin - pos) * sizeof(T));
+        else if (pos > GapBegin)
+            memmove(Buf.Data + GapBegin, Buf.Data + GapEnd, (size_t)(pos - GapBegin) * sizeof(T));
+        GapBegin = pos;
+        GapEnd = pos + gap;
+    }
+
+    // Grow the gap to at least 'len' elements. The gap is grown proportionally to the text size to keep insertions amortized O(1).
+    void    reserve_gap(int len)
+    {
+        if (Buf.Size > 0 && GapEnd - GapBegin >= len)
+            return;
+        const int text_len = size();
+        const int new_gap = ImMax(len, ImMax(256, text_len / 8));
+        const int tail_len = text_len - GapBegin;
+        ImVector<T> new_buf;
+        new_buf.resize(text_len + new_gap + 1);
+        if (GapBegin > 0)
+            memcpy(new_buf.Data, Buf.Data, (size_t)GapBegin * sizeof(T));
+        if (tail_len > 0)
+            memcpy(new_buf.Data + GapBegin + new_gap, Buf.Data + GapEnd, (size_t)tail_len * sizeof(T));
+        new_buf.Data[new_buf.Size - 1] = 0;
+        Buf.swap(new_buf);
+        GapEnd = GapBegin + new_gap;
+    }
+
+    void    insert(int pos, const T* text, int len)     { reserve_gap(len); move_gap(pos); memcpy(Buf.Data + GapBegin, text, (size_t)len * sizeof(T)); GapBegin += len; }
+    void    erase(int pos, int len)                     { IM_ASSERT(pos + len <= size()); move_gap(pos); GapEnd += len; }
+
+    // Read [begin, end) into 'out' / compare the whole text with 'text', without moving the gap.
+    void    copy(int begin, int end, T* out) const      { const T* p0; const T* p1; int len0, len1; get_segments(begin, end, &p0, &len0, &p1, &len1); if (len0 > 0) memcpy(out, p0, (size_t)len0 * sizeof(T)); if (len1 > 0) memcpy(out + len0, p1, (size_t)len1 * sizeof(T)); }
+    bool    equals(const T* text, int len) const        { if (len != size()) return false; const T* p0; const T* p1; int len0, len1; get_segments(0, len, &p0, &len0, &p1, &len1); return (len0 == 0 || memcmp(p0, text, (size_t)len0 * sizeof(T)) == 0) && (len1 == 0 || memcmp(p1, text + len0, (size_t)len1 * sizeof(T)) == 0); }
+
+    // Move the gap to the end and return the zero-terminated text. Costs O(size() - GapBegin): avoid in per-frame or per-keystroke paths.
+    T*      make_contiguous()                           { if (Buf.Size == 0) reserve_gap(0); move_gap(size()); Buf.Data[GapBegin] = 0; return Buf.Data; }
+};
+
 // Helper: ImGuiTextIndex<>
 // Maintain a line index for a text buffer. This is a strong candidate to be moved into the public API.
 struct ImGuiTextIndex
@@ -1070,11 +1142,11 @@ struct IMGUI_API ImGuiInputTextState
 {
     ImGuiContext*           Ctx;                    // parent UI context (needs to be set explicitly by parent).
     ImGuiID                 ID;                     // widget id owning the text state
-    int                     CurLenW, CurLenA;       // we need to maintain our buffer length in both UTF-8 and wchar format. UTF-8 length is valid even if TextA is not.
-    ImVector<ImWchar>       TextW;                  // edit buffer, we need to persist but can't guarantee the persistence of the user-provided buffer. so we copy into own buffer.
-    ImVector<char>          TextA;                  // temporary UTF8 buffer for callbacks and other operations. this is not updated in every code-path! size=capacity.
+    int                     CurLenA;                // length of the text in TextA, in bytes
+    ImGapBuffer<char>       TextA;                  // edit buffer (UTF-8), we need to persist but can't guarantee the persistence of the user-provided buffer. so we copy into own buffer. gap is kept at the last edit so typing doesn't move the rest of the text.
+    ImVector<char>          CallbackTextA;          // contiguous copy of the text handed to user callbacks, which may modify it. size=capacity.
     ImVector<char>          InitialTextA;           // value to revert to when pressing Escape = backup of end-user buffer at the time of focus (in UTF-8, unaltered)
-    bool                    TextAIsValid;           // temporary UTF8 buffer is not initially valid before we make the widget active (until then we pull the data from user argument)
+    ImVector<char>          InputCharsA;            // characters queued this frame that passed filtering (UTF-8), inserted at once
     int                     BufCapacityA;           // end-user buffer capacity
     float                   ScrollX;                // horizontal scrolling/offset
     ImStb::STB_TexteditState Stb;                   // state for stb_textedit.h
@@ -1084,25 +1156,27 @@ struct IMGUI_API ImGuiInputTextState
     bool                    Edited;                 // edited this frame
     ImGuiInputTextFlags     Flags;                  // copy of InputText() flags. may be used to check if e.g. ImGuiInputTextFlags_Password is set.
     bool                    ReloadUserBuf;          // force a reload of user buf so it may be modified externally. may be automatic in future version.
-    int                     ReloadSelectionStart;   // POSITIONS ARE IN IMWCHAR units *NOT* UTF-8 this is why this is not exposed yet.
+    int                     ReloadSelectionStart;   // positions are UTF-8 byte offsets, like the cursor and selection.
     int                     ReloadSelectionEnd;
 
     ImGuiInputTextState()                   { memset(this, 0, sizeof(*this)); }
-    void        ClearText()                 { CurLenW = CurLenA = 0; TextW[0] = 0; TextA[0] = 0; CursorClamp(); }
-    void        ClearFreeMemory()           { TextW.clear(); TextA.clear(); InitialTextA.clear(); }
+    void        ClearText()                 { CurLenA = 0; TextA.reset_gap(0); CursorClamp(); }
+    void        ClearFreeMemory()           { TextA.clear(); CallbackTextA.clear(); InitialTextA.clear(); InputCharsA.clear(); }
     int         GetUndoAvailCount() const   { return Stb.undostate.undo_point; }
     int         GetRedoAvailCount() const   { return IMSTB_TEXTEDIT_UNDOSTATECOUNT - Stb.undostate.redo_point; }
     void        OnKeyPressed(int key);      // Cannot be inline because we call in code in stb_textedit.h implementation
+    void        OnCharPressed(unsigned int c);
+    void        OnCharsPressed(const char* text, int text_len); // several characters typed at once (UTF-8)
 
     // Cursor & Selection
     void        CursorAnimReset()           { CursorAnim = -0.30f; }                                   // After a user-input the cursor stays on for a while without blinking
-    void        CursorClamp()               { Stb.cursor = ImMin(Stb.cursor, CurLenW); Stb.select_start = ImMin(Stb.select_start, CurLenW); Stb.select_end = ImMin(Stb.select_end, CurLenW); }
+    void        CursorClamp()               { Stb.cursor = ImMin(Stb.cursor, CurLenA); Stb.select_start = ImMin(Stb.select_start, CurLenA); Stb.select_end = ImMin(Stb.select_end, CurLenA); }
     bool        HasSelection() const        { return Stb.select_start != Stb.select_end; }
     void        ClearSelection()            { Stb.select_start = Stb.select_end = Stb.cursor; }
     int         GetCursorPos() const        { return Stb.cursor; }
     int         GetSelectionStart() const   { return Stb.select_start; }
     int         GetSelectionEnd() const     { return Stb.select_end; }
-    void        SelectAll()                 { Stb.select_start = 0; Stb.cursor = Stb.select_end = CurLenW; Stb.has_preferred_x = 0; }
+    void        SelectAll()                 { Stb.select_start = 0; Stb.cursor = Stb.select_end = CurLenA; Stb.has_preferred_x = 0; }
 
     // Reload user buf (WIP #2890)
     // If you modify underlying user-passed const char* while active you need to call this (InputText V2 may lift this)
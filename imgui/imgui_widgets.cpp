@@ -125,7 +125,7 @@ static const ImU64          IM_U64_MAX = (2ULL * 9223372036854775807LL + 1);
 // For InputTextEx()
 static bool     InputTextFilterCharacter(ImGuiContext* ctx, unsigned int* p_char, ImGuiInputTextFlags flags, ImGuiInputTextCallback callback, void* user_data, bool input_source_is_clipboard = false);
 static int      InputTextCalcTextLenAndLineCount(const char* text_begin, const char** out_text_end);
-static ImVec2   InputTextCalcTextSizeW(ImGuiContext* ctx, const ImWchar* text_begin, const ImWchar* text_end, const ImWchar** remaining = NULL, ImVec2* out_offset = NULL, bool stop_on_new_line = false);
+static ImVec2   InputTextCalcTextSize(ImGuiContext* ctx, const ImGapBuffer<char>& text, int text_begin, int text_end, int* remaining = NULL, ImVec2* out_offset = NULL, bool stop_on_new_line = false);
 
 //-------------------------------------------------------------------------
 // [SECTION] Widgets: Text, etc.
@@ -3680,7 +3680,8 @@ static int InputTextCalcTextLenAndLineCount(const char* text_begin, const char**
     return line_count;
 }
 
-static ImVec2 InputTextCalcTextSizeW(ImGuiContext* ctx, const ImWchar* text_begin, const ImWchar* text_end, const ImWchar** remaining, ImVec2* out_offset, bool stop_on_new_line)
+// Measure [text_begin, text_end) of the edit buffer (byte offsets, the range may straddle the gap)
+static ImVec2 InputTextCalcTextSize(ImGuiContext* ctx, const ImGapBuffer<char>& text, int text_begin, int text_end, int* remaining, ImVec2* out_offset, bool stop_on_new_line)
 {
     ImGuiContext& g = *ctx;
     ImFont* font = g.Font;
@@ -3690,25 +3691,63 @@ static ImVec2 InputTextCalcTextSizeW(ImGuiContext* ctx, const ImWchar* text_begi
     ImVec2 text_size = ImVec2(0, 0);
     float line_width = 0.0f;
 
-    const ImWchar* s = text_begin;
-    while (s < text_end)
-    {
-        unsigned int c = (unsigned int)(*s++);
-        if (c == '\n')
+    // Monospace font: count the characters and TABs of the line instead of adding up their advances
+    const bool monospace = font->IsMonospace();
+    const float mono_char_width = font->MonospaceAdvanceX * scale;
+    const float mono_tab_width = font->GetCharAdvance((ImWchar)'\t') * scale;
+    int mono_columns = 0;
+    int mono_tabs = 0;
+
+    // Decode each side of the gap separately, like they are rendered
+    const char* segments[2];
+    int segments_len[2];
+    text.get_segments(text_begin, text_end, &segments[0], &segments_len[0], &segments[1], &segments_len[1]);
+    int s = text_begin;
+    bool stopped = false;
+    for (int segment_n = 0; segment_n < 2 && !stopped; segment_n++)
+    {
+        const char* p = segments[segment_n];
+        const char* p_end = p + segments_len[segment_n];
+        while (p < p_end)
         {
-            text_size.x = ImMax(text_size.x, line_width);
-            text_size.y += line_height;
-            line_width = 0.0f;
-            if (stop_on_new_line)
-                break;
-            continue;
-        }
-        if (c == '\r')
-            continue;
+            unsigned int c = (unsigned int)*p;
+            if (c < 0x80)
+                p += 1;
+            else
+                p += ImTextCharFromUtf8(&c, p, p_end);
+            if (c == '\n')
+            {
+                if (monospace)
+                    line_width = mono_columns * mono_char_width + mono_tabs * mono_tab_width;
+                text_size.x = ImMax(text_size.x, line_width);
+                text_size.y += line_height;
+                line_width = 0.0f;
+                mono_columns = mono_tabs = 0;
+                if (stop_on_new_line)
+                {
+                    stopped = true;
+                    break;
+                }
+                continue;
+            }
+            if (c == '\r')
+                continue;
+            if (monospace)
+            {
+                if (c == '\t')
+                    mono_tabs++;
+                else
+                    mono_columns++;
+                continue;
+            }
 
-        const float char_width = font->GetCharAdvance((ImWchar)c) * scale;
-        line_width += char_width;
+            const float char_width = font->GetCharAdvance((ImWchar)c) * scale;
+            line_width += char_width;
+        }
+        s += (int)(p - segments[segment_n]);
     }
+    if (monospace)
+        line_width = mono_columns * mono_char_width + mono_tabs * mono_tab_width;
 
     if (text_size.x < line_width)
         text_size.x = line_width;
@@ -3725,26 +3764,73 @@ static ImVec2 InputTextCalcTextSizeW(ImGuiContext* ctx, const ImWchar* text_begi
     return text_size;
 }
 
-// Wrapper for stb_textedit.h to edit text (our wrapper is for: statically sized buffer, single-line, wchar characters. InputText converts between UTF-8 and wchar)
+static int InputTextFindLineBegin(const ImGapBuffer<char>& text, int idx)
+{
+    while (idx > 0 && text[idx - 1] != '\n')
+        idx--;
+    return idx;
+}
+
+// Draw the edit buffer without moving its gap: the text after the gap continues from where the text before it ended.
+static void InputTextRenderText(ImGuiContext* ctx, ImDrawList* draw_list, const ImVec2& pos, ImU32 col, const ImGapBuffer<char>& text, int text_len, const ImVec4* cpu_fine_clip_rect)
+{
+    ImGuiContext& g = *ctx;
+    const char* seg0; const char* seg1;
+    int seg0_len, seg1_len;
+    text.get_segments(0, text_len, &seg0, &seg0_len, &seg1, &seg1_len);
+    draw_list->AddText(g.Font, g.FontSize, pos, col, seg0, seg0 + seg0_len, 0.0f, cpu_fine_clip_rect);
+    if (seg1_len == 0)
+        return;
+
+    int line_no = 0;
+    for (const char* p = seg0; p < seg0 + seg0_len && (p = (const char*)memchr(p, '\n', seg0 + seg0_len - p)) != NULL; p++)
+        line_no++;
+    const float seg0_end_x = InputTextCalcTextSize(ctx, text, InputTextFindLineBegin(text, seg0_len), seg0_len).x;
+    const ImVec2 seg1_pos(pos.x + seg0_end_x, pos.y + line_no * g.FontSize);
+    const char* seg1_end = seg1 + seg1_len;
+    const char* seg1_line_end = (const char*)memchr(seg1, '\n', seg1_len);
+    if (seg1_line_end == NULL)
+    {
+        draw_list->AddText(g.Font, g.FontSize, seg1_pos, col, seg1, seg1_end, 0.0f, cpu_fine_clip_rect);
+        return;
+    }
+    draw_list->AddText(g.Font, g.FontSize, seg1_pos, col, seg1, seg1_line_end, 0.0f, cpu_fine_clip_rect);
+    draw_list->AddText(g.Font, g.FontSize, ImVec2(pos.x, seg1_pos.y + g.FontSize), col, seg1_line_end + 1, seg1_end, 0.0f, cpu_fine_clip_rect);
+}
+
+// Decode the character starting at byte offset 'idx' of the edit buffer. Return its length in bytes.
+static int InputTextDecodeChar(const ImGuiInputTextState* obj, int idx, unsigned int* out_char)
+{
+    char c0 = obj->TextA[idx];
+    *out_char = (unsigned char)c0;
+    if ((unsigned char)c0 < 0x80 || idx >= obj->CurLenA)
+        return idx < obj->CurLenA ? 1 : 0;
+    char s[4] = { c0, 0, 0, 0 };
+    const int s_len = ImMin(obj->CurLenA - idx, 4);
+    for (int n = 1; n < s_len; n++)
+        s[n] = obj->TextA[idx + n];
+    return ImTextCharFromUtf8(out_char, s, s + s_len);
+}
+
+// Wrapper for stb_textedit.h to edit text (our wrapper is for: statically sized buffer, single-line, UTF-8 characters. Positions are byte offsets)
 namespace ImStb
 {
 
-static int     STB_TEXTEDIT_STRINGLEN(const ImGuiInputTextState* obj)                             { return obj->CurLenW; }
-static ImWchar STB_TEXTEDIT_GETCHAR(const ImGuiInputTextState* obj, int idx)                      { IM_ASSERT(idx <= obj->CurLenW); return obj->TextW[idx]; }
-static float   STB_TEXTEDIT_GETWIDTH(ImGuiInputTextState* obj, int line_start_idx, int char_idx)  { ImWchar c = obj->TextW[line_start_idx + char_idx]; if (c == '\n') return IMSTB_TEXTEDIT_GETWIDTH_NEWLINE; ImGuiContext& g = *obj->Ctx; return g.Font->GetCharAdvance(c) * (g.FontSize / g.Font->FontSize); }
+static int     STB_TEXTEDIT_STRINGLEN(const ImGuiInputTextState* obj)                             { return obj->CurLenA; }
+static char    STB_TEXTEDIT_GETCHAR(const ImGuiInputTextState* obj, int idx)                      { IM_ASSERT(idx <= obj->CurLenA); return obj->TextA[idx]; }
+static float   STB_TEXTEDIT_GETWIDTH(ImGuiInputTextState* obj, int line_start_idx, int char_idx)  { unsigned int c; InputTextDecodeChar(obj, line_start_idx + char_idx, &c); if (c == '\n') return IMSTB_TEXTEDIT_GETWIDTH_NEWLINE; ImGuiContext& g = *obj->Ctx; return g.Font->GetCharAdvance((ImWchar)c) * (g.FontSize / g.Font->FontSize); }
 static int     STB_TEXTEDIT_KEYTOTEXT(int key)                                                    { return key >= 0x200000 ? 0 : key; }
-static ImWchar STB_TEXTEDIT_NEWLINE = '\n';
+static char    STB_TEXTEDIT_NEWLINE = '\n';
 static void    STB_TEXTEDIT_LAYOUTROW(StbTexteditRow* r, ImGuiInputTextState* obj, int line_start_idx)
 {
-    const ImWchar* text = obj->TextW.Data;
-    const ImWchar* text_remaining = NULL;
-    const ImVec2 size = InputTextCalcTextSizeW(obj->Ctx, text + line_start_idx, text + obj->CurLenW, &text_remaining, NULL, true);
+    int text_remaining = 0;
+    const ImVec2 size = InputTextCalcTextSize(obj->Ctx, obj->TextA, line_start_idx, obj->CurLenA, &text_remaining, NULL, true);
     r->x0 = 0.0f;
     r->x1 = size.x;
     r->baseline_y_delta = size.y;
     r->ymin = 0.0f;
     r->ymax = size.y;
-    r->num_chars = (int)(text_remaining - (text + line_start_idx));
+    r->num_chars = text_remaining - line_start_idx;
 }
 
 static bool is_separator(unsigned int c)
@@ -3752,16 +3838,39 @@ static bool is_separator(unsigned int c)
     return c==',' || c==';' || c=='(' || c==')' || c=='{' || c=='}' || c=='[' || c==']' || c=='|' || c=='\n' || c=='\r' || c=='.' || c=='!';
 }
 
+// Step over one UTF-8 character. Like idx-1/idx+1, may return -1 or CurLenA+1 at the ends (see imstb_textedit.h)
+static int IMSTB_TEXTEDIT_GETPREVCHARINDEX_IMPL(ImGuiInputTextState* obj, int idx)
+{
+    if (idx <= 0)
+        return -1;
+    int prev = idx - 1;
+    while (prev > 0 && idx - prev < 4 && (obj->TextA[prev] & 0xC0) == 0x80) // Skip continuation bytes
+        prev--;
+    return prev;
+}
+static int IMSTB_TEXTEDIT_GETNEXTCHARINDEX_IMPL(ImGuiInputTextState* obj, int idx)
+{
+    if (idx >= obj->CurLenA)
+        return obj->CurLenA + 1;
+    unsigned int c;
+    return idx + InputTextDecodeChar(obj, idx, &c);
+}
+#define IMSTB_TEXTEDIT_GETPREVCHARINDEX IMSTB_TEXTEDIT_GETPREVCHARINDEX_IMPL
+#define IMSTB_TEXTEDIT_GETNEXTCHARINDEX IMSTB_TEXTEDIT_GETNEXTCHARINDEX_IMPL
+
 static int is_word_boundary_from_right(ImGuiInputTextState* obj, int idx)
 {
     // When ImGuiInputTextFlags_Password is set, we don't want actions such as CTRL+Arrow to leak the fact that underlying data are blanks or separators.
     if ((obj->Flags & ImGuiInputTextFlags_Password) || idx <= 0)
         return 0;
 
-    bool prev_white = ImCharIsBlankW(obj->TextW[idx - 1]);
-    bool prev_separ = is_separator(obj->TextW[idx - 1]);
-    bool curr_white = ImCharIsBlankW(obj->TextW[idx]);
-    bool curr_separ = is_separator(obj->TextW[idx]);
+    unsigned int prev_c, curr_c;
+    InputTextDecodeChar(obj, IMSTB_TEXTEDIT_GETPREVCHARINDEX(obj, idx), &prev_c);
+    InputTextDecodeChar(obj, idx, &curr_c);
+    bool prev_white = ImCharIsBlankW(prev_c);
+    bool prev_separ = is_separator(prev_c);
+    bool curr_white = ImCharIsBlankW(curr_c);
+    bool curr_separ = is_separator(curr_c);
     return ((prev_white || prev_separ) && !(curr_separ || curr_white)) || (curr_separ && !prev_separ);
 }
 static int is_word_boundary_from_left(ImGuiInputTextState* obj, int idx)
@@ -3769,63 +3878,43 @@ static int is_word_boundary_from_left(ImGuiInputTextState* obj, int idx)
     if ((obj->Flags & ImGuiInputTextFlags_Password) || idx <= 0)
         return 0;
 
-    bool prev_white = ImCharIsBlankW(obj->TextW[idx]);
-    bool prev_separ = is_separator(obj->TextW[idx]);
-    bool curr_white = ImCharIsBlankW(obj->TextW[idx - 1]);
-    bool curr_separ = is_separator(obj->TextW[idx - 1]);
+    unsigned int prev_c, curr_c;
+    InputTextDecodeChar(obj, idx, &prev_c);
+    InputTextDecodeChar(obj, IMSTB_TEXTEDIT_GETPREVCHARINDEX(obj, idx), &curr_c);
+    bool prev_white = ImCharIsBlankW(prev_c);
+    bool prev_separ = is_separator(prev_c);
+    bool curr_white = ImCharIsBlankW(curr_c);
+    bool curr_separ = is_separator(curr_c);
     return ((prev_white) && !(curr_separ || curr_white)) || (curr_separ && !prev_separ);
 }
-static int  STB_TEXTEDIT_MOVEWORDLEFT_IMPL(ImGuiInputTextState* obj, int idx)   { idx--; while (idx >= 0 && !is_word_boundary_from_right(obj, idx)) idx--; return idx < 0 ? 0 : idx; }
-static int  STB_TEXTEDIT_MOVEWORDRIGHT_MAC(ImGuiInputTextState* obj, int idx)   { idx++; int len = obj->CurLenW; while (idx < len && !is_word_boundary_from_left(obj, idx)) idx++; return idx > len ? len : idx; }
-static int  STB_TEXTEDIT_MOVEWORDRIGHT_WIN(ImGuiInputTextState* obj, int idx)   { idx++; int len = obj->CurLenW; while (idx < len && !is_word_boundary_from_right(obj, idx)) idx++; return idx > len ? len : idx; }
+static int  STB_TEXTEDIT_MOVEWORDLEFT_IMPL(ImGuiInputTextState* obj, int idx)   { idx = IMSTB_TEXTEDIT_GETPREVCHARINDEX(obj, idx); while (idx >= 0 && !is_word_boundary_from_right(obj, idx)) idx = IMSTB_TEXTEDIT_GETPREVCHARINDEX(obj, idx); return idx < 0 ? 0 : idx; }
+static int  STB_TEXTEDIT_MOVEWORDRIGHT_MAC(ImGuiInputTextState* obj, int idx)   { idx = IMSTB_TEXTEDIT_GETNEXTCHARINDEX(obj, idx); int len = obj->CurLenA; while (idx < len && !is_word_boundary_from_left(obj, idx)) idx = IMSTB_TEXTEDIT_GETNEXTCHARINDEX(obj, idx); return idx > len ? len : idx; }
+static int  STB_TEXTEDIT_MOVEWORDRIGHT_WIN(ImGuiInputTextState* obj, int idx)   { idx = IMSTB_TEXTEDIT_GETNEXTCHARINDEX(obj, idx); int len = obj->CurLenA; while (idx < len && !is_word_boundary_from_right(obj, idx)) idx = IMSTB_TEXTEDIT_GETNEXTCHARINDEX(obj, idx); return idx > len ? len : idx; }
 static int  STB_TEXTEDIT_MOVEWORDRIGHT_IMPL(ImGuiInputTextState* obj, int idx)  { ImGuiContext& g = *obj->Ctx; if (g.IO.ConfigMacOSXBehaviors) return STB_TEXTEDIT_MOVEWORDRIGHT_MAC(obj, idx); else return STB_TEXTEDIT_MOVEWORDRIGHT_WIN(obj, idx); }
 #define STB_TEXTEDIT_MOVEWORDLEFT   STB_TEXTEDIT_MOVEWORDLEFT_IMPL  // They need to be #define for stb_textedit.h
 #define STB_TEXTEDIT_MOVEWORDRIGHT  STB_TEXTEDIT_MOVEWORDRIGHT_IMPL
 
 static void STB_TEXTEDIT_DELETECHARS(ImGuiInputTextState* obj, int pos, int n)
 {
-    ImWchar* dst = obj->TextW.Data + pos;
-
-    // We maintain our buffer length in both UTF-8 and wchar formats
     obj->Edited = true;
-    obj->CurLenA -= ImTextCountUtf8BytesFromStr(dst, dst + n);
-    obj->CurLenW -= n;
-
-    // Offset remaining text (FIXME-OPT: Use memmove)
-    const ImWchar* src = obj->TextW.Data + pos + n;
-    while (ImWchar c = *src++)
-        *dst++ = c;
-    *dst = '\0';
+    obj->CurLenA -= n;
+    obj->TextA.erase(pos, n);
 }
 
-static bool STB_TEXTEDIT_INSERTCHARS(ImGuiInputTextState* obj, int pos, const ImWchar* new_text, int new_text_len)
+static bool STB_TEXTEDIT_INSERTCHARS(ImGuiInputTextState* obj, int pos, const char* new_text, int new_text_len)
 {
     const bool is_resizable = (obj->Flags & ImGuiInputTextFlags_CallbackResize) != 0;
-    const int text_len = obj->CurLenW;
+    const int text_len = obj->CurLenA;
     IM_ASSERT(pos <= text_len);
 
-    const int new_text_len_utf8 = ImTextCountUtf8BytesFromStr(new_text, new_text + new_text_len);
-    if (!is_resizable && (new_text_len_utf8 + obj->CurLenA + 1 > obj->BufCapacityA))
+    if (!is_resizable && (new_text_len + text_len + 1 > obj->BufCapacityA))
         return false;
 
-    // Grow internal buffer if needed
-    if (new_text_len + text_len + 1 > obj->TextW.Size)
-    {
-        if (!is_resizable)
-            return false;
-        IM_ASSERT(text_len < obj->TextW.Size);
-        obj->TextW.resize(text_len + ImClamp(new_text_len * 4, 32, ImMax(256, new_text_len)) + 1);
-    }
-
-    ImWchar* text = obj->TextW.Data;
-    if (pos != text_len)
-        memmove(text + pos + new_text_len, text + pos, (size_t)(text_len - pos) * sizeof(ImWchar));
-    memcpy(text + pos, new_text, (size_t)new_text_len * sizeof(ImWchar));
+    // Grow internal buffer if needed (only the gap is grown, text after the insertion point is moved by at most the distance from the previous edit)
+    obj->TextA.insert(pos, new_text, new_text_len);
 
     obj->Edited = true;
-    obj->CurLenW += new_text_len;
-    obj->CurLenA += new_text_len_utf8;
-    obj->TextW[obj->CurLenW] = '\0';
+    obj->CurLenA += new_text_len;
 
     return true;
 }
@@ -3857,8 +3946,8 @@ static bool STB_TEXTEDIT_INSERTCHARS(ImGuiInputTextState* obj, int pos, const Im
 // the stb_textedit_paste() function creates two separate records, so we perform it manually. (FIXME: Report to nothings/stb?)
 static void stb_textedit_replace(ImGuiInputTextState* str, STB_TexteditState* state, const IMSTB_TEXTEDIT_CHARTYPE* text, int text_len)
 {
-    stb_text_makeundo_replace(str, state, 0, str->CurLenW, text_len);
-    ImStb::STB_TEXTEDIT_DELETECHARS(str, 0, str->CurLenW);
+    stb_text_makeundo_replace(str, state, 0, str->CurLenA, text_len);
+    ImStb::STB_TEXTEDIT_DELETECHARS(str, 0, str->CurLenA);
     state->cursor = state->select_start = state->select_end = 0;
     if (text_len <= 0)
         return;
@@ -3880,13 +3969,47 @@ void ImGuiInputTextState::OnKeyPressed(int key)
     CursorAnimReset();
 }
 
+void ImGuiInputTextState::OnCharPressed(unsigned int c)
+{
+    // Convert the key to a UTF-8 byte sequence.
+    char utf8[5];
+    ImTextCharToUtf8(utf8, c);
+    stb_textedit_text(this, &Stb, utf8, (int)strlen(utf8));
+    CursorFollow = true;
+    CursorAnimReset();
+}
+
+void ImGuiInputTextState::OnCharsPressed(const char* text, int text_len)
+{
+    // Insert all the characters with one edit (one undo record). Overwrite mode replaces one character per typed
+    // character, and a fixed size buffer keeps what fits: insert them one by one then, as OnCharPressed() would.
+    const int selection_len = ImAbs(Stb.select_end - Stb.select_start);
+    const bool fits = (Flags & ImGuiInputTextFlags_CallbackResize) || CurLenA - selection_len + text_len + 1 <= BufCapacityA;
+    if (Stb.insert_mode || !fits)
+    {
+        const char* text_end = text + text_len;
+        for (const char* p = text; p < text_end; )
+        {
+            const int char_len = ImTextCountUtf8BytesFromChar(p, text_end);
+            stb_textedit_text(this, &Stb, p, char_len);
+            p += char_len;
+        }
+    }
+    else
+    {
+        stb_textedit_text(this, &Stb, text, text_len);
+    }
+    CursorFollow = true;
+    CursorAnimReset();
+}
+
 ImGuiInputTextCallbackData::ImGuiInputTextCallbackData()
 {
     memset(this, 0, sizeof(*this));
 }
 
 // Public API to manipulate UTF-8 text
-// We expose UTF-8 to the user (unlike the STB_TEXTEDIT_* functions which are manipulating wchar)
+// Positions are UTF-8 byte offsets, like the STB_TEXTEDIT_* functions. Callbacks receive a contiguous copy of the edit buffer (CallbackTextA).
 // FIXME: The existence of this rarely exercised code path is a bit of a nuisance.
 void ImGuiInputTextCallbackData::DeleteChars(int pos, int bytes_count)
 {
@@ -3919,14 +4042,14 @@ void ImGuiInputTextCallbackData::InsertChars(int pos, const char* new_text, cons
         if (!is_resizable)
             return;
 
-        // Contrary to STB_TEXTEDIT_INSERTCHARS() this is working in the UTF8 buffer, hence the mildly similar code (until we remove the U16 buffer altogether!)
+        // Contrary to STB_TEXTEDIT_INSERTCHARS() this is working in the contiguous callback buffer, hence the mildly similar code
         ImGuiContext& g = *Ctx;
         ImGuiInputTextState* edit_state = &g.InputTextState;
         IM_ASSERT(edit_state->ID != 0 && g.ActiveId == edit_state->ID);
-        IM_ASSERT(Buf == edit_state->TextA.Data);
+        IM_ASSERT(Buf == edit_state->CallbackTextA.Data);
         int new_buf_size = BufTextLen + ImClamp(new_text_len * 4, 32, ImMax(256, new_text_len)) + 1;
-        edit_state->TextA.reserve(new_buf_size + 1);
-        Buf = edit_state->TextA.Data;
+        edit_state->CallbackTextA.reserve(new_buf_size + 1);
+        Buf = edit_state->CallbackTextA.Data;
         BufSize = edit_state->BufCapacityA = new_buf_size;
     }
 
@@ -4044,17 +4167,12 @@ static bool InputTextFilterCharacter(ImGuiContext* ctx, unsigned int* p_char, Im
 }
 
 // Find the shortest single replacement we can make to get the new text from the old text.
-// Important: needs to be run before TextW is rewritten with the new characters because calling STB_TEXTEDIT_GETCHAR() at the end.
+// Important: needs to be run before TextA is rewritten with the new characters because calling STB_TEXTEDIT_GETCHAR() at the end.
 // FIXME: Ideally we should transition toward (1) making InsertChars()/DeleteChars() update undo-stack (2) discourage (and keep reconcile) or obsolete (and remove reconcile) accessing buffer directly.
-static void InputTextReconcileUndoStateAfterUserCallback(ImGuiInputTextState* state, const char* new_buf_a, int new_length_a)
+static void InputTextReconcileUndoStateAfterUserCallback(ImGuiInputTextState* state, const char* new_buf, int new_length)
 {
-    ImGuiContext& g = *GImGui;
-    const ImWchar* old_buf = state->TextW.Data;
-    const int old_length = state->CurLenW;
-    const int new_length = ImTextCountCharsFromUtf8(new_buf_a, new_buf_a + new_length_a);
-    g.TempBuffer.reserve_discard((new_length + 1) * sizeof(ImWchar));
-    ImWchar* new_buf = (ImWchar*)(void*)g.TempBuffer.Data;
-    ImTextStrFromUtf8(new_buf, new_length + 1, new_buf_a, new_buf_a + new_length_a);
+    const char* old_buf = state->TextA.make_contiguous();
+    const int old_length = state->CurLenA;
 
     const int shorter_length = ImMin(old_length, new_length);
     int first_diff;
@@ -4095,9 +4213,10 @@ void ImGui::InputTextDeactivateHook(ImGuiID id)
     }
     else
     {
-        IM_ASSERT(state->TextA.Data != 0);
+        IM_ASSERT(state->TextA.Buf.Data != 0);
         g.InputTextDeactivatedState.TextA.resize(state->CurLenA + 1);
-        memcpy(g.InputTextDeactivatedState.TextA.Data, state->TextA.Data, state->CurLenA + 1);
+        state->TextA.copy(0, state->CurLenA, g.InputTextDeactivatedState.TextA.Data);
+        g.InputTextDeactivatedState.TextA[state->CurLenA] = 0;
     }
 }
 
@@ -4107,8 +4226,7 @@ void ImGui::InputTextDeactivateHook(ImGuiID id)
 //   Note that in std::string world, capacity() would omit 1 byte used by the zero-terminator.
 // - When active, hold on a privately held copy of the text (and apply back to 'buf'). So changing 'buf' while the InputText is active has no effect.
 // - If you want to use ImGui::InputText() with std::string, see misc/cpp/imgui_stdlib.h
-// (FIXME: Rather confusing and messy function, among the worse part of our codebase, expecting to rewrite a V2 at some point.. Partly because we are
-//  doing UTF8 > U16 > UTF8 conversions on the go to easily interface with stb_textedit. Ideally should stay in UTF-8 all the time. See https://github.com/nothings/stb/issues/188)
+// (FIXME: Rather confusing and messy function, among the worse part of our codebase, expecting to rewrite a V2 at some point..)
 bool ImGui::InputTextEx(const char* label, const char* hint, char* buf, int buf_size, const ImVec2& size_arg, ImGuiInputTextFlags flags, ImGuiInputTextCallback callback, void* callback_user_data)
 {
     ImGuiWindow* window = GetCurrentWindow();
@@ -4240,17 +4358,15 @@ bool ImGui::InputTextEx(const char* label, const char* hint, char* buf, int buf_
         // Preserve cursor position and undo/redo stack if we come back to same widget
         // FIXME: Since we reworked this on 2022/06, may want to differentiate recycle_cursor vs recycle_undostate?
         bool recycle_state = (state->ID == id && !init_changed_specs && !init_reload_from_user_buf);
-        if (recycle_state && (state->CurLenA != buf_len || (state->TextAIsValid && strncmp(state->TextA.Data, buf, buf_len) != 0)))
+        if (recycle_state && !state->TextA.equals(buf, buf_len))
             recycle_state = false;
 
-        // Start edition
-        const char* buf_end = NULL;
+        // Start edition: the UTF-8 text is edited as is, this is a plain copy
         state->ID = id;
-        state->TextW.resize(buf_size + 1);          // wchar count <= UTF-8 count. we use +1 to make sure that .Data is always pointing to at least an empty string.
-        state->TextA.resize(0);
-        state->TextAIsValid = false;                // TextA is not valid yet (we will display buf until then)
-        state->CurLenW = ImTextStrFromUtf8(state->TextW.Data, buf_size, buf, NULL, &buf_end);
-        state->CurLenA = (int)(buf_end - buf);      // We can't get the result from ImStrncpy() above because it is not UTF-8 aware. Here we'll cut off malformed UTF-8.
+        state->TextA.Buf.resize(ImMax(buf_size, buf_len + 1));  // we use +1 to make sure that .Data is always pointing to at least an empty string.
+        memcpy(state->TextA.Buf.Data, buf, buf_len);
+        state->TextA.reset_gap(buf_len);
+        state->CurLenA = buf_len;
 
         if (recycle_state)
         {
@@ -4328,20 +4444,20 @@ bool ImGui::InputTextEx(const char* label, const char* hint, char* buf, int buf_
     bool validated = false;
 
     // When read-only we always use the live data passed to the function
-    // FIXME-OPT: Because our selection/cursor code currently needs the wide text we need to convert it when active, which is not ideal :(
     if (is_readonly && state != NULL && (render_cursor || render_selection))
     {
-        const char* buf_end = NULL;
-        state->TextW.resize(buf_size + 1);
-        state->CurLenW = ImTextStrFromUtf8(state->TextW.Data, state->TextW.Size, buf, NULL, &buf_end);
-        state->CurLenA = (int)(buf_end - buf);
+        const int buf_len = (int)strlen(buf);
+        state->TextA.Buf.resize(buf_len + 1);
+        memcpy(state->TextA.Buf.Data, buf, buf_len);
+        state->TextA.reset_gap(buf_len);
+        state->CurLenA = buf_len;
         state->CursorClamp();
         render_selection &= state->HasSelection();
     }
 
     // Select the buffer to render.
-    const bool buf_display_from_state = (render_cursor || render_selection || g.ActiveId == id) && !is_readonly && state && state->TextAIsValid;
-    const bool is_displaying_hint = (hint != NULL && (buf_display_from_state ? state->TextA.Data : buf)[0] == 0);
+    const bool buf_display_from_state = (render_cursor || render_selection || g.ActiveId == id) && !is_readonly && state;
+    const bool is_displaying_hint = (hint != NULL && (buf_display_from_state ? state->CurLenA == 0 : buf[0] == 0));
 
     // Password pushes a temporary font with only a fallback glyph
     if (is_password && !is_displaying_hint)
@@ -4360,11 +4476,9 @@ bool ImGui::InputTextEx(const char* label, const char* hint, char* buf, int buf_
     }
 
     // Process mouse inputs and character inputs
-    int backup_current_text_length = 0;
     if (g.ActiveId == id)
     {
         IM_ASSERT(state != NULL);
-        backup_current_text_length = state->CurLenA;
         state->Edited = false;
         state->BufCapacityA = buf_size;
         state->Flags = flags;
@@ -4445,7 +4559,7 @@ bool ImGui::InputTextEx(const char* label, const char* hint, char* buf, int buf_
             {
                 unsigned int c = '\t'; // Insert TAB
                 if (InputTextFilterCharacter(&g, &c, flags, callback, callback_user_data))
-                    state->OnKeyPressed((int)c);
+                    state->OnCharPressed(c);
             }
             // FIXME: Implement Shift+Tab
             /*
@@ -4461,15 +4575,27 @@ bool ImGui::InputTextEx(const char* label, const char* hint, char* buf, int buf_
         if (io.InputQueueCharacters.Size > 0)
         {
             if (!ignore_char_inputs && !is_readonly && !input_requested_by_nav)
+            {
+                // Gather the characters that pass filtering and insert them at once, so that a burst of typing or an
+                // IME commit delivered as characters is one edit and one undo record
+                ImVector<char>& chars = state->InputCharsA;
+                chars.resize(0);
                 for (int n = 0; n < io.InputQueueCharacters.Size; n++)
                 {
-                    // Insert character if they pass filtering
                     unsigned int c = (unsigned int)io.InputQueueCharacters[n];
                     if (c == '\t') // Skip Tab, see above.
                         continue;
                     if (InputTextFilterCharacter(&g, &c, flags, callback, callback_user_data))
-                        state->OnKeyPressed((int)c);
+                    {
+                        char utf8[5];
+                        ImTextCharToUtf8(utf8, c);
+                        for (const char* p = utf8; *p; p++)
+                            chars.push_back(*p);
+                    }
                 }
+                if (chars.Size > 0)
+                    state->OnCharsPressed(chars.Data, chars.Size);
+            }
 
             // Consume characters
             io.InputQueueCharacters.resize(0);
@@ -4551,7 +4677,7 @@ bool ImGui::InputTextEx(const char* label, const char* hint, char* buf, int buf_
             {
                 unsigned int c = '\n'; // Insert new line
                 if (InputTextFilterCharacter(&g, &c, flags, callback, callback_user_data))
-                    state->OnKeyPressed((int)c);
+                    state->OnCharPressed(c);
             }
         }
         else if (is_cancel)
@@ -4590,10 +4716,10 @@ bool ImGui::InputTextEx(const char* label, const char* hint, char* buf, int buf_
             if (io.SetClipboardTextFn)
             {
                 const int ib = state->HasSelection() ? ImMin(state->Stb.select_start, state->Stb.select_end) : 0;
-                const int ie = state->HasSelection() ? ImMax(state->Stb.select_start, state->Stb.select_end) : state->CurLenW;
-                const int clipboard_data_len = ImTextCountUtf8BytesFromStr(state->TextW.Data + ib, state->TextW.Data + ie) + 1;
-                char* clipboard_data = (char*)IM_ALLOC(clipboard_data_len * sizeof(char));
-                ImTextStrToUtf8(clipboard_data, clipboard_data_len, state->TextW.Data + ib, state->TextW.Data + ie);
+                const int ie = state->HasSelection() ? ImMax(state->Stb.select_start, state->Stb.select_end) : state->CurLenA;
+                char* clipboard_data = (char*)IM_ALLOC((ie - ib + 1) * sizeof(char));
+                state->TextA.copy(ib, ie, clipboard_data);
+                clipboard_data[ie - ib] = 0;
                 SetClipboardText(clipboard_data);
                 MemFree(clipboard_data);
             }
@@ -4609,25 +4735,26 @@ bool ImGui::InputTextEx(const char* label, const char* hint, char* buf, int buf_
         {
             if (const char* clipboard = GetClipboardText())
             {
-                // Filter pasted buffer
+                // Filter pasted buffer (filters may change characters, so this is re-encoded)
                 const int clipboard_len = (int)strlen(clipboard);
-                ImWchar* clipboard_filtered = (ImWchar*)IM_ALLOC((clipboard_len + 1) * sizeof(ImWchar));
-                int clipboard_filtered_len = 0;
+                ImVector<char> clipboard_filtered;
+                clipboard_filtered.reserve(clipboard_len + 1);
                 for (const char* s = clipboard; *s != 0; )
                 {
                     unsigned int c;
                     s += ImTextCharFromUtf8(&c, s, NULL);
                     if (!InputTextFilterCharacter(&g, &c, flags, callback, callback_user_data, true))
                         continue;
-                    clipboard_filtered[clipboard_filtered_len++] = (ImWchar)c;
+                    char c_utf8[5];
+                    ImTextCharToUtf8(c_utf8, c);
+                    for (const char* p = c_utf8; *p != 0; p++)
+                        clipboard_filtered.push_back(*p);
                 }
-                clipboard_filtered[clipboard_filtered_len] = 0;
-                if (clipboard_filtered_len > 0) // If everything was filtered, ignore the pasting operation
+                if (clipboard_filtered.Size > 0) // If everything was filtered, ignore the pasting operation
                 {
-                    stb_textedit_paste(state, &state->Stb, clipboard_filtered, clipboard_filtered_len);
+                    stb_textedit_paste(state, &state->Stb, clipboard_filtered.Data, clipboard_filtered.Size);
                     state->CursorFollow = true;
                 }
-                MemFree(clipboard_filtered);
             }
         }
 
@@ -4638,6 +4765,8 @@ bool ImGui::InputTextEx(const char* label, const char* hint, char* buf, int buf_
     // Process callbacks and apply result back to user's buffer.
     const char* apply_new_text = NULL;
     int apply_new_text_length = 0;
+    bool apply_new_text_from_state = false;  // copy from both sides of the edit buffer gap instead of 'apply_new_text'
+
     if (g.ActiveId == id)
     {
         IM_ASSERT(state != NULL);
@@ -4660,24 +4789,10 @@ bool ImGui::InputTextEx(const char* label, const char* hint, char* buf, int buf_
                 apply_new_text = state->InitialTextA.Data;
                 apply_new_text_length = state->InitialTextA.Size - 1;
                 value_changed = true;
-                ImVector<ImWchar> w_text;
-                if (apply_new_text_length > 0)
-                {
-                    w_text.resize(ImTextCountCharsFromUtf8(apply_new_text, apply_new_text + apply_new_text_length) + 1);
-                    ImTextStrFromUtf8(w_text.Data, w_text.Size, apply_new_text, apply_new_text + apply_new_text_length);
-                }
-                stb_textedit_replace(state, &state->Stb, w_text.Data, (apply_new_text_length > 0) ? (w_text.Size - 1) : 0);
+                stb_textedit_replace(state, &state->Stb, state->InitialTextA.Data, apply_new_text_length);
             }
         }
 
-        // Apply ASCII value
-        if (!is_readonly)
-        {
-            state->TextAIsValid = true;
-            state->TextA.resize(state->TextW.Size * 4 + 1);
-            ImTextStrToUtf8(state->TextA.Data, state->TextA.Size, state->TextW.Data, NULL);
-        }
-
         // When using 'ImGuiInputTextFlags_EnterReturnsTrue' as a special case we reapply the live buffer back to the input buffer
         // before clearing ActiveId, even though strictly speaking it wasn't modified on this frame.
         // If we didn't do that, code like InputInt() with ImGuiInputTextFlags_EnterReturnsTrue would fail.
@@ -4732,39 +4847,45 @@ bool ImGui::InputTextEx(const char* label, const char* hint, char* buf, int buf_
                     callback_data.Flags = flags;
                     callback_data.UserData = callback_user_data;
 
-                    char* callback_buf = is_readonly ? buf : state->TextA.Data;
+                    // Callbacks work on a contiguous copy of the text, which they may modify in place
+                    if (!is_readonly)
+                    {
+                        state->CallbackTextA.resize(ImMax(state->BufCapacityA, state->CurLenA + 1));
+                        state->TextA.copy(0, state->CurLenA, state->CallbackTextA.Data);
+                        state->CallbackTextA[state->CurLenA] = 0;
+                    }
+                    char* callback_buf = is_readonly ? buf : state->CallbackTextA.Data;
                     callback_data.EventKey = event_key;
                     callback_data.Buf = callback_buf;
                     callback_data.BufTextLen = state->CurLenA;
                     callback_data.BufSize = state->BufCapacityA;
                     callback_data.BufDirty = false;
 
-                    // We have to convert from wchar-positions to UTF-8-positions, which can be pretty slow (an incentive to ditch the ImWchar buffer, see https://github.com/nothings/stb/issues/188)
-                    ImWchar* text = state->TextW.Data;
-                    const int utf8_cursor_pos = callback_data.CursorPos = ImTextCountUtf8BytesFromStr(text, text + state->Stb.cursor);
-                    const int utf8_selection_start = callback_data.SelectionStart = ImTextCountUtf8BytesFromStr(text, text + state->Stb.select_start);
-                    const int utf8_selection_end = callback_data.SelectionEnd = ImTextCountUtf8BytesFromStr(text, text + state->Stb.select_end);
+                    const int utf8_cursor_pos = callback_data.CursorPos = state->Stb.cursor;
+                    const int utf8_selection_start = callback_data.SelectionStart = state->Stb.select_start;
+                    const int utf8_selection_end = callback_data.SelectionEnd = state->Stb.select_end;
 
                     // Call user code
                     callback(&callback_data);
 
                     // Read back what user may have modified
-                    callback_buf = is_readonly ? buf : state->TextA.Data; // Pointer may have been invalidated by a resize callback
+                    callback_buf = is_readonly ? buf : state->CallbackTextA.Data; // Pointer may have been invalidated by a resize callback
                     IM_ASSERT(callback_data.Buf == callback_buf);         // Invalid to modify those fields
                     IM_ASSERT(callback_data.BufSize == state->BufCapacityA);
                     IM_ASSERT(callback_data.Flags == flags);
                     const bool buf_dirty = callback_data.BufDirty;
-                    if (callback_data.CursorPos != utf8_cursor_pos || buf_dirty)            { state->Stb.cursor = ImTextCountCharsFromUtf8(callback_data.Buf, callback_data.Buf + callback_data.CursorPos); state->CursorFollow = true; }
-                    if (callback_data.SelectionStart != utf8_selection_start || buf_dirty)  { state->Stb.select_start = (callback_data.SelectionStart == callback_data.CursorPos) ? state->Stb.cursor : ImTextCountCharsFromUtf8(callback_data.Buf, callback_data.Buf + callback_data.SelectionStart); }
-                    if (callback_data.SelectionEnd != utf8_selection_end || buf_dirty)      { state->Stb.select_end = (callback_data.SelectionEnd == callback_data.SelectionStart) ? state->Stb.select_start : ImTextCountCharsFromUtf8(callback_data.Buf, callback_data.Buf + callback_data.SelectionEnd); }
+                    if (callback_data.CursorPos != utf8_cursor_pos || buf_dirty)            { state->Stb.cursor = callback_data.CursorPos; state->CursorFollow = true; }
+                    if (callback_data.SelectionStart != utf8_selection_start || buf_dirty)  { state->Stb.select_start = (callback_data.SelectionStart == callback_data.CursorPos) ? state->Stb.cursor : callback_data.SelectionStart; }
+                    if (callback_data.SelectionEnd != utf8_selection_end || buf_dirty)      { state->Stb.select_end = (callback_data.SelectionEnd == callback_data.SelectionStart) ? state->Stb.select_start : callback_data.SelectionEnd; }
                     if (buf_dirty)
                     {
                         IM_ASSERT(!is_readonly);
                         IM_ASSERT(callback_data.BufTextLen == (int)strlen(callback_data.Buf)); // You need to maintain BufTextLen if you change the text!
                         InputTextReconcileUndoStateAfterUserCallback(state, callback_data.Buf, callback_data.BufTextLen); // FIXME: Move the rest of this block inside function and rename to InputTextReconcileStateAfterUserCallback() ?
-                        if (callback_data.BufTextLen > backup_current_text_length && is_resizable)
-                            state->TextW.resize(state->TextW.Size + (callback_data.BufTextLen - backup_current_text_length)); // Worse case scenario resize
-                        state->CurLenW = ImTextStrFromUtf8(state->TextW.Data, state->TextW.Size, callback_data.Buf, NULL);
+                        if (callback_data.BufTextLen + 1 > state->TextA.Buf.Size)
+                            state->TextA.Buf.resize(callback_data.BufTextLen + 1);
+                        memcpy(state->TextA.Buf.Data, callback_data.Buf, callback_data.BufTextLen);
+                        state->TextA.reset_gap(callback_data.BufTextLen);
                         state->CurLenA = callback_data.BufTextLen;  // Assume correct length and valid UTF-8 from user, saves us an extra strlen()
                         state->CursorAnimReset();
                     }
@@ -4772,9 +4893,9 @@ bool ImGui::InputTextEx(const char* label, const char* hint, char* buf, int buf_
             }
 
             // Will copy result string if modified
-            if (!is_readonly && strcmp(state->TextA.Data, buf) != 0)
+            if (!is_readonly && !state->TextA.equals(buf, (int)strlen(buf)))
             {
-                apply_new_text = state->TextA.Data;
+                apply_new_text_from_state = true;
                 apply_new_text_length = state->CurLenA;
                 value_changed = true;
             }
@@ -4795,9 +4916,9 @@ bool ImGui::InputTextEx(const char* label, const char* hint, char* buf, int buf_
     }
 
     // Copy result to user buffer. This can currently only happen when (g.ActiveId == id)
-    if (apply_new_text != NULL)
+    if (apply_new_text != NULL || apply_new_text_from_state)
     {
-        // We cannot test for 'backup_current_text_length != apply_new_text_length' here because we have no guarantee that the size
+        // We cannot test for 'state->CurLenA != apply_new_text_length' here because we have no guarantee that the size
         // of our owned buffer matches the size of the string object held by the user, and by design we allow InputText() to be used
         // without any storage on user's side.
         IM_ASSERT(apply_new_text_length >= 0);
@@ -4820,7 +4941,19 @@ bool ImGui::InputTextEx(const char* label, const char* hint, char* buf, int buf_
         //IMGUI_DEBUG_PRINT("InputText(\"%s\"): apply_new_text length %d\n", label, apply_new_text_length);
 
         // If the underlying buffer resize was denied or not carried to the next frame, apply_new_text_length+1 may be >= buf_size.
-        ImStrncpy(buf, apply_new_text, ImMin(apply_new_text_length + 1, buf_size));
+        if (apply_new_text_from_state)
+        {
+            const int copy_length = ImMin(apply_new_text_length, buf_size - 1);
+            if (copy_length >= 0)
+            {
+                state->TextA.copy(0, copy_length, buf);
+                buf[copy_length] = 0;
+            }
+        }
+        else
+        {
+            ImStrncpy(buf, apply_new_text, ImMin(apply_new_text_length + 1, buf_size));
+        }
     }
 
     // Release active ID at the end of the function (so e.g. pressing Return still does a final application of the value)
@@ -4845,7 +4978,8 @@ bool ImGui::InputTextEx(const char* label, const char* hint, char* buf, int buf_
     // without any carriage return, which would makes ImFont::RenderText() reserve too many vertices and probably crash. Avoid it altogether.
     // Note that we only use this limit on single-line InputText(), so a pathologically large line on a InputTextMultiline() would still crash.
     const int buf_display_max_length = 2 * 1024 * 1024;
-    const char* buf_display = buf_display_from_state ? state->TextA.Data : buf; //-V595
+    // When displaying from the state, the edit buffer is drawn directly (see InputTextRenderText()) and 'buf' was just updated from it.
+    const char* buf_display = buf;
     const char* buf_display_end = NULL; // We have specialized paths below for setting the length
     if (is_displaying_hint)
     {
@@ -4858,7 +4992,8 @@ bool ImGui::InputTextEx(const char* label, const char* hint, char* buf, int buf_
     if (render_cursor || render_selection)
     {
         IM_ASSERT(state != NULL);
-        if (!is_displaying_hint)
+        const bool render_text_from_state = buf_display_from_state && !is_displaying_hint;
+        if (!is_displaying_hint && !render_text_from_state)
             buf_display_end = buf_display + state->CurLenA;
 
         // Render text (with cursor and selection)
@@ -4867,24 +5002,24 @@ bool ImGui::InputTextEx(const char* label, const char* hint, char* buf, int buf_
         // - Handle scrolling, highlight selection, display cursor (those all requires some form of 1d->2d cursor position calculation)
         // - Measure text height (for scrollbar)
         // We are attempting to do most of that in **one main pass** to minimize the computation cost (non-negligible for large amount of text) + 2nd pass for selection rendering (we could merge them by an extra refactoring effort)
-        // FIXME: This should occur on buf_display but we'd need to maintain cursor/select_start/select_end for UTF-8.
-        const ImWchar* text_begin = state->TextW.Data;
+        // Text is accessed through byte offsets as it is split by the gap.
+        const ImGapBuffer<char>& text_a = state->TextA;
         ImVec2 cursor_offset, select_start_offset;
 
         {
             // Find lines numbers straddling 'cursor' (slot 0) and 'select_start' (slot 1) positions.
-            const ImWchar* searches_input_ptr[2] = { NULL, NULL };
+            int searches_input_idx[2] = { 0, 0 };
             int searches_result_line_no[2] = { -1000, -1000 };
             int searches_remaining = 0;
             if (render_cursor)
             {
-                searches_input_ptr[0] = text_begin + state->Stb.cursor;
+                searches_input_idx[0] = state->Stb.cursor;
                 searches_result_line_no[0] = -1;
                 searches_remaining++;
             }
             if (render_selection)
             {
-                searches_input_ptr[1] = text_begin + ImMin(state->Stb.select_start, state->Stb.select_end);
+                searches_input_idx[1] = ImMin(state->Stb.select_start, state->Stb.select_end);
                 searches_result_line_no[1] = -1;
                 searches_remaining++;
             }
@@ -4893,14 +5028,22 @@ bool ImGui::InputTextEx(const char* label, const char* hint, char* buf, int buf_
             // In multi-line mode, we never exit the loop until all lines are counted, so add one extra to the searches_remaining counter.
             searches_remaining += is_multiline ? 1 : 0;
             int line_count = 0;
-            //for (const ImWchar* s = text_begin; (s = (const ImWchar*)wcschr((const wchar_t*)s, (wchar_t)'\n')) != NULL; s++)  // FIXME-OPT: Could use this when wchar_t are 16-bit
-            for (const ImWchar* s = text_begin; *s != 0; s++)
-                if (*s == '\n')
+            const char* segments[2];
+            int segments_len[2];
+            text_a.get_segments(0, state->CurLenA, &segments[0], &segments_len[0], &segments[1], &segments_len[1]);
+            for (int segment_n = 0; segment_n < 2 && searches_remaining > 0; segment_n++)
+            {
+                const char* segment_begin = segments[segment_n];
+                const char* segment_end = segment_begin + segments_len[segment_n];
+                const int segment_offset = (segment_n == 0) ? 0 : segments_len[0];
+                for (const char* p = segment_begin; p < segment_end && (p = (const char*)memchr(p, '\n', segment_end - p)) != NULL; p++)
                 {
+                    const int s = segment_offset + (int)(p - segment_begin);
                     line_count++;
-                    if (searches_result_line_no[0] == -1 && s >= searches_input_ptr[0]) { searches_result_line_no[0] = line_count; if (--searches_remaining <= 0) break; }
-                    if (searches_result_line_no[1] == -1 && s >= searches_input_ptr[1]) { searches_result_line_no[1] = line_count; if (--searches_remaining <= 0) break; }
+                    if (searches_result_line_no[0] == -1 && s >= searches_input_idx[0]) { searches_result_line_no[0] = line_count; if (--searches_remaining <= 0) break; }
+                    if (searches_result_line_no[1] == -1 && s >= searches_input_idx[1]) { searches_result_line_no[1] = line_count; if (--searches_remaining <= 0) break; }
                 }
+            }
             line_count++;
             if (searches_result_line_no[0] == -1)
                 searches_result_line_no[0] = line_count;
@@ -4908,11 +5051,11 @@ bool ImGui::InputTextEx(const char* label, const char* hint, char* buf, int buf_
                 searches_result_line_no[1] = line_count;
 
             // Calculate 2d position by finding the beginning of the line and measuring distance
-            cursor_offset.x = InputTextCalcTextSizeW(&g, ImStrbolW(searches_input_ptr[0], text_begin), searches_input_ptr[0]).x;
+            cursor_offset.x = InputTextCalcTextSize(&g, text_a, InputTextFindLineBegin(text_a, searches_input_idx[0]), searches_input_idx[0]).x;
             cursor_offset.y = searches_result_line_no[0] * g.FontSize;
             if (searches_result_line_no[1] >= 0)
             {
-                select_start_offset.x = InputTextCalcTextSizeW(&g, ImStrbolW(searches_input_ptr[1], text_begin), searches_input_ptr[1]).x;
+                select_start_offset.x = InputTextCalcTextSize(&g, text_a, InputTextFindLineBegin(text_a, searches_input_idx[1]), searches_input_idx[1]).x;
                 select_start_offset.y = searches_result_line_no[1] * g.FontSize;
             }
 
@@ -4960,28 +5103,26 @@ bool ImGui::InputTextEx(const char* label, const char* hint, char* buf, int buf_
         const ImVec2 draw_scroll = ImVec2(state->ScrollX, 0.0f);
         if (render_selection)
         {
-            const ImWchar* text_selected_begin = text_begin + ImMin(state->Stb.select_start, state->Stb.select_end);
-            const ImWchar* text_selected_end = text_begin + ImMax(state->Stb.select_start, state->Stb.select_end);
+            const int text_selected_begin = ImMin(state->Stb.select_start, state->Stb.select_end);
+            const int text_selected_end = ImMax(state->Stb.select_start, state->Stb.select_end);
 
             ImU32 bg_color = GetColorU32(ImGuiCol_TextSelectedBg, render_cursor ? 1.0f : 0.6f); // FIXME: current code flow mandate that render_cursor is always true here, we are leaving the transparent one for tests.
             float bg_offy_up = is_multiline ? 0.0f : -1.0f;    // FIXME: those offsets should be part of the style? they don't play so well with multi-line selection.
             float bg_offy_dn = is_multiline ? 0.0f : 2.0f;
             ImVec2 rect_pos = draw_pos + select_start_offset - draw_scroll;
-            for (const ImWchar* p = text_selected_begin; p < text_selected_end; )
+            for (int p = text_selected_begin; p < text_selected_end; )
             {
                 if (rect_pos.y > clip_rect.w + g.FontSize)
                     break;
                 if (rect_pos.y < clip_rect.y)
                 {
-                    //p = (const ImWchar*)wmemchr((const wchar_t*)p, '\n', text_selected_end - p);  // FIXME-OPT: Could use this when wchar_t are 16-bit
-                    //p = p ? p + 1 : text_selected_end;
                     while (p < text_selected_end)
-                        if (*p++ == '\n')
+                        if (text_a[p++] == '\n')
                             break;
                 }
                 else
                 {
-                    ImVec2 rect_size = InputTextCalcTextSizeW(&g, p, text_selected_end, &p, NULL, true);
+                    ImVec2 rect_size = InputTextCalcTextSize(&g, text_a, p, text_selected_end, &p, NULL, true);
                     if (rect_size.x <= 0.0f) rect_size.x = IM_TRUNC(g.Font->GetCharAdvance((ImWchar)' ') * 0.50f); // So we can see selected empty lines
                     ImRect rect(rect_pos + ImVec2(0.0f, bg_offy_up - g.FontSize), rect_pos + ImVec2(rect_size.x, bg_offy_dn));
                     rect.ClipWith(clip_rect);
@@ -4994,10 +5135,14 @@ bool ImGui::InputTextEx(const char* label, const char* hint, char* buf, int buf_
         }
 
         // We test for 'buf_display_max_length' as a way to avoid some pathological cases (e.g. single-line 1 MB string) which would make ImDrawList crash.
-        if (is_multiline || (buf_display_end - buf_display) < buf_display_max_length)
+        const int buf_display_len = render_text_from_state ? state->CurLenA : (int)(buf_display_end - buf_display);
+        if (is_multiline || buf_display_len < buf_display_max_length)
         {
             ImU32 col = GetColorU32(is_displaying_hint ? ImGuiCol_TextDisabled : ImGuiCol_Text);
-            draw_window->DrawList->AddText(g.Font, g.FontSize, draw_pos - draw_scroll, col, buf_display, buf_display_end, 0.0f, is_multiline ? NULL : &clip_rect);
+            if (render_text_from_state)
+                InputTextRenderText(&g, draw_window->DrawList, draw_pos - draw_scroll, col, text_a, state->CurLenA, is_multiline ? NULL : &clip_rect);
+            else
+                draw_window->DrawList->AddText(g.Font, g.FontSize, draw_pos - draw_scroll, col, buf_display, buf_display_end, 0.0f, is_multiline ? NULL : &clip_rect);
         }
 
         // Draw blinking cursor
@@ -5086,7 +5231,7 @@ void ImGui::DebugNodeInputTextState(ImGuiInputTextState* state)
     ImStb::StbUndoState* undo_state = &stb_state->undostate;
     Text("ID: 0x%08X, ActiveID: 0x%08X", state->ID, g.ActiveId);
     DebugLocateItemOnHover(state->ID);
-    Text("CurLenW: %d, CurLenA: %d, Cursor: %d, Selection: %d..%d", state->CurLenW, state->CurLenA, stb_state->cursor, stb_state->select_start, stb_state->select_end);
+    Text("CurLenA: %d, Cursor: %d, Selection: %d..%d", state->CurLenA, stb_state->cursor, stb_state->select_start, stb_state->select_end);
     Text("has_preferred_x: %d (%.2f)", stb_state->has_preferred_x, stb_state->preferred_x);
     Text("undo_point: %d, redo_point: %d, undo_char_point: %d, redo_char_point: %d", undo_state->undo_point, undo_state->redo_point, undo_state->undo_char_point, undo_state->redo_char_point);
     if (BeginChild("undopoints", ImVec2(0.0f, GetTextLineHeight() * 10), ImGuiChildFlags_Border | ImGuiChildFlags_ResizeY)) // Visualize undo state
@@ -5100,7 +5245,7 @@ void ImGui::DebugNodeInputTextState(ImGuiInputTextState* state)
                 BeginDisabled();
             char buf[64] = "";
             if (undo_rec_type != ' ' && undo_rec->char_storage != -1)
-                ImTextStrToUtf8(buf, IM_ARRAYSIZE(buf), undo_state->undo_char + undo_rec->char_storage, undo_state->undo_char + undo_rec->char_storage + undo_rec->insert_length);
+                ImStrncpy(buf, undo_state->undo_char + undo_rec->char_storage, ImMin(undo_rec->insert_length + 1, IM_ARRAYSIZE(buf)));
             Text("%c [%02d] where %03d, insert %03d, delete %03d, char_storage %03d \"%s\"",
                 undo_rec_type, n, undo_rec->where, undo_rec->insert_length, undo_rec->delete_length, undo_rec->char_storage, buf);
             if (undo_rec_type == ' ')
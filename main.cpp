@@ -21,6 +21,14 @@
 #include <filesystem>
 #define STB_IMAGE_IMPLEMENTATION
 #include "headers/stb_image.h"
+#include "src/document.h"
+#include "src/save_queue.h"
+#include "src/journal.h"
+#include "src/text_search.h"
+#include "src/regex_search.h"
+#include "src/project_search.h"
+#include "src/trigram_index.h"
+#include "src/wrap_layout.h"
 #define GL_SILENCE_DEPRECATION
 #if defined(IMGUI_IMPL_OPENGL_ES2)
 #include <GLES2/gl2.h>
@@ -129,20 +137,67 @@ static void SaveToFile(std::string filename, std::string theText)
     OutFile.close();
 }
 
-static ImVector<char> OpenFile(std::string filename)
-{
-    std::string fileLine;
+// documents are saved on a writer thread (temp file + fsync + rename, see src/save_queue.h)
+static SaveQueue save_queue;
+
+// optional trigram index of the current directory for "find in files" (see src/trigram_index.h), told about the files
+// we write so that it doesn't have to find them on disk
+static TrigramIndex project_index;
+
+// unsaved edits are journaled so that they survive closing the window or a crash (see src/journal.h)
+static const char* JOURNAL_FILENAME = ".irohde-journal";
+static Journal journal;
 
-    std::ifstream InFile(filename);
+// the file is read on a worker thread, the tab shows up right away and fills in as chunks arrive (see PollFileLoad)
+static void OpenFile(std::string filename, Document* document)
+{
+    document->Loader.reset(new FileLoader());
+    if (!document->Loader->Start(filename.c_str())) {
+        std::cerr << "Error: Unable to open " << filename << std::endl;
+        document->Loader.reset();
+        return;
+    }
+    document->DiskPath = filename;
+    document->DiskStamp = document->Loader->Stamp();
+}
 
-    ImVector<char> outputText;
-    char byte;
-    while (InFile.get(byte)) {
-        outputText.push_back(byte);
+// called every frame for every tab, moves what the loader has read so far into the document
+static void PollFileLoad(Document* document)
+{
+    if (!document->Loader) {
+        return;
+    }
+    document->Loader->Poll(&document->Text);
+    if (!document->Loader->IsLoading()) {
+        if (document->Loader->Failed()) {
+            std::cerr << "Error: Unable to read the whole file" << std::endl;
+            document->DiskPath.clear();
+            // edits to a partial file can't be replayed on top of the real one
+            if (document->Journal) {
+                document->Journal->Discard();
+            }
+        }
+        document->Loader.reset();
     }
+}
+
+// files this big are opened in the read-only viewer instead of being loaded into an editor tab
+static const size_t VIEWER_MIN_FILE_SIZE = 256 * 1024 * 1024;
 
+static bool OpenFileInViewer(std::string filename, Document* document)
+{
+    std::ifstream InFile(filename, std::ios::binary | std::ios::ate);
+    if (!InFile || (size_t)InFile.tellg() < VIEWER_MIN_FILE_SIZE) {
+        return false;
+    }
     InFile.close();
-    return outputText;
+
+    document->View.reset(new FileView());
+    if (!document->View->Open(filename.c_str())) {
+        document->View.reset();
+        return false;
+    }
+    return true;
 }
 
 static std::string FileNameWithoutDot(const std::string& str)
@@ -181,32 +236,239 @@ static std::string RunConsoleCommand(std::string command) {
     return newConsoleOutputText;
 }
 
-static std::map<int, ImVector<char>> indexed_im_vectors;
+static std::map<int, Document> indexed_documents;
 
-static void AddIndexedImVector(int index, const ImVector<char>& im_vector) {
-    indexed_im_vectors[index] = im_vector;
+static Document& AddIndexedDocument(int index) {
+    Document& document = indexed_documents[index];
+    document = Document();
+    return document;
 }
 
-static ImVector<char>& GetIndexedImVector(int index) {
-    return indexed_im_vectors[index];
+static Document& GetIndexedDocument(int index) {
+    return indexed_documents[index];
 }
 
-static void RemoveIndexedImVector(int index) {
-    indexed_im_vectors.erase(index);
+static void RemoveIndexedDocument(int index) {
+    indexed_documents.erase(index);
 
-    // Recalculate indexes
+    // Recalculate indexes (documents are moved, not copied)
     int new_index = 0;
-    std::map<int, ImVector<char>> new_map;
-    for (const auto& pair : indexed_im_vectors) {
-        new_map[new_index++] = pair.second;
+    std::map<int, Document> new_map;
+    for (auto& pair : indexed_documents) {
+        new_map[new_index++] = std::move(pair.second);
+    }
+    indexed_documents = std::move(new_map);
+}
+
+// tells the tabs how their saves went
+static void PollSaveResults()
+{
+    SaveQueue::Result result;
+    while (save_queue.PopResult(&result)) {
+        if (!result.Ok) {
+            std::cerr << "Error: " << result.Error << std::endl;
+        }
+        for (auto& pair : indexed_documents) {
+            if (pair.second.SavePath == result.Filename) {
+                pair.second.SaveStatus = result.Ok ? "Saved." : result.Error;
+                // remember what is on disk now so the next save only writes what changes after this
+                if (result.Ok) {
+                    pair.second.Text.MarkSaved(result.Snapshot);
+                    project_index.FileChanged(result.Filename);
+                    pair.second.DiskPath = result.Filename;
+                    pair.second.DiskStamp = result.Stamp;
+                    if (pair.second.Journal) {
+                        pair.second.Journal->Saved(result.Tag, result.Filename, result.Stamp);
+                    }
+                }
+                else {
+                    pair.second.DiskPath.clear();
+                }
+            }
+        }
+    }
+}
+
+// find bar of the active tab: the whole text is searched on a worker thread (see src/text_search.h), the editor and
+// the viewer highlight the matches they display. "Replace all" builds the new text in one pass, on a worker thread for
+// big texts (see src/text_replace.h), and puts it in as one edit.
+static bool show_find_bar = false;
+static bool focus_find_bar = false;
+static bool find_match_case = false;
+static ImVector<char> find_query;
+static ImVector<char> replace_text;
+static bool replace_regex = false;
+
+static void CloseFindBar()
+{
+    show_find_bar = false;
+    for (auto& pair : indexed_documents) {
+        pair.second.Search.reset();
+        pair.second.Replace.reset();
+        pair.second.ReplaceStatus.clear();
+        pair.second.Editor.FindText.clear();
+        pair.second.Viewer.FindText.clear();
+        pair.second.Viewer.FindCurrent = (size_t)-1;
+    }
+}
+
+static void ShowReplaceAll(Document* document, const std::string& query, bool ignore_case)
+{
+    if (replace_text.empty())
+        replace_text.push_back(0);
+    ImGui::SetNextItemWidth(ImGui::GetFontSize() * 16);
+    MyInputText("##ReplaceText", &replace_text, ImVec2(0, 0));
+    ImGui::SameLine();
+    const bool replacing = document->Replace && document->Replace->IsReplacing();
+    if (ImGui::Button("Replace all") && !replacing && !query.empty()) {
+        document->Replace.reset(new TextReplace());
+        std::string error;
+        if (!document->Replace->Start(document->Text, query, replace_regex, ignore_case, replace_text.begin(), &error)) {
+            document->ReplaceStatus = "Invalid regular expression: " + error;
+            document->Replace.reset();
+        }
+    }
+    ImGui::SameLine();
+    ImGui::Checkbox("Regex##Replace", &replace_regex);
+
+    if (document->Replace) {
+        TextReplace& replace = *document->Replace;
+        if (replace.IsReplacing()) {
+            ImGui::SameLine();
+            ImGui::Text("Replacing... %.0f%% (%zu matches)", replace.Progress() * 100.0f, replace.MatchCount());
+            ImGui::SameLine();
+            if (ImGui::Button("Cancel##Replace")) {
+                replace.Cancel();
+                document->ReplaceStatus = "Cancelled.";
+                document->Replace.reset();
+            }
+            return;
+        }
+        // the text may have been edited meanwhile, the result would undo that: Apply() refuses then
+        size_t begin, end;
+        char status[128];
+        if (replace.Apply(&document->Text, &document->Editor.Undo, &begin, &end)) {
+            snprintf(status, sizeof(status), "Replaced %zu matches.", replace.MatchCount());
+            document->Editor.Cursor = std::min(document->Editor.Cursor, document->Text.Size());
+            document->Editor.ClearSelection();
+        }
+        else if (replace.MatchCount() == 0) {
+            snprintf(status, sizeof(status), "No match.");
+        }
+        else {
+            snprintf(status, sizeof(status), "The text was edited while replacing, nothing was replaced.");
+        }
+        document->ReplaceStatus = status;
+        document->Replace.reset();
+    }
+    if (!document->ReplaceStatus.empty()) {
+        ImGui::SameLine();
+        ImGui::Text("%s", document->ReplaceStatus.c_str());
+    }
+}
+
+static void ShowFindBar(Document* document)
+{
+    if (find_query.empty())
+        find_query.push_back(0);
+    if (focus_find_bar) {
+        ImGui::SetKeyboardFocusHere();
+        focus_find_bar = false;
+    }
+    ImGui::SetNextItemWidth(ImGui::GetFontSize() * 16);
+    const bool enter_pressed = MyInputText("##FindQuery", &find_query, ImVec2(0, 0), ImGuiInputTextFlags_EnterReturnsTrue);
+    if (enter_pressed) {
+        ImGui::SetKeyboardFocusHere(-1); // keep typing in the field, Enter goes to the next match
+    }
+    ImGui::SameLine();
+    const bool find_prev = ImGui::ArrowButton("##FindPrev", ImGuiDir_Up);
+    ImGui::SameLine();
+    const bool find_next = ImGui::ArrowButton("##FindNext", ImGuiDir_Down) || enter_pressed;
+    ImGui::SameLine();
+    ImGui::Checkbox("Match case", &find_match_case);
+    ImGui::SameLine();
+    if (ImGui::Button("Close")) {
+        CloseFindBar();
+        return;
+    }
+
+    // restart the search when the query or the text changed. Typing more of the query only checks the previous matches.
+    const std::string query = find_query.begin();
+    const bool ignore_case = !find_match_case;
+    if (!document->Search) {
+        document->Search.reset(new TextSearch());
+    }
+    TextSearch& search = *document->Search;
+    if (document->View) {
+        if (search.Query() != query || search.IgnoreCase() != ignore_case) {
+            search.StartMapped(document->View->Data(), document->View->Size(), query, ignore_case);
+            document->Viewer.FindCurrent = (size_t)-1;
+        }
+        document->Viewer.FindText = query;
+        document->Viewer.FindIgnoreCase = ignore_case;
+    }
+    else {
+        if (search.Query() != query || search.IgnoreCase() != ignore_case || search.TextVersion() != document->Text.Version()) {
+            search.Start(document->Text, query, ignore_case);
+        }
+        document->Editor.FindText = query;
+        document->Editor.FindIgnoreCase = ignore_case;
+    }
+
+    // the current match is the selection in the editor, FindCurrent in the viewer
+    if (find_next || find_prev) {
+        size_t from;
+        if (document->View) {
+            const size_t current = document->Viewer.FindCurrent;
+            from = current != (size_t)-1 ? current : document->View->LineStart(document->Viewer.TopLine);
+            if (find_next && current != (size_t)-1) {
+                from++;
+            }
+        }
+        else {
+            from = document->Editor.SelectionMin();
+            if (find_next && document->Editor.HasSelection()) {
+                from++;
+            }
+        }
+        size_t found;
+        if (find_next ? search.FindNext(from, &found) : search.FindPrev(from, &found)) {
+            if (document->View) {
+                document->Viewer.FindCurrent = found;
+                document->Viewer.FindFollow = true;
+            }
+            else {
+                document->Editor.SelectStart = found;
+                document->Editor.Cursor = found + query.size();
+                document->Editor.PreferredX = -1.0f;
+                document->Editor.CursorFollow = true;
+            }
+        }
+    }
+
+    if (!query.empty()) {
+        ImGui::SameLine();
+        if (search.IsSearching()) {
+            ImGui::Text("Searching... %.0f%% (%zu matches)", search.Progress() * 100.0f, search.MatchCount());
+        }
+        else if (search.MatchCount() > TextSearch::MaxMatches) {
+            ImGui::Text("%zu matches (only the first %zu can be jumped to)", search.MatchCount(), TextSearch::MaxMatches);
+        }
+        else {
+            ImGui::Text("%zu matches", search.MatchCount());
+        }
+    }
+
+    if (!document->View && !document->Loader) {
+        ShowReplaceAll(document, query, ignore_case);
     }
-    indexed_im_vectors = new_map;
 }
 
 // global variables
 
 static std::string currentFile = "no file opened";
-static std::string consoleOutputText = "";
+// console output, its wrapped lines are kept between frames (see src/wrap_layout.h)
+static WrapLayout consoleOutput;
 static ImVector<std::string> tab_names;
 static ImVector<int> active_tabs;
 static int next_tab_id = 0;
@@ -218,6 +480,387 @@ std::string currentDirectory = "";
 // than usually reported by a typical string class.
 static ImVector<char> my_str;
 
+// "search all tabs": every open tab is searched for a regex by worker threads (see src/regex_search.h). The hits
+// show up in a list while the search goes on, clicking one brings its tab to the front with the match selected.
+static RegexSearch search_all;
+static ImVector<char> search_all_pattern;
+static bool search_all_match_case = false;
+static std::string search_all_error;
+static std::vector<int> search_all_tabs;            // tab of each searched text, -1 once it is closed
+static std::vector<unsigned> search_all_versions;   // Text.Version() of each searched text
+static int select_tab = -1;                         // tab to bring to the front on the next frame
+
+static void StartSearchAllTabs()
+{
+    search_all.Clear();
+    search_all_tabs.clear();
+    search_all_versions.clear();
+    for (auto& pair : indexed_documents) {
+        if (pair.second.View) {
+            search_all.AddMapped(pair.second.View->Data(), pair.second.View->Size());
+        }
+        else {
+            search_all.AddText(pair.second.Text);
+        }
+        search_all_tabs.push_back(pair.first);
+        search_all_versions.push_back(pair.second.Text.Version());
+    }
+    search_all_error.clear();
+    search_all.Start(search_all_pattern.begin(), !search_all_match_case, &search_all_error);
+}
+
+// the tab at 'index' is closing: the tabs after it move down, and if it is a file view its mapping goes away
+static void SearchAllTabClosed(int index)
+{
+    if (GetIndexedDocument(index).View) {
+        search_all.Cancel();
+    }
+    for (int& tab : search_all_tabs) {
+        if (tab == index)
+            tab = -1;
+        else if (tab > index)
+            tab--;
+    }
+}
+
+static void JumpToSearchHit(const RegexSearch::Hit& hit, int tab)
+{
+    Document& document = GetIndexedDocument(tab);
+    select_tab = tab;
+    if (document.View) {
+        document.Viewer.FindCurrent = hit.Pos;
+        document.Viewer.FindFollow = true;
+        return;
+    }
+    if (document.Text.Version() == search_all_versions[hit.Text]) {
+        document.Editor.SelectStart = hit.Pos;
+        document.Editor.Cursor = hit.Pos + hit.Len;
+    }
+    else {
+        // edited since the search: its line is the best guess
+        document.Editor.Cursor = document.Text.LineStart(std::min(hit.Line, document.Text.LineCount() - 1));
+        document.Editor.SelectStart = document.Editor.Cursor;
+    }
+    document.Editor.PreferredX = -1.0f;
+    document.Editor.CursorFollow = true;
+}
+
+// a hit's line with its match highlighted
+static void TextWithMatch(const std::string& preview, size_t match_pos, size_t match_len)
+{
+    const char* text = preview.c_str();
+    const size_t match_end = std::min(preview.size(), match_pos + match_len);
+    ImGui::TextUnformatted(text, text + match_pos);
+    ImGui::SameLine(0.0f, 0.0f);
+    ImGui::PushStyleColor(ImGuiCol_Text, ImGui::GetStyleColorVec4(ImGuiCol_PlotHistogram));
+    ImGui::TextUnformatted(text + match_pos, text + match_end);
+    ImGui::PopStyleColor();
+    ImGui::SameLine(0.0f, 0.0f);
+    ImGui::TextUnformatted(text + match_end, text + preview.size());
+}
+
+static void ShowSearchAllTabs()
+{
+    if (search_all_pattern.empty())
+        search_all_pattern.push_back(0);
+    ImGui::Text("Regular expression:");
+    ImGui::SetNextItemWidth(ImGui::GetFontSize() * 16);
+    bool start = MyInputText("##SearchAllPattern", &search_all_pattern, ImVec2(0, 0), ImGuiInputTextFlags_EnterReturnsTrue);
+    ImGui::SameLine();
+    start |= ImGui::Button("Search all tabs");
+    ImGui::SameLine();
+    ImGui::Checkbox("Match case##SearchAll", &search_all_match_case);
+    if (start && search_all_pattern[0] != 0) {
+        StartSearchAllTabs();
+    }
+
+    if (!search_all_error.empty()) {
+        ImGui::Text("Invalid regular expression: %s", search_all_error.c_str());
+        return;
+    }
+    const size_t listed = search_all.KeptHitCount();
+    if (search_all.IsSearching()) {
+        ImGui::Text("Searching %d tabs... %.0f%% (%zu hits)", search_all.TextCount(), search_all.Progress() * 100.0f, search_all.HitCount());
+        ImGui::SameLine();
+        if (ImGui::Button("Cancel")) {
+            search_all.Cancel();
+        }
+    }
+    else if (search_all.Pattern().IsCompiled()) {
+        if (search_all.HitCount() > listed)
+            ImGui::Text("%zu hits (only the first %zu are listed)", search_all.HitCount(), listed);
+        else
+            ImGui::Text("%zu hits in %d tabs", search_all.HitCount(), search_all.TextCount());
+    }
+
+    // only the rows in view are built, there can be a million of them
+    ImGui::BeginChild("##SearchAllHits", ImVec2(-FLT_MIN, ImGui::GetTextLineHeightWithSpacing() * 12), ImGuiChildFlags_Border, ImGuiWindowFlags_HorizontalScrollbar);
+    ImGuiListClipper clipper;
+    clipper.Begin((int)listed);
+    while (clipper.Step()) {
+        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+            RegexSearch::Hit hit;
+            if (!search_all.GetHit((size_t)row, &hit))
+                break;
+            const int tab = search_all_tabs[hit.Text];
+            ImGui::PushID(row);
+            if (ImGui::Selectable("##Hit", false, ImGuiSelectableFlags_AllowOverlap) && tab >= 0) {
+                JumpToSearchHit(hit, tab);
+            }
+            ImGui::SameLine(0.0f, 0.0f);
+            ImGui::TextDisabled("%s:%zu:", tab >= 0 ? tab_names[tab].c_str() : "(closed)", hit.Line + 1);
+            ImGui::SameLine();
+            TextWithMatch(hit.Preview, hit.PreviewPos, hit.Len);
+            ImGui::PopID();
+        }
+    }
+    ImGui::EndChild();
+}
+
+// colors the text of C/C++ files (by their name) in the editor, matches their brackets and lets their blocks be folded
+static void SetUpHighlighter(const std::string& name, Document* document)
+{
+    if (!CppHighlighter::IsCppFile(name))
+        return;
+    document->Highlighter.reset(new CppHighlighter());
+    document->Text.AddListener(document->Highlighter.get());
+    document->Editor.Highlighter = document->Highlighter.get();
+    document->Brackets.reset(new BracketIndex());
+    document->Text.AddListener(document->Brackets.get());
+    document->Highlighter->SetBracketIndex(document->Brackets.get());
+    document->Editor.Brackets = document->Brackets.get();
+    document->Folds.reset(new FoldIndex());
+    document->Text.AddListener(document->Folds.get());
+    document->Editor.Folds = document->Folds.get();
+}
+
+// minimap of the editor's text next to it, 'height' pixels high at most: a 2 pixel row per line around the lines
+// in view, moving through the file as the editor scrolls. clicking or dragging on it moves the cursor to that line.
+static void ShowMinimap(Document* document, float height)
+{
+    if (!document->Map) {
+        document->Map.reset(new Minimap());
+        document->Text.AddListener(document->Map.get());
+    }
+    Minimap* map = document->Map.get();
+    if (map->TextureId == 0) {
+        // rows wrap around the texture (GL_REPEAT), both sizes are powers of two as WebGL wants for that
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, Minimap::Width, Minimap::Rows, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        map->TextureId = texture;
+    }
+
+    // the lines shown follow the editor: its first line in view goes from the top of the minimap to the bottom as
+    // it scrolls from the start of the file to the end
+    const float row_height = 2.0f;
+    const size_t line_count = document->Text.LineCount();
+    const size_t view_first = std::min(document->Editor.ViewFirstLine, line_count - 1);
+    const size_t view_last = std::min(std::max(document->Editor.ViewLastLine, view_first), line_count - 1);
+    const size_t shown = std::min(std::min(line_count, (size_t)std::max(height / row_height, 1.0f)), (size_t)Minimap::Rows);
+    size_t first = 0;
+    if (line_count > shown) {
+        const size_t view_lines = view_last - view_first + 1;
+        const double ratio = line_count > view_lines ? std::min((double)view_first / (double)(line_count - view_lines), 1.0) : 0.0;
+        first = (size_t)(ratio * (double)(line_count - shown));
+    }
+    map->Update(document->Text, document->Highlighter.get(), first, shown, ImGui::GetColorU32(ImGuiCol_Text));
+
+    // only the rows drawn again go to the texture
+    const std::vector<Minimap::Band>& bands = map->DirtyBands();
+    if (!bands.empty()) {
+        glBindTexture(GL_TEXTURE_2D, (GLuint)map->TextureId);
+#if defined(GL_UNPACK_ROW_LENGTH) && !defined(__EMSCRIPTEN__)
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+#endif
+        for (size_t n = 0; n < bands.size(); n++)
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, bands[n].FirstRow, Minimap::Width, bands[n].RowCount, GL_RGBA, GL_UNSIGNED_BYTE, map->Pixels() + (size_t)bands[n].FirstRow * Minimap::Width);
+    }
+
+    const ImVec2 pos = ImGui::GetCursorScreenPos();
+    const float v0 = (float)(first % Minimap::Rows) / Minimap::Rows;
+    ImGui::Image((void*)(intptr_t)map->TextureId, ImVec2((float)Minimap::Width, shown * row_height), ImVec2(0.0f, v0), ImVec2(1.0f, v0 + (float)shown / Minimap::Rows));
+
+    // the lines in view
+    const float view_y0 = pos.y + (float)((double)view_first - (double)first) * row_height;
+    const float view_y1 = pos.y + (float)((double)view_last + 1.0 - (double)first) * row_height;
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+    draw_list->AddRectFilled(ImVec2(pos.x, std::max(view_y0, pos.y)), ImVec2(pos.x + Minimap::Width, std::min(view_y1, pos.y + shown * row_height)), ImGui::GetColorU32(ImGuiCol_ScrollbarGrab));
+
+    if (ImGui::IsItemHovered() && ImGui::IsMouseDown(ImGuiMouseButton_Left)) {
+        const float y = ImGui::GetIO().MousePos.y - pos.y;
+        const size_t line = std::min(first + (size_t)std::max(y / row_height, 0.0f), line_count - 1);
+        document->Editor.Cursor = document->Text.LineStart(line);
+        document->Editor.ClearSelection();
+        document->Editor.PreferredX = -1.0f;
+        document->Editor.CursorFollow = true;
+    }
+}
+
+// opens the file at 'filePath' in a new tab called 'name', returns the tab
+static int OpenFileInNewTab(const std::string& name, const std::string& filePath)
+{
+    Document& document = AddIndexedDocument(next_tab_id);
+    if (!OpenFileInViewer(filePath.c_str(), &document)) {
+        OpenFile(filePath.c_str(), &document);
+        SetUpHighlighter(name, &document);
+        if (!document.DiskPath.empty()) {
+            document.Journal = journal.Track(name, document.DiskPath, document.DiskStamp, &document.Text);
+        }
+    }
+
+    // add new tab
+    active_tabs.push_back(next_tab_id);
+    tab_names.push_back(name);
+    return next_tab_id++;
+}
+
+// "find in files": the files under the current directory are searched for a regex by worker threads, skipping what
+// .gitignore excludes (see src/project_search.h). The hits stream into a list, clicking one opens its file in a tab
+// (or brings it to the front) and goes to the match once the file is loaded.
+static ProjectSearch project_search;
+static ImVector<char> project_search_pattern;
+static bool project_search_match_case = false;
+static bool project_search_use_index = false;        // kept in .irohde-trigrams in the directory
+static std::string project_search_error;
+static int project_jump_tab = -1;                   // tab to go to a hit in, once its file is loaded...
+static ProjectSearch::Hit project_jump_hit;         // ...that hit
+
+static void JumpToProjectHit(const ProjectSearch::Hit& hit)
+{
+    const std::string& name = project_search.Files()[hit.File];
+    int tab = -1;
+    for (int n = 0; n < tab_names.Size && tab < 0; n++) {
+        if (tab_names[n] == name)
+            tab = n;
+    }
+    if (tab < 0) {
+        tab = OpenFileInNewTab(name, project_search.Root() + name);
+    }
+    select_tab = tab;
+    project_jump_tab = tab;
+    project_jump_hit = hit;
+}
+
+// called every frame. The line is used rather than the offset: the tab may have been edited since it was opened.
+static void PollProjectJump()
+{
+    if (project_jump_tab < 0) {
+        return;
+    }
+    Document& document = GetIndexedDocument(project_jump_tab);
+    if (document.View) {
+        document.Viewer.FindCurrent = project_jump_hit.Pos;
+        document.Viewer.FindFollow = true;
+    }
+    else {
+        if (document.Loader) {
+            return;
+        }
+        const size_t line = std::min(project_jump_hit.Line, document.Text.LineCount() - 1);
+        const size_t pos = std::min(document.Text.LineStart(line) + project_jump_hit.Column, document.Text.Size());
+        document.Editor.SelectStart = pos;
+        document.Editor.Cursor = std::min(pos + project_jump_hit.Len, document.Text.Size());
+        document.Editor.PreferredX = -1.0f;
+        document.Editor.CursorFollow = true;
+    }
+    project_jump_tab = -1;
+}
+
+static void ProjectJumpTabClosed(int index)
+{
+    if (project_jump_tab == index)
+        project_jump_tab = -1;
+    else if (project_jump_tab > index)
+        project_jump_tab--;
+}
+
+static void ShowFindInFiles()
+{
+    if (project_search_pattern.empty())
+        project_search_pattern.push_back(0);
+    project_search.Poll();
+
+    ImGui::Text("Regular expression:");
+    ImGui::SetNextItemWidth(ImGui::GetFontSize() * 16);
+    bool start = MyInputText("##FindInFilesPattern", &project_search_pattern, ImVec2(0, 0), ImGuiInputTextFlags_EnterReturnsTrue);
+    // what changed on disk is looked for while the pattern is typed: the index is up to date for the search
+    const bool typing_started = ImGui::IsItemActivated();
+    ImGui::SameLine();
+    start |= ImGui::Button("Find in files");
+    ImGui::SameLine();
+    ImGui::Checkbox("Match case##FindInFiles", &project_search_match_case);
+    ImGui::SameLine();
+    ImGui::Checkbox("Use index##FindInFiles", &project_search_use_index);
+
+    // c_str(): currentDirectory may hold the terminating zero of the input field
+    const std::string directory = currentDirectory.c_str();
+    if (!project_search_use_index) {
+        if (project_index.IsOpen())
+            project_index.Close();
+    }
+    else if (!project_index.IsOpen() || project_index.Root() != directory) {
+        project_index.Open(directory);
+    }
+    else if (typing_started) {
+        project_index.Refresh();
+    }
+    if (start && project_search_pattern[0] != 0) {
+        project_search_error.clear();
+        project_search.Start(directory, project_search_pattern.begin(), !project_search_match_case, &project_search_error, &project_index);
+        // and again for the next search (which reads every file if it starts before this is done)
+        project_index.Refresh();
+    }
+    if (project_index.IsBuilding()) {
+        ImGui::Text("Indexing %s... %.0f%%", directory.empty() ? "." : directory.c_str(), project_index.BuildProgress() * 100.0f);
+    }
+
+    if (!project_search_error.empty()) {
+        ImGui::Text("Invalid regular expression: %s", project_search_error.c_str());
+        return;
+    }
+    const char* root = project_search.Root().empty() ? "." : project_search.Root().c_str();
+    const size_t listed = project_search.Hits().size();
+    if (project_search.IsSearching()) {
+        ImGui::Text("Searching %s... %zu files, %zu hits", root, project_search.SearchedFiles(), project_search.HitCount());
+        ImGui::SameLine();
+        if (ImGui::Button("Cancel##FindInFiles")) {
+            project_search.Cancel();
+        }
+    }
+    else if (project_search.Pattern().IsCompiled()) {
+        if (project_search.HitCount() > listed)
+            ImGui::Text("%zu hits in %s (only the first %zu are listed)", project_search.HitCount(), root, listed);
+        else
+            ImGui::Text("%zu hits in %zu of the %zu files %s in %s", project_search.HitCount(), project_search.Files().size(), project_search.SearchedFiles(),
+                project_search.UsedIndex() ? "the index gave" : "searched", root);
+    }
+
+    ImGui::BeginChild("##FindInFilesHits", ImVec2(-FLT_MIN, ImGui::GetTextLineHeightWithSpacing() * 12), ImGuiChildFlags_Border, ImGuiWindowFlags_HorizontalScrollbar);
+    ImGuiListClipper clipper;
+    clipper.Begin((int)listed);
+    while (clipper.Step()) {
+        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+            const ProjectSearch::Hit& hit = project_search.Hits()[row];
+            ImGui::PushID(row);
+            if (ImGui::Selectable("##Hit", false, ImGuiSelectableFlags_AllowOverlap)) {
+                JumpToProjectHit(hit);
+            }
+            ImGui::SameLine(0.0f, 0.0f);
+            ImGui::TextDisabled("%s:%zu:", project_search.Files()[hit.File].c_str(), hit.Line + 1);
+            ImGui::SameLine();
+            TextWithMatch(hit.Preview, hit.PreviewPos, hit.Len);
+            ImGui::PopID();
+        }
+    }
+    ImGui::EndChild();
+}
+
 std::__fs::filesystem::path absolute_path = std::__fs::filesystem::absolute("irohde");
 std::string absPath = "Absolute path to irohDE directory: " + absolute_path.string();
 
@@ -276,6 +919,23 @@ int main(int, char**)
 #endif
     ImGui_ImplOpenGL3_Init(glsl_version);
 
+    // bring back the tabs that had unsaved changes when irohDE was closed or crashed
+    std::vector<JournalRecoveredDocument> recovered_documents;
+    if (!journal.Open(JOURNAL_FILENAME, &recovered_documents)) {
+        std::cerr << "Error: Unable to write " << JOURNAL_FILENAME << ", unsaved changes won't be recoverable" << std::endl;
+    }
+    for (auto& recovered : recovered_documents) {
+        Document& document = AddIndexedDocument(next_tab_id);
+        document.Text = std::move(recovered.Text);
+        document.DiskPath = recovered.DiskPath;
+        document.DiskStamp = recovered.DiskStamp;
+        document.Journal = std::move(recovered.Journal);
+        SetUpHighlighter(recovered.Name, &document);
+        active_tabs.push_back(next_tab_id);
+        tab_names.push_back(recovered.Name);
+        next_tab_id++;
+    }
+
     // Load Fonts
     // - If no fonts are loaded, dear imgui will use the default font. You can also load multiple fonts and use ImGui::PushFont()/PopFont() to select them.
     // - AddFontFromFileTTF() will return the ImFont* so you can store it if you need to select the font among multiple.
@@ -368,6 +1028,17 @@ int main(int, char**)
 
             static ImGuiTabBarFlags tab_bar_flags = ImGuiTabBarFlags_AutoSelectNewTabs | ImGuiTabBarFlags_Reorderable | ImGuiTabBarFlags_FittingPolicyResizeDown;
 
+            for (auto& pair : indexed_documents) {
+                PollFileLoad(&pair.second);
+            }
+            PollSaveResults();
+            PollProjectJump();
+
+            if (ImGui::IsKeyChordPressed(ImGuiMod_Shortcut | ImGuiKey_F)) {
+                show_find_bar = true;
+                focus_find_bar = true;
+            }
+
             if (ImGui::BeginTabBar("MyTabBar", tab_bar_flags))
             {
                 if (show_leading_button)
@@ -392,35 +1063,77 @@ int main(int, char**)
                     bool open = true;
                     char name[16];
                     snprintf(name, IM_ARRAYSIZE(name), "%04d", active_tabs[n]);
-                    if (ImGui::BeginTabItem(tab_names[n].c_str(), &open, ImGuiTabItemFlags_None))
+                    if (ImGui::BeginTabItem(tab_names[n].c_str(), &open, n == select_tab ? ImGuiTabItemFlags_SetSelected : ImGuiTabItemFlags_None))
                     {
                         // if (my_str.empty())
                         //     my_str.push_back(0);
                         currentFile = tab_names[n];
-                        ImVector<char>& retrieved_vector = GetIndexedImVector(n);
-                        MyInputTextMultiline("##MyStr", &retrieved_vector, ImVec2(-FLT_MIN, ImGui::GetTextLineHeight() * 16));
-                        if (ImGui::Button("Save")) {
-                            std::string newText;
-                            if (!retrieved_vector.empty()) {
-                                newText.assign(retrieved_vector.begin(), retrieved_vector.end());
+                        Document& retrieved_document = GetIndexedDocument(n);
+                        if (retrieved_document.View) {
+                            // big file: read-only, nothing to save
+                            FileViewer("##MyView", retrieved_document.View.get(), &retrieved_document.Viewer, ImVec2(-FLT_MIN, ImGui::GetTextLineHeight() * 16));
+                            if (retrieved_document.View->IsIndexing())
+                                ImGui::Text("Read-only view. Indexing lines... %.0f%%", retrieved_document.View->IndexProgress() * 100.0f);
+                            else
+                                ImGui::Text("Read-only view. %zu lines", retrieved_document.View->LineCount());
+                        }
+                        else {
+                            // read-only until the whole file is there, saving a partial file would truncate it
+                            const bool loading = retrieved_document.Loader != nullptr;
+                            TextEditor("##MyStr", &retrieved_document.Text, &retrieved_document.Editor, ImVec2(-(Minimap::Width + ImGui::GetStyle().ItemSpacing.x), ImGui::GetTextLineHeight() * 16), loading ? ImGuiInputTextFlags_ReadOnly : 0);
+                            ImGui::SameLine();
+                            ShowMinimap(&retrieved_document, ImGui::GetTextLineHeight() * 16);
+                            if (loading) {
+                                ImGui::ProgressBar(retrieved_document.Loader->Progress(), ImVec2(-FLT_MIN, 0.0f), "Loading...");
                             }
-                            // get rid of last char because it is an unsupported text format
-                            if (!newText.empty()) {
-                                newText.pop_back();
+                            else {
+                                if (ImGui::Button("Save")) {
+                                    std::string filePath = currentDirectory.c_str() + currentFile;
+                                    //std::__fs::filesystem::path absolute_path = std::__fs::filesystem::absolute(currentFile.c_str());
+                                    //std::cout << "Opened file: " << currentFile.c_str() << " (absolute path: " << absolute_path << ")" << std::endl;
+                                    const bool on_disk = !retrieved_document.DiskPath.empty() && retrieved_document.DiskPath == filePath;
+                                    const uint64_t edit_count = retrieved_document.Journal ? retrieved_document.Journal->EditCount() : 0;
+                                    save_queue.Save(filePath, retrieved_document.Text, on_disk ? &retrieved_document.DiskStamp : nullptr, edit_count);
+                                    retrieved_document.SavePath = filePath;
+                                    retrieved_document.SaveStatus = "";
+                                }
+                                ImGui::SameLine();
+                                if (retrieved_document.Folds) {
+                                    if (ImGui::Button("Fold all")) {
+                                        TextEditorFoldAll(&retrieved_document.Editor);
+                                    }
+                                    ImGui::SameLine();
+                                    if (ImGui::Button("Unfold all")) {
+                                        retrieved_document.Folds->UnfoldAll();
+                                    }
+                                    ImGui::SameLine();
+                                }
+                                if (!retrieved_document.SavePath.empty() && save_queue.IsSaving(retrieved_document.SavePath))
+                                    ImGui::Text("Saving...");
+                                else
+                                    ImGui::Text("%s", retrieved_document.SaveStatus.c_str());
                             }
-                            std::string filePath = currentDirectory.c_str() + currentFile;
-                            //std::__fs::filesystem::path absolute_path = std::__fs::filesystem::absolute(currentFile.c_str());
-                            //std::cout << "Opened file: " << currentFile.c_str() << " (absolute path: " << absolute_path << ")" << std::endl;
-                            SaveToFile(filePath.c_str(), newText);
+                        }
+                        if (show_find_bar) {
+                            ShowFindBar(&retrieved_document);
                         }
                         ImGui::EndTabItem();
                     }
 
                     if (!open)
                     {
+                        if (GetIndexedDocument(n).Journal) {
+                            GetIndexedDocument(n).Journal->Discard();
+                        }
+                        if (GetIndexedDocument(n).Map && GetIndexedDocument(n).Map->TextureId != 0) {
+                            GLuint texture = (GLuint)GetIndexedDocument(n).Map->TextureId;
+                            glDeleteTextures(1, &texture);
+                        }
+                        SearchAllTabClosed(n);
+                        ProjectJumpTabClosed(n);
                         active_tabs.erase(active_tabs.Data + n);
                         tab_names.erase(tab_names.Data + n);
-                        RemoveIndexedImVector(n);
+                        RemoveIndexedDocument(n);
                         next_tab_id--;
                     }
                     else
@@ -430,12 +1143,25 @@ int main(int, char**)
                     }
                 }
 
+                select_tab = -1;
                 ImGui::EndTabBar();
             }
 
             ImGui::End();
         }
 
+        {
+            ImGui::Begin("Search");
+            ShowSearchAllTabs();
+            ImGui::End();
+        }
+
+        {
+            ImGui::Begin("Find in Files");
+            ShowFindInFiles();
+            ImGui::End();
+        }
+
         {
             ImGui::Begin("Files");
 
@@ -471,12 +1197,11 @@ int main(int, char**)
                 std::string filePath = currentDirectory.c_str() + currentFile;
                 //std::cout << filePath << std::endl;
                 SaveToFile(filePath.c_str(), "lol");
+                project_index.FileChanged(filePath);
 
-                ImVector<char> my_vector;
-                if (my_vector.empty())
-                    my_vector.push_back(0);
-
-                AddIndexedImVector(next_tab_id, my_vector);
+                Document& document = AddIndexedDocument(next_tab_id);
+                document.Journal = journal.Track(currentFile, "", FileStamp(), &document.Text);
+                SetUpHighlighter(currentFile, &document);
 
                 // add new tab
                 active_tabs.push_back(next_tab_id);
@@ -493,19 +1218,8 @@ int main(int, char**)
                 }
                 //my_str = OpenFile(currentFile.c_str());
 
-                ImVector<char> my_vector;
-                if (my_vector.empty())
-                    my_vector.push_back(0);
-
                 std::string filePath = currentDirectory.c_str() + currentFile;
-                my_vector = OpenFile(filePath.c_str());
-
-                AddIndexedImVector(next_tab_id, my_vector);
-
-                // add new tab
-                active_tabs.push_back(next_tab_id);
-                tab_names.push_back(currentFile.c_str());
-                next_tab_id++;
+                OpenFileInNewTab(currentFile.c_str(), filePath);
 
                 file_name.clear();
             }
@@ -538,7 +1252,7 @@ int main(int, char**)
                     command.assign(custom_console_text.begin(), custom_console_text.end());
                 }
 
-                consoleOutputText = RunConsoleCommand(command);
+                consoleOutput.SetText(RunConsoleCommand(command));
             }
 
             // ImGui::Begin("Console", nullptr, ImGuiWindowFlags_NoResize);
@@ -549,14 +1263,14 @@ int main(int, char**)
                 std::string filePath = currentDirectory.c_str() + currentFile;
                 std::string command = "g++ -o " + FileNameWithoutDot(filePath.c_str()) + " " + filePath.c_str();
                 //std::cout << command << std::endl;
-                consoleOutputText = RunConsoleCommand(command);
+                consoleOutput.SetText(RunConsoleCommand(command));
             }
 
             if (ImGui::Button("Run (C++)")) {
                 std::string filePath = currentDirectory.c_str() + currentFile;
                 std::string command = "./" + FileNameWithoutDot(filePath.c_str());
                 //std::cout << command << std::endl;
-                consoleOutputText = RunConsoleCommand(command);
+                consoleOutput.SetText(RunConsoleCommand(command));
             }
 
             ImGui::Text("Output:");
@@ -564,13 +1278,11 @@ int main(int, char**)
             //ImDrawList* draw_list = ImGui::GetWindowDrawList();
             static float wrap_width = 300.0f;
 
-            ImGui::PushTextWrapPos(ImGui::GetCursorPos().x + wrap_width);
             //ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.0f, 0.0f, 0.0f, 1.0f));
-            ImGui::Text("%s", consoleOutputText.c_str());
+            WrappedText(&consoleOutput, wrap_width);
             //ImGui::PopStyleColor();
 
             //draw_list->AddRectFilled(ImGui::GetItemRectMin(), ImGui::GetItemRectMax(), IM_COL32(0, 222, 255, 25));
-            ImGui::PopTextWrapPos();
             
 
             ImGui::End();
@@ -639,6 +1351,7 @@ int main(int, char**)
 #endif
 
     // Cleanup
+    journal.Close();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -0,0 +1,342 @@
+// Index of the brackets of a C/C++ text (see bracket_index.h)
+
+#include "bracket_index.h"
+#include <algorithm>
+
+static bool IsOpening(char c)
+{
+    return c == '(' || c == '[' || c == '{';
+}
+
+static char MatchingBracket(char c)
+{
+    switch (c)
+    {
+    case '(': return ')';
+    case ')': return '(';
+    case '[': return ']';
+    case ']': return '[';
+    case '{': return '}';
+    case '}': return '{';
+    default:  return 0;
+    }
+}
+
+BracketIndex::BracketIndex()
+{
+    Root = -1;
+    RandState = 0x9E3779B9u;
+}
+
+void BracketIndex::Clear()
+{
+    Nodes.clear();
+    FreeNodes.clear();
+    Root = -1;
+}
+
+int BracketIndex::NewNode(size_t gap, char kind)
+{
+    // xorshift32 for treap priorities
+    RandState ^= RandState << 13;
+    RandState ^= RandState >> 17;
+    RandState ^= RandState << 5;
+
+    Node node;
+    node.Gap = gap;
+    node.Kind = kind;
+    node.Left = node.Right = -1;
+    node.Priority = RandState;
+    int n;
+    if (!FreeNodes.empty())
+    {
+        n = FreeNodes.back();
+        FreeNodes.pop_back();
+        Nodes[n] = node;
+    }
+    else
+    {
+        Nodes.push_back(node);
+        n = (int)Nodes.size() - 1;
+    }
+    Update(n);
+    return n;
+}
+
+void BracketIndex::Update(int n)
+{
+    Node& node = Nodes[n];
+    const int left_depth = SubDepth(node.Left);
+    const int after = left_depth + (IsOpening(node.Kind) ? 1 : -1);
+    node.SubLen = SubLen(node.Left) + node.Gap + 1 + SubLen(node.Right);
+    node.SubDepth = after + SubDepth(node.Right);
+    node.SubMinBefore = left_depth;
+    node.SubMinAfter = after;
+    if (node.Left >= 0)
+    {
+        node.SubMinBefore = std::min(node.SubMinBefore, Nodes[node.Left].SubMinBefore);
+        node.SubMinAfter = std::min(node.SubMinAfter, Nodes[node.Left].SubMinAfter);
+    }
+    if (node.Right >= 0)
+    {
+        node.SubMinBefore = std::min(node.SubMinBefore, after + Nodes[node.Right].SubMinBefore);
+        node.SubMinAfter = std::min(node.SubMinAfter, after + Nodes[node.Right].SubMinAfter);
+    }
+}
+
+void BracketIndex::FreeTree(int n)
+{
+    if (n < 0)
+        return;
+    FreeTree(Nodes[n].Left);
+    FreeTree(Nodes[n].Right);
+    FreeNodes.push_back(n);
+}
+
+// Split subtree 'n' so that 'out_left' holds the brackets before 'pos' (relative to the start of the subtree)
+void BracketIndex::Split(int n, size_t pos, int* out_left, int* out_right)
+{
+    if (n < 0)
+    {
+        *out_left = *out_right = -1;
+        return;
+    }
+    const size_t bracket = SubLen(Nodes[n].Left) + Nodes[n].Gap;
+    int l, r;
+    if (pos <= bracket)
+    {
+        Split(Nodes[n].Left, pos, &l, &r);
+        Nodes[n].Left = r;
+        Update(n);
+        *out_left = l;
+        *out_right = n;
+    }
+    else
+    {
+        Split(Nodes[n].Right, pos - bracket - 1, &l, &r);
+        Nodes[n].Right = l;
+        Update(n);
+        *out_left = n;
+        *out_right = r;
+    }
+}
+
+int BracketIndex::Merge(int left, int right)
+{
+    if (left < 0)
+        return right;
+    if (right < 0)
+        return left;
+    if (Nodes[left].Priority > Nodes[right].Priority)
+    {
+        int r = Merge(Nodes[left].Right, right);
+        Nodes[left].Right = r;
+        Update(left);
+        return left;
+    }
+    int l = Merge(left, Nodes[right].Left);
+    Nodes[right].Left = l;
+    Update(right);
+    return right;
+}
+
+// Move the brackets of subtree 'n' by 'add' - 'sub' bytes: only its first bracket's gap changes
+void BracketIndex::AddToFirstGap(int n, size_t add, size_t sub)
+{
+    for (int s = n; s >= 0; s = Nodes[s].Left)
+    {
+        Nodes[s].SubLen = Nodes[s].SubLen + add - sub;
+        if (Nodes[s].Left < 0)
+            Nodes[s].Gap = Nodes[s].Gap + add - sub;
+    }
+}
+
+void BracketIndex::SetLine(size_t line_pos, size_t line_len, const char* line_text, const size_t* offsets, size_t count)
+{
+    // Most lines lexed have no bracket and had none. Lexing the text from the top appends lines after the last bracket.
+    if (count == 0 && !HasBracketIn(Root, 0, line_pos, line_pos + line_len))
+        return;
+    if (line_pos >= SubLen(Root))
+    {
+        int added = -1;
+        size_t end = SubLen(Root);
+        for (size_t n = 0; n < count; n++)
+        {
+            const size_t pos = line_pos + offsets[n];
+            added = Merge(added, NewNode(pos - end, line_text[offsets[n]]));
+            end = pos + 1;
+        }
+        Root = Merge(Root, added);
+        return;
+    }
+
+    int left, mid, right;
+    Split(Root, line_pos, &left, &right);
+    const size_t base = SubLen(left);
+    Split(right, line_pos + line_len - base, &mid, &right);
+    const size_t right_start = base + SubLen(mid);     // Where the gap of the first bracket of 'right' starts
+    FreeTree(mid);
+
+    int added = -1;
+    size_t end = base;
+    for (size_t n = 0; n < count; n++)
+    {
+        const size_t pos = line_pos + offsets[n];
+        added = Merge(added, NewNode(pos - end, line_text[offsets[n]]));
+        end = pos + 1;
+    }
+    AddToFirstGap(right, right_start, end);
+    Root = Merge(Merge(left, added), right);
+}
+
+void BracketIndex::OnInsert(size_t pos, const PieceTableSpan* spans, size_t count)
+{
+    size_t len = 0;
+    for (size_t n = 0; n < count; n++)
+        len += spans[n].Len;
+    int left, right;
+    Split(Root, pos, &left, &right);
+    AddToFirstGap(right, len, 0);
+    Root = Merge(left, right);
+}
+
+void BracketIndex::OnErase(size_t pos, size_t len)
+{
+    int left, mid, right;
+    Split(Root, pos, &left, &right);
+    Split(right, pos + len - SubLen(left), &mid, &right);
+    AddToFirstGap(right, SubLen(mid), len);
+    FreeTree(mid);
+    Root = Merge(left, right);
+}
+
+// The node of the bracket at 'pos', and the depth before it
+int BracketIndex::FindAt(size_t pos, int* out_depth_before) const
+{
+    int n = Root;
+    size_t base = 0;
+    int depth = 0;
+    while (n >= 0)
+    {
+        const Node& node = Nodes[n];
+        const size_t bracket = base + SubLen(node.Left) + node.Gap;
+        if (pos < bracket)
+        {
+            n = node.Left;
+        }
+        else if (pos == bracket)
+        {
+            *out_depth_before = depth + SubDepth(node.Left);
+            return n;
+        }
+        else
+        {
+            depth += SubDepth(node.Left) + (IsOpening(node.Kind) ? 1 : -1);
+            base = bracket + 1;
+            n = node.Right;
+        }
+    }
+    return -1;
+}
+
+// First bracket of subtree 'n' (starting at 'base_pos' with depth 'base_depth') at or after 'from' with the depth
+// after it at or below 'depth'. Subtrees are skipped by their position and lowest depth, so this only goes down the
+// path to 'from' and then down to the bracket: O(log brackets).
+int BracketIndex::FindFirstAfter(int n, size_t base_pos, int base_depth, size_t from, int depth, size_t* out_pos) const
+{
+    if (n < 0)
+        return -1;
+    const Node& node = Nodes[n];
+    if (base_pos + node.SubLen <= from || base_depth + node.SubMinAfter > depth)
+        return -1;
+    const int found = FindFirstAfter(node.Left, base_pos, base_depth, from, depth, out_pos);
+    if (found >= 0)
+        return found;
+    const size_t bracket = base_pos + SubLen(node.Left) + node.Gap;
+    const int after = base_depth + SubDepth(node.Left) + (IsOpening(node.Kind) ? 1 : -1);
+    if (bracket >= from && after <= depth)
+    {
+        *out_pos = bracket;
+        return n;
+    }
+    return FindFirstAfter(node.Right, bracket + 1, after, from, depth, out_pos);
+}
+
+// Last bracket of subtree 'n' before 'before' with the depth before it at or below 'depth'. Same as FindFirstAfter().
+int BracketIndex::FindLastBefore(int n, size_t base_pos, int base_depth, size_t before, int depth, size_t* out_pos) const
+{
+    if (n < 0)
+        return -1;
+    const Node& node = Nodes[n];
+    if (base_pos >= before || base_depth + node.SubMinBefore > depth)
+        return -1;
+    const size_t bracket = base_pos + SubLen(node.Left) + node.Gap;
+    const int depth_before = base_depth + SubDepth(node.Left);
+    const int found = FindLastBefore(node.Right, bracket + 1, depth_before + (IsOpening(node.Kind) ? 1 : -1), before, depth, out_pos);
+    if (found >= 0)
+        return found;
+    if (bracket < before && depth_before <= depth)
+    {
+        *out_pos = bracket;
+        return n;
+    }
+    return FindLastBefore(node.Left, base_pos, base_depth, before, depth, out_pos);
+}
+
+bool BracketIndex::HasBracketIn(int n, size_t base_pos, size_t begin, size_t end) const
+{
+    // First bracket at or after 'begin'
+    size_t first = (size_t)-1;
+    while (n >= 0)
+    {
+        const Node& node = Nodes[n];
+        const size_t bracket = base_pos + SubLen(node.Left) + node.Gap;
+        if (bracket >= begin)
+        {
+            first = bracket;
+            n = node.Left;
+        }
+        else
+        {
+            base_pos = bracket + 1;
+            n = node.Right;
+        }
+    }
+    return first < end;
+}
+
+bool BracketIndex::FindMatch(size_t pos, size_t* out_match) const
+{
+    // Going away from an opening bracket, its match is the first bracket back at the depth before it. Going back
+    // from a closing one, the last bracket down to the depth after it.
+    int depth_before;
+    const int n = FindAt(pos, &depth_before);
+    if (n < 0)
+        return false;
+    const char kind = Nodes[n].Kind;
+    const int match = IsOpening(kind) ? FindFirstAfter(Root, 0, 0, pos + 1, depth_before, out_match) : FindLastBefore(Root, 0, 0, pos, depth_before - 1, out_match);
+    return match >= 0 && Nodes[match].Kind == MatchingBracket(kind);
+}
+
+bool BracketIndex::FindEnclosing(size_t pos, size_t* out_open, size_t* out_close) const
+{
+    // The depth at 'pos', after the brackets before it
+    int depth = 0;
+    size_t base = 0;
+    for (int n = Root; n >= 0; )
+    {
+        const Node& node = Nodes[n];
+        const size_t bracket = base + SubLen(node.Left) + node.Gap;
+        if (pos <= bracket)
+        {
+            n = node.Left;
+            continue;
+        }
+        depth += SubDepth(node.Left) + (IsOpening(node.Kind) ? 1 : -1);
+        base = bracket + 1;
+        n = node.Right;
+    }
+    if (FindLastBefore(Root, 0, 0, pos, depth - 1, out_open) < 0)
+        return false;
+    return FindMatch(*out_open, out_close);
+}
@@ -0,0 +1,74 @@
+// Index of the brackets of a C/C++ text, for matching them.
+// The brackets ( ) [ ] { } of the code (not those in comments, strings or preprocessor directives) are kept in a treap
+// ordered by position, like the pieces of a PieceTable. A node stores the gap in bytes since the bracket before it,
+// so that inserting or erasing text only changes the node after the edit, and the subtree sums of the depth changes
+// along with the lowest depth reached before and after each bracket. Finding the bracket matching another, or the
+// pair enclosing a position, is then a descent to the first/last bracket reaching a given depth: O(log brackets)
+// whatever the distance between them.
+// Which brackets are in code takes the lexer: the index is filled by the CppHighlighter it is given to, line by line
+// as it lexes them (see CppHighlighter::SetBracketIndex()). It listens to the edits of the text itself to move the
+// brackets after them.
+
+#pragma once
+
+#include "piece_table.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class BracketIndex : public PieceTableListener
+{
+public:
+    BracketIndex();
+
+    void        Clear();
+    size_t      Count() const                       { return Nodes.size() - FreeNodes.size(); }
+
+    // Replace the brackets known in line [line_pos, line_pos + line_len) with those at 'offsets' (sorted) in
+    // 'line_text', the text of that line. O(log brackets), plus the number of brackets in the line.
+    void        SetLine(size_t line_pos, size_t line_len, const char* line_text, const size_t* offsets, size_t count);
+
+    // The bracket matching the one at 'pos'. Returns false if there is no bracket at 'pos', or it isn't closed/opened,
+    // or it is closed/opened by another kind of bracket ("(]").
+    bool        FindMatch(size_t pos, size_t* out_match) const;
+
+    // The innermost pair of matching brackets around 'pos': out_open < pos <= out_close.
+    bool        FindEnclosing(size_t pos, size_t* out_open, size_t* out_close) const;
+
+    virtual void OnInsert(size_t pos, const PieceTableSpan* spans, size_t count);
+    virtual void OnErase(size_t pos, size_t len);
+
+private:
+    struct Node
+    {
+        size_t      Gap;            // Bytes between the bracket before this one (or the start of the text) and this one
+        size_t      SubLen;         // Sum of Gap + 1 over this subtree: from its start to after its last bracket
+        char        Kind;           // The bracket
+        int         SubDepth;       // Sum of the depth changes (+1 opening, -1 closing) over this subtree...
+        int         SubMinBefore;   // ...the lowest depth before one of its brackets...
+        int         SubMinAfter;    // ...and after one, all relative to the depth at the start of the subtree
+        int         Left, Right;
+        uint32_t    Priority;
+    };
+
+    std::vector<Node>   Nodes;
+    std::vector<int>    FreeNodes;
+    int                 Root;
+    uint32_t            RandState;
+
+    int         NewNode(size_t gap, char kind);
+    void        Update(int n);
+    void        FreeTree(int n);
+    void        Split(int n, size_t pos, int* out_left, int* out_right);
+    int         Merge(int left, int right);
+    void        AddToFirstGap(int n, size_t add, size_t sub);
+    size_t      SubLen(int n) const                 { return n >= 0 ? Nodes[n].SubLen : 0; }
+    int         SubDepth(int n) const               { return n >= 0 ? Nodes[n].SubDepth : 0; }
+    int         FindAt(size_t pos, int* out_depth_before) const;
+    int         FindFirstAfter(int n, size_t base_pos, int base_depth, size_t from, int depth, size_t* out_pos) const;
+    int         FindLastBefore(int n, size_t base_pos, int base_depth, size_t before, int depth, size_t* out_pos) const;
+    bool        HasBracketIn(int n, size_t base_pos, size_t begin, size_t end) const;
+
+    BracketIndex(const BracketIndex&);
+    BracketIndex& operator=(const BracketIndex&);
+};
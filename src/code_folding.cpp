@@ -0,0 +1,351 @@
+// Code folding (see code_folding.h)
+
+#include "code_folding.h"
+#include "cpp_highlighter.h"
+#include <string.h>
+#include <algorithm>
+#include <string>
+
+static bool FoldRegionLess(const FoldRegion& a, const FoldRegion& b)
+{
+    return a.Line < b.Line || (a.Line == b.Line && a.EndLine > b.EndLine);
+}
+
+static bool SameFoldRegion(const FoldRegion& a, const FoldRegion& b)
+{
+    return a.Line == b.Line && a.EndLine == b.EndLine;
+}
+
+// Is [p, end), the directive a line starts with, "#pragma region" (1) or "#pragma endregion" (-1)? 0 otherwise.
+static int GetPragmaRegion(const char* p, const char* end)
+{
+    if (p == end || *p != '#')
+        return 0;
+    for (p++; p < end && (*p == ' ' || *p == '\t'); )
+        p++;
+    if ((size_t)(end - p) < 6 || memcmp(p, "pragma", 6) != 0)
+        return 0;
+    for (p += 6; p < end && (*p == ' ' || *p == '\t'); )
+        p++;
+    if ((size_t)(end - p) >= 6 && memcmp(p, "region", 6) == 0)
+        return 1;
+    if ((size_t)(end - p) >= 9 && memcmp(p, "endregion", 9) == 0)
+        return -1;
+    return 0;
+}
+
+FoldIndex::FoldIndex()
+{
+    HiddenBefore.push_back(0);
+    PendingFold = NoFold;
+    ScannedLines = 0;
+    ValidLines = 0;
+    TextVersion = 0;
+    ReportedEdits = 0;
+}
+
+bool FoldIndex::Update(const PieceTable& text, CppHighlighter* highlighter)
+{
+    if (text.Version() != TextVersion + ReportedEdits)
+    {
+        UnfoldAll();
+        ValidLines = 0;
+    }
+    TextVersion = text.Version();
+    ReportedEdits = 0;
+    if (PendingFold == NoFold || !FindRegions(text, highlighter, PendingFold))
+        return false;
+    const size_t line = PendingFold;
+    PendingFold = NoFold;
+    if (line == AllLines)
+    {
+        Folds = Regions;
+        UpdateHidden();
+        return !Folds.empty();
+    }
+
+    const FoldRegion* best = NULL;
+    for (size_t n = 0; n < Regions.size() && Regions[n].Line <= line; n++)
+    {
+        // Sorted by line, then the longest first: the last one containing 'line' is the innermost
+        if (Regions[n].EndLine < line || std::binary_search(Folds.begin(), Folds.end(), Regions[n], FoldRegionLess))
+            continue;
+        best = &Regions[n];
+    }
+    if (best == NULL)
+        return false;
+    Folds.insert(std::upper_bound(Folds.begin(), Folds.end(), *best, FoldRegionLess), *best);
+    UpdateHidden();
+    return true;
+}
+
+// Scan the lines lexed by the highlighter, at most UpdateBudget bytes, until every region containing 'line' (every
+// region for AllLines) is found: when the braces and pragmas open at its end are closed. Returns false if not yet.
+bool FoldIndex::FindRegions(const PieceTable& text, CppHighlighter* highlighter, size_t line)
+{
+    if (ValidLines < ScannedLines)
+        DropRegionsFrom(ValidLines);
+    const size_t line_count = text.LineCount();
+    const size_t known_lines = std::min(highlighter->KnownLines(), line_count);
+    std::vector<CppHighlighter::Run> runs;
+    std::string line_text;
+    size_t line_start = ScannedLines < line_count ? text.LineStart(ScannedLines) : 0;
+    size_t scanned_bytes = 0;
+    for (;;)
+    {
+        if (ScannedLines == line_count)
+            return true;
+        if (line != AllLines && ScannedLines > line && (OpenBraces.empty() || OpenBraces[0] > line) && (OpenPragmas.empty() || OpenPragmas[0] > line))
+            return true;
+        if (ScannedLines >= known_lines || scanned_bytes >= CppHighlighter::UpdateBudget)
+            return false;
+
+        const size_t scanned = ScannedLines++;
+        ValidLines = ScannedLines;
+        const size_t line_end = text.FindChar('\n', line_start);
+        line_text.resize(line_end - line_start);
+        if (!line_text.empty())
+            text.Copy(line_start, line_text.size(), &line_text[0]);
+        scanned_bytes += line_text.size() + 1;
+        line_start = line_end + 1;
+        runs.clear();
+        highlighter->GetRuns(scanned, line_text.data(), line_text.data() + line_text.size(), &runs);
+
+        // Braces in code only: not in comments, strings or directives
+        const char* p = line_text.data();
+        for (size_t n = 0; n < runs.size(); p += runs[n].Len, n++)
+        {
+            if (runs[n].Token == CppHighlighter::TOKEN_PREPROCESSOR && n <= 1)
+            {
+                const char* directive = p;
+                while (directive < p + runs[n].Len && (*directive == ' ' || *directive == '\t'))
+                    directive++;
+                const int pragma = GetPragmaRegion(directive, p + runs[n].Len);
+                if (pragma > 0)
+                {
+                    OpenPragmas.push_back(scanned);
+                }
+                else if (pragma < 0 && !OpenPragmas.empty())
+                {
+                    FoldRegion pair = { OpenPragmas.back(), scanned };
+                    PragmaPairs.push_back(pair);
+                    AddRegion(pair);
+                    OpenPragmas.pop_back();
+                }
+            }
+            if (runs[n].Token != CppHighlighter::TOKEN_TEXT)
+                continue;
+            for (const char* c = p; c < p + runs[n].Len; c++)
+            {
+                if (*c == '{')
+                {
+                    OpenBraces.push_back(scanned);
+                }
+                else if (*c == '}' && !OpenBraces.empty())
+                {
+                    FoldRegion pair = { OpenBraces.back(), scanned };
+                    BracePairs.push_back(pair);
+                    AddRegion(pair);
+                    OpenBraces.pop_back();
+                }
+            }
+        }
+    }
+}
+
+// Forget what was found from 'line' on, as if the scan had stopped there: the pairs closing at or after it are open
+// again, unless they open at or after it too
+void FoldIndex::DropRegionsFrom(size_t line)
+{
+    std::vector<FoldRegion>* pairs[2] = { &BracePairs, &PragmaPairs };
+    std::vector<size_t>* open[2] = { &OpenBraces, &OpenPragmas };
+    for (int k = 0; k < 2; k++)
+    {
+        while (!open[k]->empty() && open[k]->back() >= line)
+            open[k]->pop_back();
+        size_t kept = 0;
+        for (size_t n = 0; n < pairs[k]->size(); n++)
+        {
+            const FoldRegion& pair = (*pairs[k])[n];
+            if (pair.EndLine < line)
+                (*pairs[k])[kept++] = pair;
+            else if (pair.Line < line)
+                open[k]->push_back(pair.Line);
+        }
+        pairs[k]->resize(kept);
+        std::sort(open[k]->begin(), open[k]->end());
+    }
+    size_t kept = 0;
+    for (size_t n = 0; n < Regions.size(); n++)
+        if (Regions[n].EndLine < line)
+            Regions[kept++] = Regions[n];
+    Regions.resize(kept);
+    ScannedLines = line;
+}
+
+// A pair spanning lines between its first and last is a region (the same one may be found twice: "{{ }}")
+void FoldIndex::AddRegion(const FoldRegion& region)
+{
+    if (region.Line + 1 >= region.EndLine)
+        return;
+    std::vector<FoldRegion>::iterator it = std::upper_bound(Regions.begin(), Regions.end(), region, FoldRegionLess);
+    if (it != Regions.begin() && SameFoldRegion(it[-1], region))
+        return;
+    Regions.insert(it, region);
+}
+
+bool FoldIndex::Unfold(size_t line)
+{
+    std::vector<FoldRegion>::iterator it = Folds.begin();
+    while (it != Folds.end() && it->Line < line)
+        ++it;
+    std::vector<FoldRegion>::iterator end = it;
+    while (end != Folds.end() && end->Line == line)
+        ++end;
+    if (it == end)
+        return false;
+    Folds.erase(it, end);
+    UpdateHidden();
+    return true;
+}
+
+bool FoldIndex::Reveal(size_t line)
+{
+    const size_t count = Folds.size();
+    size_t kept = 0;
+    for (size_t n = 0; n < count; n++)
+        if (!(Folds[n].Line < line && line < Folds[n].EndLine))
+            Folds[kept++] = Folds[n];
+    Folds.resize(kept);
+    if (kept == count)
+        return false;
+    UpdateHidden();
+    return true;
+}
+
+void FoldIndex::UnfoldAll()
+{
+    PendingFold = NoFold;
+    Folds.clear();
+    UpdateHidden();
+}
+
+bool FoldIndex::IsFolded(size_t line) const
+{
+    const size_t n = CountHiddenBefore(line);
+    return n < Hidden.size() && Hidden[n].Line == line;
+}
+
+bool FoldIndex::IsHidden(size_t line) const
+{
+    const size_t n = CountHiddenBefore(line);
+    return n > 0 && line < Hidden[n - 1].EndLine;
+}
+
+size_t FoldIndex::RowFromLine(size_t line) const
+{
+    const size_t n = CountHiddenBefore(line);
+    if (n > 0 && line < Hidden[n - 1].EndLine)
+        line = Hidden[n - 1].Line;
+    return line - HiddenBefore[CountHiddenBefore(line)];
+}
+
+size_t FoldIndex::LineFromRow(size_t row) const
+{
+    // The row of the first line of Hidden[n] is Hidden[n].Line - HiddenBefore[n], increasing with n. Past the first
+    // lines of the n folds on rows before 'row', the line is 'row' plus what they hide.
+    size_t lo = 0;
+    size_t hi = Hidden.size();
+    while (lo < hi)
+    {
+        const size_t mid = (lo + hi) / 2;
+        if (Hidden[mid].Line - HiddenBefore[mid] < row)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return row + HiddenBefore[lo];
+}
+
+size_t FoldIndex::NextVisibleLine(size_t line) const
+{
+    const size_t n = CountHiddenBefore(line);
+    return n < Hidden.size() && Hidden[n].Line == line ? Hidden[n].EndLine : line + 1;
+}
+
+void FoldIndex::OnInsert(size_t pos, const PieceTableSpan* spans, size_t count)
+{
+    (void)pos;
+    (void)spans;
+    (void)count;
+}
+
+void FoldIndex::OnErase(size_t pos, size_t len)
+{
+    (void)pos;
+    (void)len;
+}
+
+void FoldIndex::OnEditLines(size_t line, size_t removed_lines, size_t inserted_lines)
+{
+    ReportedEdits++;
+    PendingFold = NoFold;
+    ValidLines = std::min(ValidLines, line);
+    if (Folds.empty())
+        return;
+
+    // Folds after the edit move with their lines, folds before it stay. An edit within the first line of a fold
+    // keeps it (e.g. renaming a function), any other edit of its lines unfolds it.
+    const size_t edit_end = line + removed_lines;
+    const size_t count = Folds.size();
+    size_t kept = 0;
+    bool changed = false;
+    for (size_t n = 0; n < count; n++)
+    {
+        FoldRegion fold = Folds[n];
+        if (fold.Line > edit_end)
+        {
+            fold.Line = fold.Line - removed_lines + inserted_lines;
+            fold.EndLine = fold.EndLine - removed_lines + inserted_lines;
+            changed |= removed_lines != inserted_lines;
+        }
+        else if (fold.EndLine >= line && !(fold.Line == line && removed_lines == 0 && inserted_lines == 0))
+        {
+            changed = true;
+            continue;
+        }
+        Folds[kept++] = fold;
+    }
+    Folds.resize(kept);
+    if (changed)
+        UpdateHidden();
+}
+
+void FoldIndex::UpdateHidden()
+{
+    Hidden.clear();
+    HiddenBefore.resize(1);
+    for (size_t n = 0; n < Folds.size(); n++)
+    {
+        // Folds starting in the lines hidden by another are nested in it (or cross it, which can't be shown either)
+        if (!Hidden.empty() && Folds[n].Line < Hidden.back().EndLine)
+            continue;
+        Hidden.push_back(Folds[n]);
+        HiddenBefore.push_back(HiddenBefore.back() + (Folds[n].EndLine - Folds[n].Line - 1));
+    }
+}
+
+size_t FoldIndex::CountHiddenBefore(size_t line) const
+{
+    size_t lo = 0;
+    size_t hi = Hidden.size();
+    while (lo < hi)
+    {
+        const size_t mid = (lo + hi) / 2;
+        if (Hidden[mid].Line < line)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
@@ -0,0 +1,91 @@
+// Code folding for the text editor.
+// A folded region leaves its first and last lines visible and hides the lines between them (the last line may open the
+// next region: "} else {"). The editor lays out rows, not lines: FoldIndex keeps the outermost folds as sorted disjoint
+// intervals with the count of lines they hide before each, so that mapping rows to lines and back is a binary search.
+// Everything per frame (scrolling, hit-testing, drawing) then depends on the number of visible rows, not of lines.
+// The regions that can be folded are the blocks in braces and the #pragma region/endregion pairs spanning several
+// lines, found with the C++ lexer of CppHighlighter so that braces in comments and strings don't count. They are found
+// from the top of the text as far as a fold needs, in the lines the highlighter lexed and at most UpdateBudget bytes
+// per frame: a fold is requested, and done by the frame that finds its region. An edit only drops what was found from
+// its line on.
+// FoldIndex listens to the edits of its PieceTable: folds after an edit move with their lines, and a fold whose lines
+// are edited is unfolded. Loading the text (not reported) unfolds everything.
+
+#pragma once
+
+#include "piece_table.h"
+#include <stddef.h>
+#include <vector>
+
+class CppHighlighter;
+
+// Lines (Line, EndLine) are hidden when the region is folded
+struct FoldRegion
+{
+    size_t      Line;
+    size_t      EndLine;
+};
+
+class FoldIndex : public PieceTableListener
+{
+public:
+    FoldIndex();
+
+    // Once per frame before the layout: notices a text loaded since the last call, and goes on finding the regions of
+    // a requested fold. Returns true if it folded something.
+    bool        Update(const PieceTable& text, CppHighlighter* highlighter);
+
+    // Request to fold the innermost region containing 'line' that isn't folded yet (nothing if there is none), or
+    // every region. Replaces the previous request, an edit cancels it. The highlighter has to lex the whole text
+    // while one is pending.
+    void        FoldAt(size_t line)                 { PendingFold = line; }
+    void        FoldAll()                           { PendingFold = AllLines; }
+    bool        IsFoldPending() const               { return PendingFold != NoFold; }
+
+    bool        Unfold(size_t line);                // The folds starting at 'line'. Returns false if there is none.
+    bool        Reveal(size_t line);                // Unfold whatever hides 'line'. Returns false if it wasn't hidden.
+    void        UnfoldAll();                        // Cancels a requested fold too
+
+    bool        Empty() const                       { return Folds.empty(); }
+    bool        IsFolded(size_t line) const;        // Is 'line' visible, with the lines after it folded?
+    bool        IsHidden(size_t line) const;
+
+    // Layout. Rows are the visible lines, a hidden line is on the row of the line its fold starts at. O(log folds).
+    size_t      RowCount(size_t line_count) const   { return line_count - HiddenBefore.back(); }
+    size_t      RowFromLine(size_t line) const;
+    size_t      LineFromRow(size_t row) const;
+    size_t      NextVisibleLine(size_t line) const; // The line on the row after the row of visible line 'line'
+
+    virtual void OnInsert(size_t pos, const PieceTableSpan* spans, size_t count);
+    virtual void OnErase(size_t pos, size_t len);
+    virtual void OnEditLines(size_t line, size_t removed_lines, size_t inserted_lines);
+
+private:
+    static const size_t NoFold = (size_t)-1;        // Values of PendingFold
+    static const size_t AllLines = (size_t)-2;
+
+    std::vector<FoldRegion>     Folds;              // Sorted by Line, then by EndLine the longest first. May nest.
+    std::vector<FoldRegion>     Hidden;             // The outermost folds, disjoint
+    std::vector<size_t>         HiddenBefore;       // HiddenBefore[n]: lines hidden by Hidden[0..n)
+    size_t                      PendingFold;        // Line of the requested fold, AllLines or NoFold
+
+    // The regions found in the lines [0, ScannedLines), the same as the text up to ValidLines (lines after it edited)
+    std::vector<FoldRegion>     Regions;            // Sorted like Folds, nested ones included
+    std::vector<FoldRegion>     BracePairs;         // Every '{' and its '}' found, in the order they close...
+    std::vector<FoldRegion>     PragmaPairs;        // ...and every #pragma region and its endregion
+    std::vector<size_t>         OpenBraces;         // Lines of the '{' not closed yet
+    std::vector<size_t>         OpenPragmas;        // Lines of the #pragma region not closed yet
+    size_t                      ScannedLines;
+    size_t                      ValidLines;
+    unsigned                    TextVersion;        // PieceTable::Version() at the last Update()...
+    unsigned                    ReportedEdits;      // ...and the edits reported since, each bumps it once
+
+    bool        FindRegions(const PieceTable& text, CppHighlighter* highlighter, size_t line);
+    void        DropRegionsFrom(size_t line);
+    void        AddRegion(const FoldRegion& region);
+    void        UpdateHidden();
+    size_t      CountHiddenBefore(size_t line) const;  // Number of Hidden starting before 'line'
+
+    FoldIndex(const FoldIndex&);
+    FoldIndex& operator=(const FoldIndex&);
+};
@@ -0,0 +1,500 @@
+// Syntax highlighting of C and C++ (see cpp_highlighter.h)
+
+#include "cpp_highlighter.h"
+#include <string.h>
+#include <algorithm>
+
+// A state is one of these modes, what the lexer is in at the start of a line...
+enum LexMode { LEX_CODE, LEX_BLOCK_COMMENT, LEX_LINE_COMMENT, LEX_STRING, LEX_CHAR, LEX_RAW_STRING };
+static const uint32_t LEX_MODE_MASK = 0x0F;
+// ...plus whether it is in a preprocessor directive continued from the line before, and for a raw string the index of
+// its delimiter in RawDelimiters
+static const uint32_t LEX_DIRECTIVE = 0x10;
+static const int LEX_DELIMITER_SHIFT = 8;
+
+static const size_t RAW_DELIMITER_MAX_LEN = 16;
+
+// Sorted, for IsKeyword()
+static const char* const KEYWORDS[] = {
+    "alignas", "alignof", "asm", "auto", "bool", "break", "case", "catch", "char", "char16_t", "char32_t", "char8_t",
+    "class", "co_await", "co_return", "co_yield", "concept", "const", "const_cast", "consteval", "constexpr",
+    "constinit", "continue", "decltype", "default", "delete", "do", "double", "dynamic_cast", "else", "enum",
+    "explicit", "export", "extern", "false", "final", "float", "for", "friend", "goto", "if", "inline", "int", "long",
+    "mutable", "namespace", "new", "noexcept", "nullptr", "operator", "override", "private", "protected", "public",
+    "register", "reinterpret_cast", "requires", "restrict", "return", "short", "signed", "sizeof", "static",
+    "static_assert", "static_cast", "struct", "switch", "template", "this", "thread_local", "throw", "true", "try",
+    "typedef", "typeid", "typename", "union", "unsigned", "using", "virtual", "void", "volatile", "wchar_t", "while",
+};
+static const size_t KEYWORD_MAX_LEN = 16;
+
+static const char* const CPP_EXTENSIONS[] = { "c", "cc", "cpp", "cxx", "c++", "h", "hh", "hpp", "hxx", "h++", "inl", "ipp", "tpp" };
+
+static inline bool IsIdentifierStart(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || (unsigned char)c >= 0x80;
+}
+
+static inline bool IsIdentifierChar(char c)
+{
+    return IsIdentifierStart(c) || (c >= '0' && c <= '9');
+}
+
+static inline bool IsDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static inline bool IsSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+static bool IsKeyword(const char* s, size_t len)
+{
+    if (len > KEYWORD_MAX_LEN)
+        return false;
+    size_t lo = 0;
+    size_t hi = sizeof(KEYWORDS) / sizeof(KEYWORDS[0]);
+    while (lo < hi)
+    {
+        const size_t mid = (lo + hi) / 2;
+        int c = strncmp(KEYWORDS[mid], s, len);
+        if (c == 0 && KEYWORDS[mid][len] != 0)
+            c = 1;
+        if (c < 0)
+            lo = mid + 1;
+        else if (c > 0)
+            hi = mid;
+        else
+            return true;
+    }
+    return false;
+}
+
+// Is [begin, end) a prefix of a string or character literal? Raw string prefixes end with 'R'.
+static bool IsLiteralPrefix(const char* begin, const char* end, bool* out_raw)
+{
+    size_t len = (size_t)(end - begin);
+    *out_raw = len > 0 && end[-1] == 'R';
+    if (*out_raw)
+        len--;
+    if (len == 0)
+        return *out_raw;
+    if (len == 1)
+        return begin[0] == 'L' || begin[0] == 'u' || begin[0] == 'U';
+    return len == 2 && begin[0] == 'u' && begin[1] == '8';
+}
+
+// End of a quoted literal whose opening quote is before 'p': after its closing quote, or 'end' if it isn't closed
+static const char* SkipQuoted(const char* p, const char* end, char quote, bool* out_closed)
+{
+    while (p < end)
+    {
+        const char c = *p++;
+        if (c == quote)
+        {
+            *out_closed = true;
+            return p;
+        }
+        if (c == '\\' && p < end)
+            p++;
+    }
+    *out_closed = false;
+    return end;
+}
+
+// End of a block comment whose "/*" is before 'p'
+static const char* SkipBlockComment(const char* p, const char* end, bool* out_closed)
+{
+    for (; p < end; p++)
+    {
+        p = (const char*)memchr(p, '*', (size_t)(end - p));
+        if (p == NULL)
+            break;
+        if (p + 1 < end && p[1] == '/')
+        {
+            *out_closed = true;
+            return p + 2;
+        }
+    }
+    *out_closed = false;
+    return end;
+}
+
+// End of a raw string whose opening "delimiter(" is before 'p': after its )delimiter"
+static const char* SkipRawString(const char* p, const char* end, const std::string& delimiter, bool* out_closed)
+{
+    const size_t len = delimiter.size();
+    for (; p < end; p++)
+    {
+        p = (const char*)memchr(p, ')', (size_t)(end - p));
+        if (p == NULL)
+            break;
+        if ((size_t)(end - p) >= len + 2 && memcmp(p + 1, delimiter.data(), len) == 0 && p[1 + len] == '"')
+        {
+            *out_closed = true;
+            return p + len + 2;
+        }
+    }
+    *out_closed = false;
+    return end;
+}
+
+static void AddRun(std::vector<CppHighlighter::Run>* runs, int token, size_t len)
+{
+    if (runs == NULL || len == 0)
+        return;
+    if (!runs->empty() && runs->back().Token == token)
+    {
+        runs->back().Len += len;
+        return;
+    }
+    CppHighlighter::Run run = { len, token };
+    runs->push_back(run);
+}
+
+const size_t CppHighlighter::UpdateBudget;
+
+CppHighlighter::CppHighlighter()
+{
+    Brackets = NULL;
+    TextVersion = 0;
+    ReportedEdits = 0;
+    Reset();
+}
+
+bool CppHighlighter::IsCppFile(const std::string& filename)
+{
+    const size_t dot = filename.find_last_of('.');
+    if (dot == std::string::npos || filename.find_first_of("/\\", dot) != std::string::npos)
+        return false;
+    std::string extension = filename.substr(dot + 1);
+    for (size_t n = 0; n < extension.size(); n++)
+        if (extension[n] >= 'A' && extension[n] <= 'Z')
+            extension[n] = (char)(extension[n] - 'A' + 'a');
+    for (size_t n = 0; n < sizeof(CPP_EXTENSIONS) / sizeof(CPP_EXTENSIONS[0]); n++)
+        if (extension == CPP_EXTENSIONS[n])
+            return true;
+    return false;
+}
+
+void CppHighlighter::Reset()
+{
+    States.assign(1, (uint32_t)LEX_CODE);
+    Valid = 1;
+    DirtyEnd = 0;
+    LastLineLexed = false;
+    if (Brackets != NULL)
+        Brackets->Clear();
+}
+
+void CppHighlighter::SetBracketIndex(BracketIndex* brackets)
+{
+    Brackets = brackets;
+    Reset();
+}
+
+// The line starting at 'pos', in place when it is within a piece, else copied to LineBuffer
+const char* CppHighlighter::ReadLine(const PieceTable& text, size_t pos, size_t* out_len)
+{
+    const char* data;
+    size_t span_len;
+    *out_len = 0;
+    if (!text.GetSpan(pos, &data, &span_len))
+        return NULL;
+    const char* newline = (const char*)memchr(data, '\n', span_len);
+    if (newline != NULL)
+    {
+        *out_len = (size_t)(newline - data);
+        return data;
+    }
+    LineBuffer.assign(data, span_len);
+    while (text.GetSpan(pos + LineBuffer.size(), &data, &span_len))
+    {
+        newline = (const char*)memchr(data, '\n', span_len);
+        LineBuffer.append(data, newline != NULL ? (size_t)(newline - data) : span_len);
+        if (newline != NULL)
+            break;
+    }
+    *out_len = LineBuffer.size();
+    return LineBuffer.data();
+}
+
+bool CppHighlighter::Update(const PieceTable& text, size_t last_line)
+{
+    if (text.Version() != TextVersion + ReportedEdits)
+        Reset();
+    TextVersion = text.Version();
+    ReportedEdits = 0;
+
+    const size_t line_count = text.LineCount();
+    if (States.size() > line_count)
+        States.resize(line_count);      // Can't happen if every edit was reported
+    Valid = std::min(Valid, States.size());
+    last_line = std::min(last_line, line_count - 1);
+    size_t budget = UpdateBudget;
+    size_t pos = Valid <= last_line ? text.LineStart(Valid - 1) : 0;
+    while (Valid <= last_line)
+    {
+        if (budget == 0)
+            return false;
+
+        size_t len;
+        const char* line = ReadLine(text, pos, &len);
+        LineBrackets.clear();
+        const uint32_t state = LexLine(line, line + len, States[Valid - 1], NULL, Brackets != NULL ? &LineBrackets : NULL);
+        if (Brackets != NULL)
+            Brackets->SetLine(pos, len, line, LineBrackets.data(), LineBrackets.size());
+        pos += len + 1;
+        budget -= std::min(budget, len + 1);
+
+        if (Valid < States.size())
+        {
+            if (Valid >= DirtyEnd && States[Valid] == state)
+            {
+                // Converged: the stale states are right again
+                Valid = States.size();
+                if (Valid <= last_line)
+                    pos = text.LineStart(Valid - 1);
+                continue;
+            }
+            States[Valid] = state;
+        }
+        else
+        {
+            States.push_back(state);
+        }
+        Valid++;
+    }
+
+    // The last line has no next line to lex it for, it is lexed for its brackets only
+    if (Brackets != NULL && !LastLineLexed && Valid == line_count && last_line == line_count - 1)
+    {
+        if (budget == 0)
+            return false;
+        const size_t last_pos = text.LineStart(line_count - 1);
+        size_t len;
+        const char* line = ReadLine(text, last_pos, &len);
+        LineBrackets.clear();
+        LexLine(line, line + len, States[line_count - 1], NULL, &LineBrackets);
+        Brackets->SetLine(last_pos, len, line, LineBrackets.data(), LineBrackets.size());
+        LastLineLexed = true;
+    }
+    return true;
+}
+
+bool CppHighlighter::GetRuns(size_t line, const char* line_text, const char* line_text_end, std::vector<Run>* out)
+{
+    if (line >= Valid)
+        return false;
+    LexLine(line_text, line_text_end, States[line], out);
+    return true;
+}
+
+void CppHighlighter::OnInsert(size_t pos, const PieceTableSpan* spans, size_t count)
+{
+    (void)pos;
+    (void)spans;
+    (void)count;
+}
+
+void CppHighlighter::OnErase(size_t pos, size_t len)
+{
+    (void)pos;
+    (void)len;
+}
+
+void CppHighlighter::OnEditLines(size_t line, size_t removed_lines, size_t inserted_lines)
+{
+    ReportedEdits++;
+    LastLineLexed = false;
+    const size_t edited_end = line + 1 + inserted_lines;    // First line after the edited ones
+
+    // Where the lines at or after DirtyEnd went. Those that were removed: to the end of the edited ones.
+    size_t dirty_end = DirtyEnd;
+    if (dirty_end > line + removed_lines)
+        dirty_end = dirty_end - removed_lines + inserted_lines;
+    else if (dirty_end > line)
+        dirty_end = edited_end;
+
+    // The states after 'line' become stale. If some were stale already, those lexed again since are for another
+    // version of the text than the rest: they can't be compared with.
+    if (Valid > line + 1)
+    {
+        if (Valid < States.size())
+            dirty_end = std::max(dirty_end, Valid > line + removed_lines ? Valid - removed_lines + inserted_lines : edited_end);
+        Valid = line + 1;
+    }
+    DirtyEnd = std::max(dirty_end, edited_end);
+
+    if (line + 1 < States.size())
+    {
+        const size_t erase_end = std::min(States.size(), line + 1 + removed_lines);
+        States.erase(States.begin() + (line + 1), States.begin() + erase_end);
+        States.insert(States.begin() + (line + 1), inserted_lines, (uint32_t)LEX_CODE);
+    }
+}
+
+uint32_t CppHighlighter::InternDelimiter(const char* delimiter, size_t len)
+{
+    for (size_t n = 0; n < RawDelimiters.size(); n++)
+        if (RawDelimiters[n].size() == len && memcmp(RawDelimiters[n].data(), delimiter, len) == 0)
+            return (uint32_t)n;
+    RawDelimiters.push_back(std::string(delimiter, len));
+    return (uint32_t)(RawDelimiters.size() - 1);
+}
+
+// Lex [p, end), a line without its '\n' or the beginning of one, starting in 'state'. Appends the runs to 'runs' and
+// the offsets of the brackets in code to 'brackets' unless they are NULL, and returns the state at the start of the
+// next line.
+uint32_t CppHighlighter::LexLine(const char* p, const char* end, uint32_t state, std::vector<Run>* runs, std::vector<size_t>* brackets)
+{
+    const char* const begin = p;
+    const char* last = end;
+    while (last > p && last[-1] == '\r')
+        last--;
+    const bool continued = last > p && last[-1] == '\\';    // A '\' at the end joins the next line to this one
+    int mode = (int)(state & LEX_MODE_MASK);
+    uint32_t delimiter = state >> LEX_DELIMITER_SHIFT;
+    bool directive = (state & LEX_DIRECTIVE) != 0;
+    bool line_start = mode == LEX_CODE && !directive;       // Only spaces so far, a '#' starts a directive
+    bool closed;
+    while (p < end)
+    {
+        const char* token_begin = p;
+        int token = TOKEN_TEXT;
+        switch (mode)
+        {
+        case LEX_BLOCK_COMMENT:
+            p = SkipBlockComment(p, end, &closed);
+            token = TOKEN_COMMENT;
+            if (closed)
+                mode = LEX_CODE;
+            break;
+        case LEX_LINE_COMMENT:
+            p = end;
+            token = TOKEN_COMMENT;
+            break;
+        case LEX_STRING:
+        case LEX_CHAR:
+            p = SkipQuoted(p, end, mode == LEX_STRING ? '"' : '\'', &closed);
+            token = TOKEN_STRING;
+            if (closed)
+                mode = LEX_CODE;
+            break;
+        case LEX_RAW_STRING:
+            p = SkipRawString(p, end, RawDelimiters[delimiter], &closed);
+            token = TOKEN_STRING;
+            if (closed)
+                mode = LEX_CODE;
+            break;
+        default:
+        {
+            const char c = *p;
+            if (IsSpace(c))
+            {
+                while (p < end && IsSpace(*p))
+                    p++;
+                token = runs != NULL && !runs->empty() ? runs->back().Token : TOKEN_TEXT;
+                break;
+            }
+            const bool at_line_start = line_start;
+            line_start = false;
+            token = directive ? TOKEN_PREPROCESSOR : TOKEN_TEXT;
+            if (c == '/' && p + 1 < end && (p[1] == '/' || p[1] == '*'))
+            {
+                token = TOKEN_COMMENT;
+                if (p[1] == '/')
+                {
+                    p = end;
+                    mode = LEX_LINE_COMMENT;
+                }
+                else
+                {
+                    p = SkipBlockComment(p + 2, end, &closed);
+                    if (!closed)
+                        mode = LEX_BLOCK_COMMENT;
+                }
+            }
+            else if (c == '"' || c == '\'')
+            {
+                p = SkipQuoted(p + 1, end, c, &closed);
+                token = TOKEN_STRING;
+                if (!closed)
+                    mode = c == '"' ? LEX_STRING : LEX_CHAR;
+            }
+            else if (c == '#' && at_line_start)
+            {
+                // The directive name, the rest of the directive is lexed as code but drawn as preprocessor
+                directive = true;
+                token = TOKEN_PREPROCESSOR;
+                for (p++; p < end && IsSpace(*p); )
+                    p++;
+                while (p < end && IsIdentifierChar(*p))
+                    p++;
+            }
+            else if (IsDigit(c) || (c == '.' && p + 1 < end && IsDigit(p[1])))
+            {
+                // Also digit separators (1'000), suffixes and exponents (0x1p-3, 1e+9)
+                const bool hex = c == '0' && p + 1 < end && (p[1] == 'x' || p[1] == 'X');
+                for (p++; p < end; p++)
+                {
+                    if (IsIdentifierChar(*p) || *p == '.' || (*p == '\'' && p + 1 < end && IsIdentifierChar(p[1])))
+                        continue;
+                    const char e = p[-1];
+                    if ((*p == '+' || *p == '-') && (hex ? (e == 'p' || e == 'P') : (e == 'e' || e == 'E')))
+                        continue;
+                    break;
+                }
+                token = TOKEN_NUMBER;
+            }
+            else if (IsIdentifierStart(c))
+            {
+                while (p < end && IsIdentifierChar(*p))
+                    p++;
+                bool raw;
+                if (p < end && (*p == '"' || *p == '\'') && IsLiteralPrefix(token_begin, p, &raw) && !(raw && *p == '\''))
+                {
+                    token = TOKEN_STRING;
+                    const char quote = *p;
+                    const char* open = raw ? (const char*)memchr(p + 1, '(', std::min((size_t)(end - p - 1), RAW_DELIMITER_MAX_LEN + 1)) : NULL;
+                    if (open != NULL && std::find_first_of(p + 1, open, " )\\\t", " )\\\t" + 4) == open)
+                    {
+                        delimiter = InternDelimiter(p + 1, (size_t)(open - (p + 1)));
+                        p = SkipRawString(open + 1, end, RawDelimiters[delimiter], &closed);
+                        if (!closed)
+                            mode = LEX_RAW_STRING;
+                    }
+                    else
+                    {
+                        p = SkipQuoted(p + 1, end, quote, &closed);
+                        if (!closed)
+                            mode = quote == '"' ? LEX_STRING : LEX_CHAR;
+                    }
+                }
+                else if (!directive && runs != NULL && IsKeyword(token_begin, (size_t)(p - token_begin)))
+                {
+                    token = TOKEN_KEYWORD;
+                }
+            }
+            else
+            {
+                if (brackets != NULL && !directive && (c == '(' || c == ')' || c == '[' || c == ']' || c == '{' || c == '}'))
+                    brackets->push_back((size_t)(p - begin));
+                p++;
+            }
+            break;
+        }
+        }
+        AddRun(runs, token, (size_t)(p - token_begin));
+    }
+
+    // What goes on to the next line
+    if ((mode == LEX_LINE_COMMENT || mode == LEX_STRING || mode == LEX_CHAR) && !continued)
+        mode = LEX_CODE;
+    directive = directive && (continued || mode == LEX_BLOCK_COMMENT);
+    uint32_t next = (uint32_t)mode | (directive ? LEX_DIRECTIVE : 0);
+    if (mode == LEX_RAW_STRING)
+        next |= delimiter << LEX_DELIMITER_SHIFT;
+    return next;
+}
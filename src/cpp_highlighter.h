@@ -0,0 +1,84 @@
+// Syntax highlighting of C and C++ for the text editor.
+// Lexing a line needs the state the lexer was in at its start (in a block comment, in a raw string...), which depends
+// on every line before it. Those states are cached, one per line: drawing a row only lexes the visible part of that
+// row from its cached state. After an edit the states past the edited line are kept but marked stale, and lines are
+// lexed again from there only until the state at the start of a line matches its stale one after the edited part
+// (from then on the text and the states are what they were). States are computed lazily, up to the last visible row,
+// and at most UpdateBudget bytes per frame, so opening a file or jumping to its end doesn't stall: rows whose state
+// isn't known yet are drawn plain for a few frames.
+// The highlighter listens to the edits of its PieceTable (see PieceTableListener). Loading the text, which isn't
+// reported, is noticed through PieceTable::Version() and resets the cache.
+// As it lexes lines, it can also tell a BracketIndex which brackets are in code.
+
+#pragma once
+
+#include "piece_table.h"
+#include "bracket_index.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class CppHighlighter : public PieceTableListener
+{
+public:
+    enum Token { TOKEN_TEXT, TOKEN_KEYWORD, TOKEN_NUMBER, TOKEN_STRING, TOKEN_COMMENT, TOKEN_PREPROCESSOR, TOKEN_COUNT };
+
+    // Bytes of text in a row of the same token. Spaces take the token of what is before them, to make fewer runs.
+    struct Run
+    {
+        size_t      Len;
+        int         Token;
+    };
+
+    static const size_t UpdateBudget = 64 * 1024;       // Bytes lexed by Update() at most
+
+    CppHighlighter();
+
+    // Does 'filename' look like C or C++ (by its extension)?
+    static bool IsCppFile(const std::string& filename);
+
+    // Bring the line states of 'text' up to date up to line 'last_line', once per frame before drawing. Returns false
+    // if the budget ran out first, the rest is done by the next calls.
+    bool        Update(const PieceTable& text, size_t last_line);
+
+    // The runs of [line_text, line_text_end), the beginning of line 'line' (e.g. its visible part), appended to
+    // 'out'. Returns false, and adds nothing, if the state of the line isn't known yet.
+    bool        GetRuns(size_t line, const char* line_text, const char* line_text_end, std::vector<Run>* out);
+
+    size_t      KnownLines() const                  { return Valid; }   // Lines whose state is up to date
+    // State of the lexer at the start of 'line' < KnownLines(): a line lexes the same as long as it and its state do
+    uint32_t    LineState(size_t line) const        { return States[line]; }
+
+    // Keep 'brackets' (not owned, listening to the same text) up to date with the brackets of the lines lexed by
+    // Update(), NULL to stop. The text is lexed again from the top. The index is right once every line is known.
+    void        SetBracketIndex(BracketIndex* brackets);
+    bool        BracketsKnown() const               { return Brackets != NULL && Valid == States.size() && LastLineLexed; }
+
+    virtual void OnInsert(size_t pos, const PieceTableSpan* spans, size_t count);
+    virtual void OnErase(size_t pos, size_t len);
+    virtual void OnEditLines(size_t line, size_t removed_lines, size_t inserted_lines);
+
+private:
+    // States[n] is the state at the start of line n. Those before Valid are up to date. Those from Valid on are stale:
+    // they were right for an older version of the text, which is the same as the current one from line DirtyEnd on
+    // (lines moved by the edits since are accounted for).
+    std::vector<uint32_t>       States;
+    size_t                      Valid;
+    size_t                      DirtyEnd;
+    std::vector<std::string>    RawDelimiters;      // Of the raw strings met, a state in one refers to its delimiter by index
+    std::string                 LineBuffer;         // A line crossing pieces of the text, made contiguous to be lexed
+    BracketIndex*               Brackets;
+    std::vector<size_t>         LineBrackets;       // Offsets of the brackets in the line lexed, for Brackets
+    bool                        LastLineLexed;      // For its brackets, since the last edit
+    unsigned                    TextVersion;        // PieceTable::Version() at the last Update()...
+    unsigned                    ReportedEdits;      // ...and the edits reported since, each bumps it once
+
+    void        Reset();
+    const char* ReadLine(const PieceTable& text, size_t pos, size_t* out_len);
+    uint32_t    LexLine(const char* p, const char* end, uint32_t state, std::vector<Run>* runs, std::vector<size_t>* brackets = NULL);
+    uint32_t    InternDelimiter(const char* delimiter, size_t len);
+
+    CppHighlighter(const CppHighlighter&);
+    CppHighlighter& operator=(const CppHighlighter&);
+};
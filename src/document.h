@@ -0,0 +1,40 @@
+// Contents of an editor tab: the text (piece table) plus the editor state that goes with it.
+// Files too big to be loaded are shown by a read-only FileView instead, 'Text' stays empty for those.
+// Other files are read in the background by a FileLoader, the tab is read-only until it is done.
+
+#pragma once
+
+#include "piece_table.h"
+#include "text_editor.h"
+#include "file_viewer.h"
+#include "text_search.h"
+#include "text_replace.h"
+#include "bracket_index.h"
+#include "cpp_highlighter.h"
+#include "code_folding.h"
+#include "minimap.h"
+#include "file_io.h"
+#include "journal.h"
+#include <memory>
+#include <string>
+
+struct Document
+{
+    PieceTable                  Text;
+    TextEditorState             Editor;
+    std::unique_ptr<FileLoader> Loader;     // Set while the file is being read
+    std::unique_ptr<FileView>   View;       // Set when the tab is a read-only view of a memory-mapped file
+    FileViewerState             Viewer;
+    std::unique_ptr<TextSearch> Search;     // Set while the find bar is open. Declared after 'View', which it may be reading.
+    std::unique_ptr<TextReplace> Replace;   // Set while "Replace all" is running
+    std::string                 ReplaceStatus;  // Outcome of the last "Replace all", shown in the find bar
+    std::string                 SavePath;   // Where the last save went, to match SaveQueue results
+    std::string                 SaveStatus; // Outcome of the last save, shown next to the Save button
+    std::string                 DiskPath;   // File that 'Text' was loaded from or last saved to, empty if none...
+    FileStamp                   DiskStamp;  // ...and its stamp then: saving there again only writes what changed
+    std::unique_ptr<JournalDocument> Journal;   // Listener of 'Text', journals its edits for crash recovery
+    std::unique_ptr<BracketIndex> Brackets;         // Listener of 'Text' too, filled by 'Highlighter' (see Editor.Brackets)
+    std::unique_ptr<CppHighlighter> Highlighter;    // Listener of 'Text' too, set for C/C++ files (see Editor.Highlighter)
+    std::unique_ptr<FoldIndex>  Folds;      // Listener of 'Text' too, set with 'Highlighter' (see Editor.Folds)
+    std::unique_ptr<Minimap>    Map;        // Listener of 'Text' too, set when the tab is first drawn. Its texture is deleted with the tab.
+};
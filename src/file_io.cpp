@@ -0,0 +1,271 @@
+// Reading files into editor tabs (see file_io.h)
+
+#include "file_io.h"
+#include <stdio.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Upper bound for a single read() call. Some systems refuse (or split) requests of 2 GB and more.
+static const size_t READ_CHUNK_SIZE = 64 * 1024 * 1024;
+
+// FileLoader reads a small first chunk so the first screen shows up quickly, then bigger ones
+static const size_t LOADER_FIRST_CHUNK_SIZE = 256 * 1024;
+static const size_t LOADER_CHUNK_SIZE = 8 * 1024 * 1024;
+
+#ifdef _WIN32
+typedef struct _stat64 FileStat;
+static int  FileOpen(const char* filename)                  { return _open(filename, _O_RDONLY | _O_BINARY); }
+static int  FileStatFd(int fd, FileStat* st)                { return _fstat64(fd, st); }
+static long FileRead(int fd, char* dst, size_t len)         { return _read(fd, dst, (unsigned int)len); }
+static int  FileStatPath(const char* filename, FileStat* st) { return _stat64(filename, st); }
+static int64_t FileStatMTime(const FileStat& st)            { return (int64_t)st.st_mtime * 1000000000; }
+#else
+typedef struct stat FileStat;
+static int  FileOpen(const char* filename)                  { return open(filename, O_RDONLY); }
+static int  FileStatFd(int fd, FileStat* st)                { return fstat(fd, st); }
+static long FileRead(int fd, char* dst, size_t len)
+{
+    ssize_t n;
+    do { n = read(fd, dst, len); } while (n < 0 && errno == EINTR);
+    return (long)n;
+}
+static int  FileStatPath(const char* filename, FileStat* st) { return stat(filename, st); }
+#ifdef __APPLE__
+static int64_t FileStatMTime(const FileStat& st)            { return (int64_t)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec; }
+#else
+static int64_t FileStatMTime(const FileStat& st)            { return (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec; }
+#endif
+#endif
+
+#ifdef _WIN32
+int  FileCreate(const char* filename, int)                  { return _open(filename, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE); }
+long FileWrite(int fd, const char* src, size_t len)         { return _write(fd, src, (unsigned int)len); }
+bool FileSync(int fd)                                       { return _commit(fd) == 0; }
+bool FileClose(int fd)                                      { return _close(fd) == 0; }
+bool FileReplace(const char* src, const char* dst)          { return MoveFileExA(src, dst, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0; }
+#else
+int  FileCreate(const char* filename, int mode)             { return open(filename, O_WRONLY | O_CREAT | O_TRUNC, (mode_t)mode); }
+long FileWrite(int fd, const char* src, size_t len)
+{
+    ssize_t n;
+    do { n = write(fd, src, len); } while (n < 0 && errno == EINTR);
+    return (long)n;
+}
+bool FileSync(int fd)
+{
+#ifdef __APPLE__
+    // fsync() on macOS doesn't flush the drive's cache
+    if (fcntl(fd, F_FULLFSYNC) == 0)
+        return true;
+#endif
+    return fsync(fd) == 0;
+}
+bool FileClose(int fd)                                      { return close(fd) == 0; }
+bool FileReplace(const char* src, const char* dst)          { return rename(src, dst) == 0; }
+#endif
+
+void ReleaseMappedPages(const char* data, size_t offset, size_t len)
+{
+#ifdef _WIN32
+    (void)data; (void)offset; (void)len; // Windows trims the working set of a read-only view by itself
+#else
+    if (data == NULL || len == 0)
+        return;
+    const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    const size_t begin = offset - offset % page_size;
+    madvise((void*)(data + begin), offset + len - begin, MADV_DONTNEED);
+#endif
+}
+
+static void StampFromStat(const FileStat& st, FileStamp* out)
+{
+    out->Size = (uint64_t)st.st_size;
+    out->MTime = FileStatMTime(st);
+}
+
+bool GetFileStamp(const char* filename, FileStamp* out)
+{
+    FileStat st;
+    if (FileStatPath(filename, &st) != 0)
+        return false;
+    StampFromStat(st, out);
+    return true;
+}
+
+bool GetFileStamp(int fd, FileStamp* out)
+{
+    FileStat st;
+    if (FileStatFd(fd, &st) != 0)
+        return false;
+    StampFromStat(st, out);
+    return true;
+}
+
+bool LoadFile(const char* filename, PieceTable* out)
+{
+    out->Clear();
+    int fd = FileOpen(filename);
+    if (fd < 0)
+        return false;
+    FileStat st;
+    if (FileStatFd(fd, &st) != 0)
+    {
+        FileClose(fd);
+        return false;
+    }
+
+    const size_t size = (size_t)st.st_size;
+    std::unique_ptr<char[]> data(new char[size > 0 ? size : 1]);
+    size_t read_size = 0;
+    while (read_size < size)
+    {
+        const size_t request = size - read_size < READ_CHUNK_SIZE ? size - read_size : READ_CHUNK_SIZE;
+        const long n = FileRead(fd, data.get() + read_size, request);
+        if (n < 0)
+        {
+            FileClose(fd);
+            return false;
+        }
+        if (n == 0)
+            break; // File got shorter since we stat'ed it
+        read_size += (size_t)n;
+    }
+    FileClose(fd);
+    out->Load(std::move(data), read_size);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// FileLoader
+//-----------------------------------------------------------------------------
+
+FileLoader::FileLoader()
+{
+    Fd = -1;
+    TotalBytes = 0;
+    ReadBytes.store(0);
+    Finished.store(false);
+    Error.store(false);
+    CancelRequested.store(false);
+}
+
+FileLoader::~FileLoader()
+{
+    Cancel();
+}
+
+bool FileLoader::Start(const char* filename)
+{
+    Cancel();
+    Fd = FileOpen(filename);
+    FileStat st;
+    if (Fd < 0 || FileStatFd(Fd, &st) != 0)
+    {
+        if (Fd >= 0)
+            FileClose(Fd);
+        Fd = -1;
+        Error.store(true);
+        return false;
+    }
+    TotalBytes = (size_t)st.st_size;
+    StampFromStat(st, &StartStamp);
+    ReadBytes.store(0);
+    Finished.store(false);
+    Error.store(false);
+    CancelRequested.store(false);
+    Thread = std::thread(&FileLoader::Run, this);
+    return true;
+}
+
+void FileLoader::Cancel()
+{
+    if (Thread.joinable())
+    {
+        CancelRequested.store(true);
+        Thread.join();
+    }
+    Chunks.clear();
+}
+
+void FileLoader::Run()
+{
+    size_t chunk_size = LOADER_FIRST_CHUNK_SIZE;
+    size_t read_bytes = 0;
+    while (!CancelRequested.load())
+    {
+        // Sized from the stat'ed size, but keep reading past it in case the file grew
+        const size_t remaining = TotalBytes > read_bytes ? TotalBytes - read_bytes : 0;
+        Chunk chunk;
+        chunk.Size = remaining > 0 && remaining < chunk_size ? remaining : chunk_size;
+        chunk.Data.reset(new char[chunk.Size]);
+        size_t filled = 0;
+        while (filled < chunk.Size)
+        {
+            const long n = FileRead(Fd, chunk.Data.get() + filled, chunk.Size - filled);
+            if (n < 0)
+                Error.store(true);
+            if (n <= 0)
+                break;
+            filled += (size_t)n;
+        }
+        chunk.Size = filled;
+        read_bytes += filled;
+        if (filled > 0)
+        {
+            std::lock_guard<std::mutex> lock(ChunksMutex);
+            Chunks.push_back(std::move(chunk));
+        }
+        ReadBytes.store(read_bytes);
+        if (filled == 0 || Error.load())
+            break;
+        chunk_size = LOADER_CHUNK_SIZE;
+    }
+    FileClose(Fd);
+    Fd = -1;
+    Finished.store(true);
+}
+
+bool FileLoader::Poll(PieceTable* out, size_t max_bytes)
+{
+    if (!Thread.joinable())
+        return false;
+
+    // Check before taking the chunks: once Finished is set, the chunks we take below are the last ones
+    const bool finished = Finished.load();
+    bool done = false;
+    std::vector<Chunk> taken;
+    {
+        std::lock_guard<std::mutex> lock(ChunksMutex);
+        size_t taken_bytes = 0;
+        size_t n = 0;
+        while (n < Chunks.size() && (n == 0 || taken_bytes + Chunks[n].Size <= max_bytes))
+            taken_bytes += Chunks[n++].Size;
+        taken.reserve(n);
+        for (size_t i = 0; i < n; i++)
+            taken.push_back(std::move(Chunks[i]));
+        Chunks.erase(Chunks.begin(), Chunks.begin() + (ptrdiff_t)n);
+        done = finished && Chunks.empty();
+    }
+    if (done)
+        Thread.join();
+    for (size_t i = 0; i < taken.size(); i++)
+        out->Append(std::move(taken[i].Data), taken[i].Size);
+    return !taken.empty();
+}
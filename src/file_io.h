@@ -0,0 +1,85 @@
+// Reading files into editor tabs, and the low-level file calls the writers (save queue, journal) share.
+
+#pragma once
+
+#include "piece_table.h"
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Size and modification time of a file, to tell whether it was changed by someone else since we read or wrote it
+struct FileStamp
+{
+    uint64_t    Size;
+    int64_t     MTime;          // Nanoseconds since the epoch (seconds resolution on Windows)
+
+    FileStamp()                 { Size = 0; MTime = 0; }
+    bool operator==(const FileStamp& other) const   { return Size == other.Size && MTime == other.MTime; }
+    bool operator!=(const FileStamp& other) const   { return !(*this == other); }
+};
+bool GetFileStamp(const char* filename, FileStamp* out);
+bool GetFileStamp(int fd, FileStamp* out);
+
+// Thin wrappers over the platform's file calls. They return -1 or false on failure, with errno set.
+// FileCreate() creates or truncates for writing, 'mode' is the POSIX permission bits (unused on Windows).
+int  FileCreate(const char* filename, int mode);
+long FileWrite(int fd, const char* src, size_t len); // Retries on EINTR, may write less than 'len'
+bool FileSync(int fd);                              // Flush to the drive, not just to the OS (F_FULLFSYNC on macOS)
+bool FileClose(int fd);
+bool FileReplace(const char* src, const char* dst); // Rename over 'dst', atomically
+
+// Hint that [offset, offset + len) of the read-only mapping at 'data' will not be needed soon, so the OS can drop those
+// pages from our resident set. They are clean file pages: they are simply read again on the next access.
+void ReleaseMappedPages(const char* data, size_t offset, size_t len);
+
+// Read a whole file into 'out': the size is taken from the file system, the buffer is allocated once and filled with
+// large reads, then handed over to the piece table as its original block (no further copy). Returns false if the file
+// can't be opened or read, 'out' is left empty then.
+bool LoadFile(const char* filename, PieceTable* out);
+
+// Reads a file on a worker thread, in chunks. The UI thread calls Poll() every frame to append the chunks read so far
+// to the document, so a tab can show the beginning of a big file while the rest is still loading.
+// Only the UI thread touches the PieceTable.
+class FileLoader
+{
+public:
+    FileLoader();
+    ~FileLoader();
+
+    bool        Start(const char* filename);        // Opening happens here so failures are reported right away
+    void        Cancel();
+    bool        IsLoading() const                   { return Thread.joinable(); }
+    bool        Failed() const                      { return Error.load(); }
+    float       Progress() const                    { return TotalBytes > 0 ? (float)((double)ReadBytes.load() / (double)TotalBytes) : 1.0f; }
+    FileStamp   Stamp() const                       { return StartStamp; }  // Of the file when Start() opened it
+
+    // Append the chunks read so far to 'out', up to about 'max_bytes' per call: appending indexes the newlines of the
+    // chunk (~2-3 ms per 8 MB), the default keeps a frame well under 16 ms while still taking ~500 MB/s at 60 FPS.
+    // Returns true if the text changed. IsLoading() becomes false once the last chunk has been taken.
+    bool        Poll(PieceTable* out, size_t max_bytes = 8 * 1024 * 1024);
+
+private:
+    struct Chunk
+    {
+        std::unique_ptr<char[]> Data;
+        size_t                  Size;
+    };
+
+    std::thread                 Thread;
+    std::mutex                  ChunksMutex;
+    std::vector<Chunk>          Chunks;             // Read but not taken yet. Protected by ChunksMutex.
+    int                         Fd;
+    size_t                      TotalBytes;
+    FileStamp                   StartStamp;
+    std::atomic<size_t>         ReadBytes;
+    std::atomic<bool>           Finished;
+    std::atomic<bool>           Error;
+    std::atomic<bool>           CancelRequested;
+
+    void        Run();
+
+    FileLoader(const FileLoader&);
+    FileLoader& operator=(const FileLoader&);
+};
@@ -0,0 +1,498 @@
+// Read-only file viewer (see file_viewer.h)
+
+#ifndef IMGUI_DEFINE_MATH_OPERATORS
+#define IMGUI_DEFINE_MATH_OPERATORS
+#endif
+#include "file_viewer.h"
+#include "file_io.h"
+#include "text_search.h"
+#include "imgui_internal.h"
+#include <string.h>
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// The index thread publishes its progress (and releases the pages it scanned) after each chunk of this size
+static const size_t INDEX_CHUNK_SIZE = 16 * 1024 * 1024;
+
+// Scrolling to a match further than this from the start of its line doesn't scroll horizontally, to not measure megabytes of text
+static const size_t FIND_FOLLOW_MAX_COLUMN = 64 * 1024;
+
+//-----------------------------------------------------------------------------
+// MappedFile
+//-----------------------------------------------------------------------------
+
+MappedFile::MappedFile()
+{
+    Opened = false;
+    MappedData = NULL;
+    MappedSize = 0;
+#ifdef _WIN32
+    FileHandle = MappingHandle = NULL;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const char* filename)
+{
+    Close();
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size))
+    {
+        CloseHandle(file);
+        return false;
+    }
+    if (size.QuadPart > 0)
+    {
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        const void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+        if (data == NULL)
+        {
+            if (mapping)
+                CloseHandle(mapping);
+            CloseHandle(file);
+            return false;
+        }
+        MappingHandle = mapping;
+        MappedData = (const char*)data;
+        MappedSize = (size_t)size.QuadPart;
+    }
+    FileHandle = file;
+    Opened = true;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (MappedData)
+        UnmapViewOfFile(MappedData);
+    if (MappingHandle)
+        CloseHandle((HANDLE)MappingHandle);
+    if (FileHandle)
+        CloseHandle((HANDLE)FileHandle);
+    FileHandle = MappingHandle = NULL;
+    MappedData = NULL;
+    MappedSize = 0;
+    Opened = false;
+}
+
+#else
+
+bool MappedFile::Open(const char* filename)
+{
+    Close();
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return false;
+    }
+    if (st.st_size > 0)
+    {
+        void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            close(fd);
+            return false;
+        }
+        MappedData = (const char*)data;
+        MappedSize = (size_t)st.st_size;
+    }
+    close(fd); // The mapping keeps its own reference to the file
+    Opened = true;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (MappedData)
+        munmap((void*)MappedData, MappedSize);
+    MappedData = NULL;
+    MappedSize = 0;
+    Opened = false;
+}
+
+#endif
+
+void MappedFile::Release(size_t offset, size_t len) const
+{
+    ReleaseMappedPages(MappedData, offset, len);
+}
+
+//-----------------------------------------------------------------------------
+// FileView
+//-----------------------------------------------------------------------------
+
+FileView::FileView()
+{
+    IndexedLines = 0;
+    IndexedBytes.store(0);
+    IndexDone.store(true);
+    IndexCancel.store(false);
+}
+
+FileView::~FileView()
+{
+    Close();
+}
+
+bool FileView::Open(const char* filename)
+{
+    Close();
+    if (!File.Open(filename))
+        return false;
+    IndexDone.store(false);
+    IndexThread = std::thread(&FileView::BuildIndex, this);
+    return true;
+}
+
+void FileView::Close()
+{
+    if (IndexThread.joinable())
+    {
+        IndexCancel.store(true);
+        IndexThread.join();
+    }
+    File.Close();
+    LineOffsets.clear();
+    LongLines.clear();
+    IndexedLines = 0;
+    IndexedBytes.store(0);
+    IndexDone.store(true);
+    IndexCancel.store(false);
+}
+
+void FileView::BuildIndex()
+{
+    const char* data = File.Data();
+    const size_t size = File.Size();
+    size_t lines = 0;
+    size_t line_start = 0;
+    std::vector<size_t> found;
+    std::vector<LongLine> found_long;
+    for (size_t chunk_start = 0; chunk_start < size && !IndexCancel.load(); )
+    {
+        const size_t chunk_end = size - chunk_start > INDEX_CHUNK_SIZE ? chunk_start + INDEX_CHUNK_SIZE : size;
+        found.clear();
+        found_long.clear();
+        for (const char* p = data + chunk_start; ; )
+        {
+            p = (const char*)memchr(p, '\n', (size_t)(data + chunk_end - p));
+            if (p == NULL)
+                break;
+            const size_t line_end = (size_t)(p - data);
+            if (line_end - line_start >= LongLineMin)
+            {
+                LongLine long_line = { line_start, line_end };
+                found_long.push_back(long_line);
+            }
+            p++;
+            line_start = (size_t)(p - data);
+            if (++lines % IndexStride == 0)
+                found.push_back(line_start);
+        }
+        if (chunk_end == size && size - line_start >= LongLineMin)
+        {
+            LongLine long_line = { line_start, size };
+            found_long.push_back(long_line);
+        }
+        {
+            std::lock_guard<std::mutex> lock(IndexMutex);
+            LineOffsets.insert(LineOffsets.end(), found.begin(), found.end());
+            LongLines.insert(LongLines.end(), found_long.begin(), found_long.end());
+            IndexedLines = lines;
+        }
+        IndexedBytes.store(chunk_end);
+        File.Release(chunk_start, chunk_end - chunk_start);
+        chunk_start = chunk_end;
+    }
+    IndexDone.store(true);
+}
+
+size_t FileView::LineCount() const
+{
+    std::lock_guard<std::mutex> lock(IndexMutex);
+    return IndexedLines + 1;
+}
+
+size_t FileView::LineStart(size_t line) const
+{
+    size_t pos = 0;
+    {
+        std::lock_guard<std::mutex> lock(IndexMutex);
+        if (line > IndexedLines)
+            return Size();
+        if (line >= IndexStride)
+            pos = LineOffsets[line / IndexStride - 1];
+    }
+    for (size_t n = line % IndexStride; n > 0; n--)
+        pos = LineEnd(pos) + 1;
+    return pos;
+}
+
+bool FileView::LongLineLess(const LongLine& a, const LongLine& b)
+{
+    return a.Start < b.Start;
+}
+
+size_t FileView::LineEnd(size_t line_start) const
+{
+    if (line_start >= Size())
+        return Size();
+    // Only search the beginning of the line: past that, it is a long line and the index knows where it ends. This
+    // keeps the pages after the line out of memory when it is very long (or when there is no '\n' at all).
+    const size_t search_len = ImMin(Size() - line_start, LongLineMin);
+    const char* p = (const char*)memchr(Data() + line_start, '\n', search_len);
+    if (p != NULL)
+        return (size_t)(p - Data());
+    if (search_len < LongLineMin)
+        return Size();
+    std::lock_guard<std::mutex> lock(IndexMutex);
+    LongLine key = { line_start, 0 };
+    std::vector<LongLine>::const_iterator it = std::lower_bound(LongLines.begin(), LongLines.end(), key, LongLineLess);
+    if (it != LongLines.end() && it->Start == line_start)
+        return it->End;
+    return Size(); // Still being indexed: the line runs to the end of what is known
+}
+
+size_t FileView::LineFromPos(size_t pos) const
+{
+    if (pos >= IndexedBytes.load() && pos < Size())
+        return (size_t)-1;
+    size_t line;
+    const char* p;
+    {
+        std::lock_guard<std::mutex> lock(IndexMutex);
+        const size_t indexed = (size_t)(std::upper_bound(LineOffsets.begin(), LineOffsets.end(), pos) - LineOffsets.begin());
+        line = indexed * IndexStride;
+        p = Data() + (indexed > 0 ? LineOffsets[indexed - 1] : 0);
+    }
+    // Less than IndexStride lines to count from the indexed one
+    const char* end = Data() + ImMin(pos, Size());
+    while (p < end && (p = (const char*)memchr(p, '\n', (size_t)(end - p))) != NULL)
+    {
+        line++;
+        p++;
+    }
+    return line;
+}
+
+//-----------------------------------------------------------------------------
+// Widget
+//-----------------------------------------------------------------------------
+
+// Part of a line overlapping [min_x, max_x): [*out_begin, *out_end), with *out_x the x of *out_begin.
+// Stops measuring past max_x, returns how far it measured (the full width when the line ends before max_x).
+static float ClipLineX(const char* text_begin, const char* text_end, float min_x, float max_x, const char** out_begin, const char** out_end, float* out_x)
+{
+    ImGuiContext& g = *GImGui;
+    const float scale = g.FontSize / g.Font->FontSize;
+    float line_width = 0.0f;
+    const char* s = text_begin;
+    *out_begin = NULL;
+    *out_x = 0.0f;
+    while (s < text_end && line_width < max_x)
+    {
+        unsigned int c = (unsigned int)*s;
+        int len = 1;
+        if (c >= 0x80)
+            len = ImTextCharFromUtf8(&c, s, text_end);
+        const float char_width = (c == '\r') ? 0.0f : g.Font->GetCharAdvance((ImWchar)c) * scale; // Same as CalcTextSizeA()
+        if (*out_begin == NULL && line_width + char_width > min_x)
+        {
+            *out_begin = s;
+            *out_x = line_width;
+        }
+        line_width += char_width;
+        s += len;
+    }
+    if (*out_begin == NULL)
+        *out_begin = s;
+    *out_end = s;
+    return line_width;
+}
+
+// Highlight the occurrences of the find text in a row (the line starts at 'line_pos' on screen, 'text_begin' being at
+// 'text_offset' in the file), the one starting at state->FindCurrent more than the others
+static void DrawFindMatches(ImDrawList* draw_list, const char* text_begin, const char* text_end, size_t text_offset, const FileViewerState* state, const ImVec2& line_pos, const ImVec4& clip_rect)
+{
+    ImGuiContext& g = *GImGui;
+    const ImU32 match_col = ImGui::GetColorU32(ImGuiCol_PlotHistogram, 0.35f);
+    const ImU32 current_col = ImGui::GetColorU32(ImGuiCol_PlotHistogram, 0.70f);
+    const size_t find_len = state->FindText.size();
+    const char* measured = text_begin;
+    float x = 0.0f;
+    for (const char* p = text_begin; p < text_end; p += find_len)
+    {
+        p = FindText(p, (size_t)(text_end - p), state->FindText.data(), find_len, state->FindIgnoreCase);
+        if (p == NULL)
+            break;
+        x += g.Font->CalcTextSizeA(g.FontSize, FLT_MAX, 0.0f, measured, p).x;
+        const float width = g.Font->CalcTextSizeA(g.FontSize, FLT_MAX, 0.0f, p, p + find_len).x;
+        ImRect rect(line_pos + ImVec2(x, 0.0f), line_pos + ImVec2(x + width, g.FontSize));
+        rect.ClipWith(clip_rect);
+        if (rect.Overlaps(clip_rect))
+            draw_list->AddRectFilled(rect.Min, rect.Max, text_offset + (size_t)(p - text_begin) == state->FindCurrent ? current_col : match_col);
+        x += width;
+        measured = p + find_len;
+    }
+}
+
+void FileViewer(const char* label, const FileView* view, FileViewerState* state, const ImVec2& size_arg)
+{
+    using namespace ImGui;
+    ImGuiWindow* window = GetCurrentWindow();
+    if (window->SkipItems)
+        return;
+
+    ImGuiContext& g = *GImGui;
+    ImGuiIO& io = g.IO;
+    const ImGuiStyle& style = g.Style;
+    const ImGuiID id = window->GetID(label);
+    const ImVec2 frame_size = CalcItemSize(size_arg, CalcItemWidth(), g.FontSize * 8.0f + style.FramePadding.y * 2.0f);
+
+    // Scrolling is done in lines rather than pixels (a float pixel offset runs out of precision on big files),
+    // so the child window doesn't scroll and we draw our own scrollbars.
+    PushStyleColor(ImGuiCol_ChildBg, style.Colors[ImGuiCol_FrameBg]);
+    PushStyleVar(ImGuiStyleVar_ChildRounding, style.FrameRounding);
+    PushStyleVar(ImGuiStyleVar_ChildBorderSize, style.FrameBorderSize);
+    PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0, 0));
+    bool child_visible = BeginChildEx(label, id, frame_size, true, ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse | ImGuiWindowFlags_NoNav);
+    PopStyleVar(3);
+    PopStyleColor();
+    if (!child_visible)
+    {
+        EndChild();
+        return;
+    }
+    ImGuiWindow* draw_window = g.CurrentWindow;
+    const ImRect frame_bb = draw_window->Rect();
+    const ImRect scrollbar_y_bb(frame_bb.Max.x - style.ScrollbarSize, frame_bb.Min.y, frame_bb.Max.x, frame_bb.Max.y - style.ScrollbarSize);
+    const ImRect scrollbar_x_bb(frame_bb.Min.x, frame_bb.Max.y - style.ScrollbarSize, frame_bb.Max.x - style.ScrollbarSize, frame_bb.Max.y);
+    const ImRect text_bb(frame_bb.Min + style.FramePadding, ImVec2(scrollbar_y_bb.Min.x, scrollbar_x_bb.Min.y) - style.FramePadding);
+    const ImS64 line_count = (ImS64)view->LineCount();
+    const ImS64 row_count = ImMax((ImS64)(text_bb.GetHeight() / g.FontSize), (ImS64)1);
+    const float text_width = ImMax(text_bb.GetWidth(), 1.0f);
+
+    // Inputs
+    ImS64 top_line = (ImS64)state->TopLine;
+    if (IsWindowHovered())
+    {
+        SetKeyOwner(ImGuiKey_MouseWheelY, id);
+        SetKeyOwner(ImGuiKey_MouseWheelX, id);
+        float wheel_x = io.MouseWheelH;
+        float wheel_y = io.MouseWheel;
+        if (io.KeyShift && !io.ConfigMacOSXBehaviors)
+        {
+            wheel_x = wheel_y;
+            wheel_y = 0.0f;
+        }
+        top_line -= (ImS64)(wheel_y * 3.0f);
+        state->ScrollX -= wheel_x * g.FontSize * 3.0f;
+    }
+    if (IsWindowFocused())
+    {
+        const ImGuiInputFlags f_repeat = ImGuiInputFlags_Repeat;
+        if (Shortcut(ImGuiKey_UpArrow, id, f_repeat))
+            top_line -= 1;
+        if (Shortcut(ImGuiKey_DownArrow, id, f_repeat))
+            top_line += 1;
+        if (Shortcut(ImGuiKey_PageUp, id, f_repeat))
+            top_line -= row_count;
+        if (Shortcut(ImGuiKey_PageDown, id, f_repeat))
+            top_line += row_count;
+        if (Shortcut(ImGuiKey_Home, id) || Shortcut(ImGuiMod_Ctrl | ImGuiKey_Home, id))
+            top_line = 0;
+        if (Shortcut(ImGuiKey_End, id) || Shortcut(ImGuiMod_Ctrl | ImGuiKey_End, id))
+            top_line = line_count;
+        if (Shortcut(ImGuiKey_LeftArrow, id, f_repeat))
+            state->ScrollX -= g.FontSize * 3.0f;
+        if (Shortcut(ImGuiKey_RightArrow, id, f_repeat))
+            state->ScrollX += g.FontSize * 3.0f;
+    }
+
+    // Bring the current match into view. Its line may not be indexed yet: try again on the next frames then.
+    if (state->FindFollow)
+    {
+        const size_t line = view->LineFromPos(state->FindCurrent);
+        if (line != (size_t)-1)
+        {
+            if ((ImS64)line < top_line || (ImS64)line >= top_line + row_count)
+                top_line = (ImS64)line - row_count / 3;
+            const size_t line_start = view->LineStart(line);
+            if (state->FindCurrent - line_start <= FIND_FOLLOW_MAX_COLUMN)
+            {
+                const float match_x = g.Font->CalcTextSizeA(g.FontSize, FLT_MAX, 0.0f, view->Data() + line_start, view->Data() + state->FindCurrent).x;
+                if (match_x < state->ScrollX || match_x + g.FontSize > state->ScrollX + text_width)
+                    state->ScrollX = ImMax(0.0f, match_x - text_width * 0.25f);
+                state->ContentWidth = ImMax(state->ContentWidth, match_x + text_width);
+            }
+            state->FindFollow = false;
+        }
+    }
+
+    // Scrollbars
+    const ImS64 max_top_line = ImMax(line_count - row_count, (ImS64)0);
+    top_line = ImClamp(top_line, (ImS64)0, max_top_line);
+    ScrollbarEx(scrollbar_y_bb, GetIDWithSeed("#SCROLLY", NULL, id), ImGuiAxis_Y, &top_line, row_count, line_count, ImDrawFlags_RoundCornersNone);
+    state->TopLine = (size_t)top_line;
+
+    ImS64 scroll_x = (ImS64)ImClamp(state->ScrollX, 0.0f, ImMax(state->ContentWidth - text_width, 0.0f));
+    ScrollbarEx(scrollbar_x_bb, GetIDWithSeed("#SCROLLX", NULL, id), ImGuiAxis_X, &scroll_x, (ImS64)text_width, (ImS64)ImMax(state->ContentWidth, text_width), ImDrawFlags_RoundCornersNone);
+    state->ScrollX = (float)scroll_x;
+
+    // Render the visible rows straight from the mapping. Lines are only measured up to the right edge of the view,
+    // ContentWidth grows as wider lines scroll into view.
+    const ImVec4 clip_rect(text_bb.Min.x, text_bb.Min.y, text_bb.Max.x, text_bb.Max.y);
+    const ImU32 text_col = GetColorU32(ImGuiCol_Text);
+    size_t line_start = view->LineStart(state->TopLine);
+    for (ImS64 row = 0; row <= row_count && state->TopLine + (size_t)row < (size_t)line_count && line_start < view->Size(); row++)
+    {
+        const size_t line_end = view->LineEnd(line_start);
+        const char* draw_begin;
+        const char* draw_end;
+        float draw_x;
+        const float measured_width = ClipLineX(view->Data() + line_start, view->Data() + line_end, state->ScrollX, state->ScrollX + text_width, &draw_begin, &draw_end, &draw_x);
+        state->ContentWidth = ImMax(state->ContentWidth, measured_width);
+        if (!state->FindText.empty())
+        {
+            // Up to the end of a match crossing the right edge
+            const char* find_end = draw_end + ImMin(state->FindText.size() - 1, (size_t)(view->Data() + line_end - draw_end));
+            const ImVec2 line_pos(text_bb.Min.x - state->ScrollX, text_bb.Min.y + (float)row * g.FontSize);
+            DrawFindMatches(draw_window->DrawList, view->Data() + line_start, find_end, line_start, state, line_pos, clip_rect);
+        }
+        if (draw_begin != draw_end)
+        {
+            const ImVec2 pos(text_bb.Min.x + draw_x - state->ScrollX, text_bb.Min.y + (float)row * g.FontSize);
+            draw_window->DrawList->AddText(g.Font, g.FontSize, pos, text_col, draw_begin, draw_end, 0.0f, &clip_rect);
+        }
+        line_start = line_end + 1;
+    }
+
+    EndChild();
+}
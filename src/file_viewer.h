@@ -0,0 +1,106 @@
+// Read-only viewer for files too big to be loaded in an editor tab.
+// The file is memory-mapped and never copied: only the lines on screen are read, so opening is immediate and the
+// resident memory stays proportional to what is displayed. A sparse line index (the offset of every
+// FileView::IndexStride-th line, and the extent of every line longer than FileView::LongLineMin bytes) is built on a
+// background thread; lines become reachable as the index grows.
+
+#pragma once
+
+#include "imgui.h"
+#include <stddef.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool        Open(const char* filename);
+    void        Close();
+    bool        IsOpen() const                      { return Opened; }
+    const char* Data() const                        { return MappedData; }
+    size_t      Size() const                        { return MappedSize; }
+
+    // Hint that [offset, offset + len) will not be needed soon so the OS can drop those pages from our resident set.
+    void        Release(size_t offset, size_t len) const;
+
+private:
+    bool        Opened;
+    const char* MappedData;
+    size_t      MappedSize;
+#ifdef _WIN32
+    void*       FileHandle;
+    void*       MappingHandle;
+#endif
+
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+};
+
+class FileView
+{
+public:
+    static const size_t IndexStride = 1024;         // One index entry every IndexStride lines
+    static const size_t LongLineMin = 16 * 1024;    // The end of lines at least this long is taken from the index, not searched for
+
+    FileView();
+    ~FileView();
+
+    bool        Open(const char* filename);         // Maps the file and starts indexing it in the background
+    void        Close();
+
+    const char* Data() const                        { return File.Data(); }
+    size_t      Size() const                        { return File.Size(); }
+    bool        IsIndexing() const                  { return !IndexDone.load(); }
+    float       IndexProgress() const               { return File.Size() > 0 ? (float)((double)IndexedBytes.load() / (double)File.Size()) : 1.0f; }
+    size_t      LineCount() const;                  // Lines known so far. Final once IsIndexing() returns false.
+    size_t      LineStart(size_t line) const;       // Byte offset of the first byte of 'line', Size() when not known (yet).
+    size_t      LineEnd(size_t line_start) const;   // Offset of the '\n' ending the line starting at 'line_start', or Size().
+    size_t      LineFromPos(size_t pos) const;      // Line containing byte 'pos', (size_t)-1 when not known (yet).
+
+private:
+    struct LongLine
+    {
+        size_t  Start;
+        size_t  End;                                // Offset of its '\n', or Size()
+    };
+
+    MappedFile                  File;
+    std::thread                 IndexThread;
+    mutable std::mutex          IndexMutex;
+    std::vector<size_t>         LineOffsets;        // LineOffsets[n] = start of line (n + 1) * IndexStride. Protected by IndexMutex.
+    std::vector<LongLine>       LongLines;          // Sorted by Start. Protected by IndexMutex.
+    size_t                      IndexedLines;       // Number of '\n' in [0, IndexedBytes). Protected by IndexMutex.
+    std::atomic<size_t>         IndexedBytes;
+    std::atomic<bool>           IndexDone;
+    std::atomic<bool>           IndexCancel;
+
+    void        BuildIndex();
+    static bool LongLineLess(const LongLine& a, const LongLine& b);
+
+    FileView(const FileView&);
+    FileView& operator=(const FileView&);
+};
+
+// Per-tab viewer state
+struct FileViewerState
+{
+    size_t      TopLine;                // First line displayed
+    float       ScrollX;
+    float       ContentWidth;           // Widest line seen so far, for the horizontal scroll range
+    std::string FindText;               // Occurrences of this are highlighted in the visible rows, empty for none...
+    bool        FindIgnoreCase;
+    size_t      FindCurrent;            // ...and the one starting here stands out, (size_t)-1 for none
+    bool        FindFollow;             // Scroll to FindCurrent on next render
+
+    FileViewerState()                   { TopLine = 0; ScrollX = 0.0f; ContentWidth = 0.0f; FindIgnoreCase = false; FindCurrent = (size_t)-1; FindFollow = false; }
+};
+
+// Scrolls with the mouse wheel, the scrollbar, arrows/PageUp/PageDown/Home/End when focused. There is no editing.
+void FileViewer(const char* label, const FileView* view, FileViewerState* state, const ImVec2& size = ImVec2(0, 0));
@@ -0,0 +1,608 @@
+// Crash recovery journal (see journal.h)
+
+#include "journal.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Records are flushed to disk in batches, at most this often. Typing goes to memory only in between.
+static const int JOURNAL_SYNC_INTERVAL_MS = 250;
+
+// Inserted bytes are gathered into the write buffer up to this size, bigger spans are written from their block
+static const size_t JOURNAL_DIRECT_WRITE_SIZE = 1024 * 1024;
+
+// After a save, the journal is compacted once it is at least this big, and twice as big as after the last compaction
+static const size_t JOURNAL_COMPACT_MIN_SIZE = 1024 * 1024;
+
+// The journal starts with this, then records follow. Numbers are in native byte order: the journal never leaves the
+// machine it was written on.
+static const char JOURNAL_MAGIC[8] = { 'I', 'R', 'O', 'H', 'J', 'N', 'L', '1' };
+
+// Each record: payload size (uint32), checksum of the payload (uint32), payload: type (uint8), document id (uint32),
+// then depending on the type:
+enum JournalRecordType
+{
+    JournalRecordType_Open = 1,     // name, path, stamp size, stamp mtime
+    JournalRecordType_Insert,       // position, length, bytes
+    JournalRecordType_Erase,        // position, length
+    JournalRecordType_Saved,        // edit count, path, stamp size, stamp mtime
+    JournalRecordType_Close,
+};
+
+#ifdef _WIN32
+static int  FileOpenAppend(const char* filename)                { return _open(filename, _O_WRONLY | _O_APPEND | _O_BINARY); }
+#else
+static int  FileOpenAppend(const char* filename)                { return open(filename, O_WRONLY | O_APPEND); }
+#endif
+
+static bool WriteAll(int fd, const char* data, size_t len)
+{
+    while (len > 0)
+    {
+        const long n = FileWrite(fd, data, len < (1u << 30) ? len : (1u << 30));
+        if (n <= 0)
+            return false;
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static bool ReadWholeFile(const char* filename, std::string* out)
+{
+    FILE* f = fopen(filename, "rb");
+    if (f == NULL)
+        return false;
+    char buf[64 * 1024];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        out->append(buf, n);
+    const bool ok = ferror(f) == 0;
+    fclose(f);
+    return ok;
+}
+
+//-----------------------------------------------------------------------------
+// Encoding
+//-----------------------------------------------------------------------------
+
+static uint32_t Checksum(const char* data, size_t len, uint32_t hash = 2166136261u)
+{
+    // FNV-1a: only has to catch a record torn by a crash in the middle of a write. Pass the previous result as 'hash'
+    // to continue a checksum over several buffers.
+    for (size_t n = 0; n < len; n++)
+        hash = (hash ^ (unsigned char)data[n]) * 16777619u;
+    return hash;
+}
+
+static void PutU32(std::string* out, uint32_t v)                { out->append((const char*)&v, sizeof(v)); }
+static void PutU64(std::string* out, uint64_t v)                { out->append((const char*)&v, sizeof(v)); }
+static void PutString(std::string* out, const std::string& s)   { PutU32(out, (uint32_t)s.size()); out->append(s); }
+
+static size_t BeginRecord(std::string* out, JournalRecordType type, uint32_t id)
+{
+    const size_t start = out->size();
+    out->append(8, '\0');
+    out->push_back((char)type);
+    PutU32(out, id);
+    return start;
+}
+
+static void EndRecord(std::string* out, size_t start)
+{
+    const uint32_t size = (uint32_t)(out->size() - start - 8);
+    const uint32_t checksum = Checksum(out->data() + start + 8, size);
+    memcpy(&(*out)[start], &size, sizeof(size));
+    memcpy(&(*out)[start + 4], &checksum, sizeof(checksum));
+}
+
+static void EncodeOpen(std::string* out, uint32_t id, const std::string& name, const std::string& path, const FileStamp& stamp)
+{
+    const size_t start = BeginRecord(out, JournalRecordType_Open, id);
+    PutString(out, name);
+    PutString(out, path);
+    PutU64(out, stamp.Size);
+    PutU64(out, (uint64_t)stamp.MTime);
+    EndRecord(out, start);
+}
+
+static void EncodeInsert(std::string* out, uint32_t id, size_t pos, const PieceTableSpan* spans, size_t count)
+{
+    size_t len = 0;
+    for (size_t n = 0; n < count; n++)
+        len += spans[n].Len;
+    const size_t start = BeginRecord(out, JournalRecordType_Insert, id);
+    PutU64(out, pos);
+    PutU64(out, len);
+    for (size_t n = 0; n < count; n++)
+        out->append(spans[n].Data, spans[n].Len);
+    EndRecord(out, start);
+}
+
+// Same as EncodeInsert(), straight to 'fd': the header and small spans go to 'buffer', bigger spans are written from
+// where they are after flushing 'buffer', instead of being copied
+static bool WriteInsert(int fd, std::string* buffer, uint32_t id, size_t pos, const PieceTableSpan* spans, size_t count)
+{
+    size_t len = 0;
+    for (size_t n = 0; n < count; n++)
+        len += spans[n].Len;
+    std::string head;
+    head.push_back((char)JournalRecordType_Insert);
+    PutU32(&head, id);
+    PutU64(&head, pos);
+    PutU64(&head, len);
+    uint32_t checksum = Checksum(head.data(), head.size());
+    for (size_t n = 0; n < count; n++)
+        checksum = Checksum(spans[n].Data, spans[n].Len, checksum);
+    PutU32(buffer, (uint32_t)(head.size() + len));
+    PutU32(buffer, checksum);
+    buffer->append(head);
+    for (size_t n = 0; n < count; n++)
+    {
+        if (spans[n].Len < JOURNAL_DIRECT_WRITE_SIZE)
+        {
+            buffer->append(spans[n].Data, spans[n].Len);
+            continue;
+        }
+        if (!WriteAll(fd, buffer->data(), buffer->size()) || !WriteAll(fd, spans[n].Data, spans[n].Len))
+            return false;
+        buffer->clear();
+    }
+    return true;
+}
+
+static void EncodeErase(std::string* out, uint32_t id, size_t pos, size_t len)
+{
+    const size_t start = BeginRecord(out, JournalRecordType_Erase, id);
+    PutU64(out, pos);
+    PutU64(out, len);
+    EndRecord(out, start);
+}
+
+static void EncodeSaved(std::string* out, uint32_t id, uint64_t edit_count, const std::string& path, const FileStamp& stamp)
+{
+    const size_t start = BeginRecord(out, JournalRecordType_Saved, id);
+    PutU64(out, edit_count);
+    PutString(out, path);
+    PutU64(out, stamp.Size);
+    PutU64(out, (uint64_t)stamp.MTime);
+    EndRecord(out, start);
+}
+
+struct JournalReader
+{
+    const char* P;
+    const char* End;
+    bool        Ok;
+
+    JournalReader(const char* p, const char* end)  { P = p; End = end; Ok = true; }
+    bool        Read(void* dst, size_t len)         { if (!Ok || (size_t)(End - P) < len) return Ok = false; memcpy(dst, P, len); P += len; return true; }
+    uint8_t     U8()                                { uint8_t v = 0; Read(&v, sizeof(v)); return v; }
+    uint32_t    U32()                               { uint32_t v = 0; Read(&v, sizeof(v)); return v; }
+    uint64_t    U64()                               { uint64_t v = 0; Read(&v, sizeof(v)); return v; }
+    const char* Bytes(uint64_t len)                 { if (!Ok || (uint64_t)(End - P) < len) { Ok = false; return NULL; } const char* p = P; P += len; return p; }
+    std::string String()                            { const uint32_t len = U32(); const char* p = Bytes(len); return p != NULL ? std::string(p, len) : std::string(); }
+};
+
+//-----------------------------------------------------------------------------
+// Replay
+//-----------------------------------------------------------------------------
+
+struct ReplayEdit
+{
+    uint64_t    Index;          // Edit number since the document was opened
+    bool        Insert;
+    uint64_t    Pos;
+    uint64_t    Len;
+    const char* Data;           // Inserted bytes, in the journal's buffer
+};
+
+struct ReplayDocument
+{
+    std::string             Name;
+    std::string             Path;
+    FileStamp               Stamp;
+    uint64_t                EditCount;
+    std::vector<ReplayEdit> Edits;      // Not saved yet
+    bool                    Closed;
+};
+
+// Read the records up to the end or the first damaged one (the journal was being written when we crashed)
+static void ParseJournal(const std::string& journal, std::vector<ReplayDocument>* docs, std::vector<uint32_t>* ids)
+{
+    if (journal.size() < sizeof(JOURNAL_MAGIC) || memcmp(journal.data(), JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0)
+        return;
+    JournalReader file(journal.data() + sizeof(JOURNAL_MAGIC), journal.data() + journal.size());
+    for (;;)
+    {
+        const uint32_t size = file.U32();
+        const uint32_t checksum = file.U32();
+        const char* payload = file.Bytes(size);
+        if (!file.Ok || Checksum(payload, size) != checksum)
+            break;
+
+        JournalReader r(payload, payload + size);
+        const JournalRecordType type = (JournalRecordType)r.U8();
+        const uint32_t id = r.U32();
+        ReplayDocument* doc = NULL;
+        for (size_t n = 0; n < ids->size() && doc == NULL; n++)
+            if ((*ids)[n] == id)
+                doc = &(*docs)[n];
+        if (type == JournalRecordType_Open)
+        {
+            ReplayDocument new_doc;
+            new_doc.Name = r.String();
+            new_doc.Path = r.String();
+            new_doc.Stamp.Size = r.U64();
+            new_doc.Stamp.MTime = (int64_t)r.U64();
+            new_doc.EditCount = 0;
+            new_doc.Closed = false;
+            if (r.Ok && doc == NULL)
+            {
+                docs->push_back(new_doc);
+                ids->push_back(id);
+            }
+            continue;
+        }
+        if (doc == NULL || doc->Closed)
+            continue;
+        if (type == JournalRecordType_Insert || type == JournalRecordType_Erase)
+        {
+            ReplayEdit edit;
+            edit.Index = doc->EditCount++;
+            edit.Insert = type == JournalRecordType_Insert;
+            edit.Pos = r.U64();
+            edit.Len = r.U64();
+            edit.Data = edit.Insert ? r.Bytes(edit.Len) : NULL;
+            if (r.Ok)
+                doc->Edits.push_back(edit);
+        }
+        else if (type == JournalRecordType_Saved)
+        {
+            const uint64_t saved_count = r.U64();
+            std::string path = r.String();
+            FileStamp stamp;
+            stamp.Size = r.U64();
+            stamp.MTime = (int64_t)r.U64();
+            if (!r.Ok)
+                continue;
+            doc->Path = path;
+            doc->Stamp = stamp;
+            if (doc->EditCount < saved_count)
+                doc->EditCount = saved_count; // A compacted journal: the saved edits were dropped
+            size_t keep = 0;
+            while (keep < doc->Edits.size() && doc->Edits[keep].Index < saved_count)
+                keep++;
+            doc->Edits.erase(doc->Edits.begin(), doc->Edits.begin() + (ptrdiff_t)keep);
+        }
+        else if (type == JournalRecordType_Close)
+        {
+            doc->Closed = true;
+            doc->Edits.clear();
+        }
+    }
+}
+
+// Rebuild the text of a document: its file plus the edits. Returns false if the file isn't the one the edits apply to.
+static bool RecoverDocument(const ReplayDocument& doc, PieceTable* out)
+{
+    if (!doc.Path.empty())
+    {
+        FileStamp stamp;
+        if (!GetFileStamp(doc.Path.c_str(), &stamp) || stamp != doc.Stamp || !LoadFile(doc.Path.c_str(), out))
+            return false;
+    }
+    for (size_t n = 0; n < doc.Edits.size(); n++)
+    {
+        const ReplayEdit& edit = doc.Edits[n];
+        if (edit.Pos > out->Size() || (!edit.Insert && edit.Len > out->Size() - edit.Pos))
+            return false;
+        if (edit.Insert)
+            out->Insert((size_t)edit.Pos, edit.Data, (size_t)edit.Len);
+        else
+            out->Erase((size_t)edit.Pos, (size_t)edit.Len);
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// JournalDocument
+//-----------------------------------------------------------------------------
+
+void JournalDocument::Saved(uint64_t edit_count, const std::string& path, const FileStamp& stamp)
+{
+    if (Owner == NULL)
+        return;
+    std::string record;
+    EncodeSaved(&record, Id, edit_count, path, stamp);
+    Owner->Append(record, true);
+}
+
+void JournalDocument::Discard()
+{
+    if (Owner == NULL)
+        return;
+    std::string record;
+    EndRecord(&record, BeginRecord(&record, JournalRecordType_Close, Id));
+    Owner->Append(record);
+    Owner = NULL;
+}
+
+void JournalDocument::OnInsertBlocks(const std::vector<std::shared_ptr<char>>& blocks)
+{
+    // Blocks are only ever added until the table is cleared, and the ones we hold can't be reallocated at the same
+    // address: the list only has to be copied again when its size or its last block changed
+    if (Owner == NULL)
+        return;
+    if (!Blocks || Blocks->size() != blocks.size() || (!blocks.empty() && Blocks->back() != blocks.back()))
+        Blocks = std::make_shared<const std::vector<std::shared_ptr<char>>>(blocks);
+}
+
+void JournalDocument::OnInsert(size_t pos, const PieceTableSpan* spans, size_t count)
+{
+    Edits++;
+    if (Owner == NULL)
+        return;
+    Owner->AppendInsert(Id, pos, spans, count, Blocks);
+}
+
+void JournalDocument::OnErase(size_t pos, size_t len)
+{
+    Edits++;
+    if (Owner == NULL)
+        return;
+    std::string record;
+    EncodeErase(&record, Id, pos, len);
+    Owner->Append(record);
+}
+
+//-----------------------------------------------------------------------------
+// Journal
+//-----------------------------------------------------------------------------
+
+Journal::Journal()
+{
+    Fd = -1;
+    NextId = 1;
+    Stop = false;
+}
+
+Journal::~Journal()
+{
+    Close();
+}
+
+bool Journal::Open(const char* filename, std::vector<JournalRecoveredDocument>* out_recovered)
+{
+    Close();
+    Filename = filename;
+
+    std::string old_journal;
+    std::vector<ReplayDocument> docs;
+    std::vector<uint32_t> ids;
+    if (ReadWholeFile(filename, &old_journal))
+        ParseJournal(old_journal, &docs, &ids);
+
+    // The new journal only holds the recovered documents, as they were opened plus their unsaved edits
+    std::string journal(JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    bool keep_old = false;
+    for (size_t n = 0; n < docs.size(); n++)
+    {
+        const ReplayDocument& doc = docs[n];
+        if (doc.Closed || doc.Edits.empty())
+            continue;
+        JournalRecoveredDocument recovered;
+        if (!RecoverDocument(doc, &recovered.Text))
+        {
+            fprintf(stderr, "Can't recover the unsaved changes to %s: the file changed since\n", doc.Path.c_str());
+            keep_old = true;
+            continue;
+        }
+        const uint32_t id = NextId++;
+        EncodeOpen(&journal, id, doc.Name, doc.Path, doc.Stamp);
+        for (size_t e = 0; e < doc.Edits.size(); e++)
+        {
+            const ReplayEdit& edit = doc.Edits[e];
+            if (edit.Insert)
+            {
+                PieceTableSpan span = { edit.Data, (size_t)edit.Len };
+                EncodeInsert(&journal, id, (size_t)edit.Pos, &span, 1);
+            }
+            else
+            {
+                EncodeErase(&journal, id, (size_t)edit.Pos, (size_t)edit.Len);
+            }
+        }
+        recovered.Name = doc.Name;
+        recovered.DiskPath = doc.Path;
+        recovered.DiskStamp = doc.Stamp;
+        recovered.Journal.reset(new JournalDocument(this, id, doc.Edits.size()));
+        recovered.Text.AddListener(recovered.Journal.get());
+        out_recovered->push_back(std::move(recovered));
+    }
+    if (keep_old)
+        FileReplace(filename, (Filename + ".old").c_str());
+
+    // Replace the journal atomically, a crash now must not lose what we just recovered
+    const std::string temp_filename = Filename + ".tmp";
+    int fd = FileCreate(temp_filename.c_str(), 0600);
+    bool ok = fd >= 0 && WriteAll(fd, journal.data(), journal.size()) && FileSync(fd);
+    if (fd >= 0)
+        FileClose(fd);
+    ok = ok && FileReplace(temp_filename.c_str(), filename);
+    if (ok)
+        Fd = FileOpenAppend(filename);
+    if (Fd < 0)
+    {
+        remove(temp_filename.c_str());
+        return false;
+    }
+    Stop = false;
+    Thread = std::thread(&Journal::Run, this);
+    return true;
+}
+
+void Journal::Close()
+{
+    if (Thread.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            Stop = true;
+        }
+        Wakeup.notify_one();
+        Thread.join();
+    }
+    if (Fd >= 0)
+        FileClose(Fd);
+    Fd = -1;
+}
+
+std::unique_ptr<JournalDocument> Journal::Track(const std::string& name, const std::string& disk_path, const FileStamp& disk_stamp, PieceTable* text)
+{
+    const uint32_t id = NextId++;
+    std::string record;
+    EncodeOpen(&record, id, name, disk_path, disk_stamp);
+    Append(record);
+    std::unique_ptr<JournalDocument> doc(new JournalDocument(this, id, 0));
+    text->AddListener(doc.get());
+    return doc;
+}
+
+void Journal::Append(const std::string& record, bool saved)
+{
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        if (!Thread.joinable())
+            return;
+        Pending.push_back(QueuedRecord());
+        Pending.back().Encoded = record;
+        Pending.back().Saved = saved;
+    }
+    Wakeup.notify_one();
+}
+
+void Journal::AppendInsert(uint32_t id, size_t pos, const PieceTableSpan* spans, size_t count, const JournalBlockList& blocks)
+{
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        if (!Thread.joinable())
+            return;
+        Pending.push_back(QueuedRecord());
+        QueuedRecord& record = Pending.back();
+        record.Saved = false;
+        record.Id = id;
+        record.Pos = pos;
+        record.Spans.assign(spans, spans + count);
+        record.Blocks = blocks;
+    }
+    Wakeup.notify_one();
+}
+
+bool Journal::Compact()
+{
+    // Same as what Open() keeps, for the documents still open, with their ids: Saved records from now on refer to them
+    std::string journal;
+    if (!ReadWholeFile(Filename.c_str(), &journal))
+        return false;
+    std::vector<ReplayDocument> docs;
+    std::vector<uint32_t> ids;
+    ParseJournal(journal, &docs, &ids);
+    std::string compacted(JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    for (size_t n = 0; n < docs.size(); n++)
+    {
+        const ReplayDocument& doc = docs[n];
+        if (doc.Closed)
+            continue;
+        EncodeOpen(&compacted, ids[n], doc.Name, doc.Path, doc.Stamp);
+        EncodeSaved(&compacted, ids[n], doc.Edits.empty() ? doc.EditCount : doc.Edits[0].Index, doc.Path, doc.Stamp);
+        for (size_t e = 0; e < doc.Edits.size(); e++)
+        {
+            const ReplayEdit& edit = doc.Edits[e];
+            if (edit.Insert)
+            {
+                PieceTableSpan span = { edit.Data, (size_t)edit.Len };
+                EncodeInsert(&compacted, ids[n], (size_t)edit.Pos, &span, 1);
+            }
+            else
+            {
+                EncodeErase(&compacted, ids[n], (size_t)edit.Pos, (size_t)edit.Len);
+            }
+        }
+    }
+
+    const std::string temp_filename = Filename + ".tmp";
+    int fd = FileCreate(temp_filename.c_str(), 0600);
+    bool ok = fd >= 0 && WriteAll(fd, compacted.data(), compacted.size()) && FileSync(fd);
+    if (fd >= 0)
+        FileClose(fd);
+    ok = ok && FileReplace(temp_filename.c_str(), Filename.c_str());
+    const int new_fd = ok ? FileOpenAppend(Filename.c_str()) : -1;
+    if (new_fd < 0)
+    {
+        remove(temp_filename.c_str());
+        return false; // The old journal is still complete, keep appending to it
+    }
+    FileClose(Fd);
+    Fd = new_fd;
+    return true;
+}
+
+void Journal::Run()
+{
+    bool reported_error = false;
+    FileStamp stamp;
+    size_t compacted_size = GetFileStamp(Fd, &stamp) ? (size_t)stamp.Size : 0;
+    std::unique_lock<std::mutex> lock(Mutex);
+    for (;;)
+    {
+        while (!Stop && Pending.empty())
+            Wakeup.wait(lock);
+        if (Pending.empty())
+            return; // Stopping, and everything has been written
+
+        // Let the records of the next keystrokes come in so that they are written and flushed together
+        const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(JOURNAL_SYNC_INTERVAL_MS);
+        while (!Stop && Wakeup.wait_until(lock, deadline) != std::cv_status::timeout)
+            continue;
+        std::vector<QueuedRecord> writing;
+        writing.swap(Pending);
+        lock.unlock();
+
+        std::string buffer;
+        bool ok = true;
+        bool saved = false;
+        for (size_t n = 0; n < writing.size() && ok; n++)
+        {
+            const QueuedRecord& record = writing[n];
+            if (record.Encoded.empty())
+                ok = WriteInsert(Fd, &buffer, record.Id, record.Pos, record.Spans.data(), record.Spans.size());
+            else
+                buffer += record.Encoded;
+            saved |= record.Saved;
+        }
+        ok = ok && WriteAll(Fd, buffer.data(), buffer.size()) && FileSync(Fd);
+        if (!ok && !reported_error)
+        {
+            fprintf(stderr, "Can't write %s: %s\n", Filename.c_str(), strerror(errno));
+            reported_error = true;
+        }
+        writing.clear(); // Let go of the blocks before waiting
+
+        // A save made the records of the edits it wrote useless: drop them once there are enough of them
+        if (ok && saved && GetFileStamp(Fd, &stamp) && stamp.Size >= JOURNAL_COMPACT_MIN_SIZE && stamp.Size >= 2 * (uint64_t)compacted_size)
+            if (Compact() && GetFileStamp(Fd, &stamp))
+                compacted_size = (size_t)stamp.Size;
+        lock.lock();
+    }
+}
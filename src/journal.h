@@ -0,0 +1,112 @@
+// Crash recovery journal.
+// The edits made to the editor tabs are appended to a journal file by a worker thread, which flushes it to disk at
+// most every JOURNAL_SYNC_INTERVAL_MS. Only the edits are written (insert: position + bytes, erase: position +
+// length) and never the whole text, so a huge file costs no more to journal than a small one. The UI thread only
+// queues the edits: an insert is queued as its spans, with a reference to the blocks holding them, and the worker
+// copies the bytes when it writes the record, so a big paste or undo costs the frame no more than a keystroke.
+// When the journal is opened at startup, it is replayed: the tabs that had edits not saved yet when irohDE exited or
+// crashed are rebuilt from their file (checked against the size/mtime it had) plus those edits, and handed back to be
+// shown again. The journal is then rewritten with only what is needed to recover these tabs. The worker rewrites it
+// the same way after a save, once it has grown enough for the records the save made useless to matter.
+
+#pragma once
+
+#include "piece_table.h"
+#include "file_io.h"
+#include <stdint.h>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Journal;
+
+// Shared copy of the block list of a PieceTable (see PieceTableListener::OnInsertBlocks())
+typedef std::shared_ptr<const std::vector<std::shared_ptr<char>>> JournalBlockList;
+
+// Journals the edits of one document: set as the listener of its PieceTable (done by Journal::Track()).
+class JournalDocument : public PieceTableListener
+{
+public:
+    uint64_t    EditCount() const                   { return Edits; }
+
+    // The text as it was after the first 'edit_count' edits was saved to 'path', which now has 'stamp':
+    // those edits won't be replayed any more.
+    void        Saved(uint64_t edit_count, const std::string& path, const FileStamp& stamp);
+    void        Discard();                          // The tab is closed: nothing to recover
+
+    virtual void OnInsert(size_t pos, const PieceTableSpan* spans, size_t count);
+    virtual void OnErase(size_t pos, size_t len);
+    virtual void OnInsertBlocks(const std::vector<std::shared_ptr<char>>& blocks);
+
+private:
+    friend class Journal;
+    JournalDocument(Journal* owner, uint32_t id, uint64_t edits) { Owner = owner; Id = id; Edits = edits; }
+
+    Journal*    Owner;
+    uint32_t    Id;
+    uint64_t    Edits;
+    JournalBlockList Blocks;    // The table's blocks, shared with the queued inserts
+};
+
+struct JournalRecoveredDocument
+{
+    std::string                         Name;       // Tab name
+    std::string                         DiskPath;   // File the edits apply to, empty for a new file
+    FileStamp                           DiskStamp;
+    PieceTable                          Text;       // The file with the edits applied. Already journaled:
+    std::unique_ptr<JournalDocument>    Journal;    // keep this alive as long as 'Text'.
+};
+
+class Journal
+{
+public:
+    Journal();
+    ~Journal();                                     // Close()
+
+    // Replay 'filename' if it exists, then start a new journal there. Tabs with unsaved edits are added to
+    // 'out_recovered'. Files that changed since can't be recovered: they are reported on stderr and the old journal
+    // is kept as "<filename>.old".
+    // Returns false if the journal can't be written, Track() still works then but records nothing.
+    bool        Open(const char* filename, std::vector<JournalRecoveredDocument>* out_recovered);
+    void        Close();                            // Writes and flushes what is pending
+
+    // Start journaling the edits of 'text', which is the contents of 'disk_path' with stamp 'disk_stamp' (empty
+    // 'disk_path': a new, empty file). 'name' is what the tab is called, to show it again if it gets recovered.
+    std::unique_ptr<JournalDocument> Track(const std::string& name, const std::string& disk_path, const FileStamp& disk_stamp, PieceTable* text);
+
+private:
+    friend class JournalDocument;
+
+    // A record waiting for the worker: encoded already, or an insert, which the worker encodes from its spans
+    struct QueuedRecord
+    {
+        std::string                 Encoded;        // Empty for an insert
+        bool                        Saved;          // Encoded is a "saved" record
+        uint32_t                    Id;
+        size_t                      Pos;
+        std::vector<PieceTableSpan> Spans;
+        JournalBlockList            Blocks;         // Keeps the spans valid
+
+        QueuedRecord()              { Saved = false; Id = 0; Pos = 0; }
+    };
+
+    std::string                 Filename;
+    int                         Fd;                 // Only used by the worker while it runs
+    uint32_t                    NextId;
+    std::thread                 Thread;
+    std::mutex                  Mutex;
+    std::condition_variable     Wakeup;
+    std::vector<QueuedRecord>   Pending;            // Not written yet. Protected by Mutex, as is Stop.
+    bool                        Stop;
+
+    void        Append(const std::string& record, bool saved = false);
+    void        AppendInsert(uint32_t id, size_t pos, const PieceTableSpan* spans, size_t count, const JournalBlockList& blocks);
+    bool        Compact();
+    void        Run();
+
+    Journal(const Journal&);
+    Journal& operator=(const Journal&);
+};
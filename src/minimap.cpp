@@ -0,0 +1,118 @@
+// Pixels of the minimap (see minimap.h)
+
+#include "minimap.h"
+#include "cpp_highlighter.h"
+#include "text_editor.h"
+#include <string.h>
+
+const int Minimap::Width;
+const int Minimap::Rows;
+const int Minimap::TabColumns;
+
+Minimap::Minimap()
+{
+    TextureId = 0;
+    RowPixels.resize((size_t)Rows * Width);
+    RowLine.assign(Rows, (size_t)-1);
+    RowColored.assign(Rows, false);
+    RowState.assign(Rows, 0);
+    TextVersion = 0;
+    ReportedEdits = 0;
+}
+
+void Minimap::Update(const PieceTable& text, CppHighlighter* highlighter, size_t first_line, size_t line_count, ImU32 text_col)
+{
+    Bands.clear();
+    if (text.Version() != TextVersion + ReportedEdits)
+        RowLine.assign(Rows, (size_t)-1);
+    TextVersion = text.Version();
+    ReportedEdits = 0;
+
+    const size_t end_line = first_line + (line_count < (size_t)Rows ? line_count : (size_t)Rows);
+    for (size_t line = first_line; line < end_line && line < text.LineCount(); line++)
+    {
+        const int row = (int)(line & (Rows - 1));
+        const bool colored = highlighter != NULL && line < highlighter->KnownLines();
+        const uint32_t state = colored ? highlighter->LineState(line) : 0;
+        if (RowLine[row] == line && RowColored[row] == colored && RowState[row] == state)
+            continue;
+
+        // Only the bytes that can be shown: Width columns are at most Width bytes of characters (and tabs)
+        const size_t line_start = text.LineStart(line);
+        size_t len = text.FindChar('\n', line_start) - line_start;
+        if (len > (size_t)Width * 4)
+            len = (size_t)Width * 4;
+        LineText.resize(len);
+        if (len > 0)
+            text.Copy(line_start, len, &LineText[0]);
+        DrawRow(&RowPixels[(size_t)row * Width], LineText.data(), len, colored ? highlighter : NULL, line, text_col);
+        RowLine[row] = line;
+        RowColored[row] = colored;
+        RowState[row] = state;
+        if (!Bands.empty() && Bands.back().FirstRow + Bands.back().RowCount == row)
+        {
+            Bands.back().RowCount++;
+        }
+        else
+        {
+            Band band = { row, 1 };
+            Bands.push_back(band);
+        }
+    }
+}
+
+void Minimap::DrawRow(uint32_t* pixels, const char* line, size_t len, CppHighlighter* highlighter, size_t line_no, ImU32 text_col)
+{
+    std::vector<CppHighlighter::Run>& runs = Runs;
+    runs.clear();
+    if (highlighter != NULL)
+        highlighter->GetRuns(line_no, line, line + len, &runs);
+
+    // Characters are drawn dimmer than the text, spaces are transparent
+    memset(pixels, 0, Width * sizeof(uint32_t));
+    int column = 0;
+    size_t run = 0;
+    size_t run_end = runs.empty() ? len : runs[0].Len;
+    ImU32 col = runs.empty() ? text_col : TextEditorTokenColor(runs[0].Token, text_col);
+    for (size_t n = 0; n < len && column < Width; n++)
+    {
+        while (n >= run_end && run + 1 < runs.size())
+        {
+            run++;
+            run_end += runs[run].Len;
+            col = TextEditorTokenColor(runs[run].Token, text_col);
+        }
+        const char c = line[n];
+        if (c == '\t')
+            column = (column / TabColumns + 1) * TabColumns;
+        else if (((unsigned char)c & 0xC0) == 0x80)     // UTF-8 continuation byte, same column
+            continue;
+        else if (c == ' ' || c == '\r')
+            column++;
+        else
+            pixels[column++] = (col & ~IM_COL32_A_MASK) | ((((col >> IM_COL32_A_SHIFT) & 0xFF) * 3 / 5) << IM_COL32_A_SHIFT);
+    }
+}
+
+void Minimap::OnInsert(size_t pos, const PieceTableSpan* spans, size_t count)
+{
+    (void)pos;
+    (void)spans;
+    (void)count;
+}
+
+void Minimap::OnErase(size_t pos, size_t len)
+{
+    (void)pos;
+    (void)len;
+}
+
+void Minimap::OnEditLines(size_t line, size_t removed_lines, size_t inserted_lines)
+{
+    // The edited lines change, and the lines after them move if the edit adds or removes some
+    ReportedEdits++;
+    const size_t end = removed_lines == inserted_lines ? line + removed_lines : (size_t)-1;
+    for (int row = 0; row < Rows; row++)
+        if (RowLine[row] != (size_t)-1 && RowLine[row] >= line && RowLine[row] <= end)
+            RowLine[row] = (size_t)-1;
+}
@@ -0,0 +1,64 @@
+// Pixels of the minimap drawn next to an editor tab.
+// Each line is one row of texels, a texel per column (tabs expand to TabColumns), colored like its token. Rows live in
+// a ring of Rows rows: line n is row n % Rows, so the window of lines shown by the minimap can scroll through a file
+// of any length and only the lines entering it are drawn. The caller keeps the texture (GL_REPEAT vertically, so a
+// window wrapping around the ring is still drawn as one quad) and uploads only the bands of rows drawn by the last
+// Update(). Rows are drawn again only when their line is edited, moves (lines inserted or removed before it), or
+// is colored differently (the highlighter reached it, or its lexer state changed: a comment opened above it...).
+// The minimap listens to the edits of its PieceTable. Loading the text (not reported) redraws every row.
+
+#pragma once
+
+#include "imgui.h"
+#include "piece_table.h"
+#include "cpp_highlighter.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class Minimap : public PieceTableListener
+{
+public:
+    static const int    Width = 128;            // Texels per row: the columns shown
+    static const int    Rows = 1024;            // Rows in the ring, a power of two. The most lines shown at once.
+    static const int    TabColumns = 4;
+
+    // A range of rows of the ring drawn by Update(), to upload to the texture
+    struct Band
+    {
+        int         FirstRow;
+        int         RowCount;
+    };
+
+    unsigned    TextureId;                      // Owned by the caller, 0 until it creates it
+
+    Minimap();
+
+    // Draw the rows of lines [first_line, first_line + line_count) that aren't up to date. 'highlighter' may be NULL.
+    // At most Rows lines.
+    void        Update(const PieceTable& text, CppHighlighter* highlighter, size_t first_line, size_t line_count, ImU32 text_col);
+
+    const uint32_t*             Pixels() const  { return &RowPixels[0]; }   // Rows * Width RGBA texels
+    const std::vector<Band>&    DirtyBands() const  { return Bands; }       // Drawn by the last Update()
+
+    virtual void OnInsert(size_t pos, const PieceTableSpan* spans, size_t count);
+    virtual void OnErase(size_t pos, size_t len);
+    virtual void OnEditLines(size_t line, size_t removed_lines, size_t inserted_lines);
+
+private:
+    std::vector<uint32_t>       RowPixels;
+    std::vector<size_t>         RowLine;        // Line drawn in each row, (size_t)-1 if it must be drawn again
+    std::vector<bool>           RowColored;     // Drawn with the colors of the highlighter...
+    std::vector<uint32_t>       RowState;       // ...for this CppHighlighter::LineState()
+    std::vector<Band>           Bands;
+    std::string                 LineText;       // Scratch buffers of DrawRow()
+    std::vector<CppHighlighter::Run> Runs;
+    unsigned                    TextVersion;    // PieceTable::Version() at the last Update()...
+    unsigned                    ReportedEdits;  // ...and the edits reported since, each bumps it once
+
+    void        DrawRow(uint32_t* pixels, const char* line, size_t len, CppHighlighter* highlighter, size_t line_no, ImU32 text_col);
+
+    Minimap(const Minimap&);
+    Minimap& operator=(const Minimap&);
+};
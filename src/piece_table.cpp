@@ -0,0 +1,654 @@
+// Piece table (see piece_table.h)
+
+#include "piece_table.h"
+#include <string.h>
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+// Add buffer is allocated in blocks of this size. Inserts larger than a block get a block of their own.
+static const size_t ADD_BLOCK_SIZE = 64 * 1024;
+
+// Loaded files and big inserts are cut into pieces of at most this size, cutting a piece has to recount the newlines of one side.
+static const size_t MAX_PIECE_SIZE = 64 * 1024;
+
+static size_t CountNewlines(const char* data, size_t len)
+{
+    size_t count = 0;
+    const char* data_end = data + len;
+    while (data < data_end)
+    {
+        const char* p = (const char*)memchr(data, '\n', (size_t)(data_end - data));
+        if (p == NULL)
+            break;
+        count++;
+        data = p + 1;
+    }
+    return count;
+}
+
+bool PieceTable::FileRangeLess(const FileRange& a, const FileRange& b)
+{
+    return std::less<const char*>()(a.Data, b.Data);
+}
+
+PieceTable::PieceTable()
+{
+    Root = -1;
+    AddBlock = NULL;
+    AddBlockUsed = AddBlockCapacity = 0;
+    RandState = 0x9E3779B9u;
+    EditVersion = 0;
+}
+
+PieceTable::PieceTable(PieceTable&& other)
+{
+    *this = std::move(other);
+}
+
+PieceTable& PieceTable::operator=(PieceTable&& other)
+{
+    Nodes = std::move(other.Nodes);
+    FreeNodes = std::move(other.FreeNodes);
+    Blocks = std::move(other.Blocks);
+    FileRanges = std::move(other.FileRanges);
+    Root = other.Root;
+    AddBlock = other.AddBlock;
+    AddBlockUsed = other.AddBlockUsed;
+    AddBlockCapacity = other.AddBlockCapacity;
+    Listeners = std::move(other.Listeners);
+    RandState = other.RandState;
+    EditVersion = other.EditVersion + 1;
+    other.Nodes.clear();
+    other.FreeNodes.clear();
+    other.Blocks.clear();
+    other.FileRanges.clear();
+    other.Root = -1;
+    other.AddBlock = NULL;
+    other.AddBlockUsed = other.AddBlockCapacity = 0;
+    other.Listeners.clear();
+    other.EditVersion++;
+    return *this;
+}
+
+void PieceTable::Load(std::unique_ptr<char[]> data, size_t size)
+{
+    Clear();
+    if (size == 0)
+        return;
+    const char* p = AdoptBlock(std::move(data));
+    Root = NewTree(p, size);
+    FileRange range = { p, size, 0 };
+    FileRanges.push_back(range);
+}
+
+void PieceTable::Load(const char* text, size_t size)
+{
+    std::unique_ptr<char[]> data(new char[size > 0 ? size : 1]);
+    if (size > 0)
+        memcpy(data.get(), text, size);
+    Load(std::move(data), size);
+}
+
+void PieceTable::Append(std::unique_ptr<char[]> data, size_t size)
+{
+    if (size == 0)
+        return;
+    const char* p = AdoptBlock(std::move(data));
+    FileRange range = { p, size, Size() };
+    Root = Merge(Root, NewTree(p, size));
+    EditVersion++;
+    FileRanges.insert(std::upper_bound(FileRanges.begin(), FileRanges.end(), range, FileRangeLess), range);
+}
+
+void PieceTable::Clear()
+{
+    Nodes.clear();
+    FreeNodes.clear();
+    Blocks.clear();
+    FileRanges.clear();
+    Root = -1;
+    AddBlock = NULL;
+    AddBlockUsed = AddBlockCapacity = 0;
+    EditVersion++;
+}
+
+int PieceTable::NewNode(const char* data, size_t len, size_t lines)
+{
+    // xorshift32 for treap priorities
+    RandState ^= RandState << 13;
+    RandState ^= RandState >> 17;
+    RandState ^= RandState << 5;
+
+    Node node;
+    node.Data = data;
+    node.Len = node.SubLen = len;
+    node.Lines = node.SubLines = lines;
+    node.Left = node.Right = -1;
+    node.Priority = RandState;
+    if (!FreeNodes.empty())
+    {
+        int n = FreeNodes.back();
+        FreeNodes.pop_back();
+        Nodes[n] = node;
+        return n;
+    }
+    Nodes.push_back(node);
+    return (int)Nodes.size() - 1;
+}
+
+// Build a subtree for a run of text, cut into pieces of at most MAX_PIECE_SIZE bytes
+int PieceTable::NewTree(const char* data, size_t len)
+{
+    int root = -1;
+    for (size_t offset = 0; offset < len; offset += MAX_PIECE_SIZE)
+    {
+        const size_t piece_len = len - offset < MAX_PIECE_SIZE ? len - offset : MAX_PIECE_SIZE;
+        root = Merge(root, NewNode(data + offset, piece_len, CountNewlines(data + offset, piece_len)));
+    }
+    return root;
+}
+
+void PieceTable::Update(int n)
+{
+    Node& node = Nodes[n];
+    node.SubLen = node.Len;
+    node.SubLines = node.Lines;
+    if (node.Left >= 0)
+    {
+        node.SubLen += Nodes[node.Left].SubLen;
+        node.SubLines += Nodes[node.Left].SubLines;
+    }
+    if (node.Right >= 0)
+    {
+        node.SubLen += Nodes[node.Right].SubLen;
+        node.SubLines += Nodes[node.Right].SubLines;
+    }
+}
+
+void PieceTable::FreeNode(int n)
+{
+    FreeNodes.push_back(n);
+}
+
+void PieceTable::FreeTree(int n)
+{
+    if (n < 0)
+        return;
+    FreeTree(Nodes[n].Left);
+    FreeTree(Nodes[n].Right);
+    FreeNode(n);
+}
+
+// Split subtree 'n' so that 'out_left' holds the first 'pos' bytes. A piece straddling 'pos' is cut in two.
+void PieceTable::Split(int n, size_t pos, int* out_left, int* out_right)
+{
+    if (n < 0)
+    {
+        *out_left = *out_right = -1;
+        return;
+    }
+    const size_t left_len = Nodes[n].Left >= 0 ? Nodes[Nodes[n].Left].SubLen : 0;
+    if (pos <= left_len)
+    {
+        int l, r;
+        Split(Nodes[n].Left, pos, &l, &r);
+        Nodes[n].Left = r;
+        Update(n);
+        *out_left = l;
+        *out_right = n;
+    }
+    else if (pos >= left_len + Nodes[n].Len)
+    {
+        int l, r;
+        Split(Nodes[n].Right, pos - left_len - Nodes[n].Len, &l, &r);
+        Nodes[n].Right = l;
+        Update(n);
+        *out_left = n;
+        *out_right = r;
+    }
+    else
+    {
+        // Cut the piece. The tail inherits the priority so the heap property still holds for the old right subtree.
+        // Only the newlines of the shorter side are counted.
+        const size_t offset = pos - left_len;
+        const size_t tail_len = Nodes[n].Len - offset;
+        const size_t tail_lines = offset < tail_len ? Nodes[n].Lines - CountNewlines(Nodes[n].Data, offset) : CountNewlines(Nodes[n].Data + offset, tail_len);
+        int tail = NewNode(Nodes[n].Data + offset, tail_len, tail_lines);
+        Nodes[tail].Priority = Nodes[n].Priority;
+        Nodes[tail].Right = Nodes[n].Right;
+        Nodes[n].Right = -1;
+        Nodes[n].Len = offset;
+        Nodes[n].Lines -= tail_lines;
+        Update(tail);
+        Update(n);
+        *out_left = n;
+        *out_right = tail;
+    }
+}
+
+int PieceTable::Merge(int left, int right)
+{
+    if (left < 0)
+        return right;
+    if (right < 0)
+        return left;
+    if (Nodes[left].Priority > Nodes[right].Priority)
+    {
+        int r = Merge(Nodes[left].Right, right);
+        Nodes[left].Right = r;
+        Update(left);
+        return left;
+    }
+    int l = Merge(left, Nodes[right].Left);
+    Nodes[right].Left = l;
+    Update(right);
+    return right;
+}
+
+int PieceTable::FindNode(size_t pos, size_t* out_node_start) const
+{
+    int n = Root;
+    size_t base = 0;
+    while (n >= 0)
+    {
+        const Node& node = Nodes[n];
+        const size_t left_len = node.Left >= 0 ? Nodes[node.Left].SubLen : 0;
+        if (pos < left_len)
+        {
+            n = node.Left;
+        }
+        else if (pos < left_len + node.Len)
+        {
+            *out_node_start = base + left_len;
+            return n;
+        }
+        else
+        {
+            base += left_len + node.Len;
+            pos -= left_len + node.Len;
+            n = node.Right;
+        }
+    }
+    return -1;
+}
+
+char* PieceTable::AdoptBlock(std::unique_ptr<char[]> data)
+{
+    // shared_ptr so that snapshots can keep blocks alive after the table dropped them
+    Blocks.push_back(std::shared_ptr<char>(data.release(), std::default_delete<char[]>()));
+    return Blocks.back().get();
+}
+
+const char* PieceTable::AppendToAddBuffer(const char* text, size_t len)
+{
+    if (AddBlock == NULL || AddBlockCapacity - AddBlockUsed < len)
+    {
+        if (len >= ADD_BLOCK_SIZE / 2)
+        {
+            // Big insert (paste): give it its own block and keep appending typed text to the current one.
+            std::unique_ptr<char[]> block(new char[len]);
+            memcpy(block.get(), text, len);
+            return AdoptBlock(std::move(block));
+        }
+        AddBlock = AdoptBlock(std::unique_ptr<char[]>(new char[ADD_BLOCK_SIZE]));
+        AddBlockUsed = 0;
+        AddBlockCapacity = ADD_BLOCK_SIZE;
+    }
+    char* dst = AddBlock + AddBlockUsed;
+    memcpy(dst, text, len);
+    AddBlockUsed += len;
+    return dst;
+}
+
+void PieceTable::Insert(size_t pos, const char* text, size_t len)
+{
+    if (len == 0)
+        return;
+    if (pos > Size())
+        pos = Size();
+    const char* data = AppendToAddBuffer(text, len);
+    EditVersion++;
+    if (!Listeners.empty())
+    {
+        PieceTableSpan span = { data, len };
+        NotifyInsert(pos, &span, 1, CountNewlines(data, len));
+    }
+
+    int left, right;
+    Split(Root, pos, &left, &right);
+
+    // Typing usually appends to the piece we created on the previous keystroke: extend it in place instead of adding a node.
+    if (left >= 0)
+    {
+        int n = left;
+        while (Nodes[n].Right >= 0)
+            n = Nodes[n].Right;
+        if (Nodes[n].Data + Nodes[n].Len == data && Nodes[n].Len + len <= MAX_PIECE_SIZE)
+        {
+            const size_t lines = CountNewlines(data, len);
+            Nodes[n].Len += len;
+            Nodes[n].Lines += lines;
+            for (int s = left; s >= 0; s = Nodes[s].Right)
+            {
+                Nodes[s].SubLen += len;
+                Nodes[s].SubLines += lines;
+            }
+            Root = Merge(left, right);
+            return;
+        }
+    }
+    Root = Merge(Merge(left, NewTree(data, len)), right);
+}
+
+void PieceTable::Erase(size_t pos, size_t len)
+{
+    const size_t size = Size();
+    if (pos >= size || len == 0)
+        return;
+    if (len > size - pos)
+        len = size - pos;
+    EditVersion++;
+    if (!Listeners.empty())
+    {
+        const size_t line = LineFromPos(pos);
+        const size_t removed_lines = LineFromPos(pos + len) - line;
+        for (size_t n = 0; n < Listeners.size(); n++)
+        {
+            Listeners[n]->OnErase(pos, len);
+            Listeners[n]->OnEditLines(line, removed_lines, 0);
+        }
+    }
+
+    int left, mid, right;
+    Split(Root, pos, &left, &mid);
+    Split(mid, len, &mid, &right);
+    FreeTree(mid);
+    Root = Merge(left, right);
+}
+
+void PieceTable::GetSpans(size_t pos, size_t len, std::vector<PieceTableSpan>* out) const
+{
+    while (len > 0)
+    {
+        PieceTableSpan span;
+        if (!GetSpan(pos, &span.Data, &span.Len))
+            break;
+        if (span.Len > len)
+            span.Len = len;
+        out->push_back(span);
+        pos += span.Len;
+        len -= span.Len;
+    }
+}
+
+void PieceTable::InsertSpans(size_t pos, const PieceTableSpan* spans, size_t count)
+{
+    int tree = -1;
+    for (size_t n = 0; n < count; n++)
+        tree = Merge(tree, NewTree(spans[n].Data, spans[n].Len));
+    if (tree < 0)
+        return;
+    if (pos > Size())
+        pos = Size();
+    EditVersion++;
+    if (!Listeners.empty())
+        NotifyInsert(pos, spans, count, Nodes[tree].SubLines);
+
+    int left, right;
+    Split(Root, pos, &left, &right);
+    Root = Merge(Merge(left, tree), right);
+}
+
+void PieceTable::InsertBlock(size_t pos, std::unique_ptr<char[]> data, size_t len)
+{
+    if (len == 0)
+        return;
+    PieceTableSpan span = { AdoptBlock(std::move(data)), len };
+    InsertSpans(pos, &span, 1);
+}
+
+void PieceTable::AddListener(PieceTableListener* listener)
+{
+    Listeners.push_back(listener);
+}
+
+void PieceTable::RemoveListener(PieceTableListener* listener)
+{
+    Listeners.erase(std::remove(Listeners.begin(), Listeners.end(), listener), Listeners.end());
+}
+
+void PieceTable::NotifyInsert(size_t pos, const PieceTableSpan* spans, size_t count, size_t lines)
+{
+    const size_t line = LineFromPos(pos);
+    for (size_t n = 0; n < Listeners.size(); n++)
+    {
+        Listeners[n]->OnInsertBlocks(Blocks);
+        Listeners[n]->OnInsert(pos, spans, count);
+        Listeners[n]->OnEditLines(line, 0, lines);
+    }
+}
+
+char PieceTable::CharAt(size_t pos) const
+{
+    size_t start;
+    int n = FindNode(pos, &start);
+    return n >= 0 ? Nodes[n].Data[pos - start] : 0;
+}
+
+bool PieceTable::GetSpan(size_t pos, const char** out_data, size_t* out_len) const
+{
+    size_t start;
+    int n = FindNode(pos, &start);
+    if (n < 0)
+        return false;
+    *out_data = Nodes[n].Data + (pos - start);
+    *out_len = Nodes[n].Len - (pos - start);
+    return true;
+}
+
+size_t PieceTable::Copy(size_t pos, size_t len, char* out) const
+{
+    size_t copied = 0;
+    while (copied < len)
+    {
+        const char* data;
+        size_t span_len;
+        if (!GetSpan(pos + copied, &data, &span_len))
+            break;
+        if (span_len > len - copied)
+            span_len = len - copied;
+        memcpy(out + copied, data, span_len);
+        copied += span_len;
+    }
+    return copied;
+}
+
+std::string PieceTable::Substr(size_t pos, size_t len) const
+{
+    const size_t size = Size();
+    if (pos >= size)
+        return std::string();
+    if (len > size - pos)
+        len = size - pos;
+    std::string out(len, '\0');
+    if (len > 0)
+        Copy(pos, len, &out[0]);
+    return out;
+}
+
+size_t PieceTable::FindChar(char c, size_t from) const
+{
+    const size_t size = Size();
+    while (from < size)
+    {
+        const char* data;
+        size_t span_len;
+        if (!GetSpan(from, &data, &span_len))
+            break;
+        if (const void* p = memchr(data, c, span_len))
+            return from + (size_t)((const char*)p - data);
+        from += span_len;
+    }
+    return size;
+}
+
+size_t PieceTable::FindCharReverse(char c, size_t before) const
+{
+    if (before > Size())
+        before = Size();
+    while (before > 0)
+    {
+        size_t start;
+        int n = FindNode(before - 1, &start);
+        if (n < 0)
+            break;
+        const char* data = Nodes[n].Data;
+        for (size_t i = before - start; i > 0; i--)
+            if (data[i - 1] == c)
+                return start + i - 1;
+        before = start;
+    }
+    return (size_t)-1;
+}
+
+size_t PieceTable::LineStart(size_t line) const
+{
+    if (line == 0)
+        return 0;
+
+    // Find the piece holding the line-th '\n'
+    int n = Root;
+    size_t base = 0;
+    while (n >= 0)
+    {
+        const Node& node = Nodes[n];
+        const size_t left_len = node.Left >= 0 ? Nodes[node.Left].SubLen : 0;
+        const size_t left_lines = node.Left >= 0 ? Nodes[node.Left].SubLines : 0;
+        if (line <= left_lines)
+        {
+            n = node.Left;
+        }
+        else if (line <= left_lines + node.Lines)
+        {
+            const char* p = node.Data;
+            const char* data_end = node.Data + node.Len;
+            for (size_t remaining = line - left_lines; ; remaining--)
+            {
+                p = (const char*)memchr(p, '\n', (size_t)(data_end - p));
+                if (remaining == 1)
+                    break;
+                p++;
+            }
+            return base + left_len + (size_t)(p - node.Data) + 1;
+        }
+        else
+        {
+            base += left_len + node.Len;
+            line -= left_lines + node.Lines;
+            n = node.Right;
+        }
+    }
+    return Size();
+}
+
+size_t PieceTable::LineFromPos(size_t pos) const
+{
+    int n = Root;
+    size_t line = 0;
+    while (n >= 0)
+    {
+        const Node& node = Nodes[n];
+        const size_t left_len = node.Left >= 0 ? Nodes[node.Left].SubLen : 0;
+        const size_t left_lines = node.Left >= 0 ? Nodes[node.Left].SubLines : 0;
+        if (pos < left_len)
+        {
+            n = node.Left;
+        }
+        else if (pos < left_len + node.Len)
+        {
+            return line + left_lines + CountNewlines(node.Data, pos - left_len);
+        }
+        else
+        {
+            line += left_lines + node.Lines;
+            pos -= left_len + node.Len;
+            n = node.Right;
+        }
+    }
+    return line;
+}
+
+void PieceTable::GetSnapshot(PieceTableSnapshot* out) const
+{
+    out->Spans.clear();
+    out->Spans.reserve((size_t)PieceCount());
+    out->Blocks = Blocks;
+    out->Size = Size();
+
+    // In-order walk of the treap
+    std::vector<int> stack;
+    int n = Root;
+    while (n >= 0 || !stack.empty())
+    {
+        for (; n >= 0; n = Nodes[n].Left)
+            stack.push_back(n);
+        n = stack.back();
+        stack.pop_back();
+        PieceTableSnapshot::Span span;
+        span.Data = Nodes[n].Data;
+        span.Len = Nodes[n].Len;
+        span.FileOffset = FindFileOffset(span.Data, span.Len);
+        out->Spans.push_back(span);
+        n = Nodes[n].Right;
+    }
+}
+
+void PieceTableSnapshot::GetSegments(std::vector<Segment>* out) const
+{
+    out->clear();
+    size_t pos = 0;
+    for (size_t n = 0; n < Spans.size(); n++)
+    {
+        const Span& span = Spans[n];
+        if (!out->empty() && out->back().Data + out->back().Len == span.Data)
+        {
+            out->back().Len += span.Len;
+        }
+        else
+        {
+            Segment segment = { span.Data, span.Len, pos };
+            out->push_back(segment);
+        }
+        pos += span.Len;
+    }
+}
+
+size_t PieceTable::FindFileOffset(const char* data, size_t len) const
+{
+    // Last range starting at or before 'data'. Pieces never straddle blocks, so a piece is either fully inside a range or not in it.
+    FileRange key = { data, 0, 0 };
+    std::vector<FileRange>::const_iterator it = std::upper_bound(FileRanges.begin(), FileRanges.end(), key, FileRangeLess);
+    if (it == FileRanges.begin())
+        return PieceTableSnapshot::NoFileOffset;
+    --it;
+    const size_t offset_in_range = (size_t)(data - it->Data);
+    if (std::less<const char*>()(data, it->Data + it->Len) && offset_in_range + len <= it->Len)
+        return it->FileOffset + offset_in_range;
+    return PieceTableSnapshot::NoFileOffset;
+}
+
+void PieceTable::MarkSaved(const PieceTableSnapshot& saved)
+{
+    // Blocks are never modified so the snapshot's spans describe the file whatever happened to the table since
+    FileRanges.clear();
+    FileRanges.reserve(saved.Spans.size());
+    size_t file_offset = 0;
+    for (size_t n = 0; n < saved.Spans.size(); n++)
+    {
+        FileRange range = { saved.Spans[n].Data, saved.Spans[n].Len, file_offset };
+        FileRanges.push_back(range);
+        file_offset += saved.Spans[n].Len;
+    }
+    std::sort(FileRanges.begin(), FileRanges.end(), FileRangeLess);
+}
@@ -0,0 +1,172 @@
+// Piece table used as the backing store of every editor tab.
+// The text is never stored contiguously: it is a sequence of pieces pointing into immutable blocks
+// (the original file contents and an append-only add buffer). Pieces are kept in a treap ordered by
+// document position, with subtree byte and newline counts, so locating/inserting/erasing and mapping
+// between byte offsets and line numbers costs O(log pieces) regardless of how big the file is.
+// Pieces are capped in size (MAX_PIECE_SIZE) so that cutting one and recounting its newlines stays cheap.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Bytes stored in the blocks of a PieceTable. Valid until the table is Load()ed, Clear()ed or destroyed.
+struct PieceTableSpan
+{
+    const char* Data;
+    size_t      Len;
+};
+
+// Told about every edit made to a PieceTable (Insert(), Erase(), InsertSpans()), e.g. to journal it. Called before
+// the edit is made. Loading (Load(), Append(), Clear()) is not reported.
+class PieceTableListener
+{
+public:
+    virtual ~PieceTableListener() {}
+    virtual void OnInsert(size_t pos, const PieceTableSpan* spans, size_t count) = 0;
+    virtual void OnErase(size_t pos, size_t len) = 0;
+    // The same edit in lines, for caches indexed by line: it is within line 'line' (0-based), and removes
+    // 'removed_lines' '\n' and inserts 'inserted_lines' of them.
+    virtual void OnEditLines(size_t line, size_t removed_lines, size_t inserted_lines) { (void)line; (void)removed_lines; (void)inserted_lines; }
+    // Called before OnInsert() with the blocks holding all of the table's bytes, for listeners that read the inserted
+    // bytes later (e.g. on another thread): keeping a copy of 'blocks' keeps the spans valid after Clear() or Load().
+    virtual void OnInsertBlocks(const std::vector<std::shared_ptr<char>>& blocks) { (void)blocks; }
+};
+
+// Copy of the piece list of a PieceTable. It shares ownership of the blocks, so it stays valid and can be read from
+// another thread while the table is edited or destroyed (bytes of a block are never modified once written).
+struct PieceTableSnapshot
+{
+    static const size_t NoFileOffset = (size_t)-1;
+
+    struct Span
+    {
+        const char* Data;
+        size_t      Len;
+        size_t      FileOffset;     // Where these bytes are in the file on disk (see PieceTable::MarkSaved()), NoFileOffset if they aren't there
+    };
+
+    // Contiguous bytes of the text, starting at offset Pos
+    struct Segment
+    {
+        const char* Data;
+        size_t      Len;
+        size_t      Pos;
+    };
+
+    std::vector<Span>                   Spans;
+    std::vector<std::shared_ptr<char>>  Blocks;
+    size_t                              Size;
+
+    PieceTableSnapshot()                { Size = 0; }
+
+    // The spans, with the ones that follow each other in memory merged: pieces cut from the same block (e.g. a loaded
+    // file) are read or searched as one segment.
+    void        GetSegments(std::vector<Segment>* out) const;
+};
+
+class PieceTable
+{
+public:
+    PieceTable();
+    PieceTable(PieceTable&& other);
+    PieceTable& operator=(PieceTable&& other);
+
+    // Replace the whole contents with the contents of a file. Load() takes ownership of 'data' (allocated with new[]),
+    // which becomes the original block. Append() adds the next chunk of the file when it is loaded in pieces.
+    void        Load(std::unique_ptr<char[]> data, size_t size);
+    void        Load(const char* text, size_t size);
+    void        Append(std::unique_ptr<char[]> data, size_t size);
+    void        Clear();
+
+    size_t      Size() const                        { return Root >= 0 ? Nodes[Root].SubLen : 0; }
+    bool        Empty() const                       { return Size() == 0; }
+    int         PieceCount() const                  { return (int)Nodes.size() - (int)FreeNodes.size(); }
+    size_t      LineCount() const                   { return (Root >= 0 ? Nodes[Root].SubLines : 0) + 1; }   // Number of '\n' + 1
+    unsigned    Version() const                     { return EditVersion; }  // Bumped on every modification, use to invalidate caches.
+
+    void        Insert(size_t pos, const char* text, size_t len);
+    void        Insert(size_t pos, const std::string& text)   { Insert(pos, text.data(), text.size()); }
+    void        Erase(size_t pos, size_t len);
+
+    // Editing by reference, for undo/redo: get the spans making up [pos, pos + len) (appended to 'out'), and insert
+    // spans previously obtained from this same table. No byte is copied. O(spans * log pieces) + counting newlines.
+    void        GetSpans(size_t pos, size_t len, std::vector<PieceTableSpan>* out) const;
+    void        InsertSpans(size_t pos, const PieceTableSpan* spans, size_t count);
+
+    // Insert a block of text built elsewhere (allocated with new[]), taking ownership of it instead of copying it into
+    // the add buffer, e.g. the result of a replace-all. Reported to the listener like InsertSpans().
+    void        InsertBlock(size_t pos, std::unique_ptr<char[]> data, size_t len);
+
+    // Listeners are not owned. Moving the table moves them along with the text.
+    void        AddListener(PieceTableListener* listener);
+    void        RemoveListener(PieceTableListener* listener);
+
+    // Reading. A "span" is the largest contiguous run of bytes starting at 'pos' (the remainder of the piece containing 'pos').
+    char        CharAt(size_t pos) const;
+    bool        GetSpan(size_t pos, const char** out_data, size_t* out_len) const;
+    size_t      Copy(size_t pos, size_t len, char* out) const;
+    std::string Substr(size_t pos, size_t len) const;
+    std::string ToString() const                    { return Substr(0, Size()); }
+
+    // Searching for a single byte (e.g. '\n'). Return Size() / (size_t)-1 when not found.
+    size_t      FindChar(char c, size_t from) const;            // first occurrence at or after 'from'
+    size_t      FindCharReverse(char c, size_t before) const;   // last occurrence strictly before 'before'
+
+    // Line index, maintained incrementally by Insert()/Erase(). Lines are 0-based and split on '\n'.
+    size_t      LineStart(size_t line) const;                   // byte offset of the first byte of 'line', Size() when line >= LineCount()
+    size_t      LineFromPos(size_t pos) const;                  // line containing byte 'pos' (number of '\n' before it)
+
+    // Snapshots for saving. The table remembers which bytes are in the file on disk (the loaded blocks, then whatever
+    // MarkSaved() reports) so that savers can tell unchanged spans from edited ones.
+    void        GetSnapshot(PieceTableSnapshot* out) const;     // O(pieces)
+    void        MarkSaved(const PieceTableSnapshot& saved);     // The file on disk now holds 'saved', a snapshot of this table
+
+private:
+    struct FileRange
+    {
+        const char* Data;
+        size_t      Len;
+        size_t      FileOffset;
+    };
+
+    struct Node
+    {
+        const char* Data;
+        size_t      Len;
+        size_t      SubLen;     // Sum of Len over this subtree
+        size_t      Lines;      // Number of '\n' in this piece
+        size_t      SubLines;   // Sum of Lines over this subtree
+        int         Left, Right;
+        uint32_t    Priority;
+    };
+
+    std::vector<Node>                       Nodes;
+    std::vector<int>                        FreeNodes;
+    int                                     Root;
+    std::vector<std::shared_ptr<char>>      Blocks;         // Original contents + add buffer blocks. Never reallocated so piece pointers stay valid.
+    char*                                   AddBlock;       // Current add buffer block (last of Blocks), appended to until full.
+    size_t                                  AddBlockUsed;
+    size_t                                  AddBlockCapacity;
+    std::vector<FileRange>                  FileRanges;     // Bytes known to be in the file on disk, sorted by Data
+    std::vector<PieceTableListener*>        Listeners;
+    uint32_t                                RandState;
+    unsigned                                EditVersion;
+
+    int         NewNode(const char* data, size_t len, size_t lines);
+    int         NewTree(const char* data, size_t len);
+    void        FreeNode(int n);
+    void        FreeTree(int n);
+    void        Update(int n);
+    void        Split(int n, size_t pos, int* out_left, int* out_right);
+    int         Merge(int left, int right);
+    int         FindNode(size_t pos, size_t* out_node_start) const;
+    size_t      FindFileOffset(const char* data, size_t len) const;
+    static bool FileRangeLess(const FileRange& a, const FileRange& b);
+    char*       AdoptBlock(std::unique_ptr<char[]> data);
+    const char* AppendToAddBuffer(const char* text, size_t len);
+    void        NotifyInsert(size_t pos, const PieceTableSpan* spans, size_t count, size_t lines);
+};
@@ -0,0 +1,407 @@
+// The files of a project, the way git sees them (see project_files.h)
+
+#include "project_files.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Like git, a file with a NUL byte in its first 8 KB is binary
+static const size_t BINARY_CHECK_SIZE = 8 * 1024;
+
+const size_t ProjectFile::MapMinSize;
+
+bool IsBinaryText(const char* data, size_t size)
+{
+    return size > 0 && memchr(data, 0, size < BINARY_CHECK_SIZE ? size : BINARY_CHECK_SIZE) != NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Files and directories
+//-----------------------------------------------------------------------------
+
+#ifdef _WIN32
+
+bool ProjectFile::Open(const char* filename, std::string* buffer)
+{
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || (uint64_t)size.QuadPart > (uint64_t)(size_t)-1)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    FileSize = (size_t)size.QuadPart;
+    if (FileSize == 0)
+    {
+        CloseHandle(file);
+        return true;
+    }
+    if (FileSize < MapMinSize)
+    {
+        if (buffer->size() < FileSize)
+            buffer->resize(FileSize);
+        DWORD read = 0;
+        const BOOL ok = ReadFile(file, &(*buffer)[0], (DWORD)FileSize, &read, NULL);
+        CloseHandle(file);
+        FileData = buffer->data();
+        FileSize = read;
+        return ok != 0;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL)
+        return false;
+    FileData = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping); // The view keeps the mapping alive
+    Mapped = FileData != NULL;
+    return Mapped;
+}
+
+void ProjectFile::Close()
+{
+    if (Mapped)
+        UnmapViewOfFile(FileData);
+    FileData = NULL;
+    FileSize = 0;
+    Mapped = false;
+}
+
+bool ReadProjectDirectory(const std::string& path, std::vector<ProjectDirectoryEntry>* out)
+{
+    WIN32_FIND_DATAA find_data;
+    HANDLE find = FindFirstFileA((path + "*").c_str(), &find_data);
+    if (find == INVALID_HANDLE_VALUE)
+        return false;
+    do
+    {
+        // Symbolic links and junctions are not followed, they could loop
+        if (find_data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)
+            continue;
+        if (strcmp(find_data.cFileName, ".") == 0 || strcmp(find_data.cFileName, "..") == 0)
+            continue;
+        ProjectDirectoryEntry entry;
+        entry.Name = find_data.cFileName;
+        entry.Directory = (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+        out->push_back(entry);
+    }
+    while (FindNextFileA(find, &find_data));
+    FindClose(find);
+    return true;
+}
+
+#else
+
+bool ProjectFile::Open(const char* filename, std::string* buffer)
+{
+    const int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        close(fd);
+        return false;
+    }
+    FileSize = (size_t)st.st_size;
+    if (FileSize == 0)
+    {
+        close(fd);
+        return true;
+    }
+    if (FileSize < MapMinSize)
+    {
+        if (buffer->size() < FileSize)
+            buffer->resize(FileSize);
+        char* dst = &(*buffer)[0];
+        size_t done = 0;
+        while (done < FileSize)
+        {
+            const ssize_t n = read(fd, dst + done, FileSize - done);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                break; // Shrunk meanwhile: search what is there
+            done += (size_t)n;
+        }
+        close(fd);
+        FileData = dst;
+        FileSize = done;
+        return true;
+    }
+    void* data = mmap(NULL, FileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // The mapping keeps the file open
+    if (data == MAP_FAILED)
+        return false;
+    madvise(data, FileSize, MADV_SEQUENTIAL);
+    FileData = (const char*)data;
+    Mapped = true;
+    return true;
+}
+
+void ProjectFile::Close()
+{
+    if (Mapped)
+        munmap((void*)FileData, FileSize);
+    FileData = NULL;
+    FileSize = 0;
+    Mapped = false;
+}
+
+bool ReadProjectDirectory(const std::string& path, std::vector<ProjectDirectoryEntry>* out)
+{
+    DIR* dir = opendir(path.empty() ? "." : path.c_str());
+    if (dir == NULL)
+        return false;
+    while (struct dirent* ent = readdir(dir))
+    {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+            continue;
+        ProjectDirectoryEntry entry;
+        entry.Name = ent->d_name;
+        unsigned char type = ent->d_type;
+        if (type == DT_UNKNOWN)
+        {
+            // Some file systems don't fill d_type
+            struct stat st;
+            if (lstat((path + entry.Name).c_str(), &st) != 0)
+                continue;
+            type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_LNK;
+        }
+        // Symbolic links are not followed, they could loop
+        if (type != DT_DIR && type != DT_REG)
+            continue;
+        entry.Directory = type == DT_DIR;
+        out->push_back(entry);
+    }
+    closedir(dir);
+    return true;
+}
+
+#endif
+
+//-----------------------------------------------------------------------------
+// .gitignore
+//-----------------------------------------------------------------------------
+
+// Git's wildmatch without the [[:class:]] forms: '*' and '?' don't match '/', "**/" matches any number of
+// directories, a trailing "/**" everything inside. 'glob_start' is where the whole glob starts.
+static bool GlobMatch(const char* glob_start, const char* g, const char* s)
+{
+    for (;;)
+    {
+        const char c = *g;
+        if (c == 0)
+            return *s == 0;
+        if (c == '*')
+        {
+            if (g[1] == '*' && (g == glob_start || g[-1] == '/') && (g[2] == '/' || g[2] == 0))
+            {
+                if (g[2] == 0)
+                    return true;
+                for (const char* t = s; ; t++)
+                {
+                    if (GlobMatch(glob_start, g + 3, t))
+                        return true;
+                    t = strchr(t, '/');
+                    if (t == NULL)
+                        return false;
+                }
+            }
+            while (*g == '*')
+                g++;
+            for (const char* t = s; ; t++)
+            {
+                if (GlobMatch(glob_start, g, t))
+                    return true;
+                if (*t == 0 || *t == '/')
+                    return false;
+            }
+        }
+        if (*s == 0)
+            return false;
+        if (c == '?')
+        {
+            if (*s == '/')
+                return false;
+        }
+        else if (c == '[')
+        {
+            // A '[' without its ']' is an ordinary character
+            const char* p = g + 1;
+            const bool negate = *p == '!' || *p == '^';
+            if (negate)
+                p++;
+            bool matched = false;
+            bool closed = false;
+            for (bool first = true; *p != 0; first = false)
+            {
+                if (*p == ']' && !first)
+                {
+                    closed = true;
+                    break;
+                }
+                if (*p == '\\' && p[1] != 0)
+                    p++;
+                unsigned char lo = (unsigned char)*p++;
+                unsigned char hi = lo;
+                if (p[0] == '-' && p[1] != ']' && p[1] != 0)
+                {
+                    p++;
+                    if (*p == '\\' && p[1] != 0)
+                        p++;
+                    hi = (unsigned char)*p++;
+                }
+                if ((unsigned char)*s >= lo && (unsigned char)*s <= hi)
+                    matched = true;
+            }
+            if (closed)
+            {
+                if (matched == negate || *s == '/')
+                    return false;
+                g = p;
+            }
+            else if (*s != '[')
+                return false;
+        }
+        else
+        {
+            if (c == '\\' && g[1] != 0)
+                g++;
+            if (*g != *s)
+                return false;
+        }
+        g++;
+        s++;
+    }
+}
+
+std::shared_ptr<const ProjectIgnoreRules> ProjectIgnoreRules::Load(const std::string& root, const std::string& dir_path, const std::vector<ProjectDirectoryEntry>& entries, const std::shared_ptr<const ProjectIgnoreRules>& parent)
+{
+    bool found = false;
+    for (size_t n = 0; n < entries.size() && !found; n++)
+        found = !entries[n].Directory && entries[n].Name == ".gitignore";
+    if (!found)
+        return NULL;
+    FILE* f = fopen((root + dir_path + ".gitignore").c_str(), "rb");
+    if (f == NULL)
+        return NULL;
+    std::string contents;
+    char buf[4096];
+    for (size_t n; (n = fread(buf, 1, sizeof(buf), f)) > 0; )
+        contents.append(buf, n);
+    fclose(f);
+
+    std::shared_ptr<ProjectIgnoreRules> rules(new ProjectIgnoreRules());
+    for (size_t line = 0; line < contents.size(); )
+    {
+        size_t line_end = contents.find('\n', line);
+        if (line_end == std::string::npos)
+            line_end = contents.size();
+        size_t end = line_end;
+        if (end > line && contents[end - 1] == '\r')
+            end--;
+        // Trailing spaces don't count unless escaped
+        while (end > line && contents[end - 1] == ' ' && !(end - line >= 2 && contents[end - 2] == '\\'))
+            end--;
+        size_t begin = line;
+        line = line_end + 1;
+        if (begin == end || contents[begin] == '#')
+            continue;
+
+        Rule rule;
+        rule.Negate = contents[begin] == '!';
+        if (rule.Negate)
+            begin++;
+        rule.DirOnly = end > begin && contents[end - 1] == '/';
+        if (rule.DirOnly)
+            end--;
+        rule.Glob.assign(contents, begin, end - begin);
+        rule.Anchored = rule.Glob.find('/') != std::string::npos;
+        if (rule.Anchored && rule.Glob[0] == '/')
+            rule.Glob.erase(0, 1);
+        if (!rule.Glob.empty())
+            rules->Rules.push_back(rule);
+    }
+    if (rules->Rules.empty())
+        return NULL;
+    rules->Parent = parent;
+    rules->Base = dir_path;
+    return rules;
+}
+
+bool ProjectIgnoreRules::IsIgnored(const ProjectIgnoreRules* rules, const std::string& path, bool directory)
+{
+    for (; rules != NULL; rules = rules->Parent.get())
+    {
+        const char* relative = path.c_str() + rules->Base.size();
+        const char* name = strrchr(relative, '/');
+        name = name != NULL ? name + 1 : relative;
+        for (size_t n = rules->Rules.size(); n-- > 0; )
+        {
+            const Rule& rule = rules->Rules[n];
+            if (rule.DirOnly && !directory)
+                continue;
+            if (GlobMatch(rule.Glob.c_str(), rule.Glob.c_str(), rule.Anchored ? relative : name))
+                return !rule.Negate;
+        }
+    }
+    return false;
+}
+
+void ListProjectFiles(const std::string& root, std::vector<std::string>* out, const std::atomic<bool>* cancel)
+{
+    struct PendingDirectory
+    {
+        std::string                                 Path;
+        std::shared_ptr<const ProjectIgnoreRules>   Ignore;
+    };
+    std::vector<PendingDirectory> stack(1);
+    std::vector<ProjectDirectoryEntry> entries;
+    while (!stack.empty() && !(cancel != NULL && cancel->load()))
+    {
+        PendingDirectory dir = stack.back();
+        stack.pop_back();
+        entries.clear();
+        if (!ReadProjectDirectory(root + dir.Path, &entries))
+            continue;
+        std::shared_ptr<const ProjectIgnoreRules> ignore = ProjectIgnoreRules::Load(root, dir.Path, entries, dir.Ignore);
+        if (!ignore)
+            ignore = dir.Ignore;
+        for (size_t n = entries.size(); n-- > 0; )
+        {
+            const ProjectDirectoryEntry& entry = entries[n];
+            if (entry.Directory && entry.Name == ".git")
+                continue;
+            std::string path = dir.Path + entry.Name;
+            if (ProjectIgnoreRules::IsIgnored(ignore.get(), path, entry.Directory))
+                continue;
+            if (entry.Directory)
+            {
+                PendingDirectory sub;
+                sub.Path = path + '/';
+                sub.Ignore = ignore;
+                stack.push_back(sub);
+            }
+            else
+                out->push_back(path);
+        }
+    }
+}
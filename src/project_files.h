@@ -0,0 +1,80 @@
+// The files of a project, the way git sees them: '.git' directories and the paths matched by the .gitignore files on
+// the way are not part of it, and neither are binary files (with a NUL byte in their first 8 KB, as git tells them).
+// Used by ProjectSearch (project_search.h), which walks the tree on every core, and by TrigramIndex
+// (trigram_index.h).
+
+#pragma once
+
+#include <stddef.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Whether the contents of a file make it a binary file
+bool IsBinaryText(const char* data, size_t size);
+
+struct ProjectDirectoryEntry
+{
+    std::string Name;
+    bool        Directory;
+};
+
+// The files and directories in 'path' ("" for the current directory, else ending with '/'), without "." and "..".
+// Symbolic links are left out: following them could loop.
+bool ReadProjectDirectory(const std::string& path, std::vector<ProjectDirectoryEntry>* out);
+
+// The patterns of a .gitignore file, chained to those of the directories above
+class ProjectIgnoreRules
+{
+public:
+    // The rules of the directory 'dir_path' (relative to 'root', ending with '/'), whose contents are 'entries'. NULL
+    // if it has no .gitignore, or an empty one: 'parent' applies as is then.
+    static std::shared_ptr<const ProjectIgnoreRules> Load(const std::string& root, const std::string& dir_path, const std::vector<ProjectDirectoryEntry>& entries,
+                                                          const std::shared_ptr<const ProjectIgnoreRules>& parent);
+
+    // 'path' is relative to the root, without the trailing '/' of a directory. The deepest .gitignore decides, and
+    // in a .gitignore, the last rule that matches.
+    static bool IsIgnored(const ProjectIgnoreRules* rules, const std::string& path, bool directory);
+
+private:
+    struct Rule
+    {
+        std::string Glob;
+        bool        Negate;         // "!pattern": re-includes what a previous rule excluded
+        bool        DirOnly;        // "pattern/"
+        bool        Anchored;       // Has a '/' before its end: matches the path from Base, not just the name
+    };
+
+    std::shared_ptr<const ProjectIgnoreRules> Parent;
+    std::string         Base;       // Directory of the .gitignore, relative to the root
+    std::vector<Rule>   Rules;
+};
+
+// All the files under 'root' that git wouldn't ignore, relative to it, in the order of the walk (binary files are
+// included: telling them requires reading them). Stops early when 'cancel' becomes true.
+void ListProjectFiles(const std::string& root, std::vector<std::string>* out, const std::atomic<bool>* cancel);
+
+// The contents of a file: small files are read into a buffer of the caller (reused from file to file), files from
+// MapMinSize bytes are memory-mapped, which costs more than copying a small one.
+class ProjectFile
+{
+public:
+    static const size_t MapMinSize = 1024 * 1024;
+
+    ProjectFile()                                   { FileData = NULL; FileSize = 0; Mapped = false; }
+    ~ProjectFile()                                  { Close(); }
+
+    bool        Open(const char* filename, std::string* buffer);
+    void        Close();
+    const char* Data() const                        { return FileData; }
+    size_t      Size() const                        { return FileSize; }
+
+private:
+    const char* FileData;
+    size_t      FileSize;
+    bool        Mapped;
+
+    ProjectFile(const ProjectFile&);
+    ProjectFile& operator=(const ProjectFile&);
+};
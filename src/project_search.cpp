@@ -0,0 +1,272 @@
+// Searching the files of a directory tree for a regular expression (see project_search.h)
+
+#include "project_search.h"
+#include "regex_search.h"
+#include "text_search.h"
+#include <algorithm>
+#include <chrono>
+
+const size_t ProjectSearch::MaxHits;
+
+ProjectSearch::ProjectSearch()
+{
+    FromIndex = false;
+    PendingWork = 0;
+    Results = NULL;
+    FilesSearched = 0;
+    Count = 0;
+    KeptHits = 0;
+    RunningWorkers = 0;
+    Done = true;
+    CancelRequested = false;
+}
+
+ProjectSearch::~ProjectSearch()
+{
+    Cancel();
+    FreeResults(Results.exchange(NULL));
+}
+
+bool ProjectSearch::Start(const std::string& root, const std::string& pattern, bool ignore_case, std::string* out_error, const TrigramIndex* index)
+{
+    Cancel();
+    FreeResults(Results.exchange(NULL));
+    FileNames.clear();
+    HitList.clear();
+    FilesSearched = 0;
+    Count = 0;
+    KeptHits = 0;
+    if (!Re.Compile(pattern, ignore_case, out_error))
+        return false;
+
+    RootDir = root;
+    const unsigned worker_count = std::max(1u, std::thread::hardware_concurrency());
+    Queues.clear();
+    for (unsigned n = 0; n < worker_count; n++)
+        Queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+
+    // The candidate files of the index, dealt to the workers, or the root directory to walk
+    std::vector<std::string> candidates;
+    FromIndex = index != NULL && index->IsOpen() && index->Root() == root && index->Candidates(Re.RequiredLiteral(), &candidates);
+    if (FromIndex)
+    {
+        PendingWork = candidates.size();
+        for (size_t n = 0; n < candidates.size(); n++)
+        {
+            WorkItem item;
+            item.Path.swap(candidates[n]);
+            item.Directory = false;
+            Queues[n % worker_count]->Items.push_back(std::move(item));
+        }
+    }
+    else
+    {
+        WorkItem item;
+        item.Directory = true;
+        PendingWork = 1;
+        Queues[0]->Items.push_back(item);
+    }
+
+    CancelRequested = false;
+    Done = false;
+    RunningWorkers = (int)worker_count;
+    for (unsigned n = 0; n < worker_count; n++)
+        Workers.push_back(std::thread(&ProjectSearch::Work, this, (size_t)n));
+    return true;
+}
+
+void ProjectSearch::Cancel()
+{
+    CancelRequested = true;
+    for (size_t n = 0; n < Workers.size(); n++)
+        Workers[n].join();
+    Workers.clear();
+    Queues.clear();
+    Done = true;
+}
+
+void ProjectSearch::Poll()
+{
+    // The stack is newest first: reverse it to list the files in the order they were searched
+    FileResult* list = NULL;
+    for (FileResult* result = Results.exchange(NULL); result != NULL; )
+    {
+        FileResult* next = result->Next;
+        result->Next = list;
+        list = result;
+        result = next;
+    }
+    while (list != NULL)
+    {
+        if (!list->Hits.empty())
+        {
+            const int file = (int)FileNames.size();
+            FileNames.push_back(std::move(list->Path));
+            for (size_t n = 0; n < list->Hits.size(); n++)
+            {
+                HitList.push_back(std::move(list->Hits[n]));
+                HitList.back().File = file;
+            }
+        }
+        FileResult* next = list->Next;
+        delete list;
+        list = next;
+    }
+}
+
+void ProjectSearch::FreeResults(FileResult* list)
+{
+    while (list != NULL)
+    {
+        FileResult* next = list->Next;
+        delete list;
+        list = next;
+    }
+}
+
+void ProjectSearch::Work(size_t worker)
+{
+    RegexMatcher matcher(&Re);
+    matcher.SetCancelFlag(&CancelRequested);
+    std::string buffer;
+    WorkItem item;
+    while (!CancelRequested.load())
+    {
+        if (!TakeWork(worker, &item))
+        {
+            if (PendingWork.load() == 0)
+                break;
+            // Others are still listing directories, which may give us something to do
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+            continue;
+        }
+        if (item.Directory)
+            ListDirectory(worker, item);
+        else
+            SearchFile(item, &matcher, &buffer);
+        PendingWork--;
+    }
+    if (RunningWorkers.fetch_sub(1) == 1)
+        Done.store(true);
+}
+
+// The newest item of our own queue, else the oldest of another worker's
+bool ProjectSearch::TakeWork(size_t worker, WorkItem* out)
+{
+    for (size_t n = 0; n < Queues.size(); n++)
+    {
+        WorkQueue& queue = *Queues[(worker + n) % Queues.size()];
+        std::lock_guard<std::mutex> lock(queue.Mutex);
+        if (queue.Items.empty())
+            continue;
+        if (n == 0)
+        {
+            *out = std::move(queue.Items.back());
+            queue.Items.pop_back();
+        }
+        else
+        {
+            *out = std::move(queue.Items.front());
+            queue.Items.pop_front();
+        }
+        return true;
+    }
+    return false;
+}
+
+void ProjectSearch::PushWork(size_t worker, WorkItem* item)
+{
+    PendingWork++;
+    WorkQueue& queue = *Queues[worker];
+    std::lock_guard<std::mutex> lock(queue.Mutex);
+    queue.Items.push_back(std::move(*item));
+}
+
+void ProjectSearch::ListDirectory(size_t worker, const WorkItem& dir)
+{
+    std::vector<ProjectDirectoryEntry> entries;
+    if (!ReadProjectDirectory(RootDir + dir.Path, &entries))
+        return;
+
+    // Its .gitignore applies to everything below
+    std::shared_ptr<const ProjectIgnoreRules> ignore = ProjectIgnoreRules::Load(RootDir, dir.Path, entries, dir.Ignore);
+    if (!ignore)
+        ignore = dir.Ignore;
+
+    // Pushed in reverse, so that we take them in the order of the directory
+    for (size_t n = entries.size(); n-- > 0; )
+    {
+        const ProjectDirectoryEntry& entry = entries[n];
+        if (entry.Directory && entry.Name == ".git")
+            continue;
+        WorkItem item;
+        item.Path = dir.Path + entry.Name;
+        if (ProjectIgnoreRules::IsIgnored(ignore.get(), item.Path, entry.Directory))
+            continue;
+        if (entry.Directory)
+            item.Path += '/';
+        item.Directory = entry.Directory;
+        item.Ignore = ignore;
+        PushWork(worker, &item);
+    }
+}
+
+void ProjectSearch::SearchFile(const WorkItem& file, RegexMatcher* matcher, std::string* buffer)
+{
+    ProjectFile contents;
+    if (!contents.Open((RootDir + file.Path).c_str(), buffer))
+        return;
+    if (contents.Size() == 0)
+    {
+        FilesSearched++;
+        return;
+    }
+    if (IsBinaryText(contents.Data(), contents.Size()))
+        return;
+    FileResult result;
+    result.HitCount = 0;
+    SearchText(contents.Data(), contents.Size(), matcher, &result);
+    FilesSearched++;
+    if (result.HitCount == 0)
+        return;
+
+    FileResult* pushed = new FileResult();
+    pushed->Path = file.Path;
+    pushed->Hits.swap(result.Hits);
+    pushed->HitCount = result.HitCount;
+    Count += result.HitCount;
+    pushed->Next = Results.load();
+    while (!Results.compare_exchange_weak(pushed->Next, pushed))
+        ;
+}
+
+// Same as RegexSearch::SearchChunk(), on a whole file
+void ProjectSearch::SearchText(const char* data, size_t size, RegexMatcher* matcher, FileResult* out)
+{
+    const std::string& literal = Re.RequiredLiteral();
+    const bool literal_only = Re.IsLiteral();
+    RegexLineScanner lines(data, data + size, matcher, Re);
+    while (lines.Next())
+    {
+        out->HitCount++;
+        if (KeptHits.fetch_add(1) >= MaxHits)
+            continue;
+        const char* line = lines.Line();
+        const char* match_begin = lines.LiteralMatch();
+        const char* match_last = match_begin + literal.size();
+        if (!literal_only && !matcher->FindInLine(line, lines.LineEnd(), line, &match_begin, &match_last))
+            match_begin = match_last = line;
+
+        Hit hit;
+        hit.File = -1;
+        hit.Line = lines.LineNumber();
+        hit.Pos = (size_t)(match_begin - data);
+        hit.Column = (size_t)(match_begin - line);
+        hit.Len = (size_t)(match_last - match_begin);
+        size_t preview_begin, preview_end;
+        RegexLineScanner::GetPreview(line, (size_t)(lines.LineEnd() - line), hit.Column, &preview_begin, &preview_end);
+        hit.Preview.assign(line + preview_begin, preview_end - preview_begin);
+        hit.PreviewPos = hit.Column - preview_begin;
+        out->Hits.push_back(std::move(hit));
+    }
+}
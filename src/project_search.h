@@ -0,0 +1,111 @@
+// Searching the files of a directory tree for a regular expression ("Find in files").
+// Worker threads (one per core) walk the tree and search the files they find at the same time. Each has a deque of
+// work (directories to list, files to search): it takes from the back of its own, and when it runs dry, steals from
+// the front of another one, where the oldest items are (directories near the top of the tree: the biggest pieces).
+// The tree is seen the way git sees it, without '.git', ignored paths and binary files (see project_files.h).
+// With a TrigramIndex (trigram_index.h) of the tree, only the files it gives for the regex's required literal are
+// searched, nothing is walked.
+// Hits are streamed to the UI thread: a worker pushes those of each file on a lock-free stack, Poll() takes them all
+// at once. Files are listed in the order they were searched.
+
+#pragma once
+
+#include "project_files.h"
+#include "regex_engine.h"
+#include "trigram_index.h"
+#include <stddef.h>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class ProjectSearch
+{
+public:
+    static const size_t MaxHits = 256 * 1024;       // Hits past this many are counted but not kept
+
+    struct Hit
+    {
+        int         File;           // Index in Files()
+        size_t      Line;           // From 0
+        size_t      Pos;            // Offset of the match in the file...
+        size_t      Column;         // ...and in its line
+        size_t      Len;            // Of the match
+        std::string Preview;        // The line, or the part of it around the match for a long line
+        size_t      PreviewPos;     // Offset of the match in Preview
+    };
+
+    ProjectSearch();
+    ~ProjectSearch();                               // Cancel()
+
+    // Search the files under 'root' ("" for the current directory, else ending with '/') for 'pattern', cancelling the
+    // search in progress and forgetting its hits. Returns false and sets 'out_error' if the pattern is invalid.
+    // 'index' is used when it is open on 'root' and can tell which files may match.
+    bool        Start(const std::string& root, const std::string& pattern, bool ignore_case, std::string* out_error, const TrigramIndex* index = NULL);
+    void        Cancel();
+
+    // Move the hits found since the last call to Files() and Hits(). Only the UI thread calls this and reads those.
+    void        Poll();
+
+    const Regex& Pattern() const                    { return Re; }
+    const std::string& Root() const                 { return RootDir; }
+    bool        IsSearching() const                 { return !Done.load() || Results.load() != NULL; }
+    size_t      SearchedFiles() const               { return FilesSearched.load(); }
+    size_t      HitCount() const                    { return Count.load(); }    // Found so far, kept or not
+    bool        UsedIndex() const                   { return FromIndex; }
+    const std::vector<std::string>& Files() const   { return FileNames; }       // Relative to Root()
+    const std::vector<Hit>& Hits() const            { return HitList; }
+
+private:
+    struct WorkItem
+    {
+        std::string                         Path;       // Relative to RootDir, directories end with '/'
+        bool                                Directory;
+        std::shared_ptr<const ProjectIgnoreRules> Ignore;   // Apply to the item's directory
+    };
+
+    struct WorkQueue
+    {
+        std::mutex                          Mutex;
+        std::deque<WorkItem>                Items;
+    };
+
+    // The hits of a file, on their way to the UI thread
+    struct FileResult
+    {
+        FileResult*                         Next;
+        std::string                         Path;
+        std::vector<Hit>                    Hits;
+        size_t                              HitCount;   // Kept or not
+    };
+
+    Regex                                   Re;
+    std::string                             RootDir;
+    bool                                    FromIndex;
+    std::vector<std::unique_ptr<WorkQueue> > Queues;    // One per worker
+    std::vector<std::thread>                Workers;
+    std::atomic<size_t>                     PendingWork;    // Queued or being worked on, the walk is over at 0
+    std::atomic<FileResult*>                Results;        // Lock-free stack, newest first
+    std::atomic<size_t>                     FilesSearched;
+    std::atomic<size_t>                     Count;
+    std::atomic<size_t>                     KeptHits;       // Taken by the workers, up to MaxHits
+    std::atomic<int>                        RunningWorkers;
+    std::atomic<bool>                       Done;
+    std::atomic<bool>                       CancelRequested;
+    std::vector<std::string>                FileNames;      // Owned by the UI thread, as is HitList
+    std::vector<Hit>                        HitList;
+
+    void        Work(size_t worker);
+    bool        TakeWork(size_t worker, WorkItem* out);
+    void        PushWork(size_t worker, WorkItem* item);
+    void        ListDirectory(size_t worker, const WorkItem& dir);
+    void        SearchFile(const WorkItem& file, RegexMatcher* matcher, std::string* buffer);
+    void        SearchText(const char* data, size_t size, RegexMatcher* matcher, FileResult* out);
+    static void FreeResults(FileResult* list);
+
+    ProjectSearch(const ProjectSearch&);
+    ProjectSearch& operator=(const ProjectSearch&);
+};
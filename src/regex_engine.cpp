@@ -0,0 +1,1040 @@
+// Regular expressions for searching text (see regex_engine.h)
+
+#include "regex_engine.h"
+#include <string.h>
+#include <algorithm>
+
+static const int REGEX_MAX_NESTING = 256;           // Parentheses, the parser recurses on them
+static const int REGEX_MAX_REPEAT = 1000;           // {m,n} bounds
+static const size_t REGEX_MAX_PROGRAM = 100000;     // Instructions, {m,n} copies what it repeats
+static const size_t REGEX_MAX_DFA_STATES = 2048;    // The cache is cleared past this many (1 KB each)
+static const size_t REGEX_CANCEL_CHECK_INTERVAL = 64 * 1024;    // Bytes matched between checks of the cancel flag
+
+//-----------------------------------------------------------------------------
+// Parser
+//-----------------------------------------------------------------------------
+
+enum RegexNodeType { NODE_EMPTY, NODE_SET, NODE_CONCAT, NODE_ALT, NODE_REPEAT, NODE_BOL, NODE_EOL };
+
+struct RegexNode
+{
+    int                 Type;
+    int                 Set;            // NODE_SET: index in Regex::Sets
+    int                 Literal;        // NODE_SET: the byte written in the pattern, -1 for a class
+    int                 Min, Max;       // NODE_REPEAT, Max = -1 for no limit
+    bool                Greedy;         // NODE_REPEAT
+    std::vector<int>    Children;
+};
+
+// Contents of a [class]: bytes, plus the UTF-8 characters it matches
+struct RegexClass
+{
+    RegexByteSet              Bytes;
+    bool                        AnyMultiByte;   // Every non-ASCII character
+    std::vector<std::string>    MultiBytes;     // Or these ones
+};
+
+static void SetAdd(RegexByteSet* set, unsigned char c)            { set->Bits[c >> 5] |= 1u << (c & 31); }
+static void SetAddRange(RegexByteSet* set, int first, int last)   { for (int c = first; c <= last; c++) SetAdd(set, (unsigned char)c); }
+
+// Length of the UTF-8 sequence starting with 'c', 1 for ASCII and invalid bytes
+static int Utf8SequenceLength(unsigned char c)
+{
+    if (c >= 0xC2 && c <= 0xDF) return 2;
+    if (c >= 0xE0 && c <= 0xEF) return 3;
+    if (c >= 0xF0 && c <= 0xF4) return 4;
+    return 1;
+}
+
+class RegexParser
+{
+public:
+    RegexParser(Regex* regex, const std::string& pattern)
+    {
+        Re = regex;
+        P = pattern.data();
+        End = P + pattern.size();
+        for (int n = 0; n < 4; n++)
+            Utf8Sets[n] = -1;
+    }
+
+    bool        Parse(std::string* out_error);
+
+private:
+    struct Frag
+    {
+        int                 Start;
+        std::vector<int>    Outs;       // Exits to patch: instruction * 2 + (0: Out, 1: Out1)
+    };
+
+    struct LiteralInfo
+    {
+        bool                Exact;      // The node matches Text and only Text
+        std::string         Text;       // Otherwise every match contains Text (can be empty)
+    };
+
+    Regex*                  Re;
+    const char*             P;
+    const char*             End;
+    std::string             Error;
+    std::vector<RegexNode>  Nodes;
+    int                     Utf8Sets[4];    // Lead bytes of 2, 3 and 4 byte sequences, continuation bytes
+
+    int         NewNode(int type);
+    int         NewSetNode(const RegexByteSet& set, int literal);
+    int         NewLiteralNode(unsigned char c);
+    int         NewClassNode(const RegexClass& cls);
+    int         Utf8Set(int n);
+    int         Fail(const char* error)                     { if (Error.empty()) Error = error; return -1; }
+
+    int         ParseAlt(int depth);
+    int         ParseConcat(int depth);
+    int         ParseRepeat(int depth);
+    int         ParseAtom(int depth);
+    int         ParseClass();
+    bool        ParseEscape(RegexClass* cls, bool in_class, int* out_byte);
+    bool        ParseCount(int* out_min, int* out_max);
+
+    LiteralInfo Analyze(int node) const;
+
+    int         Emit(int op, int set);
+    void        Patch(const std::vector<int>& outs, int target);
+    bool        Compile(int node, Frag* out);
+};
+
+int RegexParser::NewNode(int type)
+{
+    RegexNode node;
+    node.Type = type;
+    node.Set = -1;
+    node.Literal = -1;
+    node.Min = node.Max = 1;
+    node.Greedy = true;
+    Nodes.push_back(node);
+    return (int)Nodes.size() - 1;
+}
+
+int RegexParser::NewSetNode(const RegexByteSet& set, int literal)
+{
+    const int n = NewNode(NODE_SET);
+    Re->Sets.push_back(set);
+    Nodes[n].Set = (int)Re->Sets.size() - 1;
+    Nodes[n].Literal = literal;
+    return n;
+}
+
+int RegexParser::NewLiteralNode(unsigned char c)
+{
+    RegexByteSet set;
+    memset(&set, 0, sizeof(set));
+    SetAdd(&set, c);
+    if (Re->CaseInsensitive && ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')))
+        SetAdd(&set, (unsigned char)(c ^ 0x20));
+    return NewSetNode(set, c);
+}
+
+// 0, 1, 2: lead bytes of 2, 3, 4 byte sequences, 3: continuation bytes
+int RegexParser::Utf8Set(int n)
+{
+    if (Utf8Sets[n] < 0)
+    {
+        static const int ranges[4][2] = { { 0xC2, 0xDF }, { 0xE0, 0xEF }, { 0xF0, 0xF4 }, { 0x80, 0xBF } };
+        RegexByteSet set;
+        memset(&set, 0, sizeof(set));
+        SetAddRange(&set, ranges[n][0], ranges[n][1]);
+        Re->Sets.push_back(set);
+        Utf8Sets[n] = (int)Re->Sets.size() - 1;
+    }
+    return Utf8Sets[n];
+}
+
+// Alternation of the bytes of the class and of its UTF-8 characters
+int RegexParser::NewClassNode(const RegexClass& cls)
+{
+    RegexByteSet bytes = cls.Bytes;
+    if (Re->CaseInsensitive)
+        for (int c = 'a'; c <= 'z'; c++)
+            if (bytes.Has((unsigned char)c) || bytes.Has((unsigned char)(c - 0x20)))
+            {
+                SetAdd(&bytes, (unsigned char)c);
+                SetAdd(&bytes, (unsigned char)(c - 0x20));
+            }
+    const int alt = NewNode(NODE_ALT);
+    const int set_node = NewSetNode(bytes, -1);
+    Nodes[alt].Children.push_back(set_node);
+    if (cls.AnyMultiByte)
+    {
+        for (int len = 2; len <= 4; len++)
+        {
+            const int concat = NewNode(NODE_CONCAT);
+            for (int n = 0; n < len; n++)
+            {
+                const int byte_node = NewNode(NODE_SET);
+                Nodes[byte_node].Set = Utf8Set(n == 0 ? len - 2 : 3);
+                Nodes[concat].Children.push_back(byte_node);
+            }
+            Nodes[alt].Children.push_back(concat);
+        }
+    }
+    else
+    {
+        for (size_t n = 0; n < cls.MultiBytes.size(); n++)
+        {
+            const int concat = NewNode(NODE_CONCAT);
+            for (size_t i = 0; i < cls.MultiBytes[n].size(); i++)
+            {
+                const int byte_node = NewLiteralNode((unsigned char)cls.MultiBytes[n][i]);
+                Nodes[concat].Children.push_back(byte_node);
+            }
+            Nodes[alt].Children.push_back(concat);
+        }
+    }
+    return Nodes[alt].Children.size() == 1 ? set_node : alt;
+}
+
+bool RegexParser::Parse(std::string* out_error)
+{
+    const int root = ParseAlt(0);
+    if (root >= 0 && P < End)
+        Fail(*P == ')' ? "unmatched )" : "unexpected character");
+    Frag frag;
+    if (Error.empty() && Compile(root, &frag))
+    {
+        const int match = Emit(Regex::OP_MATCH, -1);
+        Patch(frag.Outs, match);
+        Re->Start = frag.Start;
+        const LiteralInfo literal = Analyze(root);
+        Re->Literal = literal.Text;
+        Re->LiteralOnly = literal.Exact && !literal.Text.empty() && literal.Text.find('\n') == std::string::npos;
+        for (size_t n = 0; n < Re->Program.size(); n++)
+            if (Re->Program[n].Op == Regex::OP_BOL || Re->Program[n].Op == Regex::OP_EOL)
+                Re->LiteralOnly = false;
+    }
+    if (Error.empty() && Re->Program.size() > REGEX_MAX_PROGRAM)
+        Error = "pattern too large";
+    if (!Error.empty())
+    {
+        if (out_error)
+            *out_error = Error;
+        return false;
+    }
+    return true;
+}
+
+int RegexParser::ParseAlt(int depth)
+{
+    int node = ParseConcat(depth);
+    while (node >= 0 && P < End && *P == '|')
+    {
+        P++;
+        const int right = ParseConcat(depth);
+        if (right < 0)
+            return -1;
+        if (Nodes[node].Type != NODE_ALT)
+        {
+            const int alt = NewNode(NODE_ALT);
+            Nodes[alt].Children.push_back(node);
+            node = alt;
+        }
+        Nodes[node].Children.push_back(right);
+    }
+    return node;
+}
+
+int RegexParser::ParseConcat(int depth)
+{
+    const int concat = NewNode(NODE_CONCAT);
+    while (P < End && *P != '|' && *P != ')')
+    {
+        const int node = ParseRepeat(depth);
+        if (node < 0)
+            return -1;
+        Nodes[concat].Children.push_back(node);
+    }
+    return concat;
+}
+
+// {m}, {m,} or {m,n}. Anything else isn't a count: the '{' is then a literal.
+bool RegexParser::ParseCount(int* out_min, int* out_max)
+{
+    const char* p = P + 1;
+    int values[2] = { 0, -1 };
+    for (int n = 0; n < 2; n++)
+    {
+        if (p < End && *p >= '0' && *p <= '9')
+        {
+            values[n] = 0;
+            for (; p < End && *p >= '0' && *p <= '9'; p++)
+                values[n] = std::min(values[n] * 10 + (*p - '0'), REGEX_MAX_REPEAT + 1);
+        }
+        else if (n == 0)
+        {
+            return false;
+        }
+        if (n == 0)
+        {
+            if (p < End && *p == '}')
+            {
+                values[1] = values[0];
+                break;
+            }
+            if (p >= End || *p != ',')
+                return false;
+            p++;
+        }
+    }
+    if (p >= End || *p != '}')
+        return false;
+    P = p + 1;
+    *out_min = values[0];
+    *out_max = values[1];
+    return true;
+}
+
+int RegexParser::ParseRepeat(int depth)
+{
+    if (*P == '*' || *P == '+' || *P == '?')
+        return Fail("nothing to repeat");
+    int node = ParseAtom(depth);
+    while (node >= 0 && P < End)
+    {
+        int min, max;
+        if (*P == '*')      { min = 0; max = -1; P++; }
+        else if (*P == '+') { min = 1; max = -1; P++; }
+        else if (*P == '?') { min = 0; max = 1; P++; }
+        else if (*P == '{' && ParseCount(&min, &max))
+        {
+            if (min > REGEX_MAX_REPEAT || max > REGEX_MAX_REPEAT)
+                return Fail("repeat count too large");
+            if (max >= 0 && max < min)
+                return Fail("invalid repeat count");
+        }
+        else
+        {
+            break;
+        }
+        const int repeat = NewNode(NODE_REPEAT);
+        Nodes[repeat].Min = min;
+        Nodes[repeat].Max = max;
+        if (P < End && *P == '?')
+        {
+            Nodes[repeat].Greedy = false;
+            P++;
+        }
+        Nodes[repeat].Children.push_back(node);
+        node = repeat;
+    }
+    return node;
+}
+
+// After a '\'. Escapes that stand for a class are added to 'cls' (and return true with *out_byte = -1), the others
+// return the byte they stand for.
+bool RegexParser::ParseEscape(RegexClass* cls, bool in_class, int* out_byte)
+{
+    if (P >= End)
+        return Fail("trailing \\") >= 0;
+    const char c = *P++;
+    *out_byte = -1;
+    switch (c)
+    {
+    case 'd': case 'D': case 'w': case 'W': case 's': case 'S':
+    {
+        RegexByteSet set;
+        memset(&set, 0, sizeof(set));
+        if (c == 'd' || c == 'D')
+            SetAddRange(&set, '0', '9');
+        if (c == 'w' || c == 'W')
+        {
+            SetAddRange(&set, '0', '9');
+            SetAddRange(&set, 'a', 'z');
+            SetAddRange(&set, 'A', 'Z');
+            SetAdd(&set, '_');
+        }
+        if (c == 's' || c == 'S')
+        {
+            SetAddRange(&set, '\t', '\r');
+            SetAdd(&set, ' ');
+        }
+        if (c >= 'A' && c <= 'Z')
+        {
+            // Negated: every other character but '\n', which is never in a line
+            for (int n = 0; n < 4; n++)
+                set.Bits[n] = ~set.Bits[n];
+            cls->AnyMultiByte = true;
+        }
+        for (int n = 0; n < 8; n++)
+            cls->Bytes.Bits[n] |= set.Bits[n];
+        return true;
+    }
+    case 't': *out_byte = '\t'; return true;
+    case 'n': *out_byte = '\n'; return true;
+    case 'r': *out_byte = '\r'; return true;
+    case 'f': *out_byte = '\f'; return true;
+    case 'v': *out_byte = '\v'; return true;
+    case 'x':
+    {
+        int value = 0;
+        for (int n = 0; n < 2; n++, P++)
+        {
+            const char h = P < End ? *P : 0;
+            if (h >= '0' && h <= '9')      value = value * 16 + (h - '0');
+            else if (h >= 'a' && h <= 'f') value = value * 16 + (h - 'a' + 10);
+            else if (h >= 'A' && h <= 'F') value = value * 16 + (h - 'A' + 10);
+            else return Fail("invalid \\x escape") >= 0;
+        }
+        *out_byte = value;
+        return true;
+    }
+    default:
+        if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (unsigned char)c >= 0x80)
+        {
+            if (c == 'b' && in_class)
+            {
+                *out_byte = '\b';
+                return true;
+            }
+            Error = std::string("unsupported escape \\") + c;
+            return false;
+        }
+        *out_byte = (unsigned char)c;   // Escaped punctuation
+        return true;
+    }
+}
+
+int RegexParser::ParseClass()
+{
+    RegexClass cls;
+    memset(&cls.Bytes, 0, sizeof(cls.Bytes));
+    cls.AnyMultiByte = false;
+    const bool negated = P < End && *P == '^';
+    if (negated)
+        P++;
+    for (bool first = true; ; first = false)
+    {
+        if (P >= End)
+            return Fail("missing ]");
+        if (*P == ']' && !first)
+        {
+            P++;
+            break;
+        }
+
+        // One item: a byte or a UTF-8 character, an escape, or a range of bytes
+        int lo = -1;
+        std::string multi_byte;
+        if (*P == '\\')
+        {
+            P++;
+            if (!ParseEscape(&cls, true, &lo))
+                return -1;
+            if (lo < 0)
+                continue;
+        }
+        else
+        {
+            const int len = Utf8SequenceLength((unsigned char)*P);
+            if (len > 1 && End - P >= len)
+            {
+                multi_byte.assign(P, (size_t)len);
+                P += len;
+            }
+            else
+            {
+                lo = (unsigned char)*P++;
+            }
+        }
+        if (P + 1 < End && *P == '-' && P[1] != ']')
+        {
+            P++;
+            int hi = -1;
+            if (*P == '\\')
+            {
+                P++;
+                if (!ParseEscape(&cls, true, &hi))
+                    return -1;
+            }
+            else if (Utf8SequenceLength((unsigned char)*P) == 1)
+            {
+                hi = (unsigned char)*P++;
+            }
+            if (lo < 0 || hi < 0)
+                return Fail("ranges of non-ASCII characters are not supported");
+            if (hi < lo)
+                return Fail("invalid range in class");
+            SetAddRange(&cls.Bytes, lo, hi);
+        }
+        else if (lo >= 0)
+        {
+            SetAdd(&cls.Bytes, (unsigned char)lo);
+        }
+        else
+        {
+            cls.MultiBytes.push_back(multi_byte);
+        }
+    }
+    if (negated)
+    {
+        if (!cls.MultiBytes.empty())
+            return Fail("non-ASCII characters in a negated class are not supported");
+        if (Re->CaseInsensitive)
+            for (int c = 'a'; c <= 'z'; c++)
+                if (cls.Bytes.Has((unsigned char)c) || cls.Bytes.Has((unsigned char)(c - 0x20)))
+                {
+                    SetAdd(&cls.Bytes, (unsigned char)c);
+                    SetAdd(&cls.Bytes, (unsigned char)(c - 0x20));
+                }
+        for (int n = 0; n < 4; n++)
+            cls.Bytes.Bits[n] = ~cls.Bytes.Bits[n];
+        for (int n = 4; n < 8; n++)
+            cls.Bytes.Bits[n] = 0;
+        cls.AnyMultiByte = !cls.AnyMultiByte;
+    }
+    return NewClassNode(cls);
+}
+
+int RegexParser::ParseAtom(int depth)
+{
+    const char c = *P;
+    switch (c)
+    {
+    case '(':
+    {
+        if (depth >= REGEX_MAX_NESTING)
+            return Fail("too many nested groups");
+        P++;
+        if (P + 1 < End && P[0] == '?' && P[1] == ':')
+            P += 2;
+        else if (P < End && *P == '?')
+            return Fail("unsupported group (?");
+        const int node = ParseAlt(depth + 1);
+        if (node < 0)
+            return -1;
+        if (P >= End || *P != ')')
+            return Fail("missing )");
+        P++;
+        return node;
+    }
+    case '[':
+        P++;
+        return ParseClass();
+    case '.':
+    {
+        P++;
+        RegexClass cls;
+        memset(&cls.Bytes, 0, sizeof(cls.Bytes));
+        SetAddRange(&cls.Bytes, 0, 0x7F);
+        cls.AnyMultiByte = true;
+        return NewClassNode(cls);
+    }
+    case '^':
+        P++;
+        return NewNode(NODE_BOL);
+    case '$':
+        P++;
+        return NewNode(NODE_EOL);
+    case '\\':
+    {
+        P++;
+        RegexClass cls;
+        memset(&cls.Bytes, 0, sizeof(cls.Bytes));
+        cls.AnyMultiByte = false;
+        int byte;
+        if (!ParseEscape(&cls, false, &byte))
+            return -1;
+        return byte >= 0 ? NewLiteralNode((unsigned char)byte) : NewClassNode(cls);
+    }
+    default:
+        P++;
+        return NewLiteralNode((unsigned char)c);   // The bytes of a UTF-8 character follow each other as literals
+    }
+}
+
+// What is known about the text the node matches, to find the longest literal every match contains
+RegexParser::LiteralInfo RegexParser::Analyze(int n) const
+{
+    const RegexNode& node = Nodes[n];
+    LiteralInfo info;
+    info.Exact = false;
+    switch (node.Type)
+    {
+    case NODE_EMPTY: case NODE_BOL: case NODE_EOL:
+        info.Exact = true;
+        break;
+    case NODE_SET:
+        info.Exact = node.Literal >= 0;
+        if (info.Exact)
+            info.Text.assign(1, (char)node.Literal);
+        break;
+    case NODE_CONCAT:
+    {
+        // Adjacent exact children form a literal, the longest one of these or of the children is kept
+        std::string run;
+        info.Exact = true;
+        for (size_t i = 0; i < node.Children.size(); i++)
+        {
+            const LiteralInfo child = Analyze(node.Children[i]);
+            if (child.Exact)
+            {
+                run += child.Text;
+                continue;
+            }
+            info.Exact = false;
+            if (run.size() > info.Text.size())
+                info.Text = run;
+            if (child.Text.size() > info.Text.size())
+                info.Text = child.Text;
+            run.clear();
+        }
+        if (info.Exact || run.size() > info.Text.size())
+            info.Text = run;
+        break;
+    }
+    case NODE_ALT:
+        if (node.Children.size() == 1)
+            info = Analyze(node.Children[0]);
+        break;
+    case NODE_REPEAT:
+        if (node.Min >= 1)
+        {
+            info = Analyze(node.Children[0]);
+            if (info.Exact && node.Min == node.Max)
+            {
+                const std::string text = info.Text;
+                for (int i = 1; i < node.Min && info.Text.size() < 256; i++)
+                    info.Text += text;
+                info.Exact = info.Text.size() == text.size() * (size_t)node.Min;
+            }
+            else
+            {
+                info.Exact = false;
+            }
+        }
+        break;
+    }
+    return info;
+}
+
+int RegexParser::Emit(int op, int set)
+{
+    Regex::Inst inst = { op, -1, -1, set };
+    Re->Program.push_back(inst);
+    return (int)Re->Program.size() - 1;
+}
+
+void RegexParser::Patch(const std::vector<int>& outs, int target)
+{
+    for (size_t n = 0; n < outs.size(); n++)
+    {
+        Regex::Inst& inst = Re->Program[outs[n] >> 1];
+        if (outs[n] & 1)
+            inst.Out1 = target;
+        else
+            inst.Out = target;
+    }
+}
+
+// Thompson's construction. Fails if the program gets too large ({m,n} repeats copy their contents).
+bool RegexParser::Compile(int n, Frag* out)
+{
+    if (Re->Program.size() > REGEX_MAX_PROGRAM)
+        return false;
+    const RegexNode& node = Nodes[n];
+    out->Outs.clear();
+    switch (node.Type)
+    {
+    case NODE_EMPTY: case NODE_SET: case NODE_BOL: case NODE_EOL:
+    {
+        const int op = node.Type == NODE_SET ? Regex::OP_SET : node.Type == NODE_BOL ? Regex::OP_BOL : node.Type == NODE_EOL ? Regex::OP_EOL : Regex::OP_JMP;
+        out->Start = Emit(op, node.Set);
+        out->Outs.push_back(out->Start * 2);
+        return true;
+    }
+    case NODE_CONCAT:
+    {
+        if (node.Children.empty())
+        {
+            out->Start = Emit(Regex::OP_JMP, -1);
+            out->Outs.push_back(out->Start * 2);
+            return true;
+        }
+        Frag next;
+        for (size_t i = 0; i < node.Children.size(); i++)
+        {
+            if (!Compile(Nodes[n].Children[i], i == 0 ? out : &next))
+                return false;
+            if (i > 0)
+            {
+                Patch(out->Outs, next.Start);
+                out->Outs.swap(next.Outs);
+            }
+        }
+        return true;
+    }
+    case NODE_ALT:
+    {
+        // split(child 0, split(child 1, ...)): the first alternative has the priority
+        Frag child;
+        int prev_split = -1;
+        for (size_t i = 0; i < node.Children.size(); i++)
+        {
+            const bool last = i + 1 == node.Children.size();
+            const int split = last ? -1 : Emit(Regex::OP_SPLIT, -1);
+            if (!Compile(Nodes[n].Children[i], &child))
+                return false;
+            const int start = last ? child.Start : split;
+            if (split >= 0)
+                Re->Program[split].Out = child.Start;
+            if (prev_split >= 0)
+                Re->Program[prev_split].Out1 = start;
+            else
+                out->Start = start;
+            out->Outs.insert(out->Outs.end(), child.Outs.begin(), child.Outs.end());
+            prev_split = split;
+        }
+        return true;
+    }
+    case NODE_REPEAT:
+    {
+        // x{m,n} is m copies of x followed by n - m nested optional ones, x{m,} by m - 1 copies and x+
+        const int child_node = node.Children[0];
+        const int min = node.Min, max = node.Max;
+        const bool greedy = node.Greedy;
+        const int preferred = greedy ? 0 : 1;
+        out->Start = -1;
+        Frag child;
+        const int copies = (max < 0 && min > 0) ? min - 1 : min;
+        for (int i = 0; i < copies; i++)
+        {
+            if (!Compile(child_node, &child))
+                return false;
+            if (out->Start < 0)
+                out->Start = child.Start;
+            else
+                Patch(out->Outs, child.Start);
+            out->Outs.swap(child.Outs);
+        }
+        if (max < 0)
+        {
+            // x+ (loop back after x) or x* (loop before x)
+            const bool plus = min > 0;
+            int split = -1;
+            if (!plus)
+                split = Emit(Regex::OP_SPLIT, -1);
+            if (!Compile(child_node, &child))
+                return false;
+            if (plus)
+                split = Emit(Regex::OP_SPLIT, -1);
+            Patch(child.Outs, split);
+            Regex::Inst& inst = Re->Program[split];
+            (preferred == 0 ? inst.Out : inst.Out1) = child.Start;
+            const int loop_start = plus ? child.Start : split;
+            if (out->Start < 0)
+                out->Start = loop_start;
+            else
+                Patch(out->Outs, loop_start);
+            out->Outs.assign(1, split * 2 + (1 - preferred));
+            return true;
+        }
+        std::vector<int> exits;
+        for (int i = min; i < max; i++)
+        {
+            const int split = Emit(Regex::OP_SPLIT, -1);
+            if (!Compile(child_node, &child))
+                return false;
+            Regex::Inst& inst = Re->Program[split];
+            (preferred == 0 ? inst.Out : inst.Out1) = child.Start;
+            exits.push_back(split * 2 + (1 - preferred));
+            if (out->Start < 0)
+                out->Start = split;
+            else
+                Patch(out->Outs, split);
+            out->Outs.swap(child.Outs);
+        }
+        if (out->Start < 0)
+        {
+            // x{0}
+            out->Start = Emit(Regex::OP_JMP, -1);
+            out->Outs.push_back(out->Start * 2);
+        }
+        out->Outs.insert(out->Outs.end(), exits.begin(), exits.end());
+        return true;
+    }
+    }
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+// Regex
+//-----------------------------------------------------------------------------
+
+Regex::Regex()
+{
+    CaseInsensitive = false;
+    LiteralOnly = false;
+    Start = 0;
+}
+
+bool Regex::Compile(const std::string& pattern, bool ignore_case, std::string* out_error)
+{
+    Source = pattern;
+    CaseInsensitive = ignore_case;
+    Literal.clear();
+    LiteralOnly = false;
+    Program.clear();
+    Sets.clear();
+    RegexParser parser(this, pattern);
+    if (!parser.Parse(out_error))
+    {
+        Program.clear();
+        Sets.clear();
+        Literal.clear();
+        LiteralOnly = false;
+        return false;
+    }
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// RegexMatcher
+//-----------------------------------------------------------------------------
+
+RegexMatcher::RegexMatcher(const Regex* regex)
+{
+    Re = regex;
+    CancelFlag = NULL;
+    Marks.assign(Re->Program.size(), 0);
+    MarkGeneration = 0;
+    ResetCache();
+}
+
+void RegexMatcher::NewGeneration()
+{
+    if (++MarkGeneration == 0)
+    {
+        std::fill(Marks.begin(), Marks.end(), 0u);
+        MarkGeneration = 1;
+    }
+}
+
+// Add to 'out' the instructions reachable from 'pc' without reading a byte, skipping those already visited in the
+// current generation. A $ that can't be passed yet is kept: the state has to know it is waiting for the end.
+void RegexMatcher::AddClosure(int pc, bool at_bol, bool at_eol, std::vector<int>* out)
+{
+    Stack.push_back(pc);
+    while (!Stack.empty())
+    {
+        pc = Stack.back();
+        Stack.pop_back();
+        if (Marks[pc] == MarkGeneration)
+            continue;
+        Marks[pc] = MarkGeneration;
+        const Regex::Inst& inst = Re->Program[pc];
+        switch (inst.Op)
+        {
+        case Regex::OP_JMP:
+            Stack.push_back(inst.Out);
+            break;
+        case Regex::OP_SPLIT:
+            Stack.push_back(inst.Out1);
+            Stack.push_back(inst.Out);
+            break;
+        case Regex::OP_BOL:
+            if (at_bol)
+                Stack.push_back(inst.Out);
+            break;
+        case Regex::OP_EOL:
+            if (at_eol)
+                Stack.push_back(inst.Out);
+            else
+                out->push_back(pc);
+            break;
+        default:
+            out->push_back(pc);
+            break;
+        }
+    }
+}
+
+// The id of the state for these instructions (sorted here), created if needed. The start state is never shared
+// with another one, since it is the only one where ^ holds.
+int RegexMatcher::AddState(std::vector<int>& insts, bool at_bol)
+{
+    std::sort(insts.begin(), insts.end());
+    if (!at_bol)
+    {
+        std::map<std::vector<int>, int>::const_iterator it = StateIds.find(insts);
+        if (it != StateIds.end())
+            return it->second;
+    }
+    uint8_t flags = 0;
+    for (size_t n = 0; n < insts.size(); n++)
+    {
+        const Regex::Inst& inst = Re->Program[insts[n]];
+        if (inst.Op == Regex::OP_MATCH)
+            flags |= STATE_ACCEPT | STATE_ACCEPT_AT_END;
+    }
+    if (insts.empty())
+        flags |= STATE_DEAD;
+    if ((flags & STATE_ACCEPT) == 0)
+    {
+        std::vector<int> at_end;
+        NewGeneration();
+        for (size_t n = 0; n < insts.size(); n++)
+            if (Re->Program[insts[n]].Op == Regex::OP_EOL)
+                AddClosure(Re->Program[insts[n]].Out, at_bol, true, &at_end);
+        for (size_t n = 0; n < at_end.size(); n++)
+            if (Re->Program[at_end[n]].Op == Regex::OP_MATCH)
+                flags |= STATE_ACCEPT_AT_END;
+    }
+    const int id = (int)States.size();
+    States.push_back(insts);
+    Flags.push_back(flags);
+    Next.resize(Next.size() + 256, -1);
+    if (!at_bol)
+        StateIds[insts] = id;
+    return id;
+}
+
+void RegexMatcher::ResetCache()
+{
+    States.clear();
+    Flags.clear();
+    StateIds.clear();
+    Next.clear();
+    std::vector<int> insts;
+    NewGeneration();
+    AddClosure(Re->Start, true, false, &insts);
+    StartState = AddState(insts, true);
+}
+
+// Compute (and cache) the state after reading 'c' in 'state'
+int RegexMatcher::Transition(int state, unsigned char c)
+{
+    TempInsts.clear();
+    NewGeneration();
+    const std::vector<int>& insts = States[state];
+    for (size_t n = 0; n < insts.size(); n++)
+    {
+        const Regex::Inst& inst = Re->Program[insts[n]];
+        if (inst.Op == Regex::OP_SET && Re->Sets[inst.Set].Has(c))
+            AddClosure(inst.Out, false, false, &TempInsts);
+    }
+    AddClosure(Re->Start, false, false, &TempInsts);
+    if (States.size() >= REGEX_MAX_DFA_STATES)
+    {
+        ResetCache();   // 'state' is gone, the transition isn't cached
+        return AddState(TempInsts, false);
+    }
+    const int next = AddState(TempInsts, false);
+    Next[(size_t)state * 256 + c] = (Flags[next] & (STATE_ACCEPT | STATE_DEAD)) ? -2 - next : next * 256;
+    return next;
+}
+
+bool RegexMatcher::MatchLine(const char* line, const char* line_end)
+{
+    if (Flags[StartState] & (STATE_ACCEPT | STATE_DEAD))
+        return (Flags[StartState] & STATE_ACCEPT) != 0;
+    size_t row = (size_t)StartState * 256;
+    for (const char* p = line; p < line_end; )
+    {
+        const char* block_end = (size_t)(line_end - p) > REGEX_CANCEL_CHECK_INTERVAL ? p + REGEX_CANCEL_CHECK_INTERVAL : line_end;
+        for (; p < block_end; p++)
+        {
+            // Next[] holds the row of the next state. Accepting and dead states are stored negated: one test per
+            // byte for both them and the transitions not computed yet.
+            const unsigned char c = (unsigned char)*p;
+            int next = Next[row + c];
+            if (next < 0)
+            {
+                const int state = next == -1 ? Transition((int)(row / 256), c) : -2 - next;
+                if (Flags[state] & (STATE_ACCEPT | STATE_DEAD))
+                    return (Flags[state] & STATE_ACCEPT) != 0;
+                next = state * 256;
+            }
+            row = (size_t)next;
+        }
+        if (CancelFlag != NULL && CancelFlag->load())
+            return false;
+    }
+    return (Flags[row / 256] & STATE_ACCEPT_AT_END) != 0;
+}
+
+// Add the thread at 'pc' and those it splits into to 'list', in priority order, following the instructions that
+// don't read a byte. Instructions already in the list (current generation) are skipped: they have the priority.
+void RegexMatcher::AddThread(std::vector<Thread>* list, int pc, const char* begin, const char* pos, const char* line, const char* line_end)
+{
+    Stack.push_back(pc);
+    while (!Stack.empty())
+    {
+        pc = Stack.back();
+        Stack.pop_back();
+        if (Marks[pc] == MarkGeneration)
+            continue;
+        Marks[pc] = MarkGeneration;
+        const Regex::Inst& inst = Re->Program[pc];
+        switch (inst.Op)
+        {
+        case Regex::OP_JMP:
+            Stack.push_back(inst.Out);
+            break;
+        case Regex::OP_SPLIT:
+            Stack.push_back(inst.Out1);
+            Stack.push_back(inst.Out);
+            break;
+        case Regex::OP_BOL:
+            if (pos == line)
+                Stack.push_back(inst.Out);
+            break;
+        case Regex::OP_EOL:
+            if (pos == line_end)
+                Stack.push_back(inst.Out);
+            break;
+        default:
+        {
+            Thread thread = { pc, begin };
+            list->push_back(thread);
+            break;
+        }
+        }
+    }
+}
+
+// Pike VM: all the threads advance together, one byte at a time. A thread starts at each position until a match is
+// found, with a lower priority than the ones started before: the leftmost match wins, then the priorities of the
+// alternatives and quantifiers decide.
+bool RegexMatcher::FindInLine(const char* line, const char* line_end, const char* from, const char** out_begin, const char** out_end)
+{
+    bool matched = false;
+    Threads.clear();
+    NewGeneration();
+    AddThread(&Threads, Re->Start, from, from, line, line_end);
+    for (const char* pos = from; ; pos++)
+    {
+        if (CancelFlag != NULL && (size_t)(pos - from) % REGEX_CANCEL_CHECK_INTERVAL == 0 && pos > from && CancelFlag->load())
+            return false;
+        NextThreads.clear();
+        NewGeneration();
+        for (size_t n = 0; n < Threads.size(); n++)
+        {
+            const Thread& thread = Threads[n];
+            const Regex::Inst& inst = Re->Program[thread.Pc];
+            if (inst.Op == Regex::OP_MATCH)
+            {
+                matched = true;
+                *out_begin = thread.Begin;
+                *out_end = pos;
+                break;  // The threads after this one have a lower priority
+            }
+            if (pos < line_end && Re->Sets[inst.Set].Has((unsigned char)*pos))
+                AddThread(&NextThreads, inst.Out, thread.Begin, pos + 1, line, line_end);
+        }
+        if (pos == line_end)
+            break;
+        if (!matched)
+            AddThread(&NextThreads, Re->Start, pos + 1, pos + 1, line, line_end);
+        Threads.swap(NextThreads);
+        if (Threads.empty() && matched)
+            break;
+    }
+    return matched;
+}
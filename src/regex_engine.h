@@ -0,0 +1,116 @@
+// Regular expressions for searching text, line by line.
+// The pattern is compiled to a Thompson NFA (a small program of byte-set, split and assertion instructions). It is run
+// two ways by RegexMatcher:
+// - MatchLine() tells whether a line contains a match with a DFA built lazily from the NFA and cached, so each byte
+//   costs one table lookup once the states it goes through exist. There is no backtracking, whatever the pattern.
+// - FindInLine() finds where the leftmost match is (Perl's leftmost-first semantics) by simulating the NFA (Pike VM).
+//   It is slower, it is meant to be run on lines MatchLine() accepted.
+// Every match contains RequiredLiteral() when it isn't empty: searching for it with FindText() first skips the lines
+// that can't match at memory bandwidth. When IsLiteral(), that is all there is to match.
+//
+// Syntax: literals (UTF-8), '.', [classes] with ranges and [^negation], \d \w \s \D \W \S, \t \r \f \v \xHH, escaped
+// punctuation, groups (...) and (?:...), alternation |, quantifiers * + ? {m} {m,} {m,n} and their lazy variants
+// (*? etc.), anchors ^ and $ (start and end of the line). '.' and negated classes match a whole UTF-8 character;
+// 'ignore_case' folds ASCII letters. Not supported: backreferences, lookaround, \b.
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+
+// 256 bits, one per byte value
+struct RegexByteSet
+{
+    uint32_t    Bits[8];
+    bool        Has(unsigned char c) const          { return (Bits[c >> 5] >> (c & 31)) & 1; }
+};
+
+class Regex
+{
+public:
+    Regex();
+
+    // Returns false and sets 'out_error' if the pattern is invalid or uses something unsupported
+    bool        Compile(const std::string& pattern, bool ignore_case, std::string* out_error);
+    bool        IsCompiled() const                  { return !Program.empty(); }
+    const std::string& Pattern() const              { return Source; }
+    bool        IgnoreCase() const                  { return CaseInsensitive; }
+    const std::string& RequiredLiteral() const      { return Literal; }    // To be searched with FindText(..., IgnoreCase())
+    bool        IsLiteral() const                   { return LiteralOnly; }
+
+private:
+    friend class RegexMatcher;
+    friend class RegexParser;
+
+    enum InstOp { OP_SET, OP_SPLIT, OP_JMP, OP_BOL, OP_EOL, OP_MATCH };
+
+    struct Inst
+    {
+        int         Op;
+        int         Out;
+        int         Out1;       // OP_SPLIT: lower priority branch
+        int         Set;        // OP_SET: index in Sets
+    };
+
+    std::string                 Source;
+    bool                        CaseInsensitive;
+    std::string                 Literal;
+    bool                        LiteralOnly;
+    std::vector<Inst>           Program;
+    std::vector<RegexByteSet>   Sets;
+    int                         Start;
+};
+
+// Matching state for one thread: the DFA cache lives here. A Regex can be shared by as many matchers as needed, it is
+// not modified by them.
+class RegexMatcher
+{
+public:
+    explicit RegexMatcher(const Regex* regex);
+
+    // Whether [line, line_end) contains a match. The line doesn't include its '\n'.
+    bool        MatchLine(const char* line, const char* line_end);
+
+    // Leftmost match starting at or after 'from' in [line, line_end) (^ and $ refer to the ends of the line).
+    // Returns false if there is none. A match can be empty.
+    bool        FindInLine(const char* line, const char* line_end, const char* from, const char** out_begin, const char** out_end);
+
+    // When 'cancel' becomes true, MatchLine() and FindInLine() give up (returning false) within a few dozen KB, so
+    // that a worker matching a huge line can be stopped
+    void        SetCancelFlag(const std::atomic<bool>* cancel)  { CancelFlag = cancel; }
+
+private:
+    // A DFA state is the sorted set of NFA instructions the threads are at: byte sets, $ waiting for the end of the
+    // line, match. Every state also holds the start of the regex, since a match can start anywhere in the line.
+    enum StateFlags { STATE_ACCEPT = 1, STATE_DEAD = 2, STATE_ACCEPT_AT_END = 4 };
+
+    struct Thread
+    {
+        int         Pc;
+        const char* Begin;
+    };
+
+    const Regex*                        Re;
+    const std::atomic<bool>*            CancelFlag;
+    std::vector<std::vector<int> >      States;
+    std::vector<uint8_t>                Flags;          // StateFlags of each state
+    std::map<std::vector<int>, int>     StateIds;       // All states but StartState
+    std::vector<int>                    Next;           // Next[state * 256 + byte] (see MatchLine()), -1 until computed
+    int                                 StartState;     // At the start of a line
+    std::vector<int>                    Stack;
+    std::vector<unsigned>               Marks;          // Instructions already visited, when == MarkGeneration
+    unsigned                            MarkGeneration;
+    std::vector<int>                    TempInsts;
+    std::vector<Thread>                 Threads;        // Pike VM, in priority order
+    std::vector<Thread>                 NextThreads;
+
+    void        NewGeneration();
+    void        AddClosure(int pc, bool at_bol, bool at_eol, std::vector<int>* out);
+    int         AddState(std::vector<int>& insts, bool at_bol);
+    void        ResetCache();
+    int         Transition(int state, unsigned char c);
+    void        AddThread(std::vector<Thread>* list, int pc, const char* begin, const char* pos, const char* line, const char* line_end);
+};
@@ -0,0 +1,414 @@
+// Searching several documents for a regular expression at once (see regex_search.h)
+
+#include "regex_search.h"
+#include "text_search.h"
+#include "file_io.h"
+#include <string.h>
+#include <algorithm>
+
+// Unit of work of the worker threads: small enough for a few hundred MB to keep every core busy, large enough for
+// the per-chunk costs (finding the line boundaries, publishing) not to matter
+static const size_t REGEX_SEARCH_CHUNK_SIZE = 1024 * 1024;
+
+static size_t CountNewlines(const char* data, const char* data_end)
+{
+    size_t count = 0;
+    while (data < data_end)
+    {
+        const char* p = (const char*)memchr(data, '\n', (size_t)(data_end - data));
+        if (p == NULL)
+            break;
+        count++;
+        data = p + 1;
+    }
+    return count;
+}
+
+static inline bool IsUtf8Continuation(char c)
+{
+    return ((unsigned char)c & 0xC0) == 0x80;
+}
+
+const size_t RegexLineScanner::PreviewMaxLen;
+const size_t RegexLineScanner::PreviewContext;
+
+RegexLineScanner::RegexLineScanner(const char* data, const char* data_end, RegexMatcher* matcher, const Regex& regex) : Re(regex)
+{
+    Data = data;
+    DataEnd = data_end;
+    Matcher = matcher;
+    NextLine = data;
+    CurLine = CurEnd = data;
+    Found = NULL;
+    Counted = data;
+    Lines = 0;
+}
+
+bool RegexLineScanner::Next()
+{
+    const std::string& literal = Re.RequiredLiteral();
+    const bool literal_only = Re.IsLiteral();
+    while (NextLine != NULL)
+    {
+        // Go straight to the next line containing the literal
+        const char* p = NextLine;
+        const char* line = p;
+        const char* found = NULL;
+        if (!literal.empty())
+        {
+            found = FindText(p, (size_t)(DataEnd - p), literal.data(), literal.size(), Re.IgnoreCase());
+            if (found == NULL)
+            {
+                NextLine = NULL;
+                break;
+            }
+            for (line = found; line > p && line[-1] != '\n'; )
+                line--;
+        }
+        const char* line_end = (const char*)memchr(line, '\n', (size_t)(DataEnd - line));
+        NextLine = line_end != NULL ? line_end + 1 : NULL;
+        if (line_end == NULL)
+            line_end = DataEnd;
+        const char* match_end = (line_end > line && line_end[-1] == '\r') ? line_end - 1 : line_end;
+        if ((literal_only && found + literal.size() <= match_end) || (!literal_only && Matcher->MatchLine(line, match_end)))
+        {
+            CurLine = line;
+            CurEnd = match_end;
+            Found = found;
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t RegexLineScanner::LineNumber()
+{
+    Lines += CountNewlines(Counted, CurLine);
+    Counted = CurLine;
+    return Lines;
+}
+
+size_t RegexLineScanner::LineCount() const
+{
+    return 1 + Lines + CountNewlines(Counted, DataEnd);
+}
+
+void RegexLineScanner::GetPreview(const char* line, size_t line_len, size_t match_pos, size_t* out_begin, size_t* out_end)
+{
+    size_t begin = 0;
+    size_t end = line_len;
+    if (line_len > PreviewMaxLen)
+    {
+        begin = match_pos > PreviewContext ? match_pos - PreviewContext : 0;
+        while (begin > 0 && IsUtf8Continuation(line[begin]))
+            begin--;
+        end = std::min(line_len, begin + PreviewMaxLen);
+        while (end < line_len && IsUtf8Continuation(line[end]))
+            end--;
+    }
+    *out_begin = begin;
+    *out_end = end;
+}
+
+const size_t RegexSearch::MaxHits;
+
+RegexSearch::RegexSearch()
+{
+    KeptHits = 0;
+    TotalBytes = 0;
+    NextChunk.store(0);
+    SearchedBytes.store(0);
+    Count.store(0);
+    RunningWorkers.store(0);
+    Done.store(true);
+    CancelRequested.store(false);
+}
+
+RegexSearch::~RegexSearch()
+{
+    Cancel();
+}
+
+void RegexSearch::Cancel()
+{
+    CancelRequested.store(true);
+    for (size_t n = 0; n < Workers.size(); n++)
+        Workers[n].join();
+    Workers.clear();
+}
+
+void RegexSearch::Clear()
+{
+    Cancel();
+    Texts.clear();
+    Chunks.clear();
+    KeptHits = 0;
+    TotalBytes = 0;
+    SearchedBytes.store(0);
+    Count.store(0);
+}
+
+void RegexSearch::AddText(const PieceTable& text)
+{
+    Texts.push_back(TextData());
+    TextData& data = Texts.back();
+    text.GetSnapshot(&data.Snapshot);
+    data.Mapped = false;
+    data.Snapshot.GetSegments(&data.Segments);
+    data.Size = data.Snapshot.Size;
+}
+
+void RegexSearch::AddMapped(const char* data, size_t size)
+{
+    Texts.push_back(TextData());
+    TextData& text = Texts.back();
+    text.Mapped = true;
+    if (size > 0)
+    {
+        Segment segment = { data, size, 0 };
+        text.Segments.push_back(segment);
+    }
+    text.Size = size;
+}
+
+bool RegexSearch::Start(const std::string& pattern, bool ignore_case, std::string* out_error)
+{
+    Cancel();
+    Chunks.clear();
+    KeptHits = 0;
+    TotalBytes = 0;
+    SearchedBytes.store(0);
+    Count.store(0);
+    for (size_t t = 0; t < Texts.size(); t++)
+    {
+        TextData& text = Texts[t];
+        text.FirstChunk = Chunks.size();
+        for (size_t begin = 0; begin < text.Size; begin += REGEX_SEARCH_CHUNK_SIZE)
+        {
+            Chunk chunk;
+            chunk.Text = (int)t;
+            chunk.Begin = begin;
+            chunk.End = std::min(text.Size, begin + REGEX_SEARCH_CHUNK_SIZE);
+            chunk.Done = false;
+            chunk.Lines = 0;
+            chunk.HitCount = 0;
+            Chunks.push_back(chunk);
+        }
+        text.ChunkCount = Chunks.size() - text.FirstChunk;
+        text.PublishedChunks = 0;
+        text.PublishedLines = 0;
+        text.Hits.clear();
+        text.Previews.clear();
+        TotalBytes += text.Size;
+    }
+    if (!Re.Compile(pattern, ignore_case, out_error))
+    {
+        Chunks.clear();
+        return false;
+    }
+    HitMatcher.reset(new RegexMatcher(&Re));
+
+    const size_t worker_count = std::min((size_t)std::max(1u, std::thread::hardware_concurrency()), Chunks.size());
+    NextChunk.store(0);
+    CancelRequested.store(false);
+    Done.store(worker_count == 0);
+    RunningWorkers.store((int)worker_count);
+    for (size_t n = 0; n < worker_count; n++)
+        Workers.push_back(std::thread(&RegexSearch::Work, this));
+    return true;
+}
+
+size_t RegexSearch::KeptHitCount() const
+{
+    std::lock_guard<std::mutex> lock(HitsMutex);
+    return KeptHits;
+}
+
+bool RegexSearch::GetHit(size_t index, Hit* out) const
+{
+    std::lock_guard<std::mutex> lock(HitsMutex);
+    for (size_t t = 0; t < Texts.size(); t++)
+    {
+        if (index >= Texts[t].Hits.size())
+        {
+            index -= Texts[t].Hits.size();
+            continue;
+        }
+        const StoredHit& hit = Texts[t].Hits[index];
+        out->Text = (int)t;
+        out->Line = hit.Line;
+        out->Preview.assign(Texts[t].Previews, hit.PreviewOffset, hit.PreviewLen);
+        out->PreviewPos = hit.MatchPos;
+        out->Len = hit.MatchLen;
+        if (hit.MatchPos == NotLocated)
+        {
+            const char* line = out->Preview.data();
+            const char* match_begin = line;
+            const char* match_end = line;
+            HitMatcher->FindInLine(line, line + out->Preview.size(), line, &match_begin, &match_end);
+            out->PreviewPos = (size_t)(match_begin - line);
+            out->Len = (size_t)(match_end - match_begin);
+        }
+        out->Pos = hit.LinePos + out->PreviewPos;
+        return true;
+    }
+    return false;
+}
+
+// Index of the segment containing 'pos' (or the last one)
+size_t RegexSearch::FindSegment(const TextData& text, size_t pos)
+{
+    size_t lo = 0, hi = text.Segments.size();
+    while (hi - lo > 1)
+    {
+        const size_t mid = (lo + hi) / 2;
+        if (text.Segments[mid].Pos <= pos)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// Offset of the first '\n' in [from, limit), (size_t)-1 if there is none
+size_t RegexSearch::FindNewline(const TextData& text, size_t from, size_t limit)
+{
+    for (size_t s = FindSegment(text, from); s < text.Segments.size() && text.Segments[s].Pos < limit; s++)
+    {
+        const Segment& segment = text.Segments[s];
+        const size_t begin = std::max(from, segment.Pos) - segment.Pos;
+        const size_t end = std::min(limit, segment.Pos + segment.Len) - segment.Pos;
+        if (begin >= end)
+            continue;
+        const char* p = (const char*)memchr(segment.Data + begin, '\n', end - begin);
+        if (p != NULL)
+            return segment.Pos + (size_t)(p - segment.Data);
+    }
+    return (size_t)-1;
+}
+
+// [begin, end) of the text as contiguous bytes: in place when it is in one segment, else copied into 'buffer'
+const char* RegexSearch::GetText(const TextData& text, size_t begin, size_t end, std::string* buffer)
+{
+    size_t s = FindSegment(text, begin);
+    if (s < text.Segments.size() && end <= text.Segments[s].Pos + text.Segments[s].Len)
+        return text.Segments[s].Data + (begin - text.Segments[s].Pos);
+    buffer->clear();
+    for (; s < text.Segments.size() && buffer->size() < end - begin; s++)
+    {
+        const Segment& segment = text.Segments[s];
+        const size_t offset = begin > segment.Pos ? begin - segment.Pos : 0;
+        buffer->append(segment.Data + offset, std::min(segment.Len - offset, end - begin - buffer->size()));
+    }
+    return buffer->data();
+}
+
+void RegexSearch::Work()
+{
+    RegexMatcher matcher(&Re);
+    matcher.SetCancelFlag(&CancelRequested);
+    std::string buffer;
+    Chunk result;
+    for (size_t c = NextChunk++; c < Chunks.size() && !CancelRequested.load(); c = NextChunk++)
+    {
+        SearchChunk(c, &matcher, &buffer, &result);
+        Publish(c, &result);
+        const Chunk& chunk = Chunks[c];
+        const TextData& text = Texts[chunk.Text];
+        if (text.Mapped)
+            ReleaseMappedPages(text.Segments[0].Data, chunk.Begin, chunk.End - chunk.Begin);
+        SearchedBytes += chunk.End - chunk.Begin;
+    }
+    if (RunningWorkers.fetch_sub(1) == 1)
+        Done.store(true);
+}
+
+// The lines starting in the chunk: the first one starts after the first '\n' at or after Begin - 1 (at 0 for the
+// first chunk), the last one ends at the first '\n' at or after End - 1.
+void RegexSearch::SearchChunk(size_t c, RegexMatcher* matcher, std::string* buffer, Chunk* out) const
+{
+    const Chunk& chunk = Chunks[c];
+    const TextData& text = Texts[chunk.Text];
+    out->Lines = 0;
+    out->HitCount = 0;
+    out->Hits.clear();
+    out->Previews.clear();
+    size_t first = chunk.Begin;
+    if (first > 0)
+    {
+        const size_t newline = FindNewline(text, first - 1, chunk.End - 1);
+        if (newline == (size_t)-1)
+            return; // In the middle of a line started by a previous chunk
+        first = newline + 1;
+    }
+    size_t end = FindNewline(text, chunk.End - 1, text.Size);
+    if (end == (size_t)-1)
+        end = text.Size;
+
+    const char* data = GetText(text, first, end, buffer);
+    const bool literal_only = Re.IsLiteral();
+    RegexLineScanner lines(data, data + (end - first), matcher, Re);
+    while (lines.Next())
+    {
+        out->HitCount++;
+        if (out->Hits.size() >= MaxHits)
+            continue;
+        const char* line = lines.Line();
+        const size_t line_len = (size_t)(lines.LineEnd() - line);
+        StoredHit hit;
+        hit.Line = lines.LineNumber();
+        hit.MatchPos = literal_only ? (size_t)(lines.LiteralMatch() - line) : NotLocated;
+        hit.MatchLen = literal_only ? Re.RequiredLiteral().size() : 0;
+        if (line_len > RegexLineScanner::PreviewMaxLen && !literal_only)
+        {
+            // Long line: locate the match now, to keep the part around it
+            const char* match_begin = line;
+            const char* match_last = line;
+            matcher->FindInLine(line, lines.LineEnd(), line, &match_begin, &match_last);
+            hit.MatchPos = (size_t)(match_begin - line);
+            hit.MatchLen = (size_t)(match_last - match_begin);
+        }
+        size_t preview_begin, preview_end;
+        RegexLineScanner::GetPreview(line, line_len, hit.MatchPos, &preview_begin, &preview_end);
+        if (hit.MatchPos != NotLocated)
+            hit.MatchPos -= preview_begin;
+        hit.LinePos = first + (size_t)(line - data) + preview_begin;
+        hit.PreviewOffset = out->Previews.size();
+        hit.PreviewLen = preview_end - preview_begin;
+        out->Previews.append(line + preview_begin, hit.PreviewLen);
+        out->Hits.push_back(hit);
+    }
+    out->Lines = lines.LineCount();
+}
+
+// The chunk is done. Publish its hits, and those of the chunks after it that were waiting for its line count.
+void RegexSearch::Publish(size_t c, Chunk* result)
+{
+    std::lock_guard<std::mutex> lock(HitsMutex);
+    Chunk& done = Chunks[c];
+    done.Done = true;
+    done.Lines = result->Lines;
+    done.HitCount = result->HitCount;
+    done.Hits.swap(result->Hits);
+    done.Previews.swap(result->Previews);
+    TextData& text = Texts[done.Text];
+    while (text.PublishedChunks < text.ChunkCount)
+    {
+        Chunk& chunk = Chunks[text.FirstChunk + text.PublishedChunks];
+        if (!chunk.Done)
+            break;
+        for (size_t n = 0; n < chunk.Hits.size() && KeptHits < MaxHits; n++, KeptHits++)
+        {
+            StoredHit hit = chunk.Hits[n];
+            hit.Line += text.PublishedLines;
+            hit.PreviewOffset = text.Previews.size();
+            text.Previews.append(chunk.Previews, chunk.Hits[n].PreviewOffset, hit.PreviewLen);
+            text.Hits.push_back(hit);
+        }
+        Count += chunk.HitCount;
+        text.PublishedLines += chunk.Lines;
+        std::vector<StoredHit>().swap(chunk.Hits);
+        std::string().swap(chunk.Previews);
+        text.PublishedChunks++;
+    }
+}
@@ -0,0 +1,167 @@
+// Searching several documents for a regular expression at once ("Search all tabs").
+// Each text is cut into chunks of REGEX_SEARCH_CHUNK_SIZE bytes, which worker threads (one per core) take in turn:
+// a huge tab is searched by every core as well as many small ones. A chunk owns the lines that start in it, so a
+// worker reads on to the end of its last line and skips the start of its first one, which the previous chunk owns.
+// The lines that can't match are skipped with FindText() when the regex has a required literal, the others are run
+// through its DFA (see regex_engine.h).
+// A chunk doesn't know the number of its first line until the chunks before it have counted theirs: hits are kept
+// per chunk until then, and published in the order of the text, while the search goes on.
+// A hit only keeps its line (or the part of it around the match for a long line). Where the match is in a short line
+// is found when the hit is read: the list only shows a screenful of them, and the workers only run the DFA.
+
+#pragma once
+
+#include "piece_table.h"
+#include "regex_engine.h"
+#include <stddef.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The lines of a buffer that a regex matches, in order: how RegexSearch, ProjectSearch and TextReplace read a text.
+// Lines without the required literal of the regex are skipped with FindText(), the others are run through the DFA
+// (or only checked for the literal, when the regex is one).
+class RegexLineScanner
+{
+public:
+    static const size_t PreviewMaxLen = 200;        // Longer lines are previewed around their match
+    static const size_t PreviewContext = 60;        // Bytes kept before the match then
+
+    RegexLineScanner(const char* data, const char* data_end, RegexMatcher* matcher, const Regex& regex);
+
+    bool        Next();                             // Move to the next matching line. Returns false at the end.
+    const char* Line() const                        { return CurLine; }
+    const char* LineEnd() const                     { return CurEnd; }      // Before its '\n' (and '\r')
+    const char* LiteralMatch() const                { return Found; }       // First match in the line of a literal regex
+    size_t      LineNumber();                       // Of the current line, from 0 at 'data'
+    size_t      LineCount() const;                  // In the whole buffer
+
+    // The part of a line of 'line_len' bytes to show for a match at 'match_pos': the whole line when it is short,
+    // else the part around the match, cut on UTF-8 character boundaries.
+    static void GetPreview(const char* line, size_t line_len, size_t match_pos, size_t* out_begin, size_t* out_end);
+
+private:
+    const char*     Data;
+    const char*     DataEnd;
+    RegexMatcher*   Matcher;
+    const Regex&    Re;
+    const char*     NextLine;                       // NULL once the last line was read
+    const char*     CurLine;
+    const char*     CurEnd;
+    const char*     Found;
+    const char*     Counted;                        // Lines are counted up to there
+    size_t          Lines;
+
+    RegexLineScanner(const RegexLineScanner&);
+    RegexLineScanner& operator=(const RegexLineScanner&);
+};
+
+class RegexSearch
+{
+public:
+    static const size_t MaxHits = 256 * 1024;       // Hits past this many are counted but not kept
+
+    struct Hit
+    {
+        int         Text;           // Index of the text, in the order they were added
+        size_t      Line;           // From 0
+        size_t      Pos;            // Offset of the match in the text
+        size_t      Len;            // Of the match
+        std::string Preview;        // The line, or the part of it around the match for a long line
+        size_t      PreviewPos;     // Offset of the match in Preview
+    };
+
+    RegexSearch();
+    ~RegexSearch();                                 // Cancel()
+
+    // Set the texts to search: PieceTables through snapshots (they can be edited meanwhile), read-only memory
+    // mappings (FileView::Data()) which must outlive the search. Clear() cancels the search and forgets its hits.
+    void        Clear();
+    void        AddText(const PieceTable& text);
+    void        AddMapped(const char* data, size_t size);
+
+    // Search the texts added since Clear(). Returns false and sets 'out_error' if the pattern is invalid.
+    bool        Start(const std::string& pattern, bool ignore_case, std::string* out_error);
+    void        Cancel();
+
+    const Regex& Pattern() const                    { return Re; }
+    int         TextCount() const                   { return (int)Texts.size(); }
+    bool        IsSearching() const                 { return !Done.load(); }
+    float       Progress() const                    { return TotalBytes > 0 ? (float)((double)SearchedBytes.load() / (double)TotalBytes) : 1.0f; }
+    size_t      HitCount() const                    { return Count.load(); }    // Published so far, kept or not
+    size_t      KeptHitCount() const;
+
+    // Hits are ordered by text then position. Returns false if 'index' is past the hits published so far.
+    // To be called from one thread (the UI): the match is located with a RegexMatcher of its own.
+    bool        GetHit(size_t index, Hit* out) const;
+
+private:
+    typedef PieceTableSnapshot::Segment Segment;
+
+    static const size_t NotLocated = (size_t)-1;
+
+    struct StoredHit
+    {
+        size_t      Line;
+        size_t      LinePos;            // Offset in the text where the preview starts
+        size_t      PreviewOffset;      // In the Previews of the text (of the chunk until published)
+        size_t      PreviewLen;
+        size_t      MatchPos;           // In the preview. NotLocated when the preview is the whole line: FindInLine() it
+        size_t      MatchLen;
+    };
+
+    struct TextData
+    {
+        PieceTableSnapshot      Snapshot;           // Keeps the blocks of a PieceTable alive while they are searched
+        bool                    Mapped;
+        std::vector<Segment>    Segments;
+        size_t                  Size;
+        size_t                  FirstChunk;
+        size_t                  ChunkCount;
+        size_t                  PublishedChunks;    // Protected by HitsMutex, as are the following
+        size_t                  PublishedLines;
+        std::vector<StoredHit>  Hits;
+        std::string             Previews;
+    };
+
+    struct Chunk
+    {
+        int                     Text;
+        size_t                  Begin;
+        size_t                  End;
+        bool                    Done;               // Protected by HitsMutex, as are the following
+        size_t                  Lines;              // Number of lines starting in the chunk
+        size_t                  HitCount;
+        std::vector<StoredHit>  Hits;               // Their Line counts from the chunk's first line
+        std::string             Previews;
+    };
+
+    Regex                       Re;
+    mutable std::unique_ptr<RegexMatcher> HitMatcher;  // For GetHit()
+    std::vector<TextData>       Texts;
+    std::vector<Chunk>          Chunks;
+    std::vector<std::thread>    Workers;
+    mutable std::mutex          HitsMutex;
+    size_t                      KeptHits;           // Protected by HitsMutex
+    size_t                      TotalBytes;
+    std::atomic<size_t>         NextChunk;
+    std::atomic<size_t>         SearchedBytes;
+    std::atomic<size_t>         Count;
+    std::atomic<int>            RunningWorkers;
+    std::atomic<bool>           Done;
+    std::atomic<bool>           CancelRequested;
+
+    void        Work();
+    void        SearchChunk(size_t chunk, RegexMatcher* matcher, std::string* buffer, Chunk* out) const;
+    void        Publish(size_t chunk, Chunk* result);
+
+    static size_t       FindSegment(const TextData& text, size_t pos);
+    static size_t       FindNewline(const TextData& text, size_t from, size_t limit);
+    static const char*  GetText(const TextData& text, size_t begin, size_t end, std::string* buffer);
+
+    RegexSearch(const RegexSearch&);
+    RegexSearch& operator=(const RegexSearch&);
+};
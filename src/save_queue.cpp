@@ -0,0 +1,463 @@
+// Saving documents on a background thread (see save_queue.h)
+
+#include "save_queue.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Small spans (typed text) are gathered into a buffer of this size, bigger ones are written directly from the blocks
+static const size_t WRITE_BUFFER_SIZE = 1024 * 1024;
+
+// Upper bound for a single write() call
+static const size_t WRITE_CHUNK_SIZE = 64 * 1024 * 1024;
+
+// Runs of unchanged text at least this long are copied from the old file by the kernel rather than written from memory
+static const size_t COPY_RANGE_MIN_SIZE = 1024 * 1024;
+
+// Files are only patched in place when they are at least this big (smaller ones are cheap to rewrite atomically)
+// and at most this many bytes have to be written
+static const size_t IN_PLACE_MIN_FILE_SIZE = 64 * 1024 * 1024;
+static const size_t IN_PLACE_MAX_WRITE = 16 * 1024 * 1024;
+
+#ifdef _WIN32
+static int  FileOpenRead(const char* filename)                  { return _open(filename, _O_RDONLY | _O_BINARY); }
+static int  FileOpenWrite(const char* filename)                 { return _open(filename, _O_WRONLY | _O_BINARY); }
+static long FileWriteAt(int fd, const char* src, size_t len, size_t offset)
+{
+    if (_lseeki64(fd, (__int64)offset, SEEK_SET) < 0)
+        return -1;
+    return _write(fd, src, (unsigned int)len);
+}
+static long FileCopyRange(int, size_t, int, size_t)             { errno = ENOSYS; return -1; }
+static bool FileTruncate(int fd, size_t size)                   { return _chsize_s(fd, (__int64)size) == 0; }
+static std::string FileResolveLinks(const std::string& filename) { return filename; }
+static bool FileReplaceLosesIdentity(const char*)               { return false; }
+static void FileCopyAttributes(const char*, int)                {}
+static void FileSyncParentDir(const std::string&)               {}
+#else
+static int  FileOpenRead(const char* filename)                  { return open(filename, O_RDONLY); }
+static int  FileOpenWrite(const char* filename)                 { return open(filename, O_WRONLY); }
+static long FileWriteAt(int fd, const char* src, size_t len, size_t offset)
+{
+    ssize_t n;
+    do { n = pwrite(fd, src, len, (off_t)offset); } while (n < 0 && errno == EINTR);
+    return (long)n;
+}
+// Copy from 'src_fd' at 'src_offset' to the current position of 'dst_fd' without going through user space
+static long FileCopyRange(int src_fd, size_t src_offset, int dst_fd, size_t len)
+{
+#if defined(__linux__)
+    loff_t off = (loff_t)src_offset;
+    ssize_t n;
+    do { n = copy_file_range(src_fd, &off, dst_fd, NULL, len, 0); } while (n < 0 && errno == EINTR);
+    return (long)n;
+#else
+    (void)src_fd; (void)src_offset; (void)dst_fd; (void)len;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+static bool FileTruncate(int fd, size_t size)                   { return ftruncate(fd, (off_t)size) == 0; }
+// The file a symlink points to: that is the file to replace, the link stays. Dangling links are returned as they are.
+static std::string FileResolveLinks(const std::string& filename)
+{
+    struct stat st;
+    if (lstat(filename.c_str(), &st) != 0 || !S_ISLNK(st.st_mode))
+        return filename;
+    char* resolved = realpath(filename.c_str(), NULL);
+    if (resolved == NULL)
+        return filename;
+    const std::string result(resolved);
+    free(resolved);
+    return result;
+}
+// Whether a new file renamed over 'filename' can't be the same file for its users: it would be cut from the file's
+// other hard links, or belong to us rather than to the file's owner
+static bool FileReplaceLosesIdentity(const char* filename)
+{
+    struct stat st;
+    if (stat(filename, &st) != 0)
+        return false;
+    return st.st_nlink > 1 || (geteuid() != 0 && st.st_uid != geteuid());
+}
+static void FileCopyAttributes(const char* filename, int fd)
+{
+    struct stat st;
+    if (stat(filename, &st) != 0)
+        return;
+    // Owner first: changing it clears the set-user-ID and set-group-ID bits
+    if (fchown(fd, st.st_uid, st.st_gid) != 0 && fchown(fd, (uid_t)-1, st.st_gid) != 0)
+    {
+        // Not a group we are in: the new file keeps ours
+    }
+    fchmod(fd, st.st_mode & 07777);
+}
+static void FileSyncParentDir(const std::string& filename)
+{
+    // The rename is only durable once the directory entry is
+    const size_t slash = filename.find_last_of('/');
+    const std::string dir = (slash == std::string::npos) ? "." : (slash == 0 ? "/" : filename.substr(0, slash));
+    int fd = open(dir.c_str(), O_RDONLY);
+    if (fd >= 0)
+    {
+        fsync(fd);
+        close(fd);
+    }
+}
+#endif
+
+static bool WriteAll(int fd, const char* data, size_t len)
+{
+    while (len > 0)
+    {
+        const long n = FileWrite(fd, data, len < WRITE_CHUNK_SIZE ? len : WRITE_CHUNK_SIZE);
+        if (n <= 0)
+            return false;
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static bool WriteAllAt(int fd, const char* data, size_t len, size_t offset)
+{
+    while (len > 0)
+    {
+        const long n = FileWriteAt(fd, data, len < WRITE_CHUNK_SIZE ? len : WRITE_CHUNK_SIZE, offset);
+        if (n <= 0)
+            return false;
+        data += n;
+        len -= (size_t)n;
+        offset += (size_t)n;
+    }
+    return true;
+}
+
+// Write 'count' spans that follow each other in the source file. The kernel copies what it can (nothing when the
+// files are on different file systems, or on systems without copy_file_range), the rest is written from memory.
+static bool CopySpans(int source_fd, int fd, const PieceTableSnapshot::Span* spans, size_t count, size_t len)
+{
+    size_t copied = 0;
+    while (copied < len)
+    {
+        const size_t chunk = len - copied < WRITE_CHUNK_SIZE ? len - copied : WRITE_CHUNK_SIZE;
+        const long n = FileCopyRange(source_fd, spans[0].FileOffset + copied, fd, chunk);
+        if (n <= 0)
+            break;
+        copied += (size_t)n;
+    }
+    for (size_t n = 0; n < count; n++)
+    {
+        if (copied >= spans[n].Len)
+        {
+            copied -= spans[n].Len;
+            continue;
+        }
+        if (!WriteAll(fd, spans[n].Data + copied, spans[n].Len - copied))
+            return false;
+        copied = 0;
+    }
+    return true;
+}
+
+static bool NeedsFinalNewline(const PieceTableSnapshot& snapshot)
+{
+    // Always end the file with a new line (see SaveToFile() in main.cpp)
+    const PieceTableSnapshot::Span* last_span = snapshot.Spans.empty() ? NULL : &snapshot.Spans.back();
+    return last_span == NULL || last_span->Data[last_span->Len - 1] != '\n';
+}
+
+static bool SetError(std::string* out_error, const char* what, const std::string& filename, int err)
+{
+    *out_error = std::string(what) + " " + filename + ": " + strerror(err);
+    return false;
+}
+
+bool WriteFileAtomic(const std::string& path, const PieceTableSnapshot& snapshot, int source_fd, FileStamp* out_stamp, std::string* out_error)
+{
+    const std::string filename = FileResolveLinks(path);
+    const std::string temp_filename = filename + ".irohde-tmp";
+    int fd = FileCreate(temp_filename.c_str(), 0666);
+    if (fd < 0)
+        return SetError(out_error, "Can't create", temp_filename, errno);
+    FileCopyAttributes(filename.c_str(), fd);
+
+    std::string buffer;
+    buffer.reserve(WRITE_BUFFER_SIZE);
+    bool ok = true;
+    for (size_t n = 0; n < snapshot.Spans.size() && ok; n++)
+    {
+        const PieceTableSnapshot::Span& span = snapshot.Spans[n];
+        if (source_fd >= 0 && span.FileOffset != PieceTableSnapshot::NoFileOffset)
+        {
+            // Pieces are at most 64 KB: merge the spans that continue each other in the source file into one run
+            size_t run_end = n + 1;
+            size_t run_len = span.Len;
+            while (run_end < snapshot.Spans.size() && snapshot.Spans[run_end].FileOffset == span.FileOffset + run_len)
+                run_len += snapshot.Spans[run_end++].Len;
+            if (run_len >= COPY_RANGE_MIN_SIZE)
+            {
+                ok = WriteAll(fd, buffer.data(), buffer.size());
+                buffer.clear();
+                ok = ok && CopySpans(source_fd, fd, &span, run_end - n, run_len);
+                n = run_end - 1;
+                continue;
+            }
+        }
+        if (buffer.size() + span.Len > WRITE_BUFFER_SIZE)
+        {
+            ok = WriteAll(fd, buffer.data(), buffer.size());
+            buffer.clear();
+        }
+        if (span.Len >= WRITE_BUFFER_SIZE)
+            ok = ok && WriteAll(fd, span.Data, span.Len);
+        else
+            buffer.append(span.Data, span.Len);
+    }
+
+    if (NeedsFinalNewline(snapshot))
+        buffer.push_back('\n');
+    ok = ok && WriteAll(fd, buffer.data(), buffer.size());
+    ok = ok && FileSync(fd);
+    if (ok && out_stamp != NULL)
+        GetFileStamp(fd, out_stamp);
+    int err = ok ? 0 : errno;
+    if (!FileClose(fd) && ok)
+    {
+        ok = false;
+        err = errno;
+    }
+    if (!ok)
+    {
+        remove(temp_filename.c_str());
+        return SetError(out_error, "Can't write", temp_filename, err);
+    }
+
+    if (!FileReplace(temp_filename.c_str(), filename.c_str()))
+    {
+        err = errno;
+        remove(temp_filename.c_str());
+        return SetError(out_error, "Can't replace", filename, err);
+    }
+    FileSyncParentDir(filename);
+    return true;
+}
+
+// Write the spans that aren't at their place in the file yet, or all of them when the snapshot's FileOffsets are not
+// those of the file ('offsets_valid' false). See SaveFile().
+static bool WriteFileInPlace(const std::string& filename, const PieceTableSnapshot& snapshot, bool offsets_valid, size_t new_size, FileStamp* out_stamp, std::string* out_error)
+{
+    int fd = FileOpenWrite(filename.c_str());
+    if (fd < 0)
+        return SetError(out_error, "Can't open", filename, errno);
+
+    // Changed spans are gathered while they are contiguous: the buffer always ends at 'pos'
+    std::string buffer;
+    buffer.reserve(WRITE_BUFFER_SIZE);
+    size_t buffer_offset = 0;
+    size_t pos = 0;
+    bool ok = true;
+    for (size_t n = 0; n < snapshot.Spans.size() && ok; n++)
+    {
+        const PieceTableSnapshot::Span& span = snapshot.Spans[n];
+        const bool in_place = offsets_valid && span.FileOffset == pos;
+        if (in_place || buffer.size() + span.Len > WRITE_BUFFER_SIZE)
+        {
+            ok = WriteAllAt(fd, buffer.data(), buffer.size(), buffer_offset);
+            buffer.clear();
+        }
+        if (!in_place)
+        {
+            if (span.Len >= WRITE_BUFFER_SIZE)
+                ok = ok && WriteAllAt(fd, span.Data, span.Len, pos);
+            else
+            {
+                if (buffer.empty())
+                    buffer_offset = pos;
+                buffer.append(span.Data, span.Len);
+            }
+        }
+        pos += span.Len;
+    }
+    if (pos < new_size)
+    {
+        if (buffer.empty())
+            buffer_offset = pos;
+        buffer.push_back('\n');
+    }
+    ok = ok && WriteAllAt(fd, buffer.data(), buffer.size(), buffer_offset);
+    ok = ok && FileTruncate(fd, new_size);
+    ok = ok && FileSync(fd);
+    if (ok && out_stamp != NULL)
+        GetFileStamp(fd, out_stamp);
+    int err = ok ? 0 : errno;
+    if (!FileClose(fd) && ok)
+    {
+        ok = false;
+        err = errno;
+    }
+    if (!ok)
+        return SetError(out_error, "Can't write", filename, err);
+    return true;
+}
+
+bool SaveFile(const std::string& path, const PieceTableSnapshot& snapshot, const FileStamp* on_disk, FileStamp* out_stamp, std::string* out_error)
+{
+    const std::string filename = FileResolveLinks(path);
+    const size_t new_size = snapshot.Size + (NeedsFinalNewline(snapshot) ? 1 : 0);
+
+    // Renaming a new file over a file with other hard links, or owned by someone else, would leave them the old text
+    // or give the file to us: overwrite it in place instead
+    const bool replace = !FileReplaceLosesIdentity(filename.c_str());
+
+    // The snapshot's FileOffsets are only worth something if the file is still the one they were computed for
+    int source_fd = on_disk != NULL ? FileOpenRead(filename.c_str()) : -1;
+    FileStamp stamp;
+    if (source_fd >= 0 && (!GetFileStamp(source_fd, &stamp) || stamp != *on_disk))
+    {
+        FileClose(source_fd);
+        source_fd = -1;
+    }
+    if (source_fd < 0)
+        return replace ? WriteFileAtomic(filename, snapshot, -1, out_stamp, out_error) : WriteFileInPlace(filename, snapshot, false, new_size, out_stamp, out_error);
+
+    size_t pos = 0;
+    size_t changed_bytes = new_size - snapshot.Size;
+    for (size_t n = 0; n < snapshot.Spans.size(); n++)
+    {
+        if (snapshot.Spans[n].FileOffset != pos)
+            changed_bytes += snapshot.Spans[n].Len;
+        pos += snapshot.Spans[n].Len;
+    }
+
+    bool ok;
+    if (!replace || (stamp.Size >= IN_PLACE_MIN_FILE_SIZE && changed_bytes <= IN_PLACE_MAX_WRITE))
+    {
+        FileClose(source_fd);
+        ok = WriteFileInPlace(filename, snapshot, true, new_size, out_stamp, out_error);
+    }
+    else
+    {
+        ok = WriteFileAtomic(filename, snapshot, source_fd, out_stamp, out_error);
+        FileClose(source_fd);
+    }
+    return ok;
+}
+
+//-----------------------------------------------------------------------------
+// SaveQueue
+//-----------------------------------------------------------------------------
+
+SaveQueue::SaveQueue()
+{
+    Stop = false;
+    Thread = std::thread(&SaveQueue::Run, this);
+}
+
+SaveQueue::~SaveQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        Stop = true;
+    }
+    Wakeup.notify_one();
+    Thread.join();
+}
+
+void SaveQueue::Save(const std::string& filename, const PieceTable& text, const FileStamp* on_disk, uint64_t tag)
+{
+    Job job;
+    job.Filename = filename;
+    job.Tag = tag;
+    text.GetSnapshot(&job.Snapshot);
+    job.HasOnDisk = on_disk != NULL;
+    if (on_disk != NULL)
+        job.OnDisk = *on_disk;
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        // While an earlier save of the file is being written, or until its result is taken, the caller's stamp and the
+        // snapshot's FileOffsets describe the file as it was before that save: only trust them once MarkSaved() has
+        // re-based the offsets on what that save wrote. A same-size rewrite within the mtime resolution (seconds on
+        // FAT, HFS+ and Windows) would pass the stamp check otherwise, and spans would be skipped or copied from
+        // bytes that were just overwritten.
+        if (Writing == filename)
+            job.HasOnDisk = false;
+        for (size_t n = 0; n < Results.size() && job.HasOnDisk; n++)
+            if (Results[n].Filename == filename)
+                job.HasOnDisk = false;
+        bool coalesced = false;
+        for (size_t n = 0; n < Pending.size() && !coalesced; n++)
+            if (Pending[n].Filename == filename)
+            {
+                std::swap(Pending[n].Snapshot, job.Snapshot);
+                Pending[n].OnDisk = job.OnDisk;
+                Pending[n].HasOnDisk = job.HasOnDisk;
+                Pending[n].Tag = job.Tag;
+                coalesced = true;
+            }
+        if (!coalesced)
+            Pending.push_back(std::move(job));
+    }
+    Wakeup.notify_one();
+}
+
+bool SaveQueue::IsSaving(const std::string& filename) const
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    if (Writing == filename)
+        return true;
+    for (size_t n = 0; n < Pending.size(); n++)
+        if (Pending[n].Filename == filename)
+            return true;
+    return false;
+}
+
+bool SaveQueue::PopResult(Result* out)
+{
+    std::lock_guard<std::mutex> lock(Mutex);
+    if (Results.empty())
+        return false;
+    *out = std::move(Results.front());
+    Results.pop_front();
+    return true;
+}
+
+void SaveQueue::Run()
+{
+    std::unique_lock<std::mutex> lock(Mutex);
+    for (;;)
+    {
+        while (!Stop && Pending.empty())
+            Wakeup.wait(lock);
+        if (Pending.empty())
+            return; // Stopping, and everything queued has been written
+
+        Job job = std::move(Pending.front());
+        Pending.pop_front();
+        Writing = job.Filename;
+        lock.unlock();
+
+        Result result;
+        result.Filename = job.Filename;
+        result.Tag = job.Tag;
+        result.Ok = SaveFile(job.Filename, job.Snapshot, job.HasOnDisk ? &job.OnDisk : NULL, &result.Stamp, &result.Error);
+        if (result.Ok)
+            std::swap(result.Snapshot, job.Snapshot);
+        job.Snapshot = PieceTableSnapshot();
+
+        lock.lock();
+        Writing.clear();
+        Results.push_back(std::move(result));
+    }
+}
@@ -0,0 +1,83 @@
+// Saving documents on a background thread.
+// Each save writes a snapshot of the document to a temporary file next to the target, flushes it to disk and renames
+// it over the target, so the file on disk is always either the old or the new version, even after a crash. Symlinks
+// are followed, and the new file gets the mode and owner of the old one. Files that would lose something to the
+// rename (other hard links, an owner we can't give the new file) are overwritten in place instead.
+// When the target is the file the text was loaded from (or last saved to) and nobody changed it since, only what was
+// edited is written: see SaveFile().
+
+#pragma once
+
+#include "piece_table.h"
+#include "file_io.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+class SaveQueue
+{
+public:
+    struct Result
+    {
+        std::string Filename;
+        bool        Ok;
+        std::string Error;      // Empty when Ok
+        FileStamp   Stamp;      // Of the file as written
+        PieceTableSnapshot Snapshot;    // What was written, for PieceTable::MarkSaved()
+        uint64_t    Tag;        // As passed to Save()
+    };
+
+    SaveQueue();
+    ~SaveQueue();                                   // Finishes the pending saves
+
+    // Queue a save of 'text' (as it is now) to 'filename'. Never blocks on I/O.
+    // A save of the same file that hasn't started yet is replaced rather than written twice.
+    // 'on_disk' is the stamp of 'filename' when 'text' was loaded from it or last saved to it, NULL if neither. It is
+    // ignored while an earlier save of 'filename' is being written or its result hasn't been popped yet.
+    // 'tag' is returned with the result, e.g. to tell which version of the text was saved.
+    void        Save(const std::string& filename, const PieceTable& text, const FileStamp* on_disk = NULL, uint64_t tag = 0);
+    bool        IsSaving(const std::string& filename) const;    // Queued or being written
+    bool        PopResult(Result* out);                         // Completed saves, in order
+
+private:
+    struct Job
+    {
+        std::string         Filename;
+        PieceTableSnapshot  Snapshot;
+        FileStamp           OnDisk;
+        bool                HasOnDisk;
+        uint64_t            Tag;
+    };
+
+    std::thread                 Thread;
+    mutable std::mutex          Mutex;
+    std::condition_variable     Wakeup;
+    std::deque<Job>             Pending;            // Protected by Mutex, as are the fields below
+    std::string                 Writing;            // Filename of the job being written, empty when idle
+    std::deque<Result>          Results;
+    bool                        Stop;
+
+    void        Run();
+
+    SaveQueue(const SaveQueue&);
+    SaveQueue& operator=(const SaveQueue&);
+};
+
+// Write 'snapshot' to 'filename' (the file it points to if it is a symlink) through a temporary file + flush + rename,
+// keeping the mode and, when allowed, the owner of the file. Ends the file with '\n' if the text doesn't.
+// Spans with a FileOffset are copied from 'source_fd' (the current 'filename') by the kernel when it can, or even
+// shared with it on file systems with reflinks, instead of going through user space; pass -1 to write everything.
+// Returns false and fills 'out_error' on failure, the original file is left untouched then.
+bool WriteFileAtomic(const std::string& filename, const PieceTableSnapshot& snapshot, int source_fd, FileStamp* out_stamp, std::string* out_error);
+
+// Write 'snapshot' to 'filename', which had stamp 'on_disk' (NULL if unknown) when the snapshot's FileOffsets were
+// valid. If the file hasn't changed since:
+// - a big file with few bytes changed is patched in place: only the spans that aren't already at the right offset
+//   are written (pwrite), then the file is truncated to its new size. This is not atomic: a crash in the middle
+//   can leave the changed region half written, so it is only used when that region is small.
+// - otherwise WriteFileAtomic() with the unchanged spans copied from the file.
+// Else falls back to a plain WriteFileAtomic(). Files with other hard links, or owned by someone else, are always
+// overwritten in place (all of the text when the FileOffsets aren't valid).
+bool SaveFile(const std::string& filename, const PieceTableSnapshot& snapshot, const FileStamp* on_disk, FileStamp* out_stamp, std::string* out_error);
@@ -0,0 +1,959 @@
+// Multi-line text editor widget (see text_editor.h)
+// The interaction code mirrors InputTextEx() in imgui_widgets.cpp (activation, key ownership, child window, scrolling)
+// so the editor tabs behave like the InputTextMultiline() they replaced.
+
+#ifndef IMGUI_DEFINE_MATH_OPERATORS
+#define IMGUI_DEFINE_MATH_OPERATORS
+#endif
+#include "text_editor.h"
+#include "text_search.h"
+#include "cpp_highlighter.h"
+#include "code_folding.h"
+#include "bracket_index.h"
+#include "imgui_internal.h"
+#include <string.h>
+
+//-----------------------------------------------------------------------------
+// Text helpers
+//-----------------------------------------------------------------------------
+
+static bool IsUtf8Continuation(char c)
+{
+    return ((unsigned char)c & 0xC0) == 0x80;
+}
+
+static size_t NextCharPos(const PieceTable* text, size_t pos)
+{
+    const size_t size = text->Size();
+    if (pos >= size)
+        return size;
+    pos++;
+    while (pos < size && IsUtf8Continuation(text->CharAt(pos)))
+        pos++;
+    return pos;
+}
+
+static size_t PrevCharPos(const PieceTable* text, size_t pos)
+{
+    if (pos == 0)
+        return 0;
+    pos--;
+    while (pos > 0 && IsUtf8Continuation(text->CharAt(pos)))
+        pos--;
+    return pos;
+}
+
+static size_t LineStart(const PieceTable* text, size_t pos)
+{
+    return text->FindCharReverse('\n', pos) + 1; // (size_t)-1 + 1 == 0 when on the first line
+}
+
+static size_t LineEnd(const PieceTable* text, size_t pos)
+{
+    return text->FindChar('\n', pos);
+}
+
+// 0: blank, 1: separator, 2: word character. Same separators as stb_textedit's is_separator() in imgui_widgets.cpp
+static int CharClass(char c)
+{
+    if (c == ' ' || c == '\t' || c == '\n' || c == '\r')
+        return 0;
+    if (c == ',' || c == ';' || c == '(' || c == ')' || c == '{' || c == '}' || c == '[' || c == ']' || c == '|' || c == '.' || c == '!')
+        return 1;
+    return 2;
+}
+
+static size_t MoveWordLeft(const PieceTable* text, size_t pos)
+{
+    while (pos > 0 && CharClass(text->CharAt(pos - 1)) == 0)
+        pos--;
+    if (pos == 0)
+        return 0;
+    const int cls = CharClass(text->CharAt(pos - 1));
+    while (pos > 0 && CharClass(text->CharAt(pos - 1)) == cls)
+        pos--;
+    return pos;
+}
+
+static size_t MoveWordRight(const PieceTable* text, size_t pos)
+{
+    const size_t size = text->Size();
+    if (pos < size)
+    {
+        const int cls = CharClass(text->CharAt(pos));
+        if (cls != 0)
+            while (pos < size && CharClass(text->CharAt(pos)) == cls)
+                pos++;
+    }
+    while (pos < size && CharClass(text->CharAt(pos)) == 0 && text->CharAt(pos) != '\n')
+        pos++;
+    return pos;
+}
+
+static void ReadRange(const PieceTable* text, size_t begin, size_t end, ImVector<char>* out)
+{
+    out->resize((int)(end - begin) + 1);
+    text->Copy(begin, end - begin, out->Data);
+    out->Data[end - begin] = 0;
+}
+
+static float CalcWidth(const char* text_begin, const char* text_end)
+{
+    ImGuiContext& g = *GImGui;
+    return g.Font->CalcTextSizeA(g.FontSize, FLT_MAX, 0.0f, text_begin, text_end).x;
+}
+
+// Monospace fonts: characters are counted rather than measured, and runs of plain ASCII are skipped 8 bytes at a time.
+// Walks [text_begin, text_end) up to the character closest to 'x' ('nearest') or the first one whose right edge is past
+// 'x', and sets 'out_x' to its x. Widths are computed as in CalcTextSizeA(): columns, and TABs, times their advance.
+static const char* WalkToXMonospace(const char* text_begin, const char* text_end, float x, bool nearest, float* out_x)
+{
+    ImGuiContext& g = *GImGui;
+    const float scale = g.FontSize / g.Font->FontSize;
+    const float char_width = g.Font->MonospaceAdvanceX * scale;
+    const float tab_width = g.Font->GetCharAdvance((ImWchar)'\t') * scale;
+    const ImU64 ones = 0x0101010101010101ull;
+    const ImU64 highs = 0x8080808080808080ull;
+    size_t columns = 0;
+    size_t tabs = 0;
+    const char* s = text_begin;
+    while (s < text_end)
+    {
+        // 8 characters of one column each, all before 'x'
+        if (text_end - s >= 8)
+        {
+            ImU64 word;
+            memcpy(&word, s, 8);
+            const ImU64 tab_bytes = word ^ (ones * '\t');
+            const ImU64 cr_bytes = word ^ (ones * '\r');
+            const bool plain = (word & highs) == 0 && ((tab_bytes - ones) & ~tab_bytes & highs) == 0 && ((cr_bytes - ones) & ~cr_bytes & highs) == 0;
+            const float last_x = (columns + 7) * char_width + tabs * tab_width;
+            if (plain && (nearest ? x >= last_x + char_width * 0.5f : last_x + char_width <= x))
+            {
+                columns += 8;
+                s += 8;
+                continue;
+            }
+        }
+        unsigned int c = (unsigned int)(unsigned char)*s;
+        int len = 1;
+        if (c >= 0x80)
+            len = ImTextCharFromUtf8(&c, s, text_end);
+        const float char_x = columns * char_width + tabs * tab_width;
+        const bool zero_width = c == '\r' && !nearest;    // As in the other LocateX() and SkipToX()
+        const float w = (c == '\t') ? tab_width : zero_width ? 0.0f : char_width;
+        if (nearest ? x < char_x + w * 0.5f : char_x + w > x)
+            break;
+        if (c == '\t')
+            tabs++;
+        else if (!zero_width)
+            columns++;
+        s += len;
+    }
+    *out_x = columns * char_width + tabs * tab_width;
+    return s;
+}
+
+// Byte offset in [text_begin, text_end) closest to 'x'
+static const char* LocateX(const char* text_begin, const char* text_end, float x)
+{
+    ImGuiContext& g = *GImGui;
+    if (g.Font->IsMonospace())
+    {
+        float char_x;
+        return WalkToXMonospace(text_begin, text_end, x, true, &char_x);
+    }
+    const float scale = g.FontSize / g.Font->FontSize;
+    float line_width = 0.0f;
+    const char* s = text_begin;
+    while (s < text_end)
+    {
+        unsigned int c = (unsigned int)*s;
+        int len = 1;
+        if (c >= 0x80)
+            len = ImTextCharFromUtf8(&c, s, text_end);
+        const float char_width = g.Font->GetCharAdvance((ImWchar)c) * scale;
+        if (x < line_width + char_width * 0.5f)
+            break;
+        line_width += char_width;
+        s += len;
+    }
+    return s;
+}
+
+// First character of [text_begin, text_end) whose right edge is past 'x', and its own x in 'out_x'
+static const char* SkipToX(const char* text_begin, const char* text_end, float x, float* out_x)
+{
+    ImGuiContext& g = *GImGui;
+    if (g.Font->IsMonospace())
+        return WalkToXMonospace(text_begin, text_end, x, false, out_x);
+    const float scale = g.FontSize / g.Font->FontSize;
+    float line_width = 0.0f;
+    const char* s = text_begin;
+    while (s < text_end)
+    {
+        unsigned int c = (unsigned int)*s;
+        int len = 1;
+        if (c >= 0x80)
+            len = ImTextCharFromUtf8(&c, s, text_end);
+        const float char_width = (c == '\r') ? 0.0f : g.Font->GetCharAdvance((ImWchar)c) * scale; // Same as CalcTextSizeA()
+        if (line_width + char_width > x)
+            break;
+        line_width += char_width;
+        s += len;
+    }
+    *out_x = line_width;
+    return s;
+}
+
+// Copy the beginning of line [line_start, line_end) into 'out', stopping at a character boundary once the copied text
+// is wider than 'max_x'. Returns the end of the copied range. Very long lines only cost as much as their visible part.
+static size_t ReadLineUpToX(const PieceTable* text, size_t line_start, size_t line_end, float max_x, ImVector<char>* out)
+{
+    // With a monospace font a byte per column is enough unless there are TABs or multi-byte characters
+    ImGuiContext& g = *GImGui;
+    size_t read_len = 256;
+    if (g.Font->IsMonospace() && max_x > 0.0f)
+        read_len = ImMax(read_len, (size_t)(max_x / (g.Font->MonospaceAdvanceX * (g.FontSize / g.Font->FontSize))) + 2);
+    for (;;)
+    {
+        size_t read_end = line_end - line_start > read_len ? line_start + read_len : line_end;
+        while (read_end < line_end && read_end > line_start && IsUtf8Continuation(text->CharAt(read_end)))
+            read_end--;
+        ReadRange(text, line_start, read_end, out);
+        if (read_end == line_end || CalcWidth(out->Data, out->Data + (read_end - line_start)) > max_x)
+            return read_end;
+        read_len *= 2;
+    }
+}
+
+// Highlight the occurrences of the find text in a row, the one starting at 'current' more than the others
+static void DrawFindMatches(ImDrawList* draw_list, const char* line_text, const char* line_text_end, size_t line_start, const TextEditorState* state, size_t current, const ImVec2& line_pos, const ImVec4& clip_rect)
+{
+    ImGuiContext& g = *GImGui;
+    const ImU32 match_col = ImGui::GetColorU32(ImGuiCol_PlotHistogram, 0.35f);
+    const ImU32 current_col = ImGui::GetColorU32(ImGuiCol_PlotHistogram, 0.70f);
+    const size_t find_len = state->FindText.size();
+    const char* measured = line_text;
+    float x = 0.0f;
+    for (const char* p = line_text; p < line_text_end; p += find_len)
+    {
+        p = FindText(p, (size_t)(line_text_end - p), state->FindText.data(), find_len, state->FindIgnoreCase);
+        if (p == NULL)
+            break;
+        x += CalcWidth(measured, p);
+        const float width = CalcWidth(p, p + find_len);
+        ImRect rect(line_pos + ImVec2(x, 0.0f), line_pos + ImVec2(x + width, g.FontSize));
+        rect.ClipWith(clip_rect);
+        if (rect.Overlaps(clip_rect))
+            draw_list->AddRectFilled(rect.Min, rect.Max, line_start + (size_t)(p - line_text) == current ? current_col : match_col);
+        x += width;
+        measured = p + find_len;
+    }
+}
+
+ImU32 TextEditorTokenColor(int token, ImU32 text_col)
+{
+    switch (token)
+    {
+    case CppHighlighter::TOKEN_KEYWORD:         return IM_COL32(86, 156, 214, 255);
+    case CppHighlighter::TOKEN_NUMBER:          return IM_COL32(181, 206, 168, 255);
+    case CppHighlighter::TOKEN_STRING:          return IM_COL32(206, 145, 120, 255);
+    case CppHighlighter::TOKEN_COMMENT:         return IM_COL32(106, 153, 85, 255);
+    case CppHighlighter::TOKEN_PREPROCESSOR:    return IM_COL32(197, 134, 192, 255);
+    default:                                    return text_col;
+    }
+}
+
+// Draw [draw_begin, line_text_end) of a row at 'pos', colored by 'runs', the syntax runs of the row from 'line_text'
+static void DrawRuns(ImDrawList* draw_list, const ImVec2& pos, const char* line_text, const char* draw_begin, const char* line_text_end, const std::vector<CppHighlighter::Run>& runs, ImU32 text_col)
+{
+    ImGuiContext& g = *GImGui;
+    static ImVector<ImDrawTextRun> draw_runs;
+    draw_runs.resize(0);
+    const char* run_begin = line_text;
+    for (size_t n = 0; n < runs.size() && run_begin < line_text_end; n++)
+    {
+        const char* run_end = ImMin(run_begin + runs[n].Len, line_text_end);
+        if (run_end > draw_begin)
+        {
+            ImDrawTextRun run = { (int)(run_end - ImMax(run_begin, draw_begin)), TextEditorTokenColor(runs[n].Token, text_col) };
+            draw_runs.push_back(run);
+        }
+        run_begin = run_end;
+    }
+    draw_list->AddTextRuns(g.Font, g.FontSize, pos, draw_begin, line_text_end, draw_runs.Data, draw_runs.Size);
+}
+
+// Rows are the visible lines: the same as lines unless some are folded ('folds' may be NULL)
+static size_t RowCount(const PieceTable* text, const FoldIndex* folds)
+{
+    return folds != NULL ? folds->RowCount(text->LineCount()) : text->LineCount();
+}
+
+static size_t RowFromLine(const FoldIndex* folds, size_t line)
+{
+    return folds != NULL ? folds->RowFromLine(line) : line;
+}
+
+static size_t LineFromRow(const FoldIndex* folds, size_t row)
+{
+    return folds != NULL ? folds->LineFromRow(row) : row;
+}
+
+// The brackets to highlight for the cursor: the one after or before it and its match ('out_adjacent' set), else the
+// innermost pair around it. Only once the highlighter knows the brackets of every line.
+static bool FindCursorBrackets(const TextEditorState* state, size_t* out_a, size_t* out_b, bool* out_adjacent)
+{
+    if (state->Brackets == NULL || !state->Highlighter->BracketsKnown())
+        return false;
+    *out_adjacent = true;
+    if (state->Brackets->FindMatch(state->Cursor, out_b))
+    {
+        *out_a = state->Cursor;
+        return true;
+    }
+    if (state->Cursor > 0 && state->Brackets->FindMatch(state->Cursor - 1, out_b))
+    {
+        *out_a = state->Cursor - 1;
+        return true;
+    }
+    *out_adjacent = false;
+    return state->Brackets->FindEnclosing(state->Cursor, out_a, out_b);
+}
+
+// Outline the bracket at 'pos' if it is in the visible part of the row [line_start, visible_end)
+static void DrawBracketBox(ImDrawList* draw_list, const char* line_text, size_t line_start, size_t visible_end, size_t pos, const ImVec2& line_pos, ImU32 col)
+{
+    ImGuiContext& g = *GImGui;
+    if (pos < line_start || pos >= visible_end)
+        return;
+    const char* bracket = line_text + (pos - line_start);
+    const float x = CalcWidth(line_text, bracket);
+    draw_list->AddRect(line_pos + ImVec2(x, 0.0f), line_pos + ImVec2(x + CalcWidth(bracket, bracket + 1), g.FontSize), col);
+}
+
+static size_t LocateCoord(const PieceTable* text, const FoldIndex* folds, float x, float y, ImVector<char>* scratch)
+{
+    ImGuiContext& g = *GImGui;
+    const size_t row = y < 0.0f ? 0 : (size_t)(y / g.FontSize);
+    const size_t line_start = text->LineStart(LineFromRow(folds, ImMin(row, RowCount(text, folds) - 1)));
+    const size_t line_end = LineEnd(text, line_start);
+    const size_t read_end = ReadLineUpToX(text, line_start, line_end, x, scratch);
+    return line_start + (size_t)(LocateX(scratch->Data, scratch->Data + (read_end - line_start), x) - scratch->Data);
+}
+
+static float CalcColumnX(const PieceTable* text, size_t pos, ImVector<char>* scratch)
+{
+    const size_t line_start = LineStart(text, pos);
+    ReadRange(text, line_start, pos, scratch);
+    return CalcWidth(scratch->Data, scratch->Data + (pos - line_start));
+}
+
+//-----------------------------------------------------------------------------
+// Editing
+//-----------------------------------------------------------------------------
+
+// 'coalesce' for typing and single deletions, so that a run of typing or erasing is undone at once
+static void ReplaceRange(PieceTable* text, TextEditorState* state, size_t begin, size_t end, const char* insert, size_t insert_len, bool coalesce)
+{
+    state->Undo.Replace(text, begin, end - begin, insert, insert_len, coalesce);
+    state->Cursor = state->SelectStart = begin + insert_len;
+    state->PreferredX = -1.0f;
+    state->CursorFollow = true;
+}
+
+static void ReplaceSelection(PieceTable* text, TextEditorState* state, const char* insert, size_t insert_len, bool coalesce = false)
+{
+    ReplaceRange(text, state, state->SelectionMin(), state->SelectionMax(), insert, insert_len, coalesce);
+}
+
+static bool UndoRedo(PieceTable* text, TextEditorState* state, bool redo)
+{
+    size_t cursor;
+    if (!(redo ? state->Undo.Redo(text, &cursor) : state->Undo.Undo(text, &cursor)))
+        return false;
+    state->Cursor = state->SelectStart = cursor;
+    state->PreferredX = -1.0f;
+    state->CursorFollow = true;
+    return true;
+}
+
+static void MoveCursor(TextEditorState* state, size_t pos, bool select)
+{
+    state->Cursor = pos;
+    if (!select)
+        state->SelectStart = pos;
+    state->CursorFollow = true;
+}
+
+// Move 'lines' rows up (negative) or down (positive) keeping the preferred column. Folded lines are skipped.
+static size_t MoveVertical(const PieceTable* text, TextEditorState* state, int lines, ImVector<char>* scratch)
+{
+    if (state->PreferredX < 0.0f)
+        state->PreferredX = CalcColumnX(text, state->Cursor, scratch);
+    const size_t cursor_row = RowFromLine(state->Folds, text->LineFromPos(state->Cursor));
+    size_t row;
+    if (lines < 0)
+        row = (size_t)-lines < cursor_row ? cursor_row - (size_t)-lines : 0;
+    else
+        row = ImMin(cursor_row + (size_t)lines, RowCount(text, state->Folds) - 1);
+    const size_t line_start = text->LineStart(LineFromRow(state->Folds, row));
+    const size_t line_end = LineEnd(text, line_start);
+    const size_t read_end = ReadLineUpToX(text, line_start, line_end, state->PreferredX, scratch);
+    return line_start + (size_t)(LocateX(scratch->Data, scratch->Data + (read_end - line_start), state->PreferredX) - scratch->Data);
+}
+
+//-----------------------------------------------------------------------------
+// Widget
+//-----------------------------------------------------------------------------
+
+bool TextEditor(const char* label, PieceTable* text, TextEditorState* state, const ImVec2& size_arg, ImGuiInputTextFlags flags)
+{
+    using namespace ImGui;
+    ImGuiWindow* window = GetCurrentWindow();
+    if (window->SkipItems)
+        return false;
+
+    ImGuiContext& g = *GImGui;
+    ImGuiIO& io = g.IO;
+    const ImGuiStyle& style = g.Style;
+    const bool is_readonly = (flags & ImGuiInputTextFlags_ReadOnly) != 0;
+    const bool is_osx = io.ConfigMacOSXBehaviors;
+
+    BeginGroup();
+    const ImGuiID id = window->GetID(label);
+    const ImVec2 frame_size = CalcItemSize(size_arg, CalcItemWidth(), g.FontSize * 8.0f + style.FramePadding.y * 2.0f);
+    const ImRect frame_bb(window->DC.CursorPos, window->DC.CursorPos + frame_size);
+
+    ImVec2 backup_pos = window->DC.CursorPos;
+    ItemSize(frame_bb, style.FramePadding.y);
+    if (!ItemAdd(frame_bb, id, &frame_bb, ImGuiItemFlags_Inputable))
+    {
+        EndGroup();
+        return false;
+    }
+    ImGuiLastItemData item_data_backup = g.LastItemData;
+    window->DC.CursorPos = backup_pos;
+
+    // Tab is an input character for us, don't let NavActivation from tabbing stop here
+    if (g.NavActivateId == id && (g.NavActivateFlags & ImGuiActivateFlags_FromTabbing))
+        g.NavActivateId = 0;
+    const ImGuiID backup_activate_id = g.NavActivateId;
+    if (g.ActiveId == id)
+        g.NavActivateId = 0;
+
+    PushStyleColor(ImGuiCol_ChildBg, style.Colors[ImGuiCol_FrameBg]);
+    PushStyleVar(ImGuiStyleVar_ChildRounding, style.FrameRounding);
+    PushStyleVar(ImGuiStyleVar_ChildBorderSize, style.FrameBorderSize);
+    PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0, 0));
+    bool child_visible = BeginChildEx(label, id, frame_bb.GetSize(), true, ImGuiWindowFlags_NoMove);
+    g.NavActivateId = backup_activate_id;
+    PopStyleVar(3);
+    PopStyleColor();
+    if (!child_visible)
+    {
+        EndChild();
+        EndGroup();
+        return false;
+    }
+    ImGuiWindow* draw_window = g.CurrentWindow;
+    draw_window->DC.NavLayersActiveMaskNext |= (1 << draw_window->DC.NavLayerCurrent);
+    draw_window->DC.CursorPos += style.FramePadding;
+    ImVec2 inner_size = frame_size;
+    inner_size.x -= draw_window->ScrollbarSizes.x;
+
+    const bool hovered = ItemHoverable(frame_bb, id, g.LastItemData.InFlags);
+    if (hovered)
+        g.MouseCursor = ImGuiMouseCursor_TextInput;
+
+    const bool input_requested_by_nav = (g.ActiveId != id) && ((g.NavActivateId == id) && ((g.NavActivateFlags & ImGuiActivateFlags_PreferInput) || (g.NavInputSource == ImGuiInputSource_Keyboard)));
+    const bool user_clicked = hovered && io.MouseClicked[0];
+    const bool user_scroll_active = g.ActiveId == GetWindowScrollbarID(draw_window, ImGuiAxis_Y);
+    const bool init_make_active = user_clicked || input_requested_by_nav;
+    bool clear_active_id = false;
+    bool value_changed = false;
+    float scroll_y = draw_window->Scroll.y;
+
+    static ImVector<char> scratch;
+    static std::vector<CppHighlighter::Run> runs;
+    if (state->Cursor > text->Size() || state->SelectStart > text->Size())
+        state->Cursor = state->SelectStart = text->Size();
+    // A requested fold is done once its region is found. The cursor moves out of the lines it hides.
+    if (state->Folds != NULL && state->Folds->Update(*text, state->Highlighter))
+    {
+        const size_t cursor_line = text->LineFromPos(state->Cursor);
+        if (state->Folds->IsHidden(cursor_line))
+            MoveCursor(state, LineEnd(text, text->LineStart(state->Folds->LineFromRow(state->Folds->RowFromLine(cursor_line)))), false);
+    }
+
+    if (g.ActiveId != id && init_make_active)
+    {
+        SetActiveID(id, window);
+        SetFocusID(id, window);
+        FocusWindow(window);
+        state->CursorAnim = 0.0f;
+    }
+    if (g.ActiveId == id)
+    {
+        if (user_clicked)
+            SetKeyOwner(ImGuiKey_MouseLeft, id);
+        g.ActiveIdUsingNavDirMask |= (1 << ImGuiDir_Left) | (1 << ImGuiDir_Right) | (1 << ImGuiDir_Up) | (1 << ImGuiDir_Down);
+        SetKeyOwner(ImGuiKey_Enter, id);
+        SetKeyOwner(ImGuiKey_KeypadEnter, id);
+        SetKeyOwner(ImGuiKey_Home, id);
+        SetKeyOwner(ImGuiKey_End, id);
+        SetKeyOwner(ImGuiKey_PageUp, id);
+        SetKeyOwner(ImGuiKey_PageDown, id);
+        if (is_osx)
+            SetKeyOwner(ImGuiMod_Alt, id);
+    }
+
+    // Release focus when we click outside
+    if (g.ActiveId == id && io.MouseClicked[0] && !init_make_active)
+        clear_active_id = true;
+
+    // Mouse and character inputs
+    if (g.ActiveId == id)
+    {
+        g.ActiveIdAllowOverlap = !io.MouseDown[0];
+        const float mouse_x = (io.MousePos.x - frame_bb.Min.x - style.FramePadding.x) + state->ScrollX;
+        const float mouse_y = io.MousePos.y - draw_window->DC.CursorPos.y;
+
+        if (hovered && io.MouseClickedCount[0] >= 2 && !io.KeyShift)
+        {
+            const size_t pos = LocateCoord(text, state->Folds, mouse_x, mouse_y, &scratch);
+            if ((io.MouseClickedCount[0] - 2) % 2 == 0)
+            {
+                // Double-click: select word
+                const int cls = pos < text->Size() ? CharClass(text->CharAt(pos)) : 0;
+                size_t word_begin = pos, word_end = pos;
+                while (word_begin > 0 && CharClass(text->CharAt(word_begin - 1)) == cls && text->CharAt(word_begin - 1) != '\n')
+                    word_begin--;
+                while (word_end < text->Size() && CharClass(text->CharAt(word_end)) == cls && text->CharAt(word_end) != '\n')
+                    word_end++;
+                state->SelectStart = word_begin;
+                state->Cursor = word_end;
+            }
+            else
+            {
+                // Triple-click: select line
+                const size_t line_end = LineEnd(text, pos);
+                state->SelectStart = LineStart(text, pos);
+                state->Cursor = line_end < text->Size() ? line_end + 1 : line_end;
+            }
+            state->PreferredX = -1.0f;
+            state->CursorAnim = 0.0f;
+        }
+        else if (io.MouseClicked[0] && !state->SelectedAllMouseLock)
+        {
+            if (hovered)
+            {
+                MoveCursor(state, LocateCoord(text, state->Folds, mouse_x, mouse_y, &scratch), io.KeyShift);
+                state->PreferredX = -1.0f;
+                state->CursorAnim = 0.0f;
+                state->CursorFollow = false;
+            }
+        }
+        else if (io.MouseDown[0] && !state->SelectedAllMouseLock && (io.MouseDelta.x != 0.0f || io.MouseDelta.y != 0.0f))
+        {
+            MoveCursor(state, LocateCoord(text, state->Folds, mouse_x, mouse_y, &scratch), true);
+            state->PreferredX = -1.0f;
+            state->CursorAnim = 0.0f;
+        }
+        if (state->SelectedAllMouseLock && !io.MouseDown[0])
+            state->SelectedAllMouseLock = false;
+
+        if (!is_readonly && Shortcut(ImGuiKey_Tab, id, ImGuiInputFlags_Repeat))
+        {
+            ReplaceSelection(text, state, "\t", 1, true);
+            value_changed = true;
+        }
+
+        // Regular text input. We ignore CTRL inputs, but need to allow ALT+CTRL as some keyboards (e.g. German) use AltGR (which _is_ Alt+Ctrl) to input certain characters.
+        const bool ignore_char_inputs = (io.KeyCtrl && !io.KeyAlt) || (is_osx && io.KeySuper);
+        if (io.InputQueueCharacters.Size > 0)
+        {
+            if (!ignore_char_inputs && !is_readonly && !input_requested_by_nav)
+            {
+                scratch.resize(0);
+                for (int n = 0; n < io.InputQueueCharacters.Size; n++)
+                {
+                    unsigned int c = (unsigned int)io.InputQueueCharacters[n];
+                    if (c < 0x20 || c == 0x7F || (c >= 0xE000 && c <= 0xF8FF)) // Control characters (Tab/Enter are handled as keys) and private use area
+                        continue;
+                    char utf8[5];
+                    for (const char* p = ImTextCharToUtf8(utf8, c); *p; p++)
+                        scratch.push_back(*p);
+                }
+                if (scratch.Size > 0)
+                {
+                    ReplaceSelection(text, state, scratch.Data, (size_t)scratch.Size, true);
+                    value_changed = true;
+                }
+            }
+            io.InputQueueCharacters.resize(0);
+        }
+    }
+
+    // Shortcuts and key presses
+    const int row_count_per_page = ImMax((int)((inner_size.y - style.FramePadding.y) / g.FontSize), 1);
+    if (g.ActiveId == id && !g.ActiveIdIsJustActivated && !clear_active_id)
+    {
+        const bool shift = io.KeyShift;
+        const bool is_wordmove_key_down = is_osx ? io.KeyAlt : io.KeyCtrl;
+        const bool is_startend_key_down = is_osx && io.KeySuper && !io.KeyCtrl && !io.KeyAlt;
+        const ImGuiInputFlags f_repeat = ImGuiInputFlags_Repeat;
+        const bool is_cut   = (Shortcut(ImGuiMod_Shortcut | ImGuiKey_X, id, f_repeat) || Shortcut(ImGuiMod_Shift | ImGuiKey_Delete, id, f_repeat)) && !is_readonly && state->HasSelection();
+        const bool is_copy  = (Shortcut(ImGuiMod_Shortcut | ImGuiKey_C, id) || Shortcut(ImGuiMod_Ctrl | ImGuiKey_Insert, id)) && state->HasSelection();
+        const bool is_paste = (Shortcut(ImGuiMod_Shortcut | ImGuiKey_V, id, f_repeat) || Shortcut(ImGuiMod_Shift | ImGuiKey_Insert, id, f_repeat)) && !is_readonly;
+        const bool is_undo  = Shortcut(ImGuiMod_Shortcut | ImGuiKey_Z, id, f_repeat) && !is_readonly;
+        const bool is_redo  = (Shortcut(ImGuiMod_Shortcut | ImGuiKey_Y, id, f_repeat) || (is_osx && Shortcut(ImGuiMod_Shortcut | ImGuiMod_Shift | ImGuiKey_Z, id, f_repeat))) && !is_readonly;
+        const bool is_select_all = Shortcut(ImGuiMod_Shortcut | ImGuiKey_A, id);
+        const bool is_enter_pressed = IsKeyPressed(ImGuiKey_Enter, true) || IsKeyPressed(ImGuiKey_KeypadEnter, true);
+        const bool is_cancel = Shortcut(ImGuiKey_Escape, id, f_repeat);
+        const bool is_fold = state->Folds != NULL && Shortcut(ImGuiMod_Shortcut | ImGuiMod_Shift | ImGuiKey_LeftBracket, id);
+        const bool is_unfold = state->Folds != NULL && Shortcut(ImGuiMod_Shortcut | ImGuiMod_Shift | ImGuiKey_RightBracket, id);
+        const bool is_match_bracket = state->Brackets != NULL && Shortcut(ImGuiMod_Shortcut | ImGuiMod_Shift | ImGuiKey_Backslash, id);
+
+        if (IsKeyPressed(ImGuiKey_LeftArrow))
+        {
+            if (is_startend_key_down)
+                MoveCursor(state, LineStart(text, state->Cursor), shift);
+            else if (is_wordmove_key_down)
+                MoveCursor(state, MoveWordLeft(text, state->Cursor), shift);
+            else if (state->HasSelection() && !shift)
+                MoveCursor(state, state->SelectionMin(), false);
+            else
+                MoveCursor(state, PrevCharPos(text, state->Cursor), shift);
+            state->PreferredX = -1.0f;
+        }
+        else if (IsKeyPressed(ImGuiKey_RightArrow))
+        {
+            if (is_startend_key_down)
+                MoveCursor(state, LineEnd(text, state->Cursor), shift);
+            else if (is_wordmove_key_down)
+                MoveCursor(state, MoveWordRight(text, state->Cursor), shift);
+            else if (state->HasSelection() && !shift)
+                MoveCursor(state, state->SelectionMax(), false);
+            else
+                MoveCursor(state, NextCharPos(text, state->Cursor), shift);
+            state->PreferredX = -1.0f;
+        }
+        else if (IsKeyPressed(ImGuiKey_UpArrow))
+        {
+            if (io.KeyCtrl)
+                SetScrollY(draw_window, ImMax(draw_window->Scroll.y - g.FontSize, 0.0f));
+            else if (is_startend_key_down)
+                MoveCursor(state, 0, shift);
+            else
+                MoveCursor(state, MoveVertical(text, state, -1, &scratch), shift);
+        }
+        else if (IsKeyPressed(ImGuiKey_DownArrow))
+        {
+            if (io.KeyCtrl)
+                SetScrollY(draw_window, ImMin(draw_window->Scroll.y + g.FontSize, GetScrollMaxY()));
+            else if (is_startend_key_down)
+                MoveCursor(state, text->Size(), shift);
+            else
+                MoveCursor(state, MoveVertical(text, state, +1, &scratch), shift);
+        }
+        else if (IsKeyPressed(ImGuiKey_PageUp))
+        {
+            MoveCursor(state, MoveVertical(text, state, -row_count_per_page, &scratch), shift);
+            scroll_y -= row_count_per_page * g.FontSize;
+        }
+        else if (IsKeyPressed(ImGuiKey_PageDown))
+        {
+            MoveCursor(state, MoveVertical(text, state, +row_count_per_page, &scratch), shift);
+            scroll_y += row_count_per_page * g.FontSize;
+        }
+        else if (IsKeyPressed(ImGuiKey_Home))
+        {
+            MoveCursor(state, io.KeyCtrl ? 0 : LineStart(text, state->Cursor), shift);
+            state->PreferredX = -1.0f;
+        }
+        else if (IsKeyPressed(ImGuiKey_End))
+        {
+            MoveCursor(state, io.KeyCtrl ? text->Size() : LineEnd(text, state->Cursor), shift);
+            state->PreferredX = -1.0f;
+        }
+        else if (IsKeyPressed(ImGuiKey_Delete) && !is_readonly && !is_cut)
+        {
+            const bool had_selection = state->HasSelection();
+            if (!had_selection)
+                state->Cursor = is_wordmove_key_down ? MoveWordRight(text, state->Cursor) : NextCharPos(text, state->Cursor);
+            if (state->HasSelection())
+            {
+                ReplaceSelection(text, state, "", 0, !had_selection);
+                value_changed = true;
+            }
+        }
+        else if (IsKeyPressed(ImGuiKey_Backspace) && !is_readonly)
+        {
+            const bool had_selection = state->HasSelection();
+            if (!had_selection)
+            {
+                if (is_wordmove_key_down)
+                    state->Cursor = MoveWordLeft(text, state->Cursor);
+                else if (is_osx && io.KeySuper && !io.KeyAlt && !io.KeyCtrl)
+                    state->Cursor = LineStart(text, state->Cursor);
+                else
+                    state->Cursor = PrevCharPos(text, state->Cursor);
+            }
+            if (state->HasSelection())
+            {
+                ReplaceSelection(text, state, "", 0, !had_selection);
+                value_changed = true;
+            }
+        }
+        else if (is_enter_pressed && !is_readonly)
+        {
+            ReplaceSelection(text, state, "\n", 1);
+            value_changed = true;
+        }
+        else if (is_cancel)
+        {
+            clear_active_id = true;
+        }
+        else if (is_undo || is_redo)
+        {
+            value_changed |= UndoRedo(text, state, is_redo);
+        }
+        else if (is_fold)
+        {
+            state->Folds->FoldAt(text->LineFromPos(state->Cursor));
+        }
+        else if (is_unfold)
+        {
+            state->Folds->Unfold(text->LineFromPos(state->Cursor));
+        }
+        else if (is_match_bracket)
+        {
+            // To the other side of the bracket next to the cursor, or to the end of the block around it
+            size_t bracket, match;
+            bool adjacent;
+            if (FindCursorBrackets(state, &bracket, &match, &adjacent))
+            {
+                MoveCursor(state, adjacent && bracket < state->Cursor ? match + 1 : match, false);
+                state->PreferredX = -1.0f;
+            }
+        }
+        else if (is_select_all)
+        {
+            state->SelectStart = 0;
+            state->Cursor = text->Size();
+            state->CursorFollow = true;
+        }
+        else if (is_cut || is_copy)
+        {
+            SetClipboardText(text->Substr(state->SelectionMin(), state->SelectionMax() - state->SelectionMin()).c_str());
+            if (is_cut)
+            {
+                ReplaceSelection(text, state, "", 0);
+                value_changed = true;
+            }
+        }
+        else if (is_paste)
+        {
+            if (const char* clipboard = GetClipboardText())
+            {
+                const size_t clipboard_len = strlen(clipboard);
+                if (clipboard_len > 0)
+                {
+                    ReplaceSelection(text, state, clipboard, clipboard_len);
+                    value_changed = true;
+                }
+            }
+        }
+        if (value_changed)
+            state->CursorAnim = 0.0f;
+    }
+
+    if (g.ActiveId == id && clear_active_id)
+        ClearActiveID();
+    else if (g.ActiveId == id)
+        g.WantTextInputNextFrame = 1;
+
+    // Layout: line count and cursor row come from the piece table's line index, minus the folded lines. A cursor moved
+    // into folded lines (by a click, Find next...) unfolds them.
+    const bool render_cursor = (g.ActiveId == id) || user_scroll_active;
+    const bool render_selection = state->HasSelection() && render_cursor;
+    const size_t select_min = state->SelectionMin();
+    const size_t select_max = state->SelectionMax();
+    const size_t cursor_line = text->LineFromPos(state->Cursor);
+    if (state->Folds != NULL && state->Folds->IsHidden(cursor_line))
+        state->Folds->Reveal(cursor_line);
+    const FoldIndex* folds = state->Folds;
+    const size_t row_count = RowCount(text, folds);
+    const size_t cursor_row = RowFromLine(folds, cursor_line);
+
+    const ImVec4 clip_rect(frame_bb.Min.x, frame_bb.Min.y, frame_bb.Min.x + inner_size.x, frame_bb.Min.y + inner_size.y);
+    ImVec2 draw_pos = draw_window->DC.CursorPos;
+    const float content_height = row_count * g.FontSize;
+
+    // Scroll. Also when not active: Find next/previous set the selection from outside.
+    if (state->CursorFollow)
+    {
+        const float cursor_x = CalcColumnX(text, state->Cursor, &scratch);
+        const float scroll_increment_x = inner_size.x * 0.25f;
+        const float visible_width = inner_size.x - style.FramePadding.x;
+        if (cursor_x < state->ScrollX)
+            state->ScrollX = IM_TRUNC(ImMax(0.0f, cursor_x - scroll_increment_x));
+        else if (cursor_x - visible_width >= state->ScrollX)
+            state->ScrollX = IM_TRUNC(cursor_x - visible_width + scroll_increment_x);
+
+        const float cursor_y = (cursor_row + 1) * g.FontSize;
+        if (cursor_y - g.FontSize < scroll_y)
+            scroll_y = ImMax(0.0f, cursor_y - g.FontSize);
+        else if (cursor_y - (inner_size.y - style.FramePadding.y * 2.0f) >= scroll_y)
+            scroll_y = cursor_y - inner_size.y + style.FramePadding.y * 2.0f;
+        const float scroll_max_y = ImMax((content_height + style.FramePadding.y * 2.0f) - inner_size.y, 0.0f);
+        scroll_y = ImClamp(scroll_y, 0.0f, scroll_max_y);
+        draw_pos.y += (draw_window->Scroll.y - scroll_y);   // Manipulate cursor pos immediately avoid a frame of lag
+        draw_window->Scroll.y = scroll_y;
+        state->CursorFollow = false;
+    }
+
+    // Render the rows overlapping the clip rectangle. The first visible row is found through the line index, and within
+    // a row only the text up to the right edge is read and only the glyphs past the left edge are emitted, so the cost
+    // depends on the size of the view rather than on the size of the document or the length of its lines. Folded lines
+    // are jumped over: the first visible row maps to its line through the fold index, and so does the row after a fold.
+    const ImU32 text_col = GetColorU32(ImGuiCol_Text);
+    const ImU32 select_col = GetColorU32(ImGuiCol_TextSelectedBg);
+    const size_t find_current = select_max - select_min == state->FindText.size() ? select_min : (size_t)-1;  // The selection, if it is a match
+    ImVec2 cursor_screen_pos;
+    bool cursor_row_visible = false;
+    const float visible_min_x = clip_rect.x - (draw_pos.x - state->ScrollX);   // Clip rectangle relative to the start of a row
+    const float visible_max_x = clip_rect.z - (draw_pos.x - state->ScrollX);
+    const size_t first_row = clip_rect.y > draw_pos.y ? ImMin((size_t)((clip_rect.y - draw_pos.y) / g.FontSize), row_count - 1) : 0;
+    const size_t last_row = clip_rect.w > draw_pos.y ? ImMin((size_t)((clip_rect.w - draw_pos.y) / g.FontSize), row_count - 1) : 0;
+    state->ViewFirstLine = LineFromRow(folds, first_row);
+    state->ViewLastLine = LineFromRow(folds, last_row);
+    // With brackets to match or a fold to find, the whole text is lexed (UpdateBudget at a time, the view first)
+    if (state->Highlighter != NULL)
+    {
+        const bool lex_all = state->Brackets != NULL || (folds != NULL && folds->IsFoldPending());
+        state->Highlighter->Update(*text, lex_all ? text->LineCount() - 1 : LineFromRow(folds, last_row));
+    }
+    size_t bracket_a = 0, bracket_b = 0;
+    bool brackets_adjacent = false;
+    const bool render_brackets = render_cursor && FindCursorBrackets(state, &bracket_a, &bracket_b, &brackets_adjacent);
+    const ImU32 bracket_col = GetColorU32(ImGuiCol_Text, brackets_adjacent ? 0.60f : 0.25f);
+    size_t unfold_line = (size_t)-1;
+    size_t line_no = LineFromRow(folds, first_row);
+    size_t line_start = text->LineStart(line_no);
+    for (size_t row = first_row; row <= last_row; row++)
+    {
+        const size_t line_end = text->FindChar('\n', line_start);
+        const size_t visible_end = ReadLineUpToX(text, line_start, line_end, visible_max_x, &scratch);
+        size_t find_end = visible_end;
+        if (!state->FindText.empty() && visible_end < line_end)
+        {
+            // Also read the end of a match crossing the right edge
+            find_end = ImMin(line_end, visible_end + state->FindText.size() - 1);
+            ReadRange(text, line_start, find_end, &scratch);
+        }
+        const ImVec2 line_pos(draw_pos.x - state->ScrollX, draw_pos.y + row * g.FontSize);
+        const char* line_text = scratch.Data;
+        const char* line_text_end = scratch.Data + (visible_end - line_start);
+
+        if (render_selection && select_min <= line_end && select_max >= line_start && select_min <= visible_end)
+        {
+            // Past 'visible_end' we only know the selection is beyond the right edge
+            const size_t sel_begin = ImMax(select_min, line_start);
+            const size_t sel_end = ImMin(select_max, line_end);
+            float x0 = CalcWidth(line_text, line_text + (sel_begin - line_start));
+            float x1 = sel_end <= visible_end ? x0 + CalcWidth(line_text + (sel_begin - line_start), line_text + (sel_end - line_start)) : visible_max_x;
+            if (select_max > line_end)
+                x1 += IM_TRUNC(g.Font->GetCharAdvance((ImWchar)' ') * 0.50f); // So we can see selected empty lines
+            ImRect rect(line_pos + ImVec2(x0, 0.0f), line_pos + ImVec2(x1, g.FontSize));
+            rect.ClipWith(clip_rect);
+            if (rect.Overlaps(clip_rect))
+                draw_window->DrawList->AddRectFilled(rect.Min, rect.Max, select_col);
+        }
+
+        if (!state->FindText.empty())
+            DrawFindMatches(draw_window->DrawList, line_text, scratch.Data + (find_end - line_start), line_start, state, find_current, line_pos, clip_rect);
+
+        float draw_x;
+        const char* draw_begin = SkipToX(line_text, line_text_end, visible_min_x, &draw_x);
+        if (draw_begin != line_text_end)
+        {
+            runs.clear();
+            if (state->Highlighter != NULL && state->Highlighter->GetRuns(line_no, line_text, line_text_end, &runs))
+                DrawRuns(draw_window->DrawList, line_pos + ImVec2(draw_x, 0.0f), line_text, draw_begin, line_text_end, runs, text_col);
+            else
+                draw_window->DrawList->AddText(g.Font, g.FontSize, line_pos + ImVec2(draw_x, 0.0f), text_col, draw_begin, line_text_end);
+        }
+
+        if (render_brackets)
+        {
+            DrawBracketBox(draw_window->DrawList, line_text, line_start, visible_end, bracket_a, line_pos, bracket_col);
+            DrawBracketBox(draw_window->DrawList, line_text, line_start, visible_end, bracket_b, line_pos, bracket_col);
+        }
+
+        if (folds != NULL && visible_end == line_end && folds->IsFolded(line_no))
+        {
+            // Marker after the text of a folded line, clicking it unfolds the line
+            const char* marker = "...";
+            const float x = CalcWidth(line_text, line_text_end) + g.FontSize * 0.5f;
+            const ImRect rect(line_pos + ImVec2(x, 1.0f), line_pos + ImVec2(x + CalcWidth(marker, marker + 3) + g.FontSize * 0.5f, g.FontSize - 1.0f));
+            draw_window->DrawList->AddRectFilled(rect.Min, rect.Max, GetColorU32(ImGuiCol_FrameBgHovered), style.FrameRounding);
+            draw_window->DrawList->AddText(ImVec2(rect.Min.x + g.FontSize * 0.25f, line_pos.y), GetColorU32(ImGuiCol_TextDisabled), marker, marker + 3);
+            if (hovered && io.MouseClicked[0] && rect.Contains(io.MousePos))
+                unfold_line = line_no;
+        }
+
+        if (line_no == cursor_line && state->Cursor <= visible_end)
+        {
+            cursor_screen_pos = ImTrunc(line_pos + ImVec2(CalcWidth(line_text, line_text + (state->Cursor - line_start)), g.FontSize));
+            cursor_row_visible = true;
+        }
+        if (line_end >= text->Size())
+            break;
+        const size_t next_line = folds != NULL ? folds->NextVisibleLine(line_no) : line_no + 1;
+        line_start = next_line == line_no + 1 ? line_end + 1 : text->LineStart(next_line);
+        line_no = next_line;
+    }
+    if (unfold_line != (size_t)-1)
+        state->Folds->Unfold(unfold_line);
+
+    // Draw blinking cursor
+    if (render_cursor && cursor_row_visible)
+    {
+        state->CursorAnim += io.DeltaTime;
+        bool cursor_is_visible = (!g.IO.ConfigInputTextCursorBlink) || (state->CursorAnim <= 0.0f) || ImFmod(state->CursorAnim, 1.20f) <= 0.80f;
+        ImRect cursor_screen_rect(cursor_screen_pos.x, cursor_screen_pos.y - g.FontSize + 0.5f, cursor_screen_pos.x + 1.0f, cursor_screen_pos.y - 1.5f);
+        if (cursor_is_visible && cursor_screen_rect.Overlaps(clip_rect))
+            draw_window->DrawList->AddLine(cursor_screen_rect.Min, cursor_screen_rect.GetBL(), text_col);
+
+        if (!is_readonly)
+        {
+            g.PlatformImeData.WantVisible = true;
+            g.PlatformImeData.InputPos = ImVec2(cursor_screen_pos.x - 1.0f, cursor_screen_pos.y - g.FontSize);
+            g.PlatformImeData.InputLineHeight = g.FontSize;
+        }
+    }
+
+    Dummy(ImVec2(inner_size.x, content_height + style.FramePadding.y));
+    g.NextItemData.ItemFlags |= ImGuiItemFlags_Inputable | ImGuiItemFlags_NoTabStop;
+    EndChild();
+    item_data_backup.StatusFlags |= (g.LastItemData.StatusFlags & ImGuiItemStatusFlags_HoveredWindow);
+    EndGroup();
+    if (g.LastItemData.ID == 0)
+    {
+        g.LastItemData.ID = id;
+        g.LastItemData.InFlags = item_data_backup.InFlags;
+        g.LastItemData.StatusFlags = item_data_backup.StatusFlags;
+    }
+
+    if (value_changed)
+        MarkItemEdited(id);
+    return value_changed;
+}
+
+void TextEditorFoldAll(TextEditorState* state)
+{
+    state->Folds->FoldAll();
+}
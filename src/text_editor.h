@@ -0,0 +1,50 @@
+// Multi-line text editor widget working directly on a PieceTable.
+// This replaces InputTextMultiline() for editor tabs: InputText needs the whole text in one contiguous buffer
+// (plus a wide-char copy), while this widget reads the piece table through spans and edits it in place.
+
+#pragma once
+
+#include "imgui.h"
+#include "piece_table.h"
+#include "undo_history.h"
+#include <string>
+
+class BracketIndex;
+class CppHighlighter;
+class FoldIndex;
+
+// Per-document editor state (cursor, selection, scrolling, undo). Lives with the document so switching tabs keeps it.
+struct TextEditorState
+{
+    size_t      Cursor;                 // Byte offset of the cursor
+    size_t      SelectStart;            // Selection anchor. Selection is [min(SelectStart, Cursor), max(SelectStart, Cursor))
+    float       ScrollX;
+    float       PreferredX;             // Column kept when moving up/down, < 0.0f when unset
+    float       CursorAnim;
+    bool        CursorFollow;           // Scroll to cursor on next render
+    bool        SelectedAllMouseLock;
+    UndoHistory Undo;                   // Must be cleared if the text is replaced
+    std::string FindText;               // Occurrences of this are highlighted in the visible rows (the selected one more), empty for none
+    bool        FindIgnoreCase;
+    CppHighlighter* Highlighter;        // Colors the text (not owned, listening to it), NULL to draw it plain
+    FoldIndex*  Folds;                  // Folded regions (not owned, listening to the text), NULL if folding isn't available. Needs Highlighter.
+    BracketIndex* Brackets;             // Brackets filled by Highlighter (not owned), NULL to not match them
+    size_t      ViewFirstLine;          // Lines in view at the last render (e.g. for a minimap)
+    size_t      ViewLastLine;
+
+    TextEditorState()                   { Cursor = SelectStart = 0; ScrollX = 0.0f; PreferredX = -1.0f; CursorAnim = 0.0f; CursorFollow = false; SelectedAllMouseLock = false; FindIgnoreCase = false; Highlighter = NULL; Folds = NULL; Brackets = NULL; ViewFirstLine = ViewLastLine = 0; }
+    bool        HasSelection() const    { return Cursor != SelectStart; }
+    size_t      SelectionMin() const    { return Cursor < SelectStart ? Cursor : SelectStart; }
+    size_t      SelectionMax() const    { return Cursor > SelectStart ? Cursor : SelectStart; }
+    void        ClearSelection()        { SelectStart = Cursor; }
+};
+
+// Supported flags: ImGuiInputTextFlags_ReadOnly. Tab input is always enabled. Returns true when the text was edited.
+bool TextEditor(const char* label, PieceTable* text, TextEditorState* state, const ImVec2& size = ImVec2(0, 0), ImGuiInputTextFlags flags = 0);
+
+// Fold every region of the text (state->Folds must be set), once the next frames have found them. The cursor moves
+// out of the hidden lines.
+void TextEditorFoldAll(TextEditorState* state);
+
+// Color of a CppHighlighter token, 'text_col' for plain text
+ImU32 TextEditorTokenColor(int token, ImU32 text_col);
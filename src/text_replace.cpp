@@ -0,0 +1,283 @@
+// Replacing every match in a document (see text_replace.h)
+
+#include "text_replace.h"
+#include "regex_search.h"
+#include "text_search.h"
+#include <string.h>
+#include <algorithm>
+
+// The worker reads the text in windows of about this size (whole lines for a regex), and publishes its progress (and
+// checks for cancellation) after each
+static const size_t REPLACE_CHUNK_SIZE = 4 * 1024 * 1024;
+
+static inline bool IsUtf8Continuation(char c)
+{
+    return ((unsigned char)c & 0xC0) == 0x80;
+}
+
+const size_t TextReplace::ThreadMinSize;
+
+TextReplace::TextReplace()
+{
+    TotalBytes = 0;
+    CurrentVersion = 0;
+    UseRegex = false;
+    IgnoreCase = false;
+    OutputLen = 0;
+    OutputCapacity = 0;
+    ReplaceBegin = 0;
+    ReplaceEnd = 0;
+    ScannedBytes.store(0);
+    Count.store(0);
+    Done.store(true);
+    Complete.store(false);
+    CancelRequested.store(false);
+}
+
+TextReplace::~TextReplace()
+{
+    Cancel();
+}
+
+void TextReplace::Cancel()
+{
+    if (Thread.joinable())
+    {
+        CancelRequested.store(true);
+        Thread.join();
+    }
+}
+
+bool TextReplace::Start(const PieceTable& text, const std::string& pattern, bool regex, bool ignore_case, const std::string& replacement, std::string* out_error)
+{
+    Cancel();
+    Output.reset();
+    OutputLen = 0;
+    OutputCapacity = 0;
+    ScannedBytes.store(0);
+    Count.store(0);
+    Complete.store(false);
+    if (regex && !Re.Compile(pattern, ignore_case, out_error))
+        return false;
+    Pattern = pattern;
+    UseRegex = regex;
+    IgnoreCase = ignore_case;
+    Replacement = replacement;
+
+    text.GetSnapshot(&Snapshot);
+    Snapshot.GetSegments(&Segments);
+    TotalBytes = Snapshot.Size;
+    CurrentVersion = text.Version();
+
+    CancelRequested.store(false);
+    Done.store(false);
+    if (TotalBytes < ThreadMinSize)
+        Run();
+    else
+        Thread = std::thread(&TextReplace::Run, this);
+    return true;
+}
+
+bool TextReplace::Apply(PieceTable* text, UndoHistory* undo, size_t* out_begin, size_t* out_end)
+{
+    if (!Complete.load() || Count.load() == 0 || text->Version() != CurrentVersion)
+        return false;
+    Complete.store(false);
+    Snapshot = PieceTableSnapshot();
+    Segments.clear();
+    const size_t output_len = OutputLen;
+    undo->Replace(text, ReplaceBegin, ReplaceEnd - ReplaceBegin, std::move(Output), output_len);
+    OutputLen = 0;
+    OutputCapacity = 0;
+    *out_begin = ReplaceBegin;
+    *out_end = ReplaceBegin + output_len;
+    return true;
+}
+
+void TextReplace::Run()
+{
+    std::string buffer;
+    if (UseRegex)
+        ScanRegex(&buffer);
+    else if (!Pattern.empty())
+        ScanText(&buffer);
+
+    // The block is kept by the piece table (and the undo history) as long as the text: don't keep much more than needed
+    if (Count.load() > 0 && OutputCapacity - OutputLen > OutputLen / 4 && !CancelRequested.load())
+    {
+        std::unique_ptr<char[]> output(new char[std::max(OutputLen, (size_t)1)]);
+        memcpy(output.get(), Output.get(), OutputLen);
+        Output.swap(output);
+        OutputCapacity = OutputLen;
+    }
+    Complete.store(!CancelRequested.load());
+    Done.store(true);
+}
+
+// Matches don't overlap: after a match, the next one is searched from its end. A window holds the matches starting in
+// [pos, accept_end), which may end past it.
+void TextReplace::ScanText(std::string* buffer)
+{
+    const size_t needle_len = Pattern.size();
+    for (size_t pos = 0; pos < TotalBytes && !CancelRequested.load(); )
+    {
+        const size_t accept_end = std::min(TotalBytes, pos + REPLACE_CHUNK_SIZE);
+        const size_t window_end = std::min(TotalBytes, accept_end + needle_len - 1);
+        const char* data = GetText(pos, window_end - pos, buffer);
+        const char* data_end = data + (window_end - pos);
+        size_t next = accept_end;
+        for (const char* p = data; p < data_end; )
+        {
+            p = FindText(p, (size_t)(data_end - p), Pattern.data(), needle_len, IgnoreCase);
+            if (p == NULL || pos + (size_t)(p - data) >= accept_end)
+                break;
+            const size_t begin = pos + (size_t)(p - data);
+            AddMatch(begin, begin + needle_len);
+            next = std::max(next, begin + needle_len);
+            p += needle_len;
+        }
+        ScannedBytes.store(next);
+        pos = next;
+    }
+}
+
+// Line by line, like RegexSearch::SearchChunk(). A window is made of whole lines, without the '\n' of the last one.
+void TextReplace::ScanRegex(std::string* buffer)
+{
+    RegexMatcher matcher(&Re);
+    matcher.SetCancelFlag(&CancelRequested);
+    const std::string& literal = Re.RequiredLiteral();
+    const bool literal_only = Re.IsLiteral();
+    for (size_t pos = 0; pos <= TotalBytes && !CancelRequested.load(); )
+    {
+        size_t end = TotalBytes;
+        if (pos + REPLACE_CHUNK_SIZE < TotalBytes)
+        {
+            end = FindNewline(pos + REPLACE_CHUNK_SIZE - 1);
+            if (end == (size_t)-1)
+                end = TotalBytes;
+        }
+        const char* data = GetText(pos, end - pos, buffer);
+        RegexLineScanner lines(data, data + (end - pos), &matcher, Re);
+        while (lines.Next())
+        {
+            const char* line = lines.Line();
+            const char* match_end = lines.LineEnd();
+            if (literal_only)
+            {
+                for (const char* found = lines.LiteralMatch(); found != NULL && found + literal.size() <= match_end; )
+                {
+                    const char* next = found + literal.size();
+                    AddMatch(pos + (size_t)(found - data), pos + (size_t)(next - data));
+                    found = FindText(next, (size_t)(match_end - next), literal.data(), literal.size(), Re.IgnoreCase());
+                }
+                continue;
+            }
+
+            // Every match of the line. After an empty one, the next is searched from the next character.
+            const char* match_begin;
+            const char* match_last;
+            for (const char* from = line; from <= match_end && matcher.FindInLine(line, match_end, from, &match_begin, &match_last); )
+            {
+                AddMatch(pos + (size_t)(match_begin - data), pos + (size_t)(match_last - data));
+                if (match_last > match_begin)
+                {
+                    from = match_last;
+                    continue;
+                }
+                if (match_last == match_end)
+                    break;
+                from = match_last + 1;
+                while (from < match_end && IsUtf8Continuation(*from))
+                    from++;
+            }
+        }
+        ScannedBytes.store(end);
+        pos = end + 1;
+    }
+}
+
+void TextReplace::AddMatch(size_t begin, size_t end)
+{
+    if (Count.load() == 0)
+        ReplaceBegin = ReplaceEnd = begin;
+    AppendText(ReplaceEnd, begin - ReplaceEnd);
+    AppendOutput(Replacement.data(), Replacement.size());
+    ReplaceEnd = end;
+    Count++;
+}
+
+void TextReplace::AppendOutput(const char* data, size_t len)
+{
+    if (OutputCapacity - OutputLen < len)
+    {
+        const size_t capacity = std::max(OutputCapacity * 2, OutputLen + len);
+        std::unique_ptr<char[]> output(new char[capacity]);
+        if (OutputLen > 0)
+            memcpy(output.get(), Output.get(), OutputLen);
+        Output.swap(output);
+        OutputCapacity = capacity;
+    }
+    memcpy(Output.get() + OutputLen, data, len);
+    OutputLen += len;
+}
+
+// Copy [pos, pos + len) of the text to the output
+void TextReplace::AppendText(size_t pos, size_t len)
+{
+    for (size_t s = FindSegment(pos); s < Segments.size() && len > 0; s++)
+    {
+        const Segment& segment = Segments[s];
+        const size_t offset = pos - segment.Pos;
+        const size_t n = std::min(segment.Len - offset, len);
+        AppendOutput(segment.Data + offset, n);
+        pos += n;
+        len -= n;
+    }
+}
+
+// [pos, pos + len) of the text as contiguous bytes: in place when it is in one segment, else copied into 'buffer'
+const char* TextReplace::GetText(size_t pos, size_t len, std::string* buffer) const
+{
+    size_t s = FindSegment(pos);
+    if (s < Segments.size() && pos + len <= Segments[s].Pos + Segments[s].Len)
+        return Segments[s].Data + (pos - Segments[s].Pos);
+    buffer->clear();
+    for (; s < Segments.size() && buffer->size() < len; s++)
+    {
+        const Segment& segment = Segments[s];
+        const size_t offset = pos > segment.Pos ? pos - segment.Pos : 0;
+        buffer->append(segment.Data + offset, std::min(segment.Len - offset, len - buffer->size()));
+    }
+    return buffer->data();
+}
+
+// The segment containing 'pos', Segments.size() if it is at or past the end
+size_t TextReplace::FindSegment(size_t pos) const
+{
+    size_t lo = 0;
+    size_t hi = Segments.size();
+    while (lo < hi)
+    {
+        const size_t mid = (lo + hi) / 2;
+        if (Segments[mid].Pos + Segments[mid].Len <= pos)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// Offset of the first '\n' at or after 'from', (size_t)-1 if none
+size_t TextReplace::FindNewline(size_t from) const
+{
+    for (size_t s = FindSegment(from); s < Segments.size(); s++)
+    {
+        const Segment& segment = Segments[s];
+        const size_t begin = std::max(from, segment.Pos) - segment.Pos;
+        const char* p = (const char*)memchr(segment.Data + begin, '\n', segment.Len - begin);
+        if (p != NULL)
+            return segment.Pos + (size_t)(p - segment.Data);
+    }
+    return (size_t)-1;
+}
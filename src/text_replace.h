@@ -0,0 +1,85 @@
+// Replacing every match in a document ("Replace all").
+// Replacing n matches with n edits would move the rest of the text n times. Instead the text is scanned once, through
+// a snapshot, and the result is built as it goes in one block: the text from the first match to the end of the last
+// one, with every match replaced. Apply() then swaps that part of the text for the block as a single edit (one undo
+// record), and the piece table adopts the block without copying it. Texts from ThreadMinSize bytes are scanned on a
+// worker thread, the UI keeps running meanwhile.
+// Plain text is found the way the find bar finds it (FindText(), see text_search.h). A regex (see regex_engine.h) is
+// matched line by line, and every match of a line is replaced, not only the first one. The replacement is inserted as
+// is.
+
+#pragma once
+
+#include "piece_table.h"
+#include "regex_engine.h"
+#include "undo_history.h"
+#include <stddef.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+class TextReplace
+{
+public:
+    static const size_t ThreadMinSize = 1024 * 1024;    // Smaller texts are done in Start()
+
+    TextReplace();
+    ~TextReplace();                                 // Cancel()
+
+    // Replace the matches of 'pattern' (plain text, or a regex with 'regex') in 'text' with 'replacement', cancelling
+    // the replacement in progress. Returns false and sets 'out_error' if the regex is invalid.
+    bool        Start(const PieceTable& text, const std::string& pattern, bool regex, bool ignore_case, const std::string& replacement, std::string* out_error);
+    void        Cancel();
+
+    bool        IsReplacing() const                 { return !Done.load(); }
+    float       Progress() const                    { return TotalBytes > 0 ? (float)((double)ScannedBytes.load() / (double)TotalBytes) : 1.0f; }
+    size_t      MatchCount() const                  { return Count.load(); }    // So far
+    unsigned    TextVersion() const                 { return CurrentVersion; }  // PieceTable::Version() of the text
+
+    // Once IsReplacing() is false: make the replacements in 'text', recorded as one edit in 'undo', and set 'out_begin'
+    // and 'out_end' to the replaced part. Returns false, and changes nothing, if there was no match, if the replacement
+    // was cancelled, or if the text was edited since Start(). The result is handed over: it can be applied once.
+    bool        Apply(PieceTable* text, UndoHistory* undo, size_t* out_begin, size_t* out_end);
+
+private:
+    typedef PieceTableSnapshot::Segment Segment;
+
+    std::thread                 Thread;
+    PieceTableSnapshot          Snapshot;           // Keeps the blocks of the PieceTable alive while they are read
+    std::vector<Segment>        Segments;
+    size_t                      TotalBytes;
+    unsigned                    CurrentVersion;
+    std::string                 Pattern;
+    bool                        UseRegex;
+    bool                        IgnoreCase;
+    std::string                 Replacement;
+    Regex                       Re;
+
+    // The result, built by the worker: [ReplaceBegin, ReplaceEnd) of the text with the matches replaced
+    std::unique_ptr<char[]>     Output;
+    size_t                      OutputLen;
+    size_t                      OutputCapacity;
+    size_t                      ReplaceBegin;
+    size_t                      ReplaceEnd;         // Also where the text is copied from at the next match
+
+    std::atomic<size_t>         ScannedBytes;
+    std::atomic<size_t>         Count;
+    std::atomic<bool>           Done;
+    std::atomic<bool>           Complete;           // Ran to the end (wasn't cancelled)
+    std::atomic<bool>           CancelRequested;
+
+    void        Run();
+    void        ScanText(std::string* buffer);
+    void        ScanRegex(std::string* buffer);
+    void        AddMatch(size_t begin, size_t end);
+    void        AppendOutput(const char* data, size_t len);
+    void        AppendText(size_t pos, size_t len);
+    const char* GetText(size_t pos, size_t len, std::string* buffer) const;
+    size_t      FindSegment(size_t pos) const;
+    size_t      FindNewline(size_t from) const;
+
+    TextReplace(const TextReplace&);
+    TextReplace& operator=(const TextReplace&);
+};
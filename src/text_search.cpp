@@ -0,0 +1,429 @@
+// Finding text in documents (see text_search.h)
+
+#include "text_search.h"
+#include "file_io.h"
+#include <string.h>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define TEXT_SEARCH_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// The worker publishes its progress (and checks for cancellation) after each chunk of this size
+static const size_t SCAN_CHUNK_SIZE = 4 * 1024 * 1024;
+
+//-----------------------------------------------------------------------------
+// Kernel
+//-----------------------------------------------------------------------------
+
+static inline char FoldCase(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? (char)(c + ('a' - 'A')) : c;
+}
+
+static bool BytesEqual(const char* a, const char* b, size_t len, bool ignore_case)
+{
+    if (!ignore_case)
+        return memcmp(a, b, len) == 0;
+    for (size_t n = 0; n < len; n++)
+        if (FoldCase(a[n]) != FoldCase(b[n]))
+            return false;
+    return true;
+}
+
+// Positions [0, haystack_len - needle_len] are candidates. memchr() finds the first byte, the rest is compared.
+static const char* FindTextScalar(const char* haystack, size_t haystack_len, const char* needle, size_t needle_len, bool ignore_case)
+{
+    const char* last = haystack + (haystack_len - needle_len);
+    if (!ignore_case)
+    {
+        for (const char* p = haystack; p <= last; p++)
+        {
+            p = (const char*)memchr(p, needle[0], (size_t)(last - p) + 1);
+            if (p == NULL)
+                return NULL;
+            if (memcmp(p + 1, needle + 1, needle_len - 1) == 0)
+                return p;
+        }
+        return NULL;
+    }
+    const char first = FoldCase(needle[0]);
+    for (const char* p = haystack; p <= last; p++)
+        if (FoldCase(*p) == first && BytesEqual(p + 1, needle + 1, needle_len - 1, true))
+            return p;
+    return NULL;
+}
+
+#ifdef TEXT_SEARCH_X86
+
+static inline int CountTrailingZeros(uint32_t mask)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int)index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+static inline char OtherCase(char c, bool ignore_case)
+{
+    if (ignore_case && c >= 'a' && c <= 'z')
+        return (char)(c - ('a' - 'A'));
+    return c;
+}
+
+// Each block compares 16 candidate positions: their first byte against the needle's first byte and the byte at
+// needle_len - 1 against its last byte. Both have to match for the rest of the needle to be compared, which rarely
+// happens for a needle of 2 bytes or more. The tail shorter than a block is left to the scalar version.
+static const char* FindTextSSE2(const char* haystack, size_t haystack_len, const char* needle, size_t needle_len, bool ignore_case)
+{
+    const char first = ignore_case ? FoldCase(needle[0]) : needle[0];
+    const char last = ignore_case ? FoldCase(needle[needle_len - 1]) : needle[needle_len - 1];
+    const __m128i first_lo = _mm_set1_epi8(first);
+    const __m128i first_hi = _mm_set1_epi8(OtherCase(first, ignore_case));
+    const __m128i last_lo = _mm_set1_epi8(last);
+    const __m128i last_hi = _mm_set1_epi8(OtherCase(last, ignore_case));
+    size_t i = 0;
+    for (; i + needle_len - 1 + 16 <= haystack_len; i += 16)
+    {
+        const __m128i block_first = _mm_loadu_si128((const __m128i*)(haystack + i));
+        const __m128i block_last = _mm_loadu_si128((const __m128i*)(haystack + i + needle_len - 1));
+        const __m128i eq_first = _mm_or_si128(_mm_cmpeq_epi8(block_first, first_lo), _mm_cmpeq_epi8(block_first, first_hi));
+        const __m128i eq_last = _mm_or_si128(_mm_cmpeq_epi8(block_last, last_lo), _mm_cmpeq_epi8(block_last, last_hi));
+        for (uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(eq_first, eq_last)); mask != 0; mask &= mask - 1)
+        {
+            const char* p = haystack + i + CountTrailingZeros(mask);
+            if (needle_len <= 2 || BytesEqual(p + 1, needle + 1, needle_len - 2, ignore_case))
+                return p;
+        }
+    }
+    return FindTextScalar(haystack + i, haystack_len - i, needle, needle_len, ignore_case);
+}
+
+// Same with 32 positions per block
+#ifndef _MSC_VER
+__attribute__((target("avx2")))
+#endif
+static const char* FindTextAVX2(const char* haystack, size_t haystack_len, const char* needle, size_t needle_len, bool ignore_case)
+{
+    const char first = ignore_case ? FoldCase(needle[0]) : needle[0];
+    const char last = ignore_case ? FoldCase(needle[needle_len - 1]) : needle[needle_len - 1];
+    const __m256i first_lo = _mm256_set1_epi8(first);
+    const __m256i first_hi = _mm256_set1_epi8(OtherCase(first, ignore_case));
+    const __m256i last_lo = _mm256_set1_epi8(last);
+    const __m256i last_hi = _mm256_set1_epi8(OtherCase(last, ignore_case));
+    size_t i = 0;
+    for (; i + needle_len - 1 + 32 <= haystack_len; i += 32)
+    {
+        const __m256i block_first = _mm256_loadu_si256((const __m256i*)(haystack + i));
+        const __m256i block_last = _mm256_loadu_si256((const __m256i*)(haystack + i + needle_len - 1));
+        const __m256i eq_first = _mm256_or_si256(_mm256_cmpeq_epi8(block_first, first_lo), _mm256_cmpeq_epi8(block_first, first_hi));
+        const __m256i eq_last = _mm256_or_si256(_mm256_cmpeq_epi8(block_last, last_lo), _mm256_cmpeq_epi8(block_last, last_hi));
+        for (uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(eq_first, eq_last)); mask != 0; mask &= mask - 1)
+        {
+            const char* p = haystack + i + CountTrailingZeros(mask);
+            if (needle_len <= 2 || BytesEqual(p + 1, needle + 1, needle_len - 2, ignore_case))
+                return p;
+        }
+    }
+    return FindTextSSE2(haystack + i, haystack_len - i, needle, needle_len, ignore_case);
+}
+
+static bool CpuHasAVX2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    const bool os_saves_ymm = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+    __cpuidex(info, 7, 0);
+    return os_saves_ymm && (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+#endif // TEXT_SEARCH_X86
+
+typedef const char* (*FindTextFunc)(const char*, size_t, const char*, size_t, bool);
+
+static FindTextFunc SelectFindText()
+{
+#ifdef TEXT_SEARCH_X86
+    return CpuHasAVX2() ? FindTextAVX2 : FindTextSSE2;  // SSE2 is part of x86-64
+#else
+    return FindTextScalar;
+#endif
+}
+
+const char* FindText(const char* haystack, size_t haystack_len, const char* needle, size_t needle_len, bool ignore_case)
+{
+    static const FindTextFunc find_text = SelectFindText();
+    if (needle_len == 0 || needle_len > haystack_len)
+        return NULL;
+    if (needle_len == 1 && !ignore_case)
+        return (const char*)memchr(haystack, needle[0], haystack_len); // Already vectorized by the C library
+    return find_text(haystack, haystack_len, needle, needle_len, ignore_case);
+}
+
+//-----------------------------------------------------------------------------
+// TextSearch
+//-----------------------------------------------------------------------------
+
+const size_t TextSearch::MaxMatches;
+
+TextSearch::TextSearch()
+{
+    Mapped = false;
+    CurrentIgnoreCase = false;
+    CurrentVersion = 0;
+    CurrentText = NULL;
+    Refine = false;
+    TotalBytes = 0;
+    SearchedBytes.store(0);
+    Count.store(0);
+    Done.store(true);
+    Complete.store(false);
+    CancelRequested.store(false);
+}
+
+TextSearch::~TextSearch()
+{
+    Cancel();
+}
+
+void TextSearch::Cancel()
+{
+    if (Thread.joinable())
+    {
+        CancelRequested.store(true);
+        Thread.join();
+    }
+}
+
+void TextSearch::Start(const PieceTable& text, const std::string& query, bool ignore_case)
+{
+    Cancel();
+    Mapped = false;
+    text.GetSnapshot(&Snapshot);
+    Snapshot.GetSegments(&Segments);
+    TotalBytes = Snapshot.Size;
+    StartThread(query, ignore_case, &text, text.Version());
+}
+
+void TextSearch::StartMapped(const char* data, size_t size, const std::string& query, bool ignore_case)
+{
+    Cancel();
+    Snapshot = PieceTableSnapshot();
+    Mapped = true;
+    Segments.clear();
+    if (size > 0)
+    {
+        Segment segment = { data, size, 0 };
+        Segments.push_back(segment);
+    }
+    TotalBytes = size;
+    StartThread(query, ignore_case, data, 0);
+}
+
+// Whether two occurrences of 'query' can overlap ("aa" in "aaa"), i.e. whether a proper prefix of it is also a suffix
+static bool CanOverlap(const std::string& query, bool ignore_case)
+{
+    for (size_t len = 1; len < query.size(); len++)
+        if (BytesEqual(query.data(), query.data() + query.size() - len, len, ignore_case))
+            return true;
+    return false;
+}
+
+void TextSearch::StartThread(const std::string& query, bool ignore_case, const void* text, unsigned version)
+{
+    // Occurrences of "abc" are occurrences of "ab", so typing more of the query only needs to check the matches we
+    // have. Matches don't overlap, so this only holds when occurrences of the previous query can't overlap either.
+    Refine = Complete.load() && text == CurrentText && version == CurrentVersion && ignore_case == CurrentIgnoreCase &&
+        !CurrentQuery.empty() && query.compare(0, CurrentQuery.size(), CurrentQuery) == 0 &&
+        Count.load() <= MaxMatches && !CanOverlap(CurrentQuery, ignore_case);
+    if (!Refine)
+    {
+        std::lock_guard<std::mutex> lock(MatchesMutex);
+        Matches.clear();
+        Count.store(0);
+    }
+    CurrentQuery = query;
+    CurrentIgnoreCase = ignore_case;
+    CurrentText = text;
+    CurrentVersion = version;
+    SearchedBytes.store(0);
+    CancelRequested.store(false);
+    Complete.store(false);
+    Done.store(false);
+    Thread = std::thread(&TextSearch::Run, this);
+}
+
+bool TextSearch::FindNext(size_t pos, size_t* out_pos) const
+{
+    std::lock_guard<std::mutex> lock(MatchesMutex);
+    if (Matches.empty())
+        return false;
+    std::vector<size_t>::const_iterator it = std::lower_bound(Matches.begin(), Matches.end(), pos);
+    *out_pos = it != Matches.end() ? *it : Matches.front();
+    return true;
+}
+
+bool TextSearch::FindPrev(size_t pos, size_t* out_pos) const
+{
+    std::lock_guard<std::mutex> lock(MatchesMutex);
+    if (Matches.empty())
+        return false;
+    std::vector<size_t>::const_iterator it = std::lower_bound(Matches.begin(), Matches.end(), pos);
+    *out_pos = it != Matches.begin() ? *(it - 1) : Matches.back();
+    return true;
+}
+
+void TextSearch::AddMatches(const std::vector<size_t>& found, size_t count)
+{
+    std::lock_guard<std::mutex> lock(MatchesMutex);
+    const size_t keep = std::min(found.size(), MaxMatches - std::min(Matches.size(), MaxMatches));
+    Matches.insert(Matches.end(), found.begin(), found.begin() + (ptrdiff_t)keep);
+    Count.store(Count.load() + count);
+}
+
+// Copy [pos, pos + len) of the text into 'out', or what there is of it. 'pos' is in Segments[segment].
+void TextSearch::CopyText(size_t segment, size_t pos, size_t len, std::string* out) const
+{
+    out->clear();
+    for (size_t s = segment; s < Segments.size() && out->size() < len; s++)
+    {
+        const size_t offset = pos > Segments[s].Pos ? pos - Segments[s].Pos : 0;
+        out->append(Segments[s].Data + offset, std::min(Segments[s].Len - offset, len - out->size()));
+    }
+}
+
+// Whether the query occurs at 'pos'. Positions have to be increasing from one call to the next: '*segment' is where
+// the previous one was found (0 to start with).
+bool TextSearch::MatchesAt(size_t* segment, size_t pos) const
+{
+    while (*segment < Segments.size() && Segments[*segment].Pos + Segments[*segment].Len <= pos)
+        (*segment)++;
+    size_t offset = *segment < Segments.size() ? pos - Segments[*segment].Pos : 0;
+    size_t matched = 0;
+    for (size_t s = *segment; matched < CurrentQuery.size(); s++, offset = 0)
+    {
+        if (s >= Segments.size())
+            return false;
+        const size_t len = std::min(Segments[s].Len - offset, CurrentQuery.size() - matched);
+        if (!BytesEqual(Segments[s].Data + offset, CurrentQuery.data() + matched, len, CurrentIgnoreCase))
+            return false;
+        matched += len;
+    }
+    return true;
+}
+
+void TextSearch::Run()
+{
+    if (!CurrentQuery.empty())
+    {
+        if (Refine)
+            RefineMatches();
+        else
+            Scan();
+    }
+    Complete.store(!CancelRequested.load());
+    Done.store(true);
+}
+
+// Matches don't overlap: after a match, the next one is searched from its end ('next_pos')
+void TextSearch::Scan()
+{
+    const char* needle = CurrentQuery.data();
+    const size_t needle_len = CurrentQuery.size();
+    std::vector<size_t> found;
+    std::string window;
+    size_t next_pos = 0;
+    for (size_t s = 0; s < Segments.size() && !CancelRequested.load(); s++)
+    {
+        const Segment& segment = Segments[s];
+        for (size_t chunk_start = 0; chunk_start < segment.Len && !CancelRequested.load(); )
+        {
+            // Matches starting in the chunk, they may end in the rest of the segment
+            const size_t chunk_end = std::min(segment.Len, chunk_start + SCAN_CHUNK_SIZE);
+            const char* search_end = segment.Data + std::min(segment.Len, chunk_end + needle_len - 1);
+            const char* p = segment.Data + std::max(chunk_start, next_pos > segment.Pos ? next_pos - segment.Pos : 0);
+            size_t count = 0;
+            found.clear();
+            while (p < search_end && (p = FindText(p, (size_t)(search_end - p), needle, needle_len, CurrentIgnoreCase)) != NULL)
+            {
+                const size_t pos = segment.Pos + (size_t)(p - segment.Data);
+                found.push_back(pos);
+                count++;
+                next_pos = pos + needle_len;
+                p += needle_len;
+            }
+            AddMatches(found, count);
+            SearchedBytes.store(segment.Pos + chunk_end);
+            if (Mapped)
+                ReleaseMappedPages(segment.Data, chunk_start, chunk_end - chunk_start);
+            chunk_start = chunk_end;
+        }
+
+        // Matches starting at the end of this segment and ending in the next ones
+        const size_t boundary = segment.Pos + segment.Len;
+        const size_t window_start = std::max(boundary - std::min(segment.Len, needle_len - 1), next_pos);
+        if (s + 1 < Segments.size() && window_start < boundary && !CancelRequested.load())
+        {
+            CopyText(s, window_start, boundary + needle_len - 1 - window_start, &window);
+            size_t count = 0;
+            found.clear();
+            for (const char* p = window.data(); p < window.data() + window.size(); p += needle_len)
+            {
+                p = FindText(p, (size_t)(window.data() + window.size() - p), needle, needle_len, CurrentIgnoreCase);
+                if (p == NULL || window_start + (size_t)(p - window.data()) >= boundary)
+                    break;
+                const size_t pos = window_start + (size_t)(p - window.data());
+                found.push_back(pos);
+                count++;
+                next_pos = pos + needle_len;
+            }
+            AddMatches(found, count);
+        }
+    }
+}
+
+// The previous query is a prefix of this one: its matches are the only candidates
+void TextSearch::RefineMatches()
+{
+    std::vector<size_t> previous;
+    {
+        std::lock_guard<std::mutex> lock(MatchesMutex);
+        previous.swap(Matches);
+        Count.store(0);
+    }
+    const size_t batch_size = 64 * 1024;
+    std::vector<size_t> found;
+    size_t segment = 0;
+    size_t next_pos = 0;
+    for (size_t n = 0; n < previous.size() && !CancelRequested.load(); n++)
+    {
+        if (previous[n] >= next_pos && MatchesAt(&segment, previous[n]))
+        {
+            found.push_back(previous[n]);
+            next_pos = previous[n] + CurrentQuery.size();
+        }
+        if (found.size() == batch_size)
+        {
+            AddMatches(found, found.size());
+            found.clear();
+            SearchedBytes.store(previous[n]);
+        }
+    }
+    AddMatches(found, found.size());
+    SearchedBytes.store(TotalBytes);
+}
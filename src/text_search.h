@@ -0,0 +1,84 @@
+// Finding text in documents.
+// FindText() is the search kernel. It compares the first and the last byte of the needle against 16 (SSE2) or 32
+// (AVX2) positions of the haystack at once and only verifies the positions where both match, so it runs at about
+// memory bandwidth on real text. The instruction set is picked at runtime (memchr() + memcmp() on other CPUs).
+// TextSearch runs the kernel over a whole document on a worker thread: the UI never waits for it, and it only keeps
+// the positions of the matches (for Find next/previous) and their count. Highlighting is done by the editor and the
+// viewer, which search the rows they display themselves.
+
+#pragma once
+
+#include "piece_table.h"
+#include <stddef.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// First occurrence of 'needle' in 'haystack', NULL if none (or if the needle is empty). 'ignore_case' folds ASCII
+// letters only.
+const char* FindText(const char* haystack, size_t haystack_len, const char* needle, size_t needle_len, bool ignore_case);
+
+class TextSearch
+{
+public:
+    static const size_t MaxMatches = 1024 * 1024;   // Matches past this many are counted but their position is not kept
+
+    TextSearch();
+    ~TextSearch();                                  // Cancel()
+
+    // Search 'text' (through a snapshot, the table can be edited meanwhile) for 'query', cancelling the search in
+    // progress. When 'query' extends the query of the previous search of the same text, and that search completed,
+    // only the previous matches are checked.
+    void        Start(const PieceTable& text, const std::string& query, bool ignore_case);
+
+    // Same for a read-only memory mapping of a file (FileView::Data()), which must outlive the search. The pages are
+    // released as they are searched, like FileView does when indexing.
+    void        StartMapped(const char* data, size_t size, const std::string& query, bool ignore_case);
+    void        Cancel();
+
+    const std::string& Query() const                { return CurrentQuery; }
+    bool        IgnoreCase() const                  { return CurrentIgnoreCase; }
+    unsigned    TextVersion() const                 { return CurrentVersion; }  // PieceTable::Version() of the searched text
+    bool        IsSearching() const                 { return !Done.load(); }
+    float       Progress() const                    { return TotalBytes > 0 ? (float)((double)SearchedBytes.load() / (double)TotalBytes) : 1.0f; }
+    size_t      MatchCount() const                  { return Count.load(); }    // So far
+
+    // Offset of the first match at or after 'pos' / the last match before 'pos', wrapping around the end of the text.
+    // Only the matches found so far and kept (see MaxMatches) are considered. Return false if there is none.
+    bool        FindNext(size_t pos, size_t* out_pos) const;
+    bool        FindPrev(size_t pos, size_t* out_pos) const;
+
+private:
+    typedef PieceTableSnapshot::Segment Segment;
+
+    std::thread                 Thread;
+    PieceTableSnapshot          Snapshot;           // Keeps the blocks of a PieceTable alive while they are searched
+    bool                        Mapped;
+    std::vector<Segment>        Segments;
+    std::string                 CurrentQuery;
+    bool                        CurrentIgnoreCase;
+    unsigned                    CurrentVersion;
+    const void*                 CurrentText;        // What was searched (PieceTable or mapping), to tell if a query can be refined
+    bool                        Refine;             // Check the previous matches only
+    mutable std::mutex          MatchesMutex;
+    std::vector<size_t>         Matches;            // Sorted. Protected by MatchesMutex.
+    size_t                      TotalBytes;
+    std::atomic<size_t>         SearchedBytes;
+    std::atomic<size_t>         Count;
+    std::atomic<bool>           Done;
+    std::atomic<bool>           Complete;           // The last search ran to the end (wasn't cancelled)
+    std::atomic<bool>           CancelRequested;
+
+    void        StartThread(const std::string& query, bool ignore_case, const void* text, unsigned version);
+    void        Run();
+    void        Scan();
+    void        RefineMatches();
+    void        AddMatches(const std::vector<size_t>& found, size_t count);
+    void        CopyText(size_t segment, size_t pos, size_t len, std::string* out) const;
+    bool        MatchesAt(size_t* segment, size_t pos) const;
+
+    TextSearch(const TextSearch&);
+    TextSearch& operator=(const TextSearch&);
+};
@@ -0,0 +1,669 @@
+// Trigram index of the files of a project (see trigram_index.h)
+
+#include "trigram_index.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <unordered_set>
+
+static const char INDEX_MAGIC[8] = { 'I', 'R', 'O', 'H', 'T', 'R', 'I', '1' };
+
+enum IndexFileFlags
+{
+    FILE_BINARY = 1 << 0,
+};
+
+// The build workers hand their files over in batches of about this many trigrams: merging them into the posting lists
+// happens under a lock
+static const size_t BUILD_BATCH_TRIGRAMS = 256 * 1024;
+
+struct IndexHeader
+{
+    char        Magic[8];
+    uint64_t    FileCount;
+    uint64_t    TrigramCount;
+    uint64_t    FilesOffset;
+    uint64_t    TrigramsOffset;
+    uint64_t    PostingsOffset;
+    uint64_t    PathsOffset;
+    uint64_t    TotalSize;
+};
+
+static inline uint32_t FoldByte(unsigned char c)
+{
+    return (unsigned)(c - 'A') < 26u ? c + 32u : c;
+}
+
+// The distinct trigrams of [data, data + size), sorted. 'seen' is a scratch bitset of all the trigrams, left clear.
+static void ExtractTrigrams(const char* data, size_t size, std::vector<uint64_t>* seen, std::vector<uint32_t>* out)
+{
+    out->clear();
+    if (seen->empty())
+        seen->resize((1u << 24) / 64);
+    uint64_t* bits = &(*seen)[0];
+    uint32_t trigram = 0;
+    for (size_t n = 0; n < size; n++)
+    {
+        trigram = ((trigram << 8) | FoldByte((unsigned char)data[n])) & 0xFFFFFF;
+        if (n < 2 || (bits[trigram >> 6] >> (trigram & 63)) & 1)
+            continue;
+        bits[trigram >> 6] |= (uint64_t)1 << (trigram & 63);
+        out->push_back(trigram);
+    }
+    // Every bit set is one of ours: clearing whole words is enough
+    for (size_t n = 0; n < out->size(); n++)
+        bits[(*out)[n] >> 6] = 0;
+    std::sort(out->begin(), out->end());
+}
+
+static void AppendVarint(std::string* out, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        out->push_back((char)(value | 0x80));
+        value >>= 7;
+    }
+    out->push_back((char)value);
+}
+
+static inline const uint8_t* ReadVarint(const uint8_t* p, uint32_t* out)
+{
+    uint32_t value = 0;
+    for (int shift = 0; ; shift += 7)
+    {
+        const uint8_t b = *p++;
+        value |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            break;
+    }
+    *out = value;
+    return p;
+}
+
+static inline uint64_t AlignUp(uint64_t offset)
+{
+    return (offset + 7) & ~(uint64_t)7;
+}
+
+//-----------------------------------------------------------------------------
+// Building
+//-----------------------------------------------------------------------------
+
+struct IndexedFile
+{
+    size_t      Path;               // In IndexBuild::Paths
+    FileStamp   Stamp;
+    bool        Binary;
+};
+
+struct PostingList
+{
+    uint32_t    Last;               // Id of the last file appended
+    uint32_t    Count;
+    std::string Bytes;
+};
+
+struct IndexBuild
+{
+    std::string                         Root;
+    std::vector<std::string>            Paths;
+    const std::atomic<bool>*            Cancel;
+    std::atomic<size_t>*                Done;
+    std::atomic<size_t>                 Next;
+    std::mutex                          Mutex;      // Protects Files and Postings, a file's id is its index in Files
+    std::vector<IndexedFile>            Files;
+    std::unordered_map<uint32_t, PostingList> Postings;
+};
+
+static void MergeBatch(IndexBuild* build, const std::vector<IndexedFile>& files, const std::vector<size_t>& ends, const std::vector<uint32_t>& trigrams)
+{
+    std::lock_guard<std::mutex> lock(build->Mutex);
+    size_t begin = 0;
+    for (size_t n = 0; n < files.size(); n++)
+    {
+        const uint32_t id = (uint32_t)build->Files.size();
+        build->Files.push_back(files[n]);
+        for (size_t t = begin; t < ends[n]; t++)
+        {
+            PostingList& list = build->Postings[trigrams[t]];
+            AppendVarint(&list.Bytes, list.Count > 0 ? id - list.Last : id);
+            list.Last = id;
+            list.Count++;
+        }
+        begin = ends[n];
+    }
+}
+
+static void IndexBuildWorker(IndexBuild* build)
+{
+    std::vector<uint64_t> seen;
+    std::string buffer;
+    std::vector<uint32_t> trigrams;
+    std::vector<IndexedFile> batch_files;
+    std::vector<size_t> batch_ends;         // End of each file's trigrams in batch_trigrams
+    std::vector<uint32_t> batch_trigrams;
+    for (;;)
+    {
+        const size_t n = build->Next++;
+        const bool last = n >= build->Paths.size() || build->Cancel->load();
+        if (!last)
+        {
+            // Files that can't be read are left out, Refresh() will try them again
+            const std::string filename = build->Root + build->Paths[n];
+            IndexedFile file;
+            file.Path = n;
+            ProjectFile contents;
+            if (GetFileStamp(filename.c_str(), &file.Stamp) && contents.Open(filename.c_str(), &buffer))
+            {
+                file.Binary = IsBinaryText(contents.Data(), contents.Size());
+                if (!file.Binary)
+                {
+                    ExtractTrigrams(contents.Data(), contents.Size(), &seen, &trigrams);
+                    batch_trigrams.insert(batch_trigrams.end(), trigrams.begin(), trigrams.end());
+                }
+                batch_files.push_back(file);
+                batch_ends.push_back(batch_trigrams.size());
+            }
+            (*build->Done)++;
+        }
+        if (batch_trigrams.size() >= BUILD_BATCH_TRIGRAMS || (last && !batch_files.empty()))
+        {
+            MergeBatch(build, batch_files, batch_ends, batch_trigrams);
+            batch_files.clear();
+            batch_ends.clear();
+            batch_trigrams.clear();
+        }
+        if (last)
+            break;
+    }
+}
+
+// The index file, in memory
+static void SerializeIndex(const IndexBuild& build, std::string* out)
+{
+    std::vector<uint32_t> trigrams;
+    trigrams.reserve(build.Postings.size());
+    uint64_t postings_size = 0;
+    for (std::unordered_map<uint32_t, PostingList>::const_iterator it = build.Postings.begin(); it != build.Postings.end(); ++it)
+    {
+        trigrams.push_back(it->first);
+        postings_size += it->second.Bytes.size();
+    }
+    std::sort(trigrams.begin(), trigrams.end());
+
+    IndexHeader header;
+    memcpy(header.Magic, INDEX_MAGIC, sizeof(header.Magic));
+    header.FileCount = build.Files.size();
+    header.TrigramCount = trigrams.size();
+    header.FilesOffset = sizeof(IndexHeader);
+    header.TrigramsOffset = header.FilesOffset + header.FileCount * sizeof(TrigramIndex::FileEntry);
+    header.PostingsOffset = header.TrigramsOffset + header.TrigramCount * sizeof(TrigramIndex::TrigramEntry);
+    header.PathsOffset = AlignUp(header.PostingsOffset + postings_size);
+    uint64_t paths_size = 0;
+    for (size_t n = 0; n < build.Files.size(); n++)
+        paths_size += build.Paths[build.Files[n].Path].size() + 1;
+    header.TotalSize = AlignUp(header.PathsOffset + paths_size);
+
+    out->assign((size_t)header.TotalSize, '\0');
+    char* data = &(*out)[0];
+    memcpy(data, &header, sizeof(header));
+    TrigramIndex::FileEntry* files = (TrigramIndex::FileEntry*)(data + header.FilesOffset);
+    uint64_t path_offset = 0;
+    for (size_t n = 0; n < build.Files.size(); n++)
+    {
+        const IndexedFile& file = build.Files[n];
+        const std::string& path = build.Paths[file.Path];
+        files[n].PathOffset = path_offset;
+        files[n].Size = file.Stamp.Size;
+        files[n].MTime = file.Stamp.MTime;
+        files[n].Flags = file.Binary ? FILE_BINARY : 0;
+        files[n].Reserved = 0;
+        memcpy(data + header.PathsOffset + path_offset, path.c_str(), path.size() + 1);
+        path_offset += path.size() + 1;
+    }
+    TrigramIndex::TrigramEntry* entries = (TrigramIndex::TrigramEntry*)(data + header.TrigramsOffset);
+    uint64_t postings_offset = 0;
+    for (size_t n = 0; n < trigrams.size(); n++)
+    {
+        const PostingList& list = build.Postings.find(trigrams[n])->second;
+        entries[n].Trigram = trigrams[n];
+        entries[n].Count = list.Count;
+        entries[n].PostingsOffset = postings_offset;
+        memcpy(data + header.PostingsOffset + postings_offset, list.Bytes.data(), list.Bytes.size());
+        postings_offset += list.Bytes.size();
+    }
+}
+
+//-----------------------------------------------------------------------------
+// TrigramIndex
+//-----------------------------------------------------------------------------
+
+static bool TrigramLess(const TrigramIndex::TrigramEntry& entry, uint32_t trigram)
+{
+    return entry.Trigram < trigram;
+}
+
+static bool ShorterPostings(const TrigramIndex::TrigramEntry* a, const TrigramIndex::TrigramEntry* b)
+{
+    return a->Count < b->Count;
+}
+
+const char* const TrigramIndex::FileName = ".irohde-trigrams";
+const size_t TrigramIndex::MaxChangedFiles;
+
+TrigramIndex::TrigramIndex()
+{
+    Opened = false;
+    Files = NULL;
+    FilesCount = 0;
+    Trigrams = NULL;
+    TrigramsCount = 0;
+    Postings = NULL;
+    Paths = NULL;
+    Running = false;
+    BuildRequested = false;
+    RefreshRequested = false;
+    Updating = false;
+    Building = false;
+    BuildDone = 0;
+    BuildTotal = 0;
+    CancelRequested = false;
+}
+
+TrigramIndex::~TrigramIndex()
+{
+    Close();
+}
+
+void TrigramIndex::Open(const std::string& root)
+{
+    Close();
+    RootDir = root;
+    Opened = true;
+    CancelRequested = false;
+    bool loaded;
+    {
+        std::lock_guard<std::mutex> lock(IndexMutex);
+        loaded = File.Open((RootDir + FileName).c_str(), &IndexBuffer) && UseIndex(File.Data(), File.Size());
+        if (!loaded)
+            UnmapIndex();
+    }
+    std::lock_guard<std::mutex> lock(TasksMutex);
+    if (loaded)
+        RefreshRequested = true;
+    else
+        BuildRequested = true;
+    StartThread();
+}
+
+void TrigramIndex::Close()
+{
+    CancelRequested = true;
+    if (Thread.joinable())
+        Thread.join();
+    Running = false;
+    BuildRequested = false;
+    RefreshRequested = false;
+    Updating = false;
+    ChangedPaths.clear();
+    Building = false;
+    std::lock_guard<std::mutex> lock(IndexMutex);
+    UnmapIndex();
+    Opened = false;
+}
+
+void TrigramIndex::Refresh()
+{
+    if (!Opened)
+        return;
+    std::lock_guard<std::mutex> lock(TasksMutex);
+    RefreshRequested = true;
+    StartThread();
+}
+
+void TrigramIndex::FileChanged(const std::string& path)
+{
+    if (!Opened || path.compare(0, RootDir.size(), RootDir) != 0 || path.size() == RootDir.size())
+        return;
+    std::string relative = path.substr(RootDir.size());
+    if (RootDir.empty() && (relative[0] == '/' || relative[0] == '\\' || relative.find(':') != std::string::npos))
+        return;
+    std::lock_guard<std::mutex> lock(TasksMutex);
+    ChangedPaths.push_back(relative);
+    StartThread();
+}
+
+size_t TrigramIndex::FileCount() const
+{
+    std::lock_guard<std::mutex> lock(IndexMutex);
+    return FilesCount;
+}
+
+bool TrigramIndex::IsRefreshing() const
+{
+    std::lock_guard<std::mutex> lock(TasksMutex);
+    return RefreshRequested || Updating || !ChangedPaths.empty();
+}
+
+bool TrigramIndex::Candidates(const std::string& literal, std::vector<std::string>* out) const
+{
+    out->clear();
+    if (literal.size() < 3)
+        return false;
+    std::vector<uint32_t> query;
+    uint32_t trigram = 0;
+    for (size_t n = 0; n < literal.size(); n++)
+    {
+        trigram = ((trigram << 8) | FoldByte((unsigned char)literal[n])) & 0xFFFFFF;
+        if (n >= 2)
+            query.push_back(trigram);
+    }
+    std::sort(query.begin(), query.end());
+    query.erase(std::unique(query.begin(), query.end()), query.end());
+
+    // Files changed on disk may not be found until the refresh is done
+    if (IsRefreshing())
+        return false;
+
+    std::lock_guard<std::mutex> lock(IndexMutex);
+    if (Files == NULL)
+        return false;
+
+    // The files of the index are in all the posting lists: intersect them, shortest first
+    std::vector<const TrigramEntry*> lists;
+    for (size_t n = 0; n < query.size(); n++)
+    {
+        const TrigramEntry* entry = std::lower_bound(Trigrams, Trigrams + TrigramsCount, query[n], TrigramLess);
+        if (entry == Trigrams + TrigramsCount || entry->Trigram != query[n])
+        {
+            lists.clear();
+            break;
+        }
+        lists.push_back(entry);
+    }
+    std::sort(lists.begin(), lists.end(), ShorterPostings);
+    std::vector<uint32_t> ids;
+    std::vector<uint32_t> kept;
+    for (size_t n = 0; n < lists.size(); n++)
+    {
+        const uint8_t* p = Postings + lists[n]->PostingsOffset;
+        uint32_t id = 0;
+        if (n == 0)
+        {
+            ids.resize(lists[n]->Count);
+            for (uint32_t k = 0; k < lists[n]->Count; k++)
+            {
+                uint32_t delta;
+                p = ReadVarint(p, &delta);
+                id = k == 0 ? delta : id + delta;
+                ids[k] = id;
+            }
+            continue;
+        }
+        kept.clear();
+        size_t i = 0;
+        for (uint32_t k = 0; k < lists[n]->Count && i < ids.size(); k++)
+        {
+            uint32_t delta;
+            p = ReadVarint(p, &delta);
+            id = k == 0 ? delta : id + delta;
+            while (i < ids.size() && ids[i] < id)
+                i++;
+            if (i < ids.size() && ids[i] == id)
+                kept.push_back(ids[i++]);
+        }
+        ids.swap(kept);
+        if (ids.empty())
+            break;
+    }
+    for (size_t n = 0; n < ids.size(); n++)
+        if (!Masked[ids[n]])
+            out->push_back(Paths + Files[ids[n]].PathOffset);
+
+    // The files indexed again since
+    for (std::map<std::string, ChangedFile>::const_iterator it = Changed.begin(); it != Changed.end(); ++it)
+        if (std::includes(it->second.Trigrams.begin(), it->second.Trigrams.end(), query.begin(), query.end()))
+            out->push_back(it->first);
+    return true;
+}
+
+// Called with TasksMutex locked
+void TrigramIndex::StartThread()
+{
+    if (Running)
+        return;
+    // A thread that set Running to false has nothing left to do
+    if (Thread.joinable())
+        Thread.join();
+    Running = true;
+    Thread = std::thread(&TrigramIndex::Run, this);
+}
+
+void TrigramIndex::Run()
+{
+    for (;;)
+    {
+        bool build;
+        bool refresh;
+        std::vector<std::string> paths;
+        {
+            std::lock_guard<std::mutex> lock(TasksMutex);
+            Updating = false;
+            if (CancelRequested.load() || (!BuildRequested && !RefreshRequested && ChangedPaths.empty()))
+            {
+                Running = false;
+                return;
+            }
+            build = BuildRequested;
+            refresh = RefreshRequested;
+            Updating = refresh || !ChangedPaths.empty();
+            BuildRequested = false;
+            RefreshRequested = false;
+            paths.swap(ChangedPaths);
+        }
+
+        // A build reads the files as they are now, changed ones included
+        if (build)
+        {
+            Build();
+            continue;
+        }
+        if (refresh)
+            RefreshFiles();
+        for (size_t n = 0; n < paths.size() && !CancelRequested.load(); n++)
+            UpdateFile(paths[n]);
+
+        size_t changed_count;
+        {
+            std::lock_guard<std::mutex> lock(IndexMutex);
+            changed_count = Changed.size() + (size_t)std::count(Masked.begin(), Masked.end(), true);
+        }
+        if (changed_count > MaxChangedFiles)
+        {
+            std::lock_guard<std::mutex> lock(TasksMutex);
+            BuildRequested = true;
+        }
+    }
+}
+
+void TrigramIndex::Build()
+{
+    BuildDone = 0;
+    BuildTotal = 0;
+    Building = true;
+    IndexBuild build;
+    build.Root = RootDir;
+    build.Cancel = &CancelRequested;
+    build.Done = &BuildDone;
+    build.Next = 0;
+    ListProjectFiles(RootDir, &build.Paths, &CancelRequested);
+    build.Paths.erase(std::remove(build.Paths.begin(), build.Paths.end(), std::string(FileName)), build.Paths.end());
+    BuildTotal = build.Paths.size();
+
+    const unsigned worker_count = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> workers;
+    for (unsigned n = 0; n < worker_count; n++)
+        workers.push_back(std::thread(IndexBuildWorker, &build));
+    for (size_t n = 0; n < workers.size(); n++)
+        workers[n].join();
+    if (CancelRequested.load())
+    {
+        Building = false;
+        return;
+    }
+
+    // Written next to the old one, which can't be replaced while it is mapped (on Windows). If it can't be written
+    // (read-only directory), the index is used from memory: it is built again next time.
+    std::string index;
+    SerializeIndex(build, &index);
+    const std::string filename = RootDir + FileName;
+    const std::string temp_filename = filename + ".tmp";
+    FILE* f = fopen(temp_filename.c_str(), "wb");
+    bool written = f != NULL && fwrite(index.data(), 1, index.size(), f) == index.size();
+    if (f != NULL && fclose(f) != 0)
+        written = false;
+    {
+        std::lock_guard<std::mutex> lock(IndexMutex);
+        UnmapIndex();
+        if (!written || !FileReplace(temp_filename.c_str(), filename.c_str()))
+            remove(temp_filename.c_str());
+        IndexBuffer.swap(index);
+        UseIndex(IndexBuffer.data(), IndexBuffer.size());
+    }
+    Building = false;
+}
+
+// The files created, changed or deleted since they were indexed, by size and modification time
+void TrigramIndex::RefreshFiles()
+{
+    std::vector<std::string> paths;
+    ListProjectFiles(RootDir, &paths, &CancelRequested);
+    if (CancelRequested.load())
+        return;
+    std::vector<bool> seen(FilesCount, false);
+    std::unordered_set<std::string> listed;
+    for (size_t n = 0; n < paths.size() && !CancelRequested.load(); n++)
+    {
+        if (paths[n] == FileName)
+            continue;
+        UpdateFile(paths[n]);
+        listed.insert(paths[n]);
+        const uint32_t id = FindFile(paths[n]);
+        if (id < FilesCount)
+            seen[id] = true;
+    }
+    if (CancelRequested.load())
+        return;
+
+    // The files that aren't there anymore, or are ignored now
+    std::lock_guard<std::mutex> lock(IndexMutex);
+    for (size_t n = 0; n < FilesCount; n++)
+        if (!seen[n])
+            Masked[n] = true;
+    for (std::map<std::string, ChangedFile>::iterator it = Changed.begin(); it != Changed.end(); )
+    {
+        if (listed.count(it->first) == 0)
+            it = Changed.erase(it);
+        else
+            ++it;
+    }
+}
+
+// Index the file at 'path' (relative to RootDir) again if it changed since it was indexed, a missing file is deleted
+void TrigramIndex::UpdateFile(const std::string& path)
+{
+    const std::string filename = RootDir + path;
+    const uint32_t id = FindFile(path);
+    FileStamp stamp;
+    if (!GetFileStamp(filename.c_str(), &stamp))
+    {
+        std::lock_guard<std::mutex> lock(IndexMutex);
+        Changed.erase(path);
+        if (id < FilesCount)
+            Masked[id] = true;
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(IndexMutex);
+        std::map<std::string, ChangedFile>::const_iterator it = Changed.find(path);
+        if (it != Changed.end() ? it->second.Stamp == stamp : (id < FilesCount && !Masked[id] && Files[id].Size == stamp.Size && Files[id].MTime == stamp.MTime))
+            return;
+    }
+
+    ChangedFile file;
+    file.Stamp = stamp;
+    std::string buffer;
+    ProjectFile contents;
+    if (!contents.Open(filename.c_str(), &buffer))
+        return;
+    if (!IsBinaryText(contents.Data(), contents.Size()))
+        ExtractTrigrams(contents.Data(), contents.Size(), &SeenTrigrams, &file.Trigrams);
+    contents.Close();
+    std::lock_guard<std::mutex> lock(IndexMutex);
+    Changed[path] = std::move(file);
+    if (id < FilesCount)
+        Masked[id] = true;
+}
+
+// Use the index in [data, data + size), checking that it is one. Called with IndexMutex locked.
+bool TrigramIndex::UseIndex(const char* data, size_t size)
+{
+    IndexHeader header;
+    if (data == NULL || size < sizeof(header))
+        return false;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.Magic, INDEX_MAGIC, sizeof(header.Magic)) != 0 || header.TotalSize != size || header.FileCount > 0xFFFFFFFFu ||
+        header.FilesOffset != sizeof(header) ||
+        header.TrigramsOffset != header.FilesOffset + header.FileCount * sizeof(FileEntry) ||
+        header.PostingsOffset != header.TrigramsOffset + header.TrigramCount * sizeof(TrigramEntry) ||
+        header.PathsOffset < header.PostingsOffset || header.PathsOffset > size || header.PathsOffset % 8 != 0)
+        return false;
+    Files = (const FileEntry*)(data + header.FilesOffset);
+    FilesCount = (size_t)header.FileCount;
+    Trigrams = (const TrigramEntry*)(data + header.TrigramsOffset);
+    TrigramsCount = (size_t)header.TrigramCount;
+    Postings = (const uint8_t*)(data + header.PostingsOffset);
+    Paths = data + header.PathsOffset;
+    const size_t postings_size = (size_t)(header.PathsOffset - header.PostingsOffset);
+    const size_t paths_size = size - (size_t)header.PathsOffset;
+    if (paths_size > 0 ? Paths[paths_size - 1] != '\0' : FilesCount > 0)
+        return false;
+    for (size_t n = 0; n < FilesCount; n++)
+        if (Files[n].PathOffset >= paths_size)
+            return false;
+    for (size_t n = 0; n < TrigramsCount; n++)
+        if (Trigrams[n].PostingsOffset + Trigrams[n].Count > postings_size || (n > 0 && Trigrams[n].Trigram <= Trigrams[n - 1].Trigram))
+            return false;
+
+    FileIds.clear();
+    FileIds.reserve(FilesCount);
+    for (size_t n = 0; n < FilesCount; n++)
+        FileIds[Paths + Files[n].PathOffset] = (uint32_t)n;
+    Masked.assign(FilesCount, false);
+    Changed.clear();
+    return true;
+}
+
+// Called with IndexMutex locked
+void TrigramIndex::UnmapIndex()
+{
+    File.Close();
+    IndexBuffer.clear();
+    IndexBuffer.shrink_to_fit();
+    Files = NULL;
+    FilesCount = 0;
+    Trigrams = NULL;
+    TrigramsCount = 0;
+    Postings = NULL;
+    Paths = NULL;
+    FileIds.clear();
+    Masked.clear();
+    Changed.clear();
+}
+
+// The id of the file at 'path' in the index, FilesCount if it isn't in it
+uint32_t TrigramIndex::FindFile(const std::string& path) const
+{
+    std::unordered_map<std::string, uint32_t>::const_iterator it = FileIds.find(path);
+    return it != FileIds.end() ? it->second : (uint32_t)FilesCount;
+}
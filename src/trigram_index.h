@@ -0,0 +1,133 @@
+// Trigram index of the files of a project, so that "Find in files" only reads the files that can match.
+// Every file of the project (see project_files.h) gets an id, and every trigram (3 consecutive bytes, ASCII letters
+// folded to lower case) the list of the files containing it. The files that can contain a literal are in all the
+// lists of its trigrams: ProjectSearch intersects those of the regex's RequiredLiteral() and searches only them.
+//
+// The index is written to FileName in the root directory of the project, and mapped from there when it is opened
+// again. Native byte order, every table 8-byte aligned:
+//   header | files: {path, size, mtime, flags} | trigrams: {trigram, count, postings} sorted | postings | paths
+// A posting list is the ids of the files in increasing order, as varints (LEB128) of the difference to the previous
+// id. The file isn't modified once written. Files saved from the editor (FileChanged()) and the ones Refresh() finds
+// changed on disk (by size and modification time) are indexed again in memory: their old id is masked, and queries
+// check the new trigrams as well. Past MaxChangedFiles, the whole index is rebuilt. Until a refresh is done, queries
+// give up (every file is searched): they would miss the files changed since the last one.
+// Building and refreshing happen on a background thread (the build uses every core). Queries run on the caller's
+// thread: they decode a few posting lists, the time goes into reading the candidate files afterwards.
+
+#pragma once
+
+#include "file_io.h"
+#include "project_files.h"
+#include <stdint.h>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class TrigramIndex
+{
+public:
+    static const char* const FileName;              // In the root directory of the project
+    static const size_t MaxChangedFiles = 4096;     // Indexed in memory. Past this, the index is rebuilt.
+
+    TrigramIndex();
+    ~TrigramIndex();                                // Close()
+
+    // Use the index of the project in 'root' ("" for the current directory, else ending with '/'): map it and
+    // Refresh() it, or build it if there is none (or it can't be read).
+    void        Open(const std::string& root);
+    void        Close();
+
+    // Look for the files created, changed or deleted on disk since they were indexed, in the background
+    void        Refresh();
+
+    // The file at 'path' (as given to the file system: Root() + its path in the project) was written or deleted:
+    // index it again, in the background. Ignored if it isn't in the project.
+    void        FileChanged(const std::string& path);
+
+    const std::string& Root() const                 { return RootDir; }
+    bool        IsOpen() const                      { return Opened; }
+    bool        IsBuilding() const                  { return Building.load(); }
+    float       BuildProgress() const               { return BuildTotal.load() > 0 ? (float)((double)BuildDone.load() / (double)BuildTotal.load()) : 0.0f; }
+    size_t      FileCount() const;                  // Indexed files, binary ones included
+    bool        IsRefreshing() const;               // Candidates() gives up meanwhile
+
+    // The files (relative to Root()) that may contain 'literal'. Returns false when the index can't tell (it is still
+    // being built or refreshed, a changed file isn't indexed yet, or the literal is shorter than a trigram): every file
+    // has to be searched then.
+    bool        Candidates(const std::string& literal, std::vector<std::string>* out) const;
+
+    // The tables of the file
+    struct FileEntry
+    {
+        uint64_t    PathOffset;         // In the paths, NUL-terminated
+        uint64_t    Size;
+        int64_t     MTime;
+        uint32_t    Flags;              // FILE_BINARY: in no posting list
+        uint32_t    Reserved;
+    };
+
+    struct TrigramEntry
+    {
+        uint32_t    Trigram;
+        uint32_t    Count;              // Files in the posting list
+        uint64_t    PostingsOffset;     // In the postings
+    };
+
+private:
+    // A file indexed again since the index was written
+    struct ChangedFile
+    {
+        FileStamp               Stamp;
+        std::vector<uint32_t>   Trigrams;   // Sorted
+    };
+
+    std::string                 RootDir;
+    bool                        Opened;
+
+    // The index, mapped from its file (or read into IndexBuffer), or just built in IndexBuffer. Replaced by the
+    // background thread after a build, under IndexMutex.
+    ProjectFile                 File;
+    std::string                 IndexBuffer;
+    const FileEntry*            Files;
+    size_t                      FilesCount;
+    const TrigramEntry*         Trigrams;
+    size_t                      TrigramsCount;
+    const uint8_t*              Postings;
+    const char*                 Paths;
+    std::unordered_map<std::string, uint32_t> FileIds;     // Only used by the background thread...
+    std::vector<uint64_t>       SeenTrigrams;                   // ...as is this scratch bitset
+
+    // What changed since it was written. Protected by IndexMutex.
+    mutable std::mutex          IndexMutex;
+    std::vector<bool>           Masked;             // By file id
+    std::map<std::string, ChangedFile> Changed;
+
+    // Work of the background thread. Protected by TasksMutex.
+    std::thread                 Thread;
+    mutable std::mutex          TasksMutex;
+    bool                        Running;
+    bool                        BuildRequested;
+    bool                        RefreshRequested;
+    bool                        Updating;           // The thread is refreshing or indexing ChangedPaths
+    std::vector<std::string>    ChangedPaths;       // Relative to RootDir
+    std::atomic<bool>           Building;
+    std::atomic<size_t>         BuildDone;
+    std::atomic<size_t>         BuildTotal;
+    std::atomic<bool>           CancelRequested;
+
+    void        StartThread();
+    void        Run();
+    void        Build();
+    void        RefreshFiles();
+    void        UpdateFile(const std::string& path);
+    bool        UseIndex(const char* data, size_t size);
+    void        UnmapIndex();
+    uint32_t    FindFile(const std::string& path) const;
+
+    TrigramIndex(const TrigramIndex&);
+    TrigramIndex& operator=(const TrigramIndex&);
+};
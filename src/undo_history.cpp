@@ -0,0 +1,217 @@
+// Undo/redo history of a document (see undo_history.h)
+
+#include "undo_history.h"
+
+UndoHistory::UndoHistory(size_t memory_budget)
+{
+    Current = 0;
+    MemoryBudget = memory_budget;
+    LastOpen = false;
+}
+
+void UndoHistory::Clear()
+{
+    Records.clear();
+    Spans.clear();
+    Current = 0;
+    LastOpen = false;
+}
+
+// Move TempSpans to the end of Spans, merging spans that follow each other in memory (e.g. typed characters) as long
+// as they belong to the list starting at 'list_start'
+void UndoHistory::AppendSpans(size_t list_start)
+{
+    for (size_t n = 0; n < TempSpans.size(); n++)
+    {
+        const PieceTableSpan& span = TempSpans[n];
+        if (Spans.size() > list_start && Spans.back().Data + Spans.back().Len == span.Data)
+            Spans.back().Len += span.Len;
+        else
+            Spans.push_back(span);
+    }
+    TempSpans.clear();
+}
+
+void UndoHistory::Replace(PieceTable* text, size_t pos, size_t remove_len, const char* insert, size_t insert_len, bool coalesce)
+{
+    const size_t size = text->Size();
+    if (pos > size)
+        pos = size;
+    if (remove_len > size - pos)
+        remove_len = size - pos;
+    if (remove_len == 0 && insert_len == 0)
+        return;
+    if (coalesce && Coalesce(text, pos, remove_len, insert, insert_len))
+        return;
+
+    AddRecord(text, pos, remove_len, insert, std::unique_ptr<char[]>(), insert_len, coalesce);
+}
+
+void UndoHistory::Replace(PieceTable* text, size_t pos, size_t remove_len, std::unique_ptr<char[]> block, size_t block_len)
+{
+    const size_t size = text->Size();
+    if (pos > size)
+        pos = size;
+    if (remove_len > size - pos)
+        remove_len = size - pos;
+    if (remove_len == 0 && block_len == 0)
+        return;
+    AddRecord(text, pos, remove_len, NULL, std::move(block), block_len, false);
+}
+
+// Make the edit and record it. The text inserted is 'insert', or 'block' when it is set.
+void UndoHistory::AddRecord(PieceTable* text, size_t pos, size_t remove_len, const char* insert, std::unique_ptr<char[]> block, size_t insert_len, bool open)
+{
+    // A new edit drops what could be redone
+    if (Current < Records.size())
+    {
+        Spans.resize(Records[Current].FirstSpan);
+        Records.resize(Current);
+    }
+
+    Record record;
+    record.Pos = pos;
+    record.RemovedLen = remove_len;
+    record.InsertedLen = insert_len;
+    record.FirstSpan = Spans.size();
+    text->GetSpans(pos, remove_len, &TempSpans);
+    AppendSpans(record.FirstSpan);
+    record.RemovedSpans = Spans.size() - record.FirstSpan;
+
+    text->Erase(pos, remove_len);
+    if (block)
+        text->InsertBlock(pos, std::move(block), insert_len);
+    else
+        text->Insert(pos, insert, insert_len);
+    text->GetSpans(pos, insert_len, &TempSpans);
+    AppendSpans(record.FirstSpan + record.RemovedSpans);
+    record.InsertedSpans = Spans.size() - record.FirstSpan - record.RemovedSpans;
+
+    Records.push_back(record);
+    Current = Records.size();
+    LastOpen = open;
+    TrimToBudget();
+}
+
+// Apply the edit and merge it into the last record if it continues it. Returns false (and does nothing) otherwise.
+bool UndoHistory::Coalesce(PieceTable* text, size_t pos, size_t remove_len, const char* insert, size_t insert_len)
+{
+    if (!LastOpen || Current == 0 || Current != Records.size())
+        return false;
+    Record& record = Records.back();
+    const size_t inserted_start = record.FirstSpan + record.RemovedSpans;
+
+    // Typing after the previous edit
+    if (remove_len == 0 && pos == record.Pos + record.InsertedLen)
+    {
+        text->Insert(pos, insert, insert_len);
+        text->GetSpans(pos, insert_len, &TempSpans);
+        AppendSpans(inserted_start);
+        record.InsertedSpans = Spans.size() - inserted_start;
+        record.InsertedLen += insert_len;
+        return true;
+    }
+
+    // Backspacing over what the previous edit typed
+    if (insert_len == 0 && remove_len <= record.InsertedLen && pos + remove_len == record.Pos + record.InsertedLen)
+    {
+        text->Erase(pos, remove_len);
+        record.InsertedLen -= remove_len;
+        for (size_t len = remove_len; len > 0; )
+        {
+            PieceTableSpan& last = Spans.back();
+            if (last.Len > len)
+            {
+                last.Len -= len;
+                break;
+            }
+            len -= last.Len;
+            Spans.pop_back();
+            record.InsertedSpans--;
+        }
+        if (record.RemovedLen == 0 && record.InsertedLen == 0)
+        {
+            Records.pop_back();
+            Current--;
+            LastOpen = false;
+        }
+        return true;
+    }
+
+    // Deleting right before (backspace) or at (delete) the previous deletion
+    if (insert_len == 0 && record.InsertedLen == 0 && (pos + remove_len == record.Pos || pos == record.Pos))
+    {
+        text->GetSpans(pos, remove_len, &TempSpans);
+        text->Erase(pos, remove_len);
+        if (pos == record.Pos)
+        {
+            AppendSpans(record.FirstSpan);
+        }
+        else
+        {
+            // Prepend. The last record's spans are at the end of Spans so this only moves them.
+            PieceTableSpan& first = Spans[record.FirstSpan];
+            if (TempSpans.back().Data + TempSpans.back().Len == first.Data)
+            {
+                first.Data = TempSpans.back().Data;
+                first.Len += TempSpans.back().Len;
+                TempSpans.pop_back();
+            }
+            Spans.insert(Spans.begin() + (ptrdiff_t)record.FirstSpan, TempSpans.begin(), TempSpans.end());
+            TempSpans.clear();
+            record.Pos = pos;
+        }
+        record.RemovedSpans = Spans.size() - record.FirstSpan;
+        record.RemovedLen += remove_len;
+        return true;
+    }
+    return false;
+}
+
+// Forget the oldest edits when over budget, down to 3/4 of it so that this doesn't happen on every edit
+void UndoHistory::TrimToBudget()
+{
+    size_t usage = MemoryUsage();
+    if (usage <= MemoryBudget)
+        return;
+    size_t drop = 0;
+    while (drop < Current && usage > MemoryBudget / 4 * 3)
+    {
+        usage -= sizeof(Record) + (Records[drop].RemovedSpans + Records[drop].InsertedSpans) * sizeof(PieceTableSpan);
+        drop++;
+    }
+    if (drop == 0)
+        return;
+    const size_t first_span = drop < Records.size() ? Records[drop].FirstSpan : Spans.size();
+    Spans.erase(Spans.begin(), Spans.begin() + (ptrdiff_t)first_span);
+    Records.erase(Records.begin(), Records.begin() + (ptrdiff_t)drop);
+    for (size_t n = 0; n < Records.size(); n++)
+        Records[n].FirstSpan -= first_span;
+    Current -= drop;
+    if (Current == 0)
+        LastOpen = false;
+}
+
+bool UndoHistory::Undo(PieceTable* text, size_t* out_cursor)
+{
+    if (Current == 0)
+        return false;
+    const Record& record = Records[--Current];
+    text->Erase(record.Pos, record.InsertedLen);
+    text->InsertSpans(record.Pos, Spans.data() + record.FirstSpan, record.RemovedSpans);
+    *out_cursor = record.Pos + record.RemovedLen;
+    LastOpen = false;
+    return true;
+}
+
+bool UndoHistory::Redo(PieceTable* text, size_t* out_cursor)
+{
+    if (Current == Records.size())
+        return false;
+    const Record& record = Records[Current++];
+    text->Erase(record.Pos, record.RemovedLen);
+    text->InsertSpans(record.Pos, Spans.data() + record.FirstSpan + record.RemovedSpans, record.InsertedSpans);
+    *out_cursor = record.Pos + record.InsertedLen;
+    LastOpen = false;
+    return true;
+}
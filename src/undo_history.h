@@ -0,0 +1,63 @@
+// Undo/redo history of a document.
+// An edit is recorded as (position, removed spans, inserted spans) where the spans point into the piece table's
+// blocks. Blocks are immutable and live as long as the table, so no text is copied: undoing a 1 GB paste or delete
+// costs what the edit itself cost, and the history takes a few dozen bytes per edit. The number of edits is only
+// limited by a memory budget, the oldest edits are forgotten past it. Consecutive typing and deleting coalesce into
+// one edit.
+// Spans are only valid for the table they were taken from: Clear() the history when the text is Load()ed or Clear()ed.
+
+#pragma once
+
+#include "piece_table.h"
+#include <memory>
+#include <vector>
+
+class UndoHistory
+{
+public:
+    static const size_t DefaultMemoryBudget = 16 * 1024 * 1024;
+
+    UndoHistory(size_t memory_budget = DefaultMemoryBudget);
+
+    void        Clear();
+    bool        CanUndo() const                     { return Current > 0; }
+    bool        CanRedo() const                     { return Current < Records.size(); }
+    size_t      MemoryUsage() const                 { return Records.size() * sizeof(Record) + Spans.size() * sizeof(PieceTableSpan); }
+
+    // Replace [pos, pos + remove_len) of 'text' with 'insert' and record it, dropping what could be redone.
+    // With 'coalesce', an edit that continues the previous one (typing after it, deleting right before or after it,
+    // or backspacing over what it typed) is merged into it and both are undone at once.
+    void        Replace(PieceTable* text, size_t pos, size_t remove_len, const char* insert, size_t insert_len, bool coalesce);
+
+    // Same with a block the table takes ownership of (see PieceTable::InsertBlock()). Never coalesced.
+    void        Replace(PieceTable* text, size_t pos, size_t remove_len, std::unique_ptr<char[]> block, size_t block_len);
+
+    // Return false when there is nothing to undo/redo, else set 'out_cursor' to the end of the restored text.
+    bool        Undo(PieceTable* text, size_t* out_cursor);
+    bool        Redo(PieceTable* text, size_t* out_cursor);
+
+private:
+    // The spans of a record are Spans[FirstSpan, FirstSpan + RemovedSpans) then the inserted ones. Records and their
+    // spans are stored in order, so the spans of the last record are at the end of Spans.
+    struct Record
+    {
+        size_t  Pos;
+        size_t  RemovedLen;
+        size_t  InsertedLen;
+        size_t  FirstSpan;
+        size_t  RemovedSpans;
+        size_t  InsertedSpans;
+    };
+
+    std::vector<Record>         Records;
+    std::vector<PieceTableSpan> Spans;
+    std::vector<PieceTableSpan> TempSpans;
+    size_t                      Current;            // Records[0, Current) can be undone, the rest redone
+    size_t                      MemoryBudget;
+    bool                        LastOpen;           // The last record may be extended by the next coalescing edit
+
+    bool        Coalesce(PieceTable* text, size_t pos, size_t remove_len, const char* insert, size_t insert_len);
+    void        AddRecord(PieceTable* text, size_t pos, size_t remove_len, const char* insert, std::unique_ptr<char[]> block, size_t insert_len, bool open);
+    void        AppendSpans(size_t list_start);
+    void        TrimToBudget();
+};
@@ -0,0 +1,235 @@
+// Word-wrapped layout of a text (see wrap_layout.h)
+
+#ifndef IMGUI_DEFINE_MATH_OPERATORS
+#define IMGUI_DEFINE_MATH_OPERATORS
+#endif
+#include "wrap_layout.h"
+#include "imgui_internal.h"
+#include <string.h>
+#include <algorithm>
+#include <thread>
+
+const size_t WrapLayout::ParallelMinBytes;
+
+WrapLayout::WrapLayout()
+{
+    FirstStale = 0;
+    Font = NULL;
+    FontSize = 0.0f;
+    WrapWidth = 0.0f;
+    SetText(std::string());
+}
+
+void WrapLayout::SetText(const std::string& text)
+{
+    std::vector<Line> lines;
+    const char* data = text.data();
+    size_t begin = 0;
+    for (;;)
+    {
+        const char* eol = (const char*)memchr(data + begin, '\n', text.size() - begin);
+        Line line;
+        line.Begin = begin;
+        line.End = eol != NULL ? (size_t)(eol - data) : text.size();
+        line.OldBegin = begin;
+        line.FirstRow = line.RowCount = 0;
+        line.Stale = true;
+
+        // Same as the line it replaces: its rows only move with it. An empty line has no row if it is the last one.
+        const size_t n = lines.size();
+        const size_t len = line.End - line.Begin;
+        const bool same_last = (n + 1 == Lines.size()) == (eol == NULL);
+        if (n < Lines.size() && !Lines[n].Stale && Lines[n].End - Lines[n].Begin == len && (len > 0 || same_last) && memcmp(data + line.Begin, Text.data() + Lines[n].Begin, len) == 0)
+        {
+            line.OldBegin = Lines[n].OldBegin;
+            line.FirstRow = Lines[n].FirstRow;
+            line.RowCount = Lines[n].RowCount;
+            line.Stale = false;
+        }
+        lines.push_back(line);
+        if (eol == NULL)
+            break;
+        begin = line.End + 1;
+    }
+    Text = text;
+    Lines.swap(lines);
+
+    // The lines before the first one changed or moved keep their rows in place
+    FirstStale = 0;
+    while (FirstStale < Lines.size() && !Lines[FirstStale].Stale && Lines[FirstStale].Begin == Lines[FirstStale].OldBegin)
+        FirstStale++;
+    if (FirstStale == Lines.size())
+        Rows.resize(Lines.back().FirstRow + Lines.back().RowCount);
+}
+
+void WrapLayout::Append(const std::string& text)
+{
+    if (text.empty())
+        return;
+    // The last line goes on with the text, which may start more lines
+    const size_t old_size = Text.size();
+    Text += text;
+    const char* data = Text.data();
+    Lines.back().Stale = true;
+    FirstStale = std::min(FirstStale, Lines.size() - 1);
+    for (size_t begin = old_size; ; )
+    {
+        const char* eol = (const char*)memchr(data + begin, '\n', Text.size() - begin);
+        Lines.back().End = eol != NULL ? (size_t)(eol - data) : Text.size();
+        if (eol == NULL)
+            break;
+        begin = Lines.back().End + 1;
+        Line line;
+        line.Begin = line.End = line.OldBegin = begin;
+        line.FirstRow = line.RowCount = 0;
+        line.Stale = true;
+        Lines.push_back(line);
+    }
+}
+
+void WrapLayout::Layout(ImFont* font, float size, float wrap_width)
+{
+    if (font != Font || size != FontSize || wrap_width != WrapWidth)
+    {
+        for (size_t n = 0; n < Lines.size(); n++)
+            Lines[n].Stale = true;
+        FirstStale = 0;
+        Font = font;
+        FontSize = size;
+        WrapWidth = wrap_width;
+    }
+    if (FirstStale == Lines.size())
+        return;
+
+    // Split the lines from FirstStale into about as many bytes per worker. Lines that didn't change are counted
+    // though they are only copied, most texts laid out in parallel are laid out again as a whole anyway.
+    const size_t begin = Lines[FirstStale].Begin;
+    const size_t bytes = Lines.back().End - begin;
+    const size_t worker_count = std::max((size_t)1, std::min((size_t)std::max(1u, std::thread::hardware_concurrency()), bytes / ParallelMinBytes));
+    std::vector<size_t> splits;                 // First line of each worker, then the end
+    splits.push_back(FirstStale);
+    for (size_t n = 1; n < worker_count; n++)
+    {
+        const size_t target = begin + bytes / worker_count * n;
+        size_t lo = splits.back();
+        size_t hi = Lines.size();
+        while (lo < hi)
+        {
+            const size_t mid = (lo + hi) / 2;
+            if (Lines[mid].Begin < target)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        splits.push_back(lo);
+    }
+    splits.push_back(Lines.size());
+
+    std::vector<std::vector<Row> > rows(worker_count);
+    if (worker_count == 1)
+    {
+        LayOutLines(splits[0], splits[1], &rows[0]);
+    }
+    else
+    {
+        std::vector<std::thread> workers;
+        for (size_t n = 0; n < worker_count; n++)
+            workers.push_back(std::thread(&WrapLayout::LayOutLines, this, splits[n], splits[n + 1], &rows[n]));
+        for (size_t n = 0; n < workers.size(); n++)
+            workers[n].join();
+    }
+
+    // The rows of each worker start after those of the workers before it
+    Rows.resize(FirstStale > 0 ? Lines[FirstStale - 1].FirstRow + Lines[FirstStale - 1].RowCount : 0);
+    for (size_t n = 0; n < worker_count; n++)
+    {
+        const size_t base = Rows.size();
+        for (size_t line = splits[n]; line < splits[n + 1]; line++)
+            Lines[line].FirstRow += base;
+        Rows.insert(Rows.end(), rows[n].begin(), rows[n].end());
+    }
+    FirstStale = Lines.size();
+}
+
+// Lay out lines [first_line, end_line) into 'out_rows', their FirstRow relative to its start. Lines that aren't stale
+// copy their rows from Rows. Runs on worker threads: only touches those lines.
+void WrapLayout::LayOutLines(size_t first_line, size_t end_line, std::vector<Row>* out_rows)
+{
+    const float scale = FontSize / Font->FontSize;
+    const char* text = Text.data();
+    for (size_t n = first_line; n < end_line; n++)
+    {
+        Line& line = Lines[n];
+        const size_t first_row = out_rows->size();
+        if (n > 0 && n + 1 == Lines.size() && line.Begin == line.End)
+        {
+            // After the last '\n': nothing to draw, ImGui doesn't give it a row either
+        }
+        else if (!line.Stale)
+        {
+            for (size_t row = line.FirstRow; row < line.FirstRow + line.RowCount; row++)
+            {
+                Row moved = { Rows[row].Begin - line.OldBegin + line.Begin, Rows[row].End - line.OldBegin + line.Begin };
+                out_rows->push_back(moved);
+            }
+        }
+        else
+        {
+            // Where ImFont::RenderText() would break the line: the blanks at a break are skipped, on neither row
+            const char* s = text + line.Begin;
+            const char* line_end = text + line.End;
+            for (;;)
+            {
+                const char* eol = s < line_end && WrapWidth > 0.0f ? Font->CalcWordWrapPositionA(scale, s, line_end, WrapWidth) : line_end;
+                if (eol >= line_end)
+                {
+                    Row row = { (size_t)(s - text), line.End };
+                    out_rows->push_back(row);
+                    break;
+                }
+                Row row = { (size_t)(s - text), (size_t)(eol - text) };
+                out_rows->push_back(row);
+                s = eol;
+                while (s < line_end && (*s == ' ' || *s == '\t'))
+                    s++;
+                if (s == line_end)
+                    break;
+            }
+        }
+        line.FirstRow = first_row;
+        line.RowCount = out_rows->size() - first_row;
+        line.OldBegin = line.Begin;
+        line.Stale = false;
+    }
+}
+
+void WrappedText(WrapLayout* layout, float wrap_width)
+{
+    using namespace ImGui;
+    ImGuiWindow* window = GetCurrentWindow();
+    if (window->SkipItems)
+        return;
+
+    ImGuiContext& g = *GImGui;
+    layout->Layout(g.Font, g.FontSize, wrap_width);
+    const ImVec2 pos(window->DC.CursorPos.x, window->DC.CursorPos.y + window->DC.CurrLineTextBaseOffset);
+    const ImRect bb(pos, pos + ImVec2(wrap_width, layout->RowCount() * g.FontSize));
+    ItemSize(bb.GetSize(), 0.0f);
+    if (!ItemAdd(bb, 0))
+        return;
+
+    // Only the rows in the clip rect
+    const float clip_min_y = ImMax(window->ClipRect.Min.y, bb.Min.y);
+    const float clip_max_y = ImMin(window->ClipRect.Max.y, bb.Max.y);
+    if (clip_max_y <= clip_min_y)
+        return;
+    const size_t first_row = (size_t)((clip_min_y - pos.y) / g.FontSize);
+    const size_t end_row = ImMin((size_t)((clip_max_y - pos.y) / g.FontSize) + 1, layout->RowCount());
+    const ImU32 col = GetColorU32(ImGuiCol_Text);
+    const char* text = layout->GetText().c_str();
+    for (size_t row = first_row; row < end_row; row++)
+    {
+        const WrapLayout::Row& r = layout->GetRow(row);
+        window->DrawList->AddText(g.Font, g.FontSize, ImVec2(pos.x, pos.y + row * g.FontSize), col, text + r.Begin, text + r.End);
+    }
+}
@@ -0,0 +1,73 @@
+// Word-wrapped layout of a text, cached between frames.
+// ImGui wraps text as it draws it: every frame, every character of a wrapped string is measured again to find where its
+// lines break (ImFont::CalcWordWrapPositionA), visible or not. WrapLayout finds the breaks of each line of a text once,
+// with the same rules, and keeps them as rows until the text, the font, its size or the wrap width change. Setting a
+// new text keeps the rows of the lines that didn't change, and appending to it (a log that grows) only lays out what
+// was appended; a new font, size or width lays out every line again, on all cores for long texts. Drawing it is then an
+// AddText() per visible row, found by their index: the cost of a frame depends on the rows shown, not on the length of
+// the text.
+
+#pragma once
+
+#include "imgui.h"
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+class WrapLayout
+{
+public:
+    // Bytes laid out by each worker thread at least, when many lines are laid out at once
+    static const size_t ParallelMinBytes = 256 * 1024;
+
+    // [Begin, End) of Text, drawn on one row
+    struct Row
+    {
+        size_t      Begin;
+        size_t      End;
+    };
+
+    WrapLayout();
+
+    // Lines equal to the line at the same index in the previous text keep their rows
+    void        SetText(const std::string& text);
+    void        Append(const std::string& text);   // Only lays out the last line again, and the lines added
+    const std::string& GetText() const              { return Text; }
+
+    // Break the lines that aren't laid out yet for 'font' at 'size' pixels, to fit 'wrap_width' pixels. Nothing to do
+    // if neither they nor the text changed since the last call.
+    void        Layout(ImFont* font, float size, float wrap_width);
+
+    size_t      RowCount() const                    { return Rows.size(); }
+    const Row&  GetRow(size_t row) const            { return Rows[row]; }
+    size_t      LineCount() const                   { return Lines.size(); }
+    size_t      LineFirstRow(size_t line) const     { return Lines[line].FirstRow; }
+
+private:
+    struct Line
+    {
+        size_t      Begin;              // In Text
+        size_t      End;                // Before its '\n' (or the end of the text)
+        size_t      OldBegin;           // Where it was in the text its rows were laid out for
+        size_t      FirstRow;           // Its rows in Rows...
+        size_t      RowCount;           // ...or in the Rows of the last Layout(), if the line moved since
+        bool        Stale;              // Changed since the last Layout(), has no rows
+    };
+
+    std::string         Text;
+    std::vector<Line>   Lines;
+    std::vector<Row>    Rows;
+    size_t              FirstStale;     // Lines before it keep their rows where they are, Lines.size() if none changed
+    ImFont*             Font;           // What the rows were laid out for
+    float               FontSize;
+    float               WrapWidth;
+
+    void        LayOutLines(size_t first_line, size_t end_line, std::vector<Row>* out_rows);
+
+    WrapLayout(const WrapLayout&);
+    WrapLayout& operator=(const WrapLayout&);
+};
+
+// Draw the rows of 'layout' visible in the current window, laid out for the current font to wrap at 'wrap_width'
+// pixels from the cursor. Takes the space of the whole text, like ImGui::TextWrapped() would.
+void WrappedText(WrapLayout* layout, float wrap_width);